@@ -0,0 +1,142 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <taskflow/taskflow.hpp>
+#include <thread>
+#include <typeindex>
+#include <utility>
+
+#include "atlas/core/IEngine.hpp"
+#include "atlas/core/time/EngineClock.hpp"
+#include "hephaestus/Component.hpp"
+#include "hephaestus/World.hpp"
+
+namespace atlas::hephaestus::bench {
+// Distinct component types for the cases which are parameterized over the number of components.
+template <std::size_t Index>
+struct Value : public Component<Value<Index>> {
+    float value = 1.F;
+};
+
+constexpr std::size_t MAX_VALUES = 8;
+
+// 1k to 10M entities, in steps of 10x.
+inline auto entity_counts(benchmark::internal::Benchmark* bench) -> void {
+    constexpr std::int64_t MIN_ENTITIES = 1'000;
+    constexpr std::int64_t MAX_ENTITIES = 10'000'000;
+    bench->RangeMultiplier(10)
+        ->Range(MIN_ENTITIES, MAX_ENTITIES)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+}
+
+// The executors are shared by every case, spawning the workers isn't part of what is measured.
+inline auto get_serial_executor() -> tf::Executor& {
+    static tf::Executor executor{1};
+    return executor;
+}
+
+inline auto get_parallel_executor() -> tf::Executor& {
+    static tf::Executor executor{std::thread::hardware_concurrency()};
+    return executor;
+}
+
+// Just enough of an engine to own a World, the benchmarks tick the frame graph of the world
+// themselves instead of going through the Hephaestus module and the game loop.
+class BenchEngine final : public core::IEngine {
+  public:
+    BenchEngine() = default;
+    ~BenchEngine() override = default;
+
+    BenchEngine(const BenchEngine&) = delete;
+    auto operator=(const BenchEngine&) -> BenchEngine& = delete;
+
+    BenchEngine(BenchEngine&&) = delete;
+    auto operator=(BenchEngine&&) -> BenchEngine& = delete;
+
+    auto run() -> void override {}
+
+    [[nodiscard]] auto get_game() -> core::IGame& override {
+        assert(false && "The benchmarks run the worlds without a game.");
+        std::abort();
+    }
+
+    [[nodiscard]] auto get_clock() const -> const core::IEngineClock& override {
+        return clock;
+    }
+
+    [[nodiscard]] auto get_engine_init_status() const -> core::EngineInitStatus override {
+        return init_status;
+    }
+
+    auto set_engine_init_status(const core::EngineInitStatus status) -> void {
+        init_status = status;
+    }
+
+  protected:
+    [[nodiscard]] auto get_module_impl(std::type_index module) const -> core::IModule* override {
+        return nullptr;
+    }
+
+  private:
+    core::EngineClock clock;
+    core::EngineInitStatus init_status = core::EngineInitStatus::RunningStart;
+};
+
+// A world in the start phase, archetypes and systems are created before calling start.
+class BenchWorld final {
+  public:
+    BenchWorld()
+        : world{engine, 0} {}
+    ~BenchWorld() = default;
+
+    BenchWorld(const BenchWorld&) = delete;
+    auto operator=(const BenchWorld&) -> BenchWorld& = delete;
+
+    BenchWorld(BenchWorld&&) = delete;
+    auto operator=(BenchWorld&&) -> BenchWorld& = delete;
+
+    [[nodiscard]] auto get() -> World& {
+        return world;
+    }
+
+    auto start() -> void {
+        world.build_graph(1);
+        engine.set_engine_init_status(core::EngineInitStatus::Initialized);
+    }
+
+    auto tick(tf::Executor& executor) -> void {
+        executor.run(world.get_frame_graph()).wait();
+    }
+
+  private:
+    BenchEngine engine;
+    World world;
+};
+
+// Queues num_entities entities with the components Value<Indices>...
+template <std::size_t... Indices>
+auto queue_entities(
+    World& world,
+    const std::size_t num_entities,
+    std::index_sequence<Indices...> /*components*/
+) -> void {
+    for (std::size_t i = 0; i < num_entities; ++i) {
+        world.create_entity(Value<Indices>{}...);
+    }
+}
+
+// Pre-creates the archetype of Value<Indices>..., sized for num_entities.
+template <std::size_t... Indices>
+auto reserve_archetype(
+    World& world,
+    const std::size_t num_entities,
+    std::index_sequence<Indices...> /*components*/
+) -> void {
+    world.create_archetype<Value<Indices>...>(static_cast<std::uint32_t>(num_entities));
+}
+} // namespace atlas::hephaestus::bench
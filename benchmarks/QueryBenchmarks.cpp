@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <vector>
+
+#include "BenchCommon.hpp"
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/ComponentVersions.hpp"
+#include "hephaestus/SparseSet.hpp"
+#include "hephaestus/Utils.hpp"
+#include "hephaestus/query/Query.hpp"
+
+namespace atlas::hephaestus::bench {
+namespace {
+// The storage a Query reads from, filled directly instead of going through a World so only the
+// query itself is measured.
+struct QueryStorage final {
+    ArchetypeMap archetypes;
+    SparseSets sparse_sets;
+    ComponentVersions versions;
+    Entity next_entity = 0;
+
+    template <AllTypeOfComponent... ComponentTypes>
+    auto add_archetype(const std::size_t num_entities) -> void {
+        auto archetype = std::make_unique<Archetype>(static_cast<std::uint32_t>(num_entities));
+        for (std::size_t i = 0; i < num_entities; ++i) {
+            archetype->create_entity<ComponentTypes...>(next_entity++, ComponentTypes{}...);
+        }
+        archetypes.emplace(make_archetype_key<ComponentTypes...>(), std::move(archetype));
+    }
+};
+
+// The entities are spread over four archetypes which all match the query, each with an extra
+// component the query doesn't read.
+auto fill(QueryStorage& storage, const std::size_t num_entities) -> void {
+    const auto per_archetype = num_entities / 4;
+    storage.add_archetype<Value<0>, Value<1>, Value<2>, Value<4>>(per_archetype);
+    storage.add_archetype<Value<0>, Value<1>, Value<2>, Value<5>>(per_archetype);
+    storage.add_archetype<Value<0>, Value<1>, Value<2>, Value<6>>(per_archetype);
+    storage.add_archetype<Value<0>, Value<1>, Value<2>, Value<7>>(
+        num_entities - (3 * per_archetype)
+    );
+}
+
+using BenchQuery = Query<Value<0>, Value<1>, Value<2>>;
+
+// A query which has never run, matching the archetypes and building its cache from scratch.
+auto query_get_cold(benchmark::State& state) -> void {
+    QueryStorage storage;
+    fill(storage, static_cast<std::size_t>(state.range(0)));
+
+    for (auto _ : state) {
+        const BenchQuery query{
+            storage.archetypes,
+            storage.sparse_sets,
+            storage.versions,
+            std::pmr::get_default_resource(),
+            {}
+        };
+        benchmark::DoNotOptimize(query.get().data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// A query whose cache is still valid, the cost of every system execution without structural
+// changes.
+auto query_get_warm(benchmark::State& state) -> void {
+    QueryStorage storage;
+    fill(storage, static_cast<std::size_t>(state.range(0)));
+
+    const BenchQuery query{
+        storage.archetypes,
+        storage.sparse_sets,
+        storage.versions,
+        std::pmr::get_default_resource(),
+        {}
+    };
+    benchmark::DoNotOptimize(query.get().data());
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(query.get().data());
+    }
+}
+
+// Every archetype gets the bits of its index as components, shifted by one so none is empty.
+// Returns the keys in the order they were added.
+auto fill_archetypes(ArchetypeMap& archetypes, const std::size_t num_archetypes)
+    -> std::vector<ArchetypeKey> {
+    std::vector<ArchetypeKey> keys;
+    keys.reserve(num_archetypes);
+    for (std::size_t index = 1; index <= num_archetypes; ++index) {
+        ArchetypeKey key;
+        for (std::size_t bit = 0; (index >> bit) != 0; ++bit) {
+            if (((index >> bit) & 1U) != 0) {
+                key.add_component(bit);
+            }
+        }
+        archetypes.emplace(key, std::make_unique<Archetype>(0));
+        keys.emplace_back(key);
+    }
+    return keys;
+}
+
+// Finding the id of an existing archetype, as done for every created entity. Parameterized over
+// the number of archetypes, the entity count doesn't affect it.
+auto find_archetype(benchmark::State& state) -> void {
+    const auto num_archetypes = static_cast<std::size_t>(state.range(0));
+    ArchetypeMap archetypes;
+    auto keys = fill_archetypes(archetypes, num_archetypes);
+
+    // Visits the keys in a fixed random order, so the lookups don't walk the table in order.
+    std::ranges::shuffle(keys, std::mt19937{42});
+    std::size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(archetypes.find_id(keys[next]));
+        next = next + 1 == keys.size() ? 0 : next + 1;
+    }
+}
+
+// A pass of query matching over every archetype, as done when a query cache is rebuilt.
+auto match_archetypes(benchmark::State& state) -> void {
+    ArchetypeMap archetypes;
+    fill_archetypes(archetypes, static_cast<std::size_t>(state.range(0)));
+
+    ArchetypeKey query_key;
+    query_key.add_component(0).add_component(1);
+    for (auto _ : state) {
+        std::size_t matched = 0;
+        for (const auto& [key, archetype] : archetypes) {
+            matched += query_key.is_subset_of(key) ? 1 : 0;
+        }
+        benchmark::DoNotOptimize(matched);
+    }
+}
+} // namespace
+
+BENCHMARK(query_get_cold)->Apply(entity_counts);
+BENCHMARK(query_get_warm)->Apply(entity_counts)->Unit(benchmark::kNanosecond);
+BENCHMARK(find_archetype)->RangeMultiplier(8)->Range(8, 4096);
+BENCHMARK(match_archetypes)->Arg(10)->Arg(1000)->Arg(10000);
+} // namespace atlas::hephaestus::bench
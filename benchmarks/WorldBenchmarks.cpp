@@ -0,0 +1,272 @@
+#include <array>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <tuple>
+#include <utility>
+
+#include "BenchCommon.hpp"
+#include "atlas/core/IEngine.hpp"
+#include "hephaestus/World.hpp"
+#include "hephaestus/WorldSnapshot.hpp"
+
+namespace atlas::hephaestus::bench {
+namespace {
+constexpr std::size_t NUM_CREATED_COMPONENTS = 4;
+
+enum class Execution : std::uint8_t {
+    Serial,
+    Parallel,
+};
+
+// Queueing the entities and applying the queue in the next frame.
+auto create_entities(benchmark::State& state) -> void {
+    const auto num_entities = static_cast<std::size_t>(state.range(0));
+    constexpr auto COMPONENTS = std::make_index_sequence<NUM_CREATED_COMPONENTS>{};
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto bench_world = std::make_unique<BenchWorld>();
+        reserve_archetype(bench_world->get(), num_entities, COMPONENTS);
+        bench_world->start();
+        state.ResumeTiming();
+
+        queue_entities(bench_world->get(), num_entities, COMPONENTS);
+        bench_world->tick(get_parallel_executor());
+
+        state.PauseTiming();
+        bench_world.reset();
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Same as create_entities, but as a single batch cloning a prefab row.
+auto instantiate_prefab(benchmark::State& state) -> void {
+    const auto num_entities = static_cast<std::size_t>(state.range(0));
+    constexpr auto COMPONENTS = std::make_index_sequence<NUM_CREATED_COMPONENTS>{};
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto bench_world = std::make_unique<BenchWorld>();
+        auto& world = bench_world->get();
+        reserve_archetype(world, num_entities, COMPONENTS);
+        const auto prefab = world.create_prefab(Value<0>{}, Value<1>{}, Value<2>{}, Value<3>{});
+        bench_world->start();
+        state.ResumeTiming();
+
+        world.instantiate(prefab, num_entities);
+        bench_world->tick(get_parallel_executor());
+
+        state.PauseTiming();
+        bench_world.reset();
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Queueing every entity for destruction and applying the queue at the end of the frame.
+auto destroy_entities(benchmark::State& state) -> void {
+    const auto num_entities = static_cast<std::size_t>(state.range(0));
+    constexpr auto COMPONENTS = std::make_index_sequence<NUM_CREATED_COMPONENTS>{};
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto bench_world = std::make_unique<BenchWorld>();
+        auto& world = bench_world->get();
+        reserve_archetype(world, num_entities, COMPONENTS);
+        queue_entities(world, num_entities, COMPONENTS);
+        bench_world->start();
+        bench_world->tick(get_parallel_executor());
+        state.ResumeTiming();
+
+        for (Entity entity = 0; entity < num_entities; ++entity) {
+            world.destroy_entity(entity);
+        }
+        bench_world->tick(get_parallel_executor());
+
+        state.PauseTiming();
+        bench_world.reset();
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Writes Value<0> and reads the other components.
+template <std::size_t... Indices>
+auto create_value_system(World& world, std::index_sequence<Indices...> /*read_components*/)
+    -> void {
+    world.create_system([](const core::IEngine& engine,
+                           std::tuple<Value<0>&, const Value<Indices + 1>&...> components) {
+        std::get<0>(components).value += (std::get<Indices + 1>(components).value + ... + 1.F);
+    });
+}
+
+// A frame with a single system over NumComponents components, with the query cache warm. Every
+// entity has all the components, only the width of the tuple changes.
+template <std::size_t NumComponents, Execution ExecutionType>
+auto execute_system(benchmark::State& state) -> void {
+    static_assert(NumComponents >= 1 && NumComponents <= MAX_VALUES);
+
+    const auto num_entities = static_cast<std::size_t>(state.range(0));
+    constexpr auto COMPONENTS = std::make_index_sequence<MAX_VALUES>{};
+    auto& executor = ExecutionType == Execution::Serial ? get_serial_executor()
+                                                        : get_parallel_executor();
+
+    BenchWorld bench_world;
+    auto& world = bench_world.get();
+    reserve_archetype(world, num_entities, COMPONENTS);
+    queue_entities(world, num_entities, COMPONENTS);
+    create_value_system(world, std::make_index_sequence<NumComponents - 1>{});
+    bench_world.start();
+    bench_world.tick(executor);
+
+    for (auto _ : state) {
+        bench_world.tick(executor);
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Every system writes one component and reads another, which gives a dense but realistic mix of
+// conflicting and independent systems.
+template <std::size_t Written, std::size_t Read>
+auto create_pair_system(World& world) -> void {
+    world.create_system([](const core::IEngine& engine,
+                           std::tuple<Value<Written>&, const Value<Read>&> components) {
+        std::get<0>(components).value += std::get<1>(components).value;
+    });
+}
+
+template <std::size_t... Indices>
+constexpr auto make_pair_systems(std::index_sequence<Indices...> /*indices*/) {
+    return std::array{&create_pair_system<Indices, (Indices + 1) % MAX_VALUES>...};
+}
+
+// Building the dependency graph, and with it the frame graph, of a world with N systems.
+auto build_graph(benchmark::State& state) -> void {
+    const auto num_systems = static_cast<std::size_t>(state.range(0));
+    constexpr auto PAIR_SYSTEMS = make_pair_systems(std::make_index_sequence<MAX_VALUES>{});
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto bench_world = std::make_unique<BenchWorld>();
+        for (std::size_t i = 0; i < num_systems; ++i) {
+            PAIR_SYSTEMS[i % PAIR_SYSTEMS.size()](bench_world->get());
+        }
+        state.ResumeTiming();
+
+        bench_world->start();
+
+        state.PauseTiming();
+        bench_world.reset();
+        state.ResumeTiming();
+    }
+}
+
+// Loading a snapshot of N entities into an empty world, the file is in the page cache.
+auto load_snapshot(benchmark::State& state) -> void {
+    const auto num_entities = static_cast<std::size_t>(state.range(0));
+    constexpr auto COMPONENTS = std::make_index_sequence<NUM_CREATED_COMPONENTS>{};
+    const auto path = std::filesystem::temp_directory_path() / "hephaestus_bench_snapshot.bin";
+
+    SnapshotSchema schema;
+    schema.register_components<Value<0>, Value<1>, Value<2>, Value<3>>();
+    {
+        BenchWorld bench_world;
+        reserve_archetype(bench_world.get(), num_entities, COMPONENTS);
+        queue_entities(bench_world.get(), num_entities, COMPONENTS);
+        bench_world.start();
+        bench_world.tick(get_parallel_executor());
+        if (!bench_world.get().save_snapshot(path, schema)) {
+            state.SkipWithError("Can't save the snapshot.");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto bench_world = std::make_unique<BenchWorld>();
+        state.ResumeTiming();
+
+        benchmark::DoNotOptimize(bench_world->get().load_snapshot(path, schema));
+
+        state.PauseTiming();
+        bench_world.reset();
+        state.ResumeTiming();
+    }
+
+    std::filesystem::remove(path);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Bumps every component, which dirties every chunk of its column.
+template <std::size_t... Indices>
+auto create_dirtying_systems(World& world, std::index_sequence<Indices...> /*written*/) -> void {
+    (world.create_system([](const core::IEngine& engine, std::tuple<Value<Indices>&> components) {
+         std::get<0>(components).value += 1.F;
+     }),
+     ...);
+}
+
+// A frame which checkpoints the 4 components of N entities, NumWritten of them being written by a
+// system. Compare with execute_system<1, Serial> for the cost of the checkpoint itself.
+template <std::size_t NumWritten>
+auto checkpoint(benchmark::State& state) -> void {
+    const auto num_entities = static_cast<std::size_t>(state.range(0));
+    constexpr auto COMPONENTS = std::make_index_sequence<NUM_CREATED_COMPONENTS>{};
+
+    BenchWorld bench_world;
+    auto& world = bench_world.get();
+    reserve_archetype(world, num_entities, COMPONENTS);
+    queue_entities(world, num_entities, COMPONENTS);
+    world.enable_checkpoints<Value<0>, Value<1>, Value<2>, Value<3>>();
+    if constexpr (NumWritten == 0) {
+        world.create_system(
+            [](const core::IEngine& engine, std::tuple<const Value<0>&> components) {
+                benchmark::DoNotOptimize(std::get<0>(components).value);
+            }
+        );
+    } else {
+        create_dirtying_systems(world, std::make_index_sequence<NumWritten>{});
+    }
+    bench_world.start();
+    // Fills the ring, every frame after it drops the oldest one.
+    for (std::size_t i = 0; i < world.get_checkpoints()->get_settings().num_frames; ++i) {
+        bench_world.tick(get_serial_executor());
+    }
+
+    for (auto _ : state) {
+        bench_world.tick(get_serial_executor());
+    }
+
+    state.counters["copied_bytes"] =
+        static_cast<double>(world.get_checkpoints()->get_stats().copied_bytes);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+} // namespace
+
+BENCHMARK(create_entities)->Apply(entity_counts);
+BENCHMARK(instantiate_prefab)->Apply(entity_counts);
+BENCHMARK(destroy_entities)->Apply(entity_counts);
+BENCHMARK(load_snapshot)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(checkpoint, 0)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(checkpoint, 1)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(checkpoint, 4)->Apply(entity_counts);
+
+BENCHMARK_TEMPLATE(execute_system, 1, Execution::Serial)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 2, Execution::Serial)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 4, Execution::Serial)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 8, Execution::Serial)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 1, Execution::Parallel)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 2, Execution::Parallel)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 4, Execution::Parallel)->Apply(entity_counts);
+BENCHMARK_TEMPLATE(execute_system, 8, Execution::Parallel)->Apply(entity_counts);
+
+BENCHMARK(build_graph)->RangeMultiplier(4)->Range(8, 512)->Unit(benchmark::kMicrosecond);
+} // namespace atlas::hephaestus::bench
@@ -0,0 +1,264 @@
+// Runs one of the scenario games headless and writes its frame times and memory use as JSON, see
+// perf_harness.py which runs every scenario a number of times and compares them to a baseline.
+//
+//   atlas_perf --list
+//   atlas_perf --scenario boids [--frames 600] [--scale 1.0] [--out result.json]
+//   atlas_perf --scenario churn --record churn.cmds
+//   atlas_perf --scenario replay --replay churn.cmds
+//
+// A replay runs as many frames as the log holds.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <print>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+// clang-format off
+#include <windows.h>
+#include <psapi.h>
+// clang-format on
+#elif !defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#include "Scenarios.hpp"
+#include "atlas/core/Engine.hpp"
+
+namespace atlas::hephaestus::perf {
+namespace {
+// The first frames create the initial entities and build the query caches, they aren't part of the
+// steady state which is measured.
+constexpr std::size_t NUM_WARMUP_FRAMES = 10;
+
+struct ScenarioResult {
+    std::vector<double> frame_times;
+    std::uint64_t num_live_entities = 0;
+};
+
+template <typename GameType>
+auto run_scenario() -> ScenarioResult {
+    core::Engine<GameType> engine;
+    engine.run();
+
+    const auto& game = dynamic_cast<const ScenarioGame&>(engine.get_game());
+    const auto& hephaestus = engine.template get_module<Hephaestus>();
+    return ScenarioResult{
+        .frame_times = game.get_frame_times(),
+        .num_live_entities = hephaestus.get_tot_num_created_ents()
+                             - hephaestus.get_tot_num_destroyed_ents(),
+    };
+}
+
+struct Scenario {
+    std::string_view name;
+    std::function<ScenarioResult()> run;
+};
+
+const auto SCENARIOS = std::array{
+    Scenario{.name = "boids", .run = run_scenario<BoidsScenario>},
+    Scenario{.name = "bullet_hell", .run = run_scenario<BulletHellScenario>},
+    Scenario{.name = "churn", .run = run_scenario<ChurnScenario>},
+};
+
+// Not listed, it needs a log to replay.
+const auto REPLAY_SCENARIO = Scenario{.name = "replay", .run = run_scenario<ReplayScenario>};
+
+// Peak resident set size of the process in bytes, which is why every scenario runs in a process of
+// its own.
+auto get_peak_rss() -> std::uint64_t {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == 0) {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+    // ru_maxrss survives exec on Linux and would report the peak of the parent, such as the
+    // harness, if it was larger. VmHWM is reset by exec.
+    constexpr std::string_view KEY = "VmHWM:";
+    constexpr std::uint64_t KILOBYTE = 1024;
+    std::ifstream status{"/proc/self/status"};
+    for (std::string line; std::getline(status, line);) {
+        if (line.starts_with(KEY)) {
+            return std::stoull(line.substr(KEY.size())) * KILOBYTE;
+        }
+    }
+    return 0;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Bytes on macOS.
+    return static_cast<std::uint64_t>(usage.ru_maxrss);
+#endif
+}
+
+// Nearest rank percentile of sorted values.
+auto percentile(const std::span<const double> sorted, const double fraction) -> double {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    const auto rank = static_cast<std::size_t>(
+        std::ceil(fraction * static_cast<double>(sorted.size()))
+    );
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+auto get_compiler() -> std::string {
+#if defined(__clang__)
+    return std::format("clang {}.{}.{}", __clang_major__, __clang_minor__, __clang_patchlevel__);
+#elif defined(__GNUC__)
+    return std::format("gcc {}.{}.{}", __GNUC__, __GNUC_MINOR__, __GNUC_PATCHLEVEL__);
+#elif defined(_MSC_VER)
+    return std::format("msvc {}", _MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+auto write_result(std::ostream& stream, const std::string_view name, const ScenarioResult& result)
+    -> void {
+    const auto frames = std::span{result.frame_times}.subspan(
+        std::min(NUM_WARMUP_FRAMES, result.frame_times.size())
+    );
+    std::vector<double> sorted{frames.begin(), frames.end()};
+    std::ranges::sort(sorted);
+
+    const auto total_ms = std::accumulate(sorted.begin(), sorted.end(), 0.0);
+    const auto mean_ms = sorted.empty() ? 0.0 : total_ms / static_cast<double>(sorted.size());
+    constexpr double MILLISECONDS = 1000.0;
+    constexpr double MEGABYTE = 1024.0 * 1024.0;
+    const auto fps = total_ms > 0.0 ? MILLISECONDS * static_cast<double>(sorted.size()) / total_ms
+                                    : 0.0;
+
+    // Only numbers and fixed identifiers, nothing which would need escaping.
+    std::println(stream, "{{");
+    std::println(stream, "  \"scenario\": \"{}\",", name);
+    std::println(stream, "  \"num_frames\": {},", sorted.size());
+    std::println(stream, "  \"num_warmup_frames\": {},", result.frame_times.size() - sorted.size());
+    std::println(stream, "  \"scale\": {},", SCENARIO_SETTINGS.scale);
+    std::println(stream, "  \"num_live_entities\": {},", result.num_live_entities);
+    std::println(stream, "  \"fps\": {},", fps);
+    std::println(stream, "  \"mean_frame_ms\": {},", mean_ms);
+    std::println(stream, "  \"p50_frame_ms\": {},", percentile(sorted, 0.5));
+    std::println(stream, "  \"p99_frame_ms\": {},", percentile(sorted, 0.99));
+    std::println(stream, "  \"max_frame_ms\": {},", sorted.empty() ? 0.0 : sorted.back());
+    std::println(stream, "  \"peak_rss_mb\": {},", static_cast<double>(get_peak_rss()) / MEGABYTE);
+    std::println(stream, "  \"compiler\": \"{}\",", get_compiler());
+#if defined(NDEBUG)
+    std::println(stream, "  \"asserts\": false,");
+#else
+    std::println(stream, "  \"asserts\": true,");
+#endif
+    std::println(stream, "  \"hardware_concurrency\": {}", std::thread::hardware_concurrency());
+    std::println(stream, "}}");
+}
+
+auto print_usage() -> void {
+    std::println(
+        stderr,
+        "usage: atlas_perf --list\n"
+        "       atlas_perf --scenario <name> [--frames <n>] [--scale <factor>] [--out <path>]\n"
+        "                  [--record <path>] [--replay <path>]"
+    );
+}
+} // namespace
+} // namespace atlas::hephaestus::perf
+
+auto main(int argc, char** argv) -> int {
+    using namespace atlas::hephaestus;
+    using namespace atlas::hephaestus::perf;
+
+    const std::vector<std::string_view> args{argv + 1, argv + argc};
+    std::optional<std::string_view> scenario_name;
+    std::optional<std::string> out_path;
+    std::optional<std::string> replay_path;
+    std::size_t num_frames = 600;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        const auto has_value = i + 1 < args.size();
+        if (args[i] == "--list") {
+            for (const auto& scenario : SCENARIOS) {
+                std::println("{}", scenario.name);
+            }
+            return 0;
+        }
+        if (args[i] == "--scenario" && has_value) {
+            scenario_name = args[++i];
+        } else if (args[i] == "--frames" && has_value) {
+            num_frames = std::stoul(std::string{args[++i]});
+        } else if (args[i] == "--scale" && has_value) {
+            SCENARIO_SETTINGS.scale = std::stof(std::string{args[++i]});
+        } else if (args[i] == "--out" && has_value) {
+            out_path = std::string{args[++i]};
+        } else if (args[i] == "--record" && has_value) {
+            SCENARIO_SETTINGS.record_path = std::string{args[++i]};
+        } else if (args[i] == "--replay" && has_value) {
+            replay_path = std::string{args[++i]};
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (!scenario_name.has_value()) {
+        print_usage();
+        return 1;
+    }
+
+    const auto listed = std::ranges::find(SCENARIOS, *scenario_name, &Scenario::name);
+    const auto is_replay = *scenario_name == REPLAY_SCENARIO.name;
+    if (listed == SCENARIOS.end() && !is_replay) {
+        print_usage();
+        return 1;
+    }
+    const auto& scenario = is_replay ? REPLAY_SCENARIO : *listed;
+
+    SCENARIO_SETTINGS.num_frames = num_frames + NUM_WARMUP_FRAMES;
+
+    CommandReplayer replayer;
+    if (is_replay) {
+        if (!replay_path.has_value()) {
+            print_usage();
+            return 1;
+        }
+        register_scenario_components(replayer);
+        if (const auto loaded = replayer.load(*replay_path); !loaded.has_value()) {
+            std::println(
+                stderr,
+                "cannot replay {}: error {}",
+                *replay_path,
+                static_cast<int>(loaded.error())
+            );
+            return 1;
+        }
+        SCENARIO_SETTINGS.replayer = &replayer;
+        SCENARIO_SETTINGS.num_frames = replayer.get_num_frames();
+    }
+
+    const auto result = scenario.run();
+    if (!out_path.has_value()) {
+        write_result(std::cout, scenario.name, result);
+        return 0;
+    }
+
+    std::ofstream file{*out_path};
+    write_result(file, scenario.name, result);
+    return file ? 0 : 1;
+}
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numbers>
+#include <optional>
+#include <random>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "atlas/core/Game.hpp"
+#include "atlas/core/IEngine.hpp"
+#include "hephaestus/CommandLog.hpp"
+#include "hephaestus/Component.hpp"
+#include "hephaestus/Hephaestus.hpp"
+#include "hephaestus/SpatialIndex.hpp"
+#include "hephaestus/SystemParams.hpp"
+
+namespace atlas::hephaestus::perf {
+struct ScenarioSettings {
+    // Warmup frames included.
+    std::size_t num_frames = 600;
+    // Multiplies the number of entities of every scenario.
+    float scale = 1.F;
+    // Records the commands of the scenario into a command log when set.
+    std::optional<std::filesystem::path> record_path;
+    // The loaded log the replay scenario replays.
+    CommandReplayer* replayer = nullptr;
+};
+
+constexpr float DELTA_TIME = 1.F / 60.F;
+
+// Engine<G> default constructs the game, the settings are read from here instead.
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+inline ScenarioSettings SCENARIO_SETTINGS;
+
+[[nodiscard]] inline auto scaled(const std::size_t count) -> std::size_t {
+    return std::max<std::size_t>(1, static_cast<std::size_t>(count * SCENARIO_SETTINGS.scale));
+}
+
+// A headless game which runs a fixed number of frames and records the wall time of each of them,
+// measured between two calls to should_quit, which the engine makes once per frame.
+class ScenarioGame : public core::Game {
+  public:
+    auto pre_start() -> void override {}
+
+    auto start() -> void override {
+        auto& hephaestus = get_engine().get_module<Hephaestus>();
+        if (SCENARIO_SETTINGS.record_path.has_value()) {
+            record_file.open(*SCENARIO_SETTINGS.record_path, std::ios::binary);
+            recorder.emplace(record_file, DELTA_TIME);
+            hephaestus.set_command_recorder(&*recorder);
+        }
+        setup(hephaestus);
+    }
+
+    auto post_start() -> void override {}
+
+    auto pre_shutdown() -> void override {
+        if (recorder.has_value()) {
+            get_engine().get_module<Hephaestus>().set_command_recorder(nullptr);
+            recorder.reset();
+        }
+    }
+
+    auto shutdown() -> void override {}
+    auto post_shutdown() -> void override {}
+
+    [[nodiscard]] auto should_quit() const -> bool override {
+        const auto now = std::chrono::steady_clock::now();
+        if (last_frame_end.has_value()) {
+            frame_times.emplace_back(
+                std::chrono::duration<double, std::milli>(now - *last_frame_end).count()
+            );
+        }
+        last_frame_end = now;
+
+        return frame_times.size() >= SCENARIO_SETTINGS.num_frames;
+    }
+
+    // Milliseconds, one per frame.
+    [[nodiscard]] auto get_frame_times() const -> const std::vector<double>& {
+        return frame_times;
+    }
+
+  protected:
+    virtual auto setup(Hephaestus& hephaestus) -> void = 0;
+
+  private:
+    mutable std::vector<double> frame_times;
+    mutable std::optional<std::chrono::steady_clock::time_point> last_frame_end;
+
+    std::ofstream record_file;
+    std::optional<CommandRecorder> recorder;
+};
+
+struct Position : public Component<Position> {
+    float x, y;
+};
+
+struct Velocity : public Component<Velocity> {
+    float dx, dy;
+};
+
+struct Health : public Component<Health> {
+    std::uint32_t value;
+};
+
+struct Emitter : public Component<Emitter> {
+    float angle;
+    float spin;
+};
+
+struct Marked : public Component<Marked, SparseStorage> {
+    std::uint32_t frame;
+};
+
+constexpr float WORLD_SIZE = 1000.F;
+
+[[nodiscard]] inline auto wrap(const float value) -> float {
+    return value - (WORLD_SIZE * std::floor(value / WORLD_SIZE));
+}
+
+// A swarm steered by its neighbours, found through the spatial index every frame. Exercises the
+// spatial index refresh, a read heavy system with random access into the index and a plain
+// integration system.
+class BoidsScenario final : public ScenarioGame {
+  protected:
+    auto setup(Hephaestus& hephaestus) -> void override {
+        constexpr std::size_t NUM_BOIDS = 10'000;
+        constexpr float NEIGHBOUR_RADIUS = 12.F;
+        constexpr float SPEED = 40.F;
+
+        std::mt19937 rng{1};
+        std::uniform_real_distribution<float> coordinate{0.F, WORLD_SIZE};
+        std::uniform_real_distribution<float> angle{0.F, 2.F * std::numbers::pi_v<float>};
+        for (std::size_t i = 0; i < scaled(NUM_BOIDS); ++i) {
+            const auto heading = angle(rng);
+            hephaestus.create_entity(
+                Position{.x = coordinate(rng), .y = coordinate(rng)},
+                Velocity{.dx = std::cos(heading) * SPEED, .dy = std::sin(heading) * SPEED}
+            );
+        }
+        hephaestus.create_spatial_index<Position>(NEIGHBOUR_RADIUS);
+
+        // Crowded boids turn away, lonely ones drift towards the center.
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<const Position&, Velocity&> components,
+                                    Res<const SpatialIndex<Position>> index) {
+            constexpr std::size_t CROWDED = 6;
+            constexpr float TURN = 0.05F;
+            constexpr float PULL = 0.01F;
+
+            auto& [position, velocity] = components;
+            std::size_t neighbours = 0;
+            index->query_radius(position.x, position.y, NEIGHBOUR_RADIUS, [&](Entity entity) {
+                neighbours++;
+            });
+
+            if (neighbours > CROWDED) {
+                const auto dx = (velocity.dx * std::cos(TURN)) - (velocity.dy * std::sin(TURN));
+                velocity.dy = (velocity.dx * std::sin(TURN)) + (velocity.dy * std::cos(TURN));
+                velocity.dx = dx;
+            } else {
+                velocity.dx += ((WORLD_SIZE / 2.F) - position.x) * PULL;
+                velocity.dy += ((WORLD_SIZE / 2.F) - position.y) * PULL;
+            }
+
+            const auto speed = std::hypot(velocity.dx, velocity.dy);
+            if (speed > 0.F) {
+                velocity.dx *= SPEED / speed;
+                velocity.dy *= SPEED / speed;
+            }
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<Position&, const Velocity&> components) {
+            auto& [position, velocity] = components;
+            position.x = wrap(position.x + (velocity.dx * DELTA_TIME));
+            position.y = wrap(position.y + (velocity.dy * DELTA_TIME));
+        });
+    }
+};
+
+// Rotating emitters spawning rings of bullets which live for a fixed number of frames, a steady
+// state of a few hundred thousand bullets with thousands created and destroyed every frame.
+class BulletHellScenario final : public ScenarioGame {
+  protected:
+    static constexpr std::size_t LIFETIME_FRAMES = 120;
+    static constexpr std::size_t BULLETS_PER_EMITTER = 32;
+
+    // The bullets spawned per frame, the oldest wave is destroyed when its slot comes around.
+    struct Waves {
+        std::vector<std::vector<Entity>> waves = std::vector<std::vector<Entity>>(LIFETIME_FRAMES);
+        std::size_t head = 0;
+    };
+
+    auto setup(Hephaestus& hephaestus) -> void override {
+        constexpr std::size_t NUM_EMITTERS = 64;
+        constexpr float BULLET_SPEED = 120.F;
+
+        const auto num_emitters = scaled(NUM_EMITTERS);
+        for (std::size_t i = 0; i < num_emitters; ++i) {
+            const auto t = static_cast<float>(i) / static_cast<float>(num_emitters);
+            hephaestus.create_entity(
+                Position{
+                    .x = WORLD_SIZE * t,
+                    .y = (WORLD_SIZE / 2.F) + (std::sin(t * 20.F) * WORLD_SIZE / 4.F),
+                },
+                Emitter{.angle = 0.F, .spin = 0.02F + (0.01F * static_cast<float>(i % 4))}
+            );
+        }
+
+        // Bullets are spawned by systems, their archetype must exist before start is over.
+        hephaestus.create_archetype<Position, Velocity>(
+            static_cast<std::uint32_t>(num_emitters * BULLETS_PER_EMITTER * LIFETIME_FRAMES)
+        );
+        hephaestus.insert_resource(Waves{});
+
+        hephaestus.create_system([&hephaestus](
+                                     const core::IEngine& engine,
+                                     std::tuple<> components,
+                                     Res<Waves> waves
+                                 ) {
+            waves->head = (waves->head + 1) % LIFETIME_FRAMES;
+            for (const auto entity : waves->waves[waves->head]) {
+                hephaestus.destroy_entity(entity);
+            }
+            waves->waves[waves->head].clear();
+        });
+
+        hephaestus.create_system([&hephaestus](
+                                     const core::IEngine& engine,
+                                     std::tuple<const Position&, Emitter&> components,
+                                     Res<Waves> waves
+                                 ) {
+            constexpr float RING_STEP = 2.F * std::numbers::pi_v<float> / BULLETS_PER_EMITTER;
+
+            auto& [position, emitter] = components;
+            emitter.angle += emitter.spin;
+            auto& wave = waves->waves[waves->head];
+            for (std::size_t i = 0; i < BULLETS_PER_EMITTER; ++i) {
+                const auto heading = emitter.angle + (RING_STEP * static_cast<float>(i));
+                wave.emplace_back(hephaestus.create_entity(
+                    Position{.x = position.x, .y = position.y},
+                    Velocity{
+                        .dx = std::cos(heading) * BULLET_SPEED,
+                        .dy = std::sin(heading) * BULLET_SPEED,
+                    }
+                ));
+            }
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<Position&, const Velocity&> components) {
+            auto& [position, velocity] = components;
+            position.x += velocity.dx * DELTA_TIME;
+            position.y += velocity.dy * DELTA_TIME;
+        });
+    }
+};
+
+// Random entities destroyed and replaced every frame across three archetypes, with sparse
+// components added on the way and entities toggled on and off. Keeps the structural change paths
+// and the query cache rebuilds busy.
+class ChurnScenario final : public ScenarioGame {
+  protected:
+    struct Population {
+        std::vector<Entity> live;
+        std::mt19937 rng{1};
+        std::uint32_t frame = 0;
+    };
+
+    auto setup(Hephaestus& hephaestus) -> void override {
+        constexpr std::size_t NUM_ENTITIES = 100'000;
+        // 5% of the entities are replaced every frame.
+        constexpr std::size_t CHURN_DIVISOR = 20;
+
+        const auto num_entities = scaled(NUM_ENTITIES);
+        hephaestus.create_archetype<Position, Velocity>(static_cast<std::uint32_t>(num_entities));
+        hephaestus.create_archetype<Position, Velocity, Health>(
+            static_cast<std::uint32_t>(num_entities)
+        );
+        hephaestus.create_archetype<Position, Health>(static_cast<std::uint32_t>(num_entities));
+
+        Population population;
+        population.live.reserve(num_entities);
+        for (std::size_t i = 0; i < num_entities; ++i) {
+            population.live.emplace_back(spawn(hephaestus, population.rng));
+        }
+        hephaestus.insert_resource(std::move(population));
+
+        const auto churn = std::max<std::size_t>(1, num_entities / CHURN_DIVISOR);
+        hephaestus.create_system([&hephaestus, churn](
+                                     const core::IEngine& engine,
+                                     std::tuple<> components,
+                                     Res<Population> population
+                                 ) {
+            auto& live = population->live;
+            auto& rng = population->rng;
+            population->frame++;
+            for (std::size_t i = 0; i < churn; ++i) {
+                std::uniform_int_distribution<std::size_t> pick{0, live.size() - 1};
+                const auto index = pick(rng);
+                hephaestus.destroy_entity(live[index]);
+
+                const auto entity = spawn(hephaestus, rng);
+                live[index] = entity;
+                if (rng() % 4 == 0) {
+                    hephaestus.add_component(entity, Marked{.frame = population->frame});
+                }
+            }
+
+            // Only once every destroyed entity has been replaced, the toggles are applied in the
+            // next frame and must not hit an entity which is destroyed at the end of this one.
+            std::uniform_int_distribution<std::size_t> pick{0, live.size() - 1};
+            for (std::size_t i = 0; i < churn / 8; ++i) {
+                hephaestus.set_enabled(live[pick(rng)], rng() % 2 == 0);
+            }
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<Position&, const Velocity&> components) {
+            auto& [position, velocity] = components;
+            position.x = wrap(position.x + (velocity.dx * DELTA_TIME));
+            position.y = wrap(position.y + (velocity.dy * DELTA_TIME));
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<Health&> components) {
+            auto& [health] = components;
+            health.value = health.value == 0 ? 100 : health.value - 1;
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<const Health&, const Marked&> components) {
+            auto& [health, marked] = components;
+            std::ignore = health.value + marked.frame;
+        });
+    }
+
+  private:
+    static auto spawn(Hephaestus& hephaestus, std::mt19937& rng) -> Entity {
+        const auto position = Position{
+            .x = static_cast<float>(rng() % 1000),
+            .y = static_cast<float>(rng() % 1000),
+        };
+        const auto velocity = Velocity{.dx = 1.F, .dy = -1.F};
+        const auto health = Health{.value = 100};
+
+        switch (rng() % 3) {
+        case 0:
+            return hephaestus.create_entity(Position{position}, Velocity{velocity});
+        case 1:
+            return hephaestus.create_entity(
+                Position{position},
+                Velocity{velocity},
+                Health{health}
+            );
+        default:
+            return hephaestus.create_entity(Position{position}, Health{health});
+        }
+    }
+};
+
+// Registers every component of the scenarios, so that the logs recorded from any of them can be
+// replayed.
+inline auto register_scenario_components(CommandReplayer& replayer) -> void {
+    replayer.register_components<Position, Velocity, Health, Emitter, Marked>();
+}
+
+// Replays a command log recorded with atlas_perf --record, or by a game, one recorded frame per
+// frame. The systems of the churn scenario run on the replayed entities, so the frames cost what
+// the structural changes of the recording and a light simulation of them cost.
+class ReplayScenario final : public ScenarioGame {
+  protected:
+    auto setup(Hephaestus& hephaestus) -> void override {
+        assert(SCENARIO_SETTINGS.replayer != nullptr && "The replay scenario needs a log.");
+        const auto delta_time = static_cast<float>(
+            SCENARIO_SETTINGS.replayer->get_fixed_delta_time()
+        );
+
+        hephaestus.create_system([delta_time](const core::IEngine& engine,
+                                              std::tuple<Position&, const Velocity&> components) {
+            auto& [position, velocity] = components;
+            position.x = wrap(position.x + (velocity.dx * delta_time));
+            position.y = wrap(position.y + (velocity.dy * delta_time));
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<Health&> components) {
+            auto& [health] = components;
+            health.value = health.value == 0 ? 100 : health.value - 1;
+        });
+
+        hephaestus.create_system([](const core::IEngine& engine,
+                                    std::tuple<const Health&, const Marked&> components) {
+            auto& [health, marked] = components;
+            std::ignore = health.value + marked.frame;
+        });
+
+        SCENARIO_SETTINGS.replayer->attach(hephaestus.get_world());
+    }
+};
+} // namespace atlas::hephaestus::perf
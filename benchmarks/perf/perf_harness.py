@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+"""Performance regression harness for Atlas.
+
+Runs the scenario games of atlas_perf and a subset of the atlas_bench suite a number of times,
+writes the results together with the machine they ran on as JSON, and compares them to a baseline.
+
+A case only counts as regressed or improved when the change is larger than both a fixed minimum
+for the metric and the noise of the samples, NOISE_SIGMAS times the combined standard deviation of
+the baseline and the current run. The comparison is printed as a table and the exit code is 1 if
+anything regressed, or 77, which CTest reports as skipped, if there is no baseline yet or it was
+recorded on a different machine or build.
+
+Record a new baseline on the reference machine with --update-baseline and commit it.
+"""
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import socket
+import statistics
+import subprocess
+import sys
+import tempfile
+
+SKIPPED = 77
+
+# Small entity counts only, the full suite up to 10M entities takes far too long to repeat.
+DEFAULT_BENCH_FILTER = r"/(1000|10000|100000)(/|$)|find_archetype|build_graph"
+
+NOISE_SIGMAS = 3.0
+
+# name: (higher is better, minimum relative change which is reported)
+METRICS = {
+    "throughput": (True, 0.05),
+    "p99_frame_ms": (False, 0.10),
+    "peak_rss_mb": (False, 0.05),
+}
+
+# Results which were recorded on a machine differing in these aren't comparable.
+MACHINE_KEYS = ("host", "machine", "cpu_count", "compiler", "asserts")
+
+TIME_UNITS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+def summarize(samples):
+    return {
+        "mean": statistics.fmean(samples),
+        "stddev": statistics.stdev(samples) if len(samples) > 1 else 0.0,
+        "samples": samples,
+    }
+
+
+def run_scenarios(executable, repetitions, frames, scale):
+    names = subprocess.run(
+        [executable, "--list"], check=True, capture_output=True, text=True
+    ).stdout.split()
+
+    cases = {}
+    build = {}
+    for name in names:
+        runs = []
+        for _ in range(repetitions):
+            with tempfile.TemporaryDirectory() as directory:
+                path = os.path.join(directory, "result.json")
+                # Every run gets a process of its own, the peak RSS is per process.
+                subprocess.run(
+                    [
+                        executable,
+                        "--scenario", name,
+                        "--frames", str(frames),
+                        "--scale", str(scale),
+                        "--out", path,
+                    ],
+                    check=True,
+                    stdout=subprocess.DEVNULL,
+                )
+                with open(path, encoding="utf-8") as file:
+                    runs.append(json.load(file))
+
+        build = {key: runs[0][key] for key in ("compiler", "asserts")}
+        cases[f"scenario/{name}"] = {
+            "throughput": summarize([run["fps"] for run in runs]),
+            "p99_frame_ms": summarize([run["p99_frame_ms"] for run in runs]),
+            "peak_rss_mb": summarize([run["peak_rss_mb"] for run in runs]),
+        }
+    return cases, build
+
+
+def run_benchmarks(executable, repetitions, bench_filter):
+    with tempfile.TemporaryDirectory() as directory:
+        path = os.path.join(directory, "bench.json")
+        subprocess.run(
+            [
+                executable,
+                f"--benchmark_filter={bench_filter}",
+                f"--benchmark_repetitions={repetitions}",
+                f"--benchmark_out={path}",
+                "--benchmark_out_format=json",
+            ],
+            check=True,
+            stdout=subprocess.DEVNULL,
+        )
+        with open(path, encoding="utf-8") as file:
+            report = json.load(file)
+
+    # Items per second where the case reports them, iterations per second otherwise.
+    samples = {}
+    for run in report["benchmarks"]:
+        if run.get("run_type") != "iteration":
+            continue
+        if "items_per_second" in run:
+            value = run["items_per_second"]
+        else:
+            value = 1.0 / (run["real_time"] * TIME_UNITS[run["time_unit"]])
+        samples.setdefault(f"bench/{run['run_name']}", []).append(value)
+
+    cases = {name: {"throughput": summarize(values)} for name, values in samples.items()}
+    return cases, report.get("context", {})
+
+
+def git_commit(source_dir):
+    try:
+        return subprocess.run(
+            ["git", "rev-parse", "HEAD"],
+            cwd=source_dir,
+            check=True,
+            capture_output=True,
+            text=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def compare_metric(metric, baseline, current):
+    higher_is_better, min_change = METRICS[metric]
+    if baseline["mean"] == 0.0:
+        return 0.0, "ok"
+
+    change = (current["mean"] - baseline["mean"]) / baseline["mean"]
+    noise = NOISE_SIGMAS * math.hypot(baseline["stddev"], current["stddev"]) / baseline["mean"]
+    threshold = max(min_change, noise)
+
+    better = change > threshold if higher_is_better else change < -threshold
+    worse = change < -threshold if higher_is_better else change > threshold
+    if worse:
+        return change, "REGRESSED"
+    if better:
+        return change, "improved"
+    return change, "ok"
+
+
+def format_value(value):
+    if value >= 1e6:
+        return f"{value / 1e6:.2f}M"
+    if value >= 1e3:
+        return f"{value / 1e3:.2f}k"
+    return f"{value:.3f}"
+
+
+def machine_mismatches(baseline, current):
+    return [
+        key
+        for key in MACHINE_KEYS
+        if baseline["machine"].get(key) != current["machine"].get(key)
+    ]
+
+
+def compare(baseline, current):
+    """Prints the comparison table, returns the number of regressed metrics."""
+    header = ("case", "metric", "baseline", "current", "change", "status")
+    rows = []
+    num_regressed = 0
+    for name in sorted(set(baseline["cases"]) | set(current["cases"])):
+        base_case = baseline["cases"].get(name)
+        current_case = current["cases"].get(name)
+        if base_case is None or current_case is None:
+            status = "new" if base_case is None else "missing"
+            rows.append((name, "", "", "", "", status))
+            continue
+
+        for metric in METRICS:
+            if metric not in base_case or metric not in current_case:
+                continue
+            change, status = compare_metric(metric, base_case[metric], current_case[metric])
+            num_regressed += status == "REGRESSED"
+            rows.append(
+                (
+                    name,
+                    metric,
+                    format_value(base_case[metric]["mean"]),
+                    format_value(current_case[metric]["mean"]),
+                    f"{change * 100:+.1f}%",
+                    status,
+                )
+            )
+
+    widths = [max(len(row[i]) for row in [header, *rows]) for i in range(len(header))]
+    for row in [header, tuple("-" * width for width in widths), *rows]:
+        print("  ".join(cell.ljust(width) for cell, width in zip(row, widths)).rstrip())
+
+    return num_regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--bench", help="path to atlas_bench, skipped if not given")
+    parser.add_argument("--scenarios", help="path to atlas_perf, skipped if not given")
+    parser.add_argument("--baseline", required=True, help="baseline JSON to compare to")
+    parser.add_argument("--out", required=True, help="where to write the results JSON")
+    parser.add_argument("--repetitions", type=int, default=5)
+    parser.add_argument("--frames", type=int, default=600)
+    parser.add_argument("--scale", type=float, default=1.0)
+    parser.add_argument("--bench-filter", default=DEFAULT_BENCH_FILTER)
+    parser.add_argument(
+        "--update-baseline",
+        action="store_true",
+        help="write the results to the baseline instead of comparing",
+    )
+    args = parser.parse_args()
+
+    source_dir = os.path.dirname(os.path.abspath(__file__))
+    results = {
+        "machine": {
+            "host": socket.gethostname(),
+            "platform": platform.platform(),
+            "machine": platform.machine(),
+            "processor": platform.processor(),
+            "cpu_count": os.cpu_count(),
+        },
+        "timestamp": datetime.datetime.now(datetime.timezone.utc).isoformat(),
+        "git_commit": git_commit(source_dir),
+        "repetitions": args.repetitions,
+        "cases": {},
+    }
+
+    if args.scenarios:
+        cases, build = run_scenarios(args.scenarios, args.repetitions, args.frames, args.scale)
+        results["machine"].update(build)
+        results["cases"].update(cases)
+    if args.bench:
+        cases, context = run_benchmarks(args.bench, args.repetitions, args.bench_filter)
+        results["benchmark_context"] = context
+        results["cases"].update(cases)
+
+    with open(args.out, "w", encoding="utf-8") as file:
+        json.dump(results, file, indent=2)
+
+    if args.update_baseline:
+        with open(args.baseline, "w", encoding="utf-8") as file:
+            json.dump(results, file, indent=2)
+        print(f"Wrote the baseline to {args.baseline}.")
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print(f"No baseline at {args.baseline}, record one with --update-baseline.")
+        print(f"Results written to {args.out}.")
+        return SKIPPED
+
+    with open(args.baseline, encoding="utf-8") as file:
+        baseline = json.load(file)
+
+    num_regressed = compare(baseline, results)
+    mismatches = machine_mismatches(baseline, results)
+    if mismatches:
+        # Timings of another machine or build say nothing about a regression.
+        print(
+            "\nThe baseline was recorded on a different machine or build "
+            f"({', '.join(mismatches)}), the comparison is only indicative."
+        )
+        print(f"Results written to {args.out}.")
+        return SKIPPED
+
+    print(f"\n{num_regressed} regression(s), results written to {args.out}.")
+    return 1 if num_regressed > 0 else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -33,6 +33,8 @@
             ninja
             cmake
             gtest
+            gbenchmark
+            python3
           ];
 
           cmakeFlags = [
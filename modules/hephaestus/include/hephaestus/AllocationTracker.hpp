@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "hephaestus/HephaestusConfig.hpp"
+
+namespace atlas::hephaestus {
+// What a thread was doing when it allocated, see AllocationScopeGuard.
+enum class AllocationScope : std::uint8_t {
+    // Outside of every scope, game code and idle workers included.
+    Other,
+    // Scheduling and waiting for the frame graphs of the worlds.
+    ModuleTick,
+    // Handing work to other workers from within a task, taskflow allocates the tasks of subflows.
+    TaskScheduling,
+    SystemExecute,
+    // The creation, sparse, hierarchy, enabled and destroy queues.
+    QueueApplication,
+    // Refreshing the spatial indices and compacting the archetypes.
+    Maintenance,
+};
+
+constexpr std::size_t NUM_ALLOCATION_SCOPES = 6;
+
+// Threads past the limit share the counters of the last one.
+constexpr std::size_t MAX_TRACKED_THREADS = 64;
+
+[[nodiscard]] constexpr auto make_scope_mask(const AllocationScope scope) -> std::uint32_t {
+    return std::uint32_t{1} << static_cast<std::uint32_t>(scope);
+}
+
+[[nodiscard]] auto get_allocation_scope_name(AllocationScope scope) -> const char*;
+
+// The scopes the ECS itself is responsible for, which are expected to stop allocating once warmed
+// up.
+constexpr std::uint32_t ECS_ALLOCATION_SCOPES = make_scope_mask(AllocationScope::SystemExecute)
+                                                | make_scope_mask(AllocationScope::QueueApplication)
+                                                | make_scope_mask(AllocationScope::Maintenance);
+
+struct AllocationCounts {
+    std::uint64_t num_allocations = 0;
+    std::uint64_t bytes = 0;
+};
+
+// The allocations of every thread between two points in time, usually a frame.
+struct AllocationStats {
+    std::uint64_t frame = 0;
+    AllocationCounts total;
+    std::array<AllocationCounts, NUM_ALLOCATION_SCOPES> per_scope{};
+    // In the order the threads made their first allocation in.
+    std::array<AllocationCounts, MAX_TRACKED_THREADS> per_thread{};
+    std::size_t num_threads = 0;
+
+    [[nodiscard]] auto get(const AllocationScope scope) const -> const AllocationCounts& {
+        return per_scope[static_cast<std::size_t>(scope)];
+    }
+
+    // Summed over the scopes of the mask.
+    [[nodiscard]] auto get(std::uint32_t scope_mask) const -> AllocationCounts;
+};
+
+// Counts the heap allocations of the whole process, per thread and per scope, and turns them into
+// numbers per frame. Frames are delimited by the Hephaestus module around its tick.
+//
+// Opt-in with -DHEPHAESTUS_TRACK_ALLOCATIONS=ON, which replaces the global operator new. Without
+// it nothing is counted and every function here is a no-op. Counting is lock free, every thread
+// bumps counters of its own, and never allocates.
+//
+// Work which a task hands to other workers is counted in the scope those workers are in, which is
+// why the systems set their scope for every entity they run on as well.
+class AllocationTracker final {
+  public:
+    static constexpr bool IS_ENABLED = TRACK_ALLOCATIONS;
+
+    [[nodiscard]] static auto get() -> AllocationTracker&;
+
+    // Called from operator new.
+    static auto record(std::size_t bytes) noexcept -> void;
+
+    [[nodiscard]] static auto get_scope() noexcept -> AllocationScope;
+    static auto set_scope(AllocationScope scope) noexcept -> void;
+
+    auto begin_frame() -> void;
+    auto end_frame() -> void;
+
+    [[nodiscard]] auto get_last_frame() const -> const AllocationStats& {
+        return last_frame;
+    }
+
+    // Everything since the start of the process.
+    [[nodiscard]] auto collect_totals() const -> AllocationStats;
+
+    // Test mode. Every frame from warmup_frames on asserts that the scopes of the mask didn't
+    // allocate, and reports the offending frames.
+    auto expect_no_allocations(std::uint64_t warmup_frames, std::uint32_t scope_mask) -> void;
+    auto stop_expecting_no_allocations() -> void;
+
+    // Frames which allocated while no allocations were expected.
+    [[nodiscard]] auto get_num_violations() const -> std::uint64_t {
+        return num_violations;
+    }
+
+  private:
+    AllocationTracker() = default;
+
+    auto check_frame() -> void;
+
+    AllocationStats frame_start;
+    AllocationStats last_frame;
+    std::uint64_t num_frames = 0;
+
+    bool is_expecting_no_allocations = false;
+    std::uint64_t first_checked_frame = 0;
+    std::uint32_t checked_scopes = 0;
+    std::uint64_t num_violations = 0;
+};
+
+// Sets the allocation scope of the current thread and restores the previous one when destroyed.
+class AllocationScopeGuard final {
+  public:
+    explicit AllocationScopeGuard(const AllocationScope scope) {
+        if constexpr (AllocationTracker::IS_ENABLED) {
+            previous = AllocationTracker::get_scope();
+            AllocationTracker::set_scope(scope);
+        }
+    }
+
+    ~AllocationScopeGuard() {
+        if constexpr (AllocationTracker::IS_ENABLED) {
+            AllocationTracker::set_scope(previous);
+        }
+    }
+
+    AllocationScopeGuard(const AllocationScopeGuard&) = delete;
+    auto operator=(const AllocationScopeGuard&) -> AllocationScopeGuard& = delete;
+
+    AllocationScopeGuard(AllocationScopeGuard&&) = delete;
+    auto operator=(AllocationScopeGuard&&) -> AllocationScopeGuard& = delete;
+
+  private:
+    AllocationScope previous = AllocationScope::Other;
+};
+} // namespace atlas::hephaestus
@@ -2,15 +2,40 @@
 
 #include "hephaestus/ArchetypeKey.hpp"
 #include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
 #include "hephaestus/Concepts.hpp"
+#include "hephaestus/SparseSet.hpp"
+#include "hephaestus/Stats.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <memory_resource>
 #include <ranges>
+#include <span>
 #include <unordered_map>
 #include <vector>
 
 namespace atlas::hephaestus {
+struct ComponentCodec;
+
+namespace detail {
+// Reallocates the vector with exactly the requested capacity, shrink_to_fit can only shrink down to
+// the size and is non-binding.
+template <typename T>
+auto shrink_vector(std::pmr::vector<T>& vector, const std::size_t capacity) -> void {
+    assert(capacity >= vector.size() && "Cannot shrink a vector below its size");
+
+    std::pmr::vector<T> shrunk{vector.get_allocator()};
+    shrunk.reserve(capacity);
+    std::ranges::move(vector, std::back_inserter(shrunk));
+    vector.swap(shrunk);
+}
+} // namespace detail
+
 struct IComponentStorage {
     IComponentStorage() = default;
 
@@ -23,15 +48,40 @@ struct IComponentStorage {
     virtual ~IComponentStorage() = default;
 
     [[nodiscard]] virtual auto size() const -> std::size_t = 0;
+    [[nodiscard]] virtual auto capacity() const -> std::size_t = 0;
+    [[nodiscard]] virtual auto get_element_size() const -> std::size_t = 0;
     virtual auto destroy(std::size_t index) -> void = 0;
+    // The rows must be unique and sorted from the highest to the lowest, see
+    // Archetype::destroy_rows.
+    virtual auto destroy_rows(std::span<const std::size_t> rows) -> void = 0;
+    virtual auto shrink(std::size_t capacity) -> void = 0;
+
+    // An empty storage of the same component type.
+    [[nodiscard]] virtual auto make_empty(std::pmr::memory_resource* memory_resource) const
+        -> std::unique_ptr<IComponentStorage> = 0;
+    // Appends count components moved out of other, starting at index first. Other must hold the
+    // same component type, its components are left moved from.
+    virtual auto append_moved(IComponentStorage& other, std::size_t first, std::size_t count)
+        -> void = 0;
 };
 
 template <TypeOfComponent ComponentType>
 struct ComponentStorage final : public IComponentStorage {
+    explicit ComponentStorage(std::pmr::memory_resource* memory_resource)
+        : components{memory_resource} {}
+
     [[nodiscard]] auto size() const -> std::size_t override {
         return components.size();
     }
 
+    [[nodiscard]] auto capacity() const -> std::size_t override {
+        return components.capacity();
+    }
+
+    [[nodiscard]] auto get_element_size() const -> std::size_t override {
+        return sizeof(ComponentType);
+    }
+
     auto destroy(std::size_t index) -> void override {
         assert(
             index < components.size()
@@ -43,17 +93,56 @@ struct ComponentStorage final : public IComponentStorage {
         }
 
         components.pop_back();
-        ComponentType::increment_version();
     }
 
-    std::vector<ComponentType> components{};
+    auto destroy_rows(const std::span<const std::size_t> rows) -> void override {
+        for (const auto row : rows) {
+            destroy(row);
+        }
+    }
+
+    auto shrink(const std::size_t capacity) -> void override {
+        detail::shrink_vector(components, capacity);
+    }
+
+    [[nodiscard]] auto make_empty(std::pmr::memory_resource* memory_resource) const
+        -> std::unique_ptr<IComponentStorage> override {
+        return std::make_unique<ComponentStorage>(memory_resource);
+    }
+
+    auto append_moved(IComponentStorage& other, const std::size_t first, const std::size_t count)
+        -> void override {
+        auto& source = static_cast<ComponentStorage&>(other).components;
+        assert(first + count <= source.size() && "Moving components past the end of the column.");
+
+        const auto begin = source.begin() + static_cast<std::ptrdiff_t>(first);
+        components.insert(
+            components.end(),
+            std::make_move_iterator(begin),
+            std::make_move_iterator(begin + static_cast<std::ptrdiff_t>(count))
+        );
+    }
+
+    std::pmr::vector<ComponentType> components;
 };
 
 class Archetype final {
   public:
-    explicit Archetype(const std::uint32_t entity_buffer_size) {
+    // All containers of the archetype, the component columns included, allocate from
+    // memory_resource, see hephaestus/Memory.hpp.
+    explicit Archetype(
+        const std::uint32_t entity_buffer_size,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource()
+    )
+        : ent_to_component_index{memory_resource}
+        , component_index_to_ent{memory_resource}
+        , enabled_mask{memory_resource}
+        , component_storages{memory_resource}
+        , memory_resource{memory_resource}
+        , entity_buffer_size{entity_buffer_size} {
         ent_to_component_index.reserve(entity_buffer_size);
         component_index_to_ent.reserve(entity_buffer_size);
+        enabled_mask.reserve(get_num_mask_words(entity_buffer_size));
         component_storages.reserve(entity_buffer_size);
     }
 
@@ -68,44 +157,221 @@ class Archetype final {
     template <AllTypeOfComponent... ComponentTypes>
     auto create_entity(Entity entity, ComponentTypes&&... components) -> void;
 
+    // Type erased create_entity, data holds the values of the components back to back in the
+    // order of the codecs, see hephaestus/ComponentCodec.hpp.
+    auto create_entity(
+        Entity entity,
+        std::span<const ComponentCodec* const> codecs,
+        std::span<const std::byte> data
+    ) -> void;
+
+    // Appends to the column of the component, the row has to be completed by create_entity.
+    template <TypeOfComponent ComponentType>
+    auto add_to_component_storage(ComponentType&& component) -> void;
+
+    // Appends the values packed in data to the column of the component byte for byte, the rows
+    // have to be completed by push_rows. Only for trivially copyable components.
+    template <TypeOfColumnComponent ComponentType>
+    auto append_to_column(std::span<const std::byte> data) -> void;
+
+    // Appends count copies of every column component, growing each column once. Trivially
+    // copyable components are filled in byte for byte, the others are copy constructed. The rows
+    // have to be completed by push_rows.
+    template <AllTypeOfComponent... ComponentTypes>
+    auto append_copies(std::size_t count, const ComponentTypes&... components) -> void;
+
+    // Appends count enabled rows for the entities first_entity, first_entity + 1 and so on, once
+    // the columns have been filled in by append_copies.
+    auto push_rows(Entity first_entity, std::size_t count) -> void;
+
+    // Appends count rows of every column of source moved out of it, starting at first_row. Source
+    // must have the same columns, the rows have to be completed by push_rows.
+    auto append_moved_columns(Archetype& source, std::size_t first_row, std::size_t count)
+        -> void;
+
+    // Bulk create_entity for an empty archetype, once the columns have been filled in. The enabled
+    // mask holds a bit per entity, in the layout of get_enabled_bits.
+    auto push_rows(std::span<const Entity> entities, std::span<const std::uint64_t> enabled_mask)
+        -> void;
+
+    // The enabled bits of every row, one word per 64 rows.
+    [[nodiscard]] auto get_enabled_mask() const -> std::span<const std::uint64_t> {
+        return enabled_mask;
+    }
+
     auto destroy_entity(Entity entity) -> bool;
 
+    // Destroys many rows at once, with a single virtual call per column. The rows must be unique
+    // and sorted from the highest to the lowest. Every row swapped into a hole then comes from
+    // past the rows which are still to be destroyed, so none of them move, and the columns are
+    // walked back to front.
+    auto destroy_rows(std::span<const std::size_t> rows) -> void;
+
+    [[nodiscard]] auto get_num_entities() const -> std::size_t {
+        return component_index_to_ent.size();
+    }
+
+    // Rows the archetype can hold before its containers have to grow.
+    [[nodiscard]] auto get_capacity() const -> std::size_t {
+        return component_index_to_ent.capacity();
+    }
+
+    // The capacity the archetype was created with.
+    [[nodiscard]] auto get_entity_buffer_size() const -> std::size_t {
+        return entity_buffer_size;
+    }
+
+    // Fills in everything but the id and the key, which only the ArchetypeMap knows about. Doesn't
+    // touch the rows.
+    [[nodiscard]] auto collect_stats() const -> ArchetypeStats;
+
+    // Reallocates all containers to hold exactly capacity rows, releasing the rest of their memory.
+    // Invalidates all references into the component columns.
+    auto shrink(std::size_t capacity) -> void;
+
+    // The entity of every row, in row order.
+    [[nodiscard]] auto get_entities() const -> const std::pmr::vector<Entity>& {
+        return component_index_to_ent;
+    }
+
+    [[nodiscard]] auto contains(const Entity entity) const -> bool {
+        return ent_to_component_index.contains(entity);
+    }
+
+    // The row of an entity which lives in the archetype.
+    [[nodiscard]] auto get_row_index(const Entity entity) const -> std::size_t {
+        assert(ent_to_component_index.contains(entity) && "Entity does not exist in archetype");
+        return ent_to_component_index.at(entity);
+    }
+
+    // Disabled rows keep their components and their place in the archetype but are skipped by the
+    // queries. Toggling flips a bit in the enabled mask, the row never moves and the component
+    // versions are left alone, so the query caches stay valid. Returns false if the entity already
+    // was in the requested state.
+    auto set_enabled(Entity entity, bool enabled) -> bool;
+
+    [[nodiscard]] auto is_enabled(const std::size_t row) const -> bool {
+        return ((enabled_mask[row / MASK_WORD_BITS] >> (row % MASK_WORD_BITS)) & 1U) != 0;
+    }
+
+    [[nodiscard]] auto get_num_disabled() const -> std::size_t {
+        return num_disabled;
+    }
+
+    // The enabled bits of the 64 rows starting at row, the lowest bit being row. Bits past the last
+    // row are zero.
+    [[nodiscard]] auto get_enabled_bits(std::size_t row) const -> std::uint64_t;
+
+    // Bumped by every toggle, queries use it to know when to refresh their copy of the mask.
+    [[nodiscard]] auto get_enabled_version() const -> std::uint64_t {
+        return enabled_version;
+    }
+
+    // Bumped whenever a row moves to another index, which only destroying rows does. Queries
+    // caching rows without being versioned on the key of the archetype, such as the ones served
+    // by a group, use it to notice their rows have gone stale.
+    [[nodiscard]] auto get_row_version() const -> std::uint64_t {
+        return row_version;
+    }
+
+    // Columns are created with the first component stored in them.
+    [[nodiscard]] auto has_column(const ComponentTypeId component_id) const -> bool {
+        return component_storages.contains(component_id);
+    }
+
+    // The column of a component which is stored in the archetype, in row order.
+    template <TypeOfColumnComponent ComponentType>
+    [[nodiscard]] auto get_column() const -> std::span<const std::remove_cvref_t<ComponentType>> {
+        return get_components<std::remove_cvref_t<ComponentType>>();
+    }
+
+    template <TypeOfColumnComponent ComponentType>
+    [[nodiscard]] auto get_column() -> std::span<std::remove_cvref_t<ComponentType>> {
+        return get_components<std::remove_cvref_t<ComponentType>>();
+    }
+
+    // The components of a single row, sparse components are fetched from sparse_sets.
     template <AllTypeOfComponent... ComponentTypes>
-    auto get_entity_tuples() const -> decltype(auto);
+    [[nodiscard]] auto get_row(std::size_t index, const SparseSets& sparse_sets) const
+        -> std::tuple<ComponentTypes&...> {
+        return std::tuple<ComponentTypes&...>{get_component<ComponentTypes>(index, sparse_sets)...};
+    }
+
+    // The rows whose entity is in all the sparse sets of sparse_include and none of
+    // sparse_exclude, in row order.
+    [[nodiscard]] auto get_matching_rows(
+        const SparseSets& sparse_sets,
+        const ArchetypeKey& sparse_include,
+        const ArchetypeKey& sparse_exclude
+    ) const -> decltype(auto);
+
+    static constexpr std::size_t MASK_WORD_BITS = 64;
 
   private:
+    [[nodiscard]] static auto get_num_mask_words(const std::size_t num_rows) -> std::size_t {
+        return (num_rows + MASK_WORD_BITS - 1) / MASK_WORD_BITS;
+    }
+
+    // Appends the entity and its enabled bit, once its components have been added to the columns.
+    auto push_row(Entity entity) -> void;
+
+    // Moves the last row into the row, along with its entity and enabled bit, and pops it. The
+    // columns are left to the caller.
+    auto pop_row(std::size_t row) -> void;
+
     template <TypeOfComponent ComponentType>
-    [[nodiscard]] auto get_components() const -> std::vector<ComponentType>&;
+    [[nodiscard]] auto get_components() const -> std::pmr::vector<ComponentType>&;
+
+    // The column of the component, created on first use.
+    template <TypeOfColumnComponent ComponentType>
+    [[nodiscard]] auto get_or_create_column() -> std::pmr::vector<ComponentType>&;
 
     template <TypeOfComponent ComponentType>
-    auto add_to_component_storage(ComponentType&& component) -> void;
+    [[nodiscard]] auto get_component(std::size_t index, const SparseSets& sparse_sets) const
+        -> ComponentType&;
 
-    using ComponentTypeId = std::size_t;
-    std::unordered_map<Entity, std::size_t> ent_to_component_index;
-    std::vector<Entity> component_index_to_ent;
-    std::unordered_map<ComponentTypeId, std::unique_ptr<IComponentStorage>> component_storages;
+    std::pmr::unordered_map<Entity, std::size_t> ent_to_component_index;
+    std::pmr::vector<Entity> component_index_to_ent;
+    // One bit per row, set for enabled rows, in chunks of 64 rows per word.
+    std::pmr::vector<std::uint64_t> enabled_mask;
+    std::size_t num_disabled = 0;
+    std::uint64_t enabled_version = 0;
+    std::uint64_t row_version = 0;
+    std::pmr::unordered_map<ComponentTypeId, std::unique_ptr<IComponentStorage>>
+        component_storages;
+    std::pmr::memory_resource* memory_resource;
+    std::size_t entity_buffer_size;
 };
 
 template <AllTypeOfComponent... ComponentTypes>
 auto Archetype::create_entity(Entity entity, ComponentTypes&&... components) -> void {
     (add_to_component_storage<ComponentTypes>(std::forward<ComponentTypes>(components)), ...);
-    assert(!component_storages.empty() && "Cannot add entity without components");
-
-    const auto& first_component_storage = *component_storages.begin()->second;
-    ent_to_component_index.emplace(entity, first_component_storage.size() - 1);
-    component_index_to_ent.emplace_back(entity);
+    push_row(entity);
 }
 
-template <AllTypeOfComponent... ComponentTypes>
-auto Archetype::get_entity_tuples() const -> decltype(auto) {
+inline auto Archetype::get_matching_rows(
+    const SparseSets& sparse_sets,
+    const ArchetypeKey& sparse_include,
+    const ArchetypeKey& sparse_exclude
+) const -> decltype(auto) {
+    const auto needs_sparse_join = !sparse_include.empty() || !sparse_exclude.empty();
     return std::views::iota(std::size_t{0}, ent_to_component_index.size())
-           | std::views::transform([this](const auto& index) {
-                 return std::tuple<ComponentTypes&...>{get_components<ComponentTypes>()[index]...};
+           | std::views::filter([this,
+                                 &sparse_sets,
+                                 needs_sparse_join,
+                                 sparse_include,
+                                 sparse_exclude](const auto& index) {
+                 return !needs_sparse_join
+                        || sparse_sets.matches(
+                            component_index_to_ent[index],
+                            sparse_include,
+                            sparse_exclude
+                        );
              });
 }
 
 template <TypeOfComponent ComponentType>
-[[nodiscard]] auto Archetype::get_components() const -> std::vector<ComponentType>& {
+[[nodiscard]] auto Archetype::get_components() const -> std::pmr::vector<ComponentType>& {
     const auto type_id = get_component_type_id<ComponentType>();
     assert(component_storages.contains(type_id) && "Component type not found in archetype");
 
@@ -113,16 +379,69 @@ template <TypeOfComponent ComponentType>
         ->components;
 }
 
+template <TypeOfComponent ComponentType>
+[[nodiscard]] auto Archetype::get_component(
+    const std::size_t index,
+    const SparseSets& sparse_sets
+) const -> ComponentType& {
+    if constexpr (TypeOfSparseComponent<ComponentType>) {
+        return sparse_sets.get<ComponentType>().get(component_index_to_ent[index]);
+    } else if constexpr (TypeOfTagComponent<ComponentType>) {
+        // Tags carry no data, every row shares the same instance.
+        static std::remove_cvref_t<ComponentType> tag{};
+        return tag;
+    } else {
+        return get_components<ComponentType>()[index];
+    }
+}
+
 template <TypeOfComponent ComponentType>
 auto Archetype::add_to_component_storage(ComponentType&& component) -> void {
-    const auto type_id = get_component_type_id<ComponentType>();
-    if (!component_storages.contains(type_id)) {
-        component_storages.insert({type_id, std::make_unique<ComponentStorage<ComponentType>>()});
+    // Tags only live in the archetype key, and sparse components in the sparse sets of the world.
+    if constexpr (TypeOfColumnComponent<ComponentType>) {
+        get_or_create_column<std::remove_cvref_t<ComponentType>>().emplace_back(
+            std::forward<ComponentType>(component)
+        );
     }
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto Archetype::append_copies(const std::size_t count, const ComponentTypes&... components)
+    -> void {
+    const auto append = [this, count]<typename ComponentType>(const ComponentType& component) {
+        if constexpr (TypeOfColumnComponent<ComponentType>) {
+            auto& column = get_or_create_column<std::remove_cvref_t<ComponentType>>();
+            // A single insert grows the column once, and fills trivially copyable components
+            // with plain stores instead of running a constructor per row.
+            column.insert(column.end(), count, component);
+        }
+    };
+    (append(components), ...);
+}
 
-    static_cast<ComponentStorage<ComponentType>&>(*component_storages[type_id].get())
-        .components.emplace_back(std::forward<ComponentType>(component));
+template <TypeOfColumnComponent ComponentType>
+auto Archetype::append_to_column(const std::span<const std::byte> data) -> void {
+    using ValueType = std::remove_cvref_t<ComponentType>;
+    static_assert(
+        std::is_trivially_copyable_v<ValueType>,
+        "Only trivially copyable components can be copied into a column byte for byte."
+    );
+    assert(data.size() % sizeof(ValueType) == 0 && "The data must hold whole components.");
+
+    auto& column = get_or_create_column<ValueType>();
+    const auto offset = column.size();
+    column.resize(offset + (data.size() / sizeof(ValueType)));
+    std::memcpy(column.data() + offset, data.data(), data.size());
+}
+
+template <TypeOfColumnComponent ComponentType>
+auto Archetype::get_or_create_column() -> std::pmr::vector<ComponentType>& {
+    const auto type_id = get_component_type_id<ComponentType>();
+    auto& storage = component_storages[type_id];
+    if (storage == nullptr) {
+        storage = std::make_unique<ComponentStorage<ComponentType>>(memory_resource);
+    }
 
-    ComponentType::increment_version();
+    return static_cast<ComponentStorage<ComponentType>&>(*storage).components;
 }
 } // namespace atlas::hephaestus
@@ -3,21 +3,28 @@
 #include <algorithm>
 #include <array>
 #include <bit>
+#include <cassert>
 #include <cstdint>
 #include <functional>
 #include <string_view>
 #include <type_traits>
 
+#include "hephaestus/BitsetOps.hpp"
+#include "hephaestus/HephaestusConfig.hpp"
+
 namespace atlas::hephaestus {
 
 // Type-safe wrapper for archetype key using bitmasking
-// Supports up to 256 component types (4 * 64) without heap allocations
-// This is a hard limit (but is easily adjustable if needed). 256 components should be sufficient
-// for most games. Might be a good idea to add this to a generated file via CMake later on and let
-// it be controlled from the Game space.
+// Supports up to MAX_COMPONENT_TYPES component types without heap allocations. The width is
+// decided at configure time through HEPHAESTUS_MAX_COMPONENT_TYPES (see
+// generated/template/HephaestusConfig.hpp.in), 256 by default.
 class ArchetypeKey {
   public:
-    static constexpr std::size_t STORAGE_SIZE = 4;
+    static_assert(
+        MAX_COMPONENT_TYPES % 64 == 0 && MAX_COMPONENT_TYPES > 0,
+        "MAX_COMPONENT_TYPES must be a multiple of 64."
+    );
+    static constexpr std::size_t STORAGE_SIZE = MAX_COMPONENT_TYPES / 64;
     using ValueType = std::uint64_t;
     using StorageType = std::array<ValueType, STORAGE_SIZE>;
 
@@ -26,7 +33,11 @@ class ArchetypeKey {
         : storage(storage) {}
 
     constexpr auto operator==(const ArchetypeKey& other) const -> bool {
-        return storage == other.storage;
+        if consteval {
+            return storage == other.storage;
+        } else {
+            return bitset::equal(storage, other.storage);
+        }
     }
 
     constexpr auto operator!=(const ArchetypeKey& other) const -> bool {
@@ -36,8 +47,8 @@ class ArchetypeKey {
     constexpr auto operator<(const ArchetypeKey& other) const -> bool {
         // Lexicographic comparison
         for (std::size_t i = 0; i < STORAGE_SIZE; ++i) {
-            if (storage.at(i) != other.storage.at(i)) {
-                return storage.at(i) < other.storage.at(i);
+            if (storage[i] != other.storage[i]) {
+                return storage[i] < other.storage[i];
             }
         }
         return false; // Equal
@@ -50,34 +61,61 @@ class ArchetypeKey {
     [[nodiscard]] constexpr auto has_component(size_t component_id) const -> bool {
         const auto bucket = component_id / 64;
         const auto bit = component_id % 64;
-        return bucket < STORAGE_SIZE && (storage.at(bucket) & (1ULL << bit)) != 0;
+        return bucket < STORAGE_SIZE && (storage[bucket] & (1ULL << bit)) != 0;
     }
 
     constexpr auto add_component(std::size_t component_id) -> ArchetypeKey& {
+        assert(component_id < MAX_COMPONENT_TYPES && "Component id is out of range for the key.");
         const auto bucket = component_id / 64;
         const auto bit = component_id % 64;
-        if (bucket < STORAGE_SIZE) {
-            storage.at(bucket) |= (1ULL << bit);
+        storage[bucket] |= (1ULL << bit);
+        return *this;
+    }
+
+    constexpr auto add_components(const ArchetypeKey& other) -> ArchetypeKey& {
+        for (std::size_t i = 0; i < STORAGE_SIZE; ++i) {
+            storage[i] |= other.storage[i];
         }
         return *this;
     }
 
+    // Calls func with the id of every component in the key, in ascending order.
+    template <typename Func>
+    constexpr auto for_each_component(Func&& func) const -> void {
+        for (std::size_t bucket = 0; bucket < STORAGE_SIZE; ++bucket) {
+            auto bits = storage[bucket];
+            while (bits != 0) {
+                const auto bit = static_cast<std::size_t>(std::countr_zero(bits));
+                func((bucket * 64) + bit);
+                bits &= bits - 1;
+            }
+        }
+    }
+
     [[nodiscard]] constexpr auto is_subset_of(const ArchetypeKey& other) const -> bool {
-        for (std::size_t i = 0; i < STORAGE_SIZE; ++i) {
-            if ((storage.at(i) & other.storage.at(i)) != storage.at(i)) {
-                return false;
+        if consteval {
+            for (std::size_t i = 0; i < STORAGE_SIZE; ++i) {
+                if ((storage[i] & other.storage[i]) != storage[i]) {
+                    return false;
+                }
             }
+            return true;
+        } else {
+            return bitset::is_subset_of(storage, other.storage);
         }
-        return true;
     }
 
     [[nodiscard]] constexpr auto intersects_with(const ArchetypeKey& other) const -> bool {
-        for (std::size_t i = 0; i < STORAGE_SIZE; ++i) {
-            if ((storage.at(i) & other.storage.at(i)) != 0) {
-                return true;
+        if consteval {
+            for (std::size_t i = 0; i < STORAGE_SIZE; ++i) {
+                if ((storage[i] & other.storage[i]) != 0) {
+                    return true;
+                }
             }
+            return false;
+        } else {
+            return bitset::intersects(storage, other.storage);
         }
-        return false;
     }
 
     [[nodiscard]] constexpr auto count_components() const -> std::uint32_t {
@@ -89,26 +127,19 @@ class ArchetypeKey {
     }
 
     [[nodiscard]] constexpr auto empty() const -> bool {
-        return std::ranges::all_of(storage, [](const ValueType& bucket) {
-            return bucket == 0;
-        });
+        if consteval {
+            return std::ranges::all_of(storage, [](const ValueType& bucket) {
+                return bucket == 0;
+            });
+        } else {
+            return bitset::none(storage);
+        }
     }
 
   private:
     StorageType storage{};
 };
 
-inline auto next_id() -> std::size_t {
-    static std::size_t id = 0;
-    return id++;
-}
-
-template <typename T>
-inline auto counter() -> std::size_t {
-    static std::size_t value = next_id();
-    return value;
-}
-
 // Simple compile-time string hash using FNV-1a algorithm
 constexpr auto hash_string(std::string_view str) -> std::uint64_t {
     std::uint64_t hash = 14695981039346656037ULL; // FNV offset basis
@@ -119,29 +150,21 @@ constexpr auto hash_string(std::string_view str) -> std::uint64_t {
     return hash;
 }
 
-template <typename T>
-auto get_component_type_id() -> std::size_t {
-    using NormalizedType = std::remove_cvref_t<T>;
-
-    // Static variable caches the computed result per type
-    static const std::size_t cached_id = counter<NormalizedType>()
-                                         % (ArchetypeKey::STORAGE_SIZE * 64);
-
-    return cached_id;
-}
-
 // Hash functor for ArchetypeKey
 struct ArchetypeKeyHash {
     constexpr auto operator()(const ArchetypeKey& sig) const -> std::size_t {
-        // Combine all storage buckets into a single hash
-        std::size_t result = 0;
-        const auto& storage = sig.get_storage();
-        for (std::size_t i = 0; i < ArchetypeKey::STORAGE_SIZE; ++i) {
-            // Use a simple hash combining algorithm
-            result ^= std::hash<std::uint64_t>{}(storage.at(i)) + 0x9e3779b9
-                      + (result << std::size_t{6}) + (result >> std::size_t{2});
+        // Multiply-xorshift over every bucket. std::hash<std::uint64_t> is the identity on most
+        // standard libraries, which leaves the low bits (used by the ArchetypeMap index) poorly
+        // mixed for keys that only differ in a few high component bits.
+        constexpr std::uint64_t MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+        constexpr std::uint64_t SHIFT = 29;
+
+        std::uint64_t result = 0;
+        for (const auto bucket : sig.get_storage()) {
+            result = (result ^ bucket) * MULTIPLIER;
+            result ^= result >> SHIFT;
         }
-        return result;
+        return static_cast<std::size_t>(result);
     }
 };
 
@@ -1,8 +1,17 @@
 #pragma once
 
-#include "hephaestus/ArchetypeKey.hpp"
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
 
 namespace atlas::hephaestus {
 class Archetype;
@@ -11,7 +20,163 @@ class Archetype;
 namespace atlas::hephaestus {
 using ArchetypePtr = std::unique_ptr<Archetype>;
 
-// ArchetypeMap using ArchetypeKey
-using ArchetypeMap = std::
-    unordered_map<ArchetypeKey, ArchetypePtr, ArchetypeKeyHash, ArchetypeKeyEqual>;
+constexpr auto INVALID_ARCHETYPE_ID = std::numeric_limits<ArchetypeId>::max();
+
+// Flat table of archetypes. The archetypes are stored densely in insertion order and indexed by
+// their ArchetypeId, which never changes once assigned. Lookups by key go through an open
+// addressing (linear probing) index which only stores the id and a hash fragment, so a probe
+// touches a single 8 byte slot and only compares the full key on a hash match.
+//
+// Iterating the map walks all dense entries. Query matching only walks the active archetypes, empty
+// archetypes can be retired (see World compaction) which takes them out of matching without
+// removing them, and they are revived as soon as an entity is added to them again.
+//
+// Archetypes are never removed, the id of an archetype is stable for the lifetime of the world.
+// The Archetype objects themselves are heap allocated and never move, the entries may.
+//
+// The map also tracks which archetype every entity lives in, which the World keeps up to date as
+// entities are created and destroyed. Entity ids are handed out sequentially and never reused, the
+// locations are split into fixed size pages indexed by entity, and a page is freed once every
+// entity in it is destroyed. A world which keeps creating and destroying entities only holds the
+// pages of the ids which are alive.
+class ArchetypeMap final {
+  public:
+    using Entry = std::pair<ArchetypeKey, ArchetypePtr>;
+
+    ArchetypeMap();
+    ~ArchetypeMap();
+
+    ArchetypeMap(const ArchetypeMap&) = delete;
+    auto operator=(const ArchetypeMap&) -> ArchetypeMap& = delete;
+
+    ArchetypeMap(ArchetypeMap&&) noexcept;
+    auto operator=(ArchetypeMap&&) noexcept -> ArchetypeMap&;
+
+    auto reserve(std::size_t capacity) -> void;
+
+    // Inserts the archetype if the key isn't present, returns the id of the archetype with the key
+    // and whether it was inserted.
+    auto emplace(const ArchetypeKey& key, ArchetypePtr archetype) -> std::pair<ArchetypeId, bool>;
+
+    // Same semantics as std::unordered_map, inserts an empty ArchetypePtr if missing.
+    auto operator[](const ArchetypeKey& key) -> ArchetypePtr&;
+
+    // Returns INVALID_ARCHETYPE_ID if there is no archetype with the key.
+    [[nodiscard]] auto find_id(const ArchetypeKey& key) const -> ArchetypeId;
+
+    [[nodiscard]] auto contains(const ArchetypeKey& key) const -> bool {
+        return find_id(key) != INVALID_ARCHETYPE_ID;
+    }
+
+    [[nodiscard]] auto at(const ArchetypeKey& key) const -> const ArchetypePtr& {
+        const auto id = find_id(key);
+        assert(id != INVALID_ARCHETYPE_ID && "No archetype with the key in the map.");
+        return entries[id].second;
+    }
+
+    [[nodiscard]] auto at(const ArchetypeId id) const -> const ArchetypePtr& {
+        assert(id < entries.size() && "Archetype id is out of range.");
+        return entries[id].second;
+    }
+
+    [[nodiscard]] auto get_key(const ArchetypeId id) const -> const ArchetypeKey& {
+        assert(id < entries.size() && "Archetype id is out of range.");
+        return entries[id].first;
+    }
+
+    [[nodiscard]] auto get_entry(const ArchetypeId id) const -> const Entry& {
+        assert(id < entries.size() && "Archetype id is out of range.");
+        return entries[id];
+    }
+
+    // Allocates the pages of the entities from first_entity up to num_entities. Setting the
+    // locations of different entities in that range is safe from multiple threads afterwards,
+    // nothing is allocated.
+    auto reserve_locations(std::size_t first_entity, std::size_t num_entities) -> void;
+
+    auto set_location(Entity entity, ArchetypeId id) -> void;
+    // Frees the page of the entity if it was the last one alive in it.
+    auto erase_location(Entity entity) -> void;
+
+    // Returns INVALID_ARCHETYPE_ID if the entity doesn't exist.
+    [[nodiscard]] auto find_location(const Entity entity) const -> ArchetypeId {
+        const auto page = entity / LOCATION_PAGE_SIZE;
+        if (page >= location_pages.size() || location_pages[page] == nullptr) {
+            return INVALID_ARCHETYPE_ID;
+        }
+        return location_pages[page]->ids[entity % LOCATION_PAGE_SIZE];
+    }
+
+    [[nodiscard]] auto contains_entity(const Entity entity) const -> bool {
+        return find_location(entity) != INVALID_ARCHETYPE_ID;
+    }
+
+    // Both are no-ops if the archetype already is in the requested state.
+    auto retire(ArchetypeId id) -> void;
+    auto revive(ArchetypeId id) -> void;
+
+    [[nodiscard]] auto is_retired(const ArchetypeId id) const -> bool {
+        assert(id < entries.size() && "Archetype id is out of range.");
+        return active_index[id] == INVALID_ARCHETYPE_ID;
+    }
+
+    // Unordered, retiring an archetype moves the last active one into its place.
+    [[nodiscard]] auto get_active_ids() const -> const std::vector<ArchetypeId>& {
+        return active_ids;
+    }
+
+    // Bumped every time the set of active archetypes changes. Queries cache the archetypes they
+    // match and only rematch when the generation has changed.
+    [[nodiscard]] auto get_generation() const -> std::uint64_t {
+        return generation;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t {
+        return entries.size();
+    }
+
+    [[nodiscard]] auto empty() const -> bool {
+        return entries.empty();
+    }
+
+    [[nodiscard]] auto begin() const {
+        return entries.begin();
+    }
+
+    [[nodiscard]] auto end() const {
+        return entries.end();
+    }
+
+    // Bytes of the allocated location pages.
+    [[nodiscard]] auto get_location_bytes() const -> std::size_t;
+
+  private:
+    static constexpr std::size_t LOCATION_PAGE_SIZE = 4096;
+
+    struct Slot {
+        std::uint32_t hash = 0;
+        ArchetypeId id = INVALID_ARCHETYPE_ID;
+    };
+
+    struct LocationPage {
+        std::array<ArchetypeId, LOCATION_PAGE_SIZE> ids;
+        // Entities of the page with a location, the creation tasks set them concurrently.
+        std::atomic<std::uint32_t> num_located = 0;
+    };
+
+    [[nodiscard]] auto find_slot(const ArchetypeKey& key, std::size_t hash) const -> std::size_t;
+    auto rehash(std::size_t num_slots) -> void;
+
+    std::vector<Entry> entries;
+    std::vector<Slot> slots;
+
+    std::vector<ArchetypeId> active_ids;
+    // Position of each archetype in active_ids, INVALID_ARCHETYPE_ID when retired.
+    std::vector<ArchetypeId> active_index;
+    std::uint64_t generation = 0;
+
+    std::vector<std::unique_ptr<LocationPage>> location_pages;
+    // The last freed page, reused by the next one so steady churn doesn't allocate.
+    std::unique_ptr<LocationPage> spare_location_page;
+};
 } // namespace atlas::hephaestus
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HEPHAESTUS_BITSET_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define HEPHAESTUS_BITSET_SSE2 1
+#endif
+
+// Word wise set operations for the fixed size bitsets used by the ArchetypeKey. When the width
+// is a multiple of the vector width the whole set is reduced into a single accumulator and tested
+// once at the end, no early outs, which keeps the loop free of unpredictable branches. Anything
+// else, or a target without SSE2/AVX2, falls back to the same reduction on 64 bit words.
+namespace atlas::hephaestus::bitset {
+template <std::size_t N>
+using Words = std::array<std::uint64_t, N>;
+
+#if defined(HEPHAESTUS_BITSET_AVX2)
+constexpr std::size_t SIMD_WORDS = 4;
+
+inline auto load(const std::uint64_t* words) -> __m256i {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words));
+}
+
+inline auto is_zero(const __m256i value) -> bool {
+    return _mm256_testz_si256(value, value) != 0;
+}
+
+inline auto zero() -> __m256i {
+    return _mm256_setzero_si256();
+}
+
+inline auto or_(const __m256i lhs, const __m256i rhs) -> __m256i {
+    return _mm256_or_si256(lhs, rhs);
+}
+
+inline auto and_(const __m256i lhs, const __m256i rhs) -> __m256i {
+    return _mm256_and_si256(lhs, rhs);
+}
+
+// ~lhs & rhs
+inline auto andnot(const __m256i lhs, const __m256i rhs) -> __m256i {
+    return _mm256_andnot_si256(lhs, rhs);
+}
+
+inline auto xor_(const __m256i lhs, const __m256i rhs) -> __m256i {
+    return _mm256_xor_si256(lhs, rhs);
+}
+#elif defined(HEPHAESTUS_BITSET_SSE2)
+constexpr std::size_t SIMD_WORDS = 2;
+
+inline auto load(const std::uint64_t* words) -> __m128i {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(words));
+}
+
+inline auto is_zero(const __m128i value) -> bool {
+    // SSE2 has no ptest, compare against zero and check that all bytes matched.
+    constexpr int ALL_BYTES = 0xFFFF;
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(value, _mm_setzero_si128())) == ALL_BYTES;
+}
+
+inline auto zero() -> __m128i {
+    return _mm_setzero_si128();
+}
+
+inline auto or_(const __m128i lhs, const __m128i rhs) -> __m128i {
+    return _mm_or_si128(lhs, rhs);
+}
+
+inline auto and_(const __m128i lhs, const __m128i rhs) -> __m128i {
+    return _mm_and_si128(lhs, rhs);
+}
+
+// ~lhs & rhs
+inline auto andnot(const __m128i lhs, const __m128i rhs) -> __m128i {
+    return _mm_andnot_si128(lhs, rhs);
+}
+
+inline auto xor_(const __m128i lhs, const __m128i rhs) -> __m128i {
+    return _mm_xor_si128(lhs, rhs);
+}
+#else
+constexpr std::size_t SIMD_WORDS = 0;
+#endif
+
+template <std::size_t N>
+constexpr bool USE_SIMD = SIMD_WORDS != 0 && N % SIMD_WORDS == 0;
+
+// Every bit set in lhs is also set in rhs.
+template <std::size_t N>
+[[nodiscard]] inline auto is_subset_of(const Words<N>& lhs, const Words<N>& rhs) -> bool {
+#if defined(HEPHAESTUS_BITSET_AVX2) || defined(HEPHAESTUS_BITSET_SSE2)
+    if constexpr (USE_SIMD<N>) {
+        auto acc = zero();
+        for (std::size_t i = 0; i < N; i += SIMD_WORDS) {
+            acc = or_(acc, andnot(load(&rhs[i]), load(&lhs[i])));
+        }
+        return is_zero(acc);
+    }
+#endif
+    std::uint64_t acc = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        acc |= lhs[i] & ~rhs[i];
+    }
+    return acc == 0;
+}
+
+template <std::size_t N>
+[[nodiscard]] inline auto intersects(const Words<N>& lhs, const Words<N>& rhs) -> bool {
+#if defined(HEPHAESTUS_BITSET_AVX2) || defined(HEPHAESTUS_BITSET_SSE2)
+    if constexpr (USE_SIMD<N>) {
+        auto acc = zero();
+        for (std::size_t i = 0; i < N; i += SIMD_WORDS) {
+            acc = or_(acc, and_(load(&lhs[i]), load(&rhs[i])));
+        }
+        return !is_zero(acc);
+    }
+#endif
+    std::uint64_t acc = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        acc |= lhs[i] & rhs[i];
+    }
+    return acc != 0;
+}
+
+template <std::size_t N>
+[[nodiscard]] inline auto equal(const Words<N>& lhs, const Words<N>& rhs) -> bool {
+#if defined(HEPHAESTUS_BITSET_AVX2) || defined(HEPHAESTUS_BITSET_SSE2)
+    if constexpr (USE_SIMD<N>) {
+        auto acc = zero();
+        for (std::size_t i = 0; i < N; i += SIMD_WORDS) {
+            acc = or_(acc, xor_(load(&lhs[i]), load(&rhs[i])));
+        }
+        return is_zero(acc);
+    }
+#endif
+    std::uint64_t acc = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        acc |= lhs[i] ^ rhs[i];
+    }
+    return acc == 0;
+}
+
+template <std::size_t N>
+[[nodiscard]] inline auto none(const Words<N>& words) -> bool {
+#if defined(HEPHAESTUS_BITSET_AVX2) || defined(HEPHAESTUS_BITSET_SSE2)
+    if constexpr (USE_SIMD<N>) {
+        auto acc = zero();
+        for (std::size_t i = 0; i < N; i += SIMD_WORDS) {
+            acc = or_(acc, load(&words[i]));
+        }
+        return is_zero(acc);
+    }
+#endif
+    std::uint64_t acc = 0;
+    for (std::size_t i = 0; i < N; ++i) {
+        acc |= words[i];
+    }
+    return acc == 0;
+}
+} // namespace atlas::hephaestus::bitset
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <typeindex>
+#include <utility>
+#include <vector>
+
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentVersions.hpp"
+
+namespace atlas::hephaestus {
+struct CheckpointSettings {
+    // Frames kept in the ring, every checkpoint past them drops the oldest one.
+    std::size_t num_frames = 8;
+    // Columns are compared, copied and shared between frames in chunks of about this many bytes.
+    std::size_t chunk_size = 16 * 1024;
+};
+
+// The bytes of the columns, entities included, taken by the last checkpoint.
+struct CheckpointStats {
+    std::size_t copied_bytes = 0;
+    // Left in the chunks of the previous frame.
+    std::size_t shared_bytes = 0;
+};
+
+// A ring of the values of selected column components as of the end of the last frames, to roll the
+// world back and resimulate it, see World::enable_checkpoints. Frames share the chunks of a column
+// which haven't changed in between, so every checkpoint only copies the dirty chunks:
+// - Components which no system writes can only change through structural changes. Their columns
+//   are shared whole, without being read, as long as the versions of the archetype are unchanged.
+// - The columns of the other components are compared with the previous frame chunk by chunk.
+//
+// Restoring writes the values back into the columns, the rows of entities which are still in their
+// archetype included. It doesn't undo structural changes: entities created since then keep their
+// values, destroyed ones stay destroyed. Sparse components and resources aren't checkpointed.
+class Checkpoints final {
+  public:
+    explicit Checkpoints(const CheckpointSettings& settings);
+    ~Checkpoints() = default;
+
+    Checkpoints(const Checkpoints&) = delete;
+    auto operator=(const Checkpoints&) -> Checkpoints& = delete;
+
+    Checkpoints(Checkpoints&&) = delete;
+    auto operator=(Checkpoints&&) -> Checkpoints& = delete;
+
+    // Frames count the checkpoints, one is taken at the end of every tick. 0 before the first one.
+    [[nodiscard]] auto get_frame() const -> std::uint64_t {
+        return frame;
+    }
+
+    // The oldest frame which can still be restored, nothing can be while it's past get_frame.
+    [[nodiscard]] auto get_oldest_frame() const -> std::uint64_t {
+        return frame + 1 - num_kept;
+    }
+
+    [[nodiscard]] auto get_stats() const -> const CheckpointStats& {
+        return stats;
+    }
+
+    [[nodiscard]] auto get_settings() const -> const CheckpointSettings& {
+        return settings;
+    }
+
+  private:
+    friend class World;
+
+    using ColumnBytes = auto (*)(Archetype& archetype) -> std::span<std::byte>;
+
+    struct Component {
+        ComponentTypeId component_id;
+        std::type_index type;
+        std::size_t element_size;
+        ColumnBytes get_bytes;
+        // Resolved from the system dependencies in World::build_graph.
+        bool has_writers = true;
+    };
+
+    static constexpr std::size_t ENTITIES = std::numeric_limits<std::size_t>::max();
+
+    // A column of an archetype, or its entities, which come first.
+    struct Column {
+        ArchetypeId archetype_id;
+        // Index in components, ENTITIES for the entities of the archetype.
+        std::size_t component;
+        // A whole number of elements.
+        std::size_t chunk_size;
+        // The sum of the versions of the archetype when it was last checkpointed.
+        std::optional<std::uint64_t> version;
+    };
+
+    struct ColumnFrame {
+        std::size_t size = 0;
+        std::vector<std::uint32_t> chunks;
+    };
+
+    // Indexed like columns, archetypes created afterwards aren't part of it.
+    struct Frame {
+        std::vector<ColumnFrame> columns;
+    };
+
+    struct Chunk {
+        std::vector<std::byte> data;
+        std::uint32_t num_refs = 0;
+    };
+
+    // Called by the world at the end of the frame, and while it isn't ticking.
+    auto capture(ArchetypeMap& archetypes, const ComponentVersions& versions) -> void;
+    auto restore(std::uint64_t restored_frame, ArchetypeMap& archetypes) -> bool;
+
+    auto capture_column(
+        std::span<const std::byte> bytes,
+        std::size_t chunk_size,
+        bool is_unchanged,
+        const ColumnFrame* previous,
+        ColumnFrame& target
+    ) -> void;
+    // Copies the saved rows which are still in the archetype back into the column.
+    auto restore_rows(
+        const ColumnFrame& saved,
+        std::size_t element_size,
+        std::size_t chunk_size,
+        std::span<std::byte> bytes
+    ) -> void;
+    [[nodiscard]] auto copy_chunk(std::span<const std::byte> bytes) -> std::uint32_t;
+    auto release(Frame& target) -> void;
+    [[nodiscard]] auto get_slot(std::uint64_t saved_frame) const -> std::size_t;
+    // Empty when the archetype has no column of the component yet.
+    [[nodiscard]] auto get_column_bytes(const Column& column, Archetype& archetype) const
+        -> std::span<const std::byte>;
+
+    CheckpointSettings settings;
+    std::vector<Component> components;
+    std::vector<Column> columns;
+    std::size_t num_archetypes = 0;
+
+    // The ring of frames, the newest one is in the slot of frame % num_frames.
+    std::vector<Frame> frames;
+    std::size_t num_kept = 0;
+    std::uint64_t frame = 0;
+    // The frame dropped by the last checkpoint. Kept to reuse the allocations.
+    Frame dropped;
+
+    std::vector<Chunk> chunks;
+    std::vector<std::uint32_t> free_chunks;
+    CheckpointStats stats;
+
+    // The saved entities of the archetype being restored, and the pairs of their saved and current
+    // rows. Kept to reuse the allocations.
+    std::vector<Entity> saved_entities;
+    std::vector<std::pair<std::size_t, std::size_t>> restored_rows;
+};
+} // namespace atlas::hephaestus
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentCodec.hpp"
+#include "hephaestus/Concepts.hpp"
+
+namespace atlas::hephaestus {
+class World;
+
+// A command log holds every structural command of a world, frame by frame, so the exact spawn
+// and despawn pattern of a session can be replayed headless, profiled and compared between engine
+// versions:
+//
+//   header:  "ATLSCMDS", version, fixed delta time
+//   records: component declarations (index, size, storage, type name) and frames
+//   frame:   the commands applied in the beginning of the frame (creations, sparse components,
+//            parents and enabled toggles), then the destroys applied at its end
+//
+// Integers are LEB128 varints, component values are their raw bytes, so only trivially copyable
+// components can be recorded and logs are only portable between builds with the same layout of
+// the components. Entities are stored as the handles of the recording, the replay maps them.
+enum class CommandLogErrorCode : std::uint8_t {
+    NoError,
+
+    CannotOpen,
+    NotACommandLog,
+    UnsupportedVersion,
+    Truncated,
+    // A component type of the log which wasn't registered with the replayer.
+    UnknownComponent,
+    ComponentSizeMismatch,
+};
+
+enum class CommandType : std::uint8_t {
+    DeclareComponent,
+    Frame,
+
+    CreateEntity,
+    DestroyEntity,
+    AddComponent,
+    RemoveComponent,
+    SetParent,
+    RemoveParent,
+    SetEnabled,
+};
+
+constexpr std::uint64_t COMMAND_LOG_VERSION = 1;
+
+// Records the commands of a world into a stream, see World::set_command_recorder. Commands can be
+// recorded from any thread, the frames are written to the stream at the end of every frame.
+class CommandRecorder final {
+  public:
+    // fixed_delta_time is the time step the recorded session simulated with, replays get it
+    // through CommandReplayer::get_fixed_delta_time.
+    CommandRecorder(std::ostream& stream, double fixed_delta_time);
+    // Writes the commands which haven't been applied yet as a last frame.
+    ~CommandRecorder();
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    auto operator=(const CommandRecorder&) -> CommandRecorder& = delete;
+
+    CommandRecorder(CommandRecorder&&) = delete;
+    auto operator=(CommandRecorder&&) -> CommandRecorder& = delete;
+
+    template <AllTypeOfComponent... ComponentTypes>
+    auto record_create(Entity entity, const ComponentTypes&... components) -> void;
+    auto record_create(Entity entity, std::span<const RawComponent> components) -> void;
+
+    auto record_destroy(Entity entity) -> void;
+
+    template <TypeOfSparseComponent ComponentType>
+    auto record_add_component(Entity entity, const ComponentType& component) -> void;
+    auto record_add_component(Entity entity, RawComponent component) -> void;
+
+    auto record_remove_component(Entity entity, const ComponentCodec& codec) -> void;
+
+    // NO_PARENT removes the parent.
+    auto record_set_parent(Entity child, Entity parent) -> void;
+    auto record_set_enabled(Entity entity, bool enabled) -> void;
+
+    // Called by the world when it starts applying the commands of a frame, and before it applies
+    // the destroys at the end of it, which is when the frame is written.
+    auto begin_frame() -> void;
+    auto end_frame() -> void;
+
+    [[nodiscard]] auto get_num_frames() const -> std::uint64_t;
+
+  private:
+    auto write_component(std::vector<std::byte>& buffer, RawComponent component) -> void;
+    auto write_frame(std::span<const std::byte> start, std::span<const std::byte> end) -> void;
+
+    std::ostream& stream;
+
+    mutable std::mutex mutex;
+    // Log index of every component type, indexed by component type id.
+    std::vector<std::uint64_t> component_indices;
+    std::uint64_t num_declared = 0;
+    // Declarations made since the last frame was written, they go out before it.
+    std::vector<std::byte> declarations;
+    // The commands applied in the beginning of the next frame.
+    std::vector<std::byte> pending_start;
+    // The commands applied in the beginning of the current frame.
+    std::vector<std::byte> frame_start;
+    // The destroys applied at the end of the current frame.
+    std::vector<std::byte> pending_end;
+    std::uint64_t num_frames = 0;
+};
+
+// Replays a command log into a world, one recorded frame per tick, mapping the entity handles of
+// the recording to the ones of the world. Every component type of the log must be registered
+// first, they are matched by type name and size.
+//
+//   CommandReplayer replayer;
+//   replayer.register_components<Position, Velocity, Selected>();
+//   if (replayer.load(path)) {
+//       replayer.attach(world);
+//   }
+class CommandReplayer final {
+  public:
+    CommandReplayer() = default;
+
+    template <AllTypeOfComponent... ComponentTypes>
+    auto register_components() -> void;
+
+    // Reads and validates the whole log up front, the replay itself doesn't do any IO.
+    auto load(const std::filesystem::path& path) -> std::expected<void, CommandLogErrorCode>;
+    auto load(std::istream& stream) -> std::expected<void, CommandLogErrorCode>;
+
+    // Creates the archetypes of the log and a system which replays a frame per tick, and issues
+    // the commands which precede the first frame. Must be called before start has finished.
+    //
+    // The system issues the commands of the next frame and the destroys of the current one while
+    // the world ticks, so both are applied in the same frame as in the recording.
+    auto attach(World& world) -> void;
+
+    [[nodiscard]] auto get_fixed_delta_time() const -> double {
+        return fixed_delta_time;
+    }
+
+    [[nodiscard]] auto get_num_frames() const -> std::size_t {
+        return frames.size();
+    }
+
+    [[nodiscard]] auto get_num_replayed_frames() const -> std::size_t {
+        return num_replayed_frames;
+    }
+
+    [[nodiscard]] auto is_finished() const -> bool {
+        return num_replayed_frames >= frames.size();
+    }
+
+  private:
+    struct Frame {
+        std::span<const std::byte> start;
+        std::span<const std::byte> end;
+    };
+
+    struct ArchetypeUsage {
+        ArchetypeKey signature;
+        std::size_t num_live = 0;
+        std::size_t peak_live = 0;
+    };
+
+    auto parse_declaration(std::span<const std::byte>& data)
+        -> std::expected<void, CommandLogErrorCode>;
+    auto validate(std::span<const std::byte> commands) -> std::expected<void, CommandLogErrorCode>;
+    auto validate_frames() -> std::expected<void, CommandLogErrorCode>;
+    auto issue(World& world, std::span<const std::byte> commands) -> void;
+    auto replay_frame(World& world) -> void;
+
+    [[nodiscard]] auto find_entity(std::uint64_t recorded) const -> std::size_t;
+    [[nodiscard]] auto map_entity(std::uint64_t recorded) const -> Entity;
+
+    std::vector<const ComponentCodec*> registered;
+    // Indexed by the component index of the log.
+    std::vector<const ComponentCodec*> codecs;
+
+    std::vector<std::byte> log;
+    std::vector<Frame> frames;
+    double fixed_delta_time = 0.0;
+
+    // The archetypes the log creates entities in, with the most entities they held at once.
+    std::vector<ArchetypeUsage> archetype_usages;
+    // The archetype usage of every entity the log has created so far, or NO_ARCHETYPE once it's
+    // destroyed. Only used while validating.
+    std::unordered_map<std::uint64_t, std::size_t> entity_archetypes;
+    // The entities destroyed by the commands being validated.
+    std::vector<std::uint64_t> section_destroys;
+
+    // The entity handles the log creates, sorted, and the entity of the world for each of them.
+    std::vector<std::uint64_t> recorded_entities;
+    std::vector<Entity> entities;
+    std::vector<RawComponent> scratch;
+    std::size_t num_replayed_frames = 0;
+};
+
+template <AllTypeOfComponent... ComponentTypes>
+auto CommandRecorder::record_create(const Entity entity, const ComponentTypes&... components)
+    -> void {
+    if constexpr ((std::is_trivially_copyable_v<ComponentTypes> && ...)) {
+        const std::array<RawComponent, sizeof...(ComponentTypes)> raw{RawComponent{
+            .codec = &get_component_codec<ComponentTypes>(),
+            .data = reinterpret_cast<const std::byte*>(&components),
+        }...};
+        record_create(entity, raw);
+    } else {
+        assert(false && "Only trivially copyable components can be recorded.");
+    }
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto CommandRecorder::record_add_component(const Entity entity, const ComponentType& component)
+    -> void {
+    record_add_component(
+        entity,
+        RawComponent{
+            .codec = &get_component_codec<ComponentType>(),
+            .data = reinterpret_cast<const std::byte*>(&component),
+        }
+    );
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto CommandReplayer::register_components() -> void {
+    (registered.emplace_back(&get_component_codec<ComponentTypes>()), ...);
+}
+} // namespace atlas::hephaestus
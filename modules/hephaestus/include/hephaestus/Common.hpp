@@ -4,4 +4,7 @@
 
 namespace atlas::hephaestus {
 using Entity = std::uint32_t;
+using WorldId = std::uint32_t;
+using ComponentTypeId = std::uint32_t;
+using ArchetypeId = std::uint32_t;
 } // namespace atlas::hephaestus
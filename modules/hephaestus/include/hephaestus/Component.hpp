@@ -1,7 +1,5 @@
 #pragma once
 
-#include <cstdint>
-
 namespace atlas::hephaestus {
 // This class should not be copied, we would enforce this by deleting the copy
 // constructor. However, that would it so that inherited classes are no longer
@@ -10,21 +8,26 @@ namespace atlas::hephaestus {
 // A workaround to get around this limitation is the use of RValueArg concept
 // which can be found in hephaestus/Concepts.hpp. We require that when
 // constructing components in the component storage in the Archetype.
-template <typename Derived>
+//
+// Components carry no state of their own in the base, structural versions are
+// tracked per World, see hephaestus/ComponentVersions.hpp.
+//
+// The storage policy decides where the component lives:
+// - ArchetypeStorage (default): a column in the archetype of the entity. Fast to
+//   iterate, but adding or removing the component moves the entity to another
+//   archetype.
+// - SparseStorage: a paged sparse set owned by the World, outside of the
+//   archetype, see hephaestus/SparseSet.hpp. Adding and removing is O(1) and
+//   never moves the entity, which suits small components that are attached and
+//   removed all the time (selection, per frame damage, timers).
+//
+//   struct Selected : Component<Selected, SparseStorage> {};
+struct ArchetypeStorage {};
+struct SparseStorage {};
+
+template <typename Derived, typename Storage = ArchetypeStorage>
 class Component {
   public:
-    [[nodiscard]] auto static get_version() -> const std::uint64_t& {
-        return version_counter;
-    }
-
-    static auto increment_version() -> void {
-        version_counter++;
-    }
-
-  private:
-    static std::uint64_t version_counter;
+    using StoragePolicy = Storage;
 };
-
-template <typename Derived>
-std::uint64_t Component<Derived>::version_counter = 0;
 } // namespace atlas::hephaestus
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/SparseSet.hpp"
+
+namespace atlas::hephaestus {
+// A component type which is only known at runtime, such as one read back from a command log, see
+// hephaestus/CommandLog.hpp. The value of a component is its bytes, which is why only trivially
+// copyable components can be stored and restored through a codec.
+struct ComponentCodec {
+    ComponentTypeId component_id = INVALID_COMPONENT_TYPE_ID;
+    // Zero for tags, which carry no data.
+    std::size_t size = 0;
+    bool is_sparse = false;
+    bool is_trivially_copyable = false;
+
+    // Appends the value to the column of the component in the archetype, tags have none.
+    void (*append_column)(Archetype& archetype, const std::byte* data) = nullptr;
+    // Same as SparseSets::emplace and SparseSets::remove.
+    ArchetypeKey (*emplace_sparse)(SparseSets& sets, Entity entity, const std::byte* data) =
+        nullptr;
+    ArchetypeKey (*remove_sparse)(SparseSets& sets, Entity entity) = nullptr;
+};
+
+// A component value of a type only known at runtime, data points at codec->size bytes.
+struct RawComponent {
+    const ComponentCodec* codec = nullptr;
+    const std::byte* data = nullptr;
+};
+
+namespace detail {
+template <typename ValueType>
+auto decode_component(const std::byte* data) -> ValueType {
+    if constexpr (std::is_trivially_copyable_v<ValueType>) {
+        ValueType value{};
+        if constexpr (!std::is_empty_v<ValueType>) {
+            std::memcpy(&value, data, sizeof(ValueType));
+        }
+        return value;
+    } else {
+        assert(false && "Only trivially copyable components can be decoded.");
+        return ValueType{};
+    }
+}
+} // namespace detail
+
+// One codec per component type, created on first use.
+template <TypeOfComponent ComponentType>
+[[nodiscard]] auto get_component_codec() -> const ComponentCodec& {
+    using ValueType = std::remove_cvref_t<ComponentType>;
+
+    static const ComponentCodec codec{
+        .component_id = get_component_type_id<ValueType>(),
+        .size = std::is_empty_v<ValueType> ? 0 : sizeof(ValueType),
+        .is_sparse = TypeOfSparseComponent<ValueType>,
+        .is_trivially_copyable = std::is_trivially_copyable_v<ValueType>,
+        .append_column =
+            [](Archetype& archetype, const std::byte* data) {
+                if constexpr (TypeOfColumnComponent<ValueType>) {
+                    archetype.add_to_component_storage<ValueType>(
+                        detail::decode_component<ValueType>(data)
+                    );
+                }
+            },
+        .emplace_sparse = [](SparseSets& sets, const Entity entity, const std::byte* data) {
+            if constexpr (TypeOfSparseComponent<ValueType>) {
+                return sets.emplace(entity, detail::decode_component<ValueType>(data));
+            } else {
+                assert(false && "Only sparse components live in the sparse sets.");
+                return ArchetypeKey{};
+            }
+        },
+        .remove_sparse = [](SparseSets& sets, const Entity entity) {
+            if constexpr (TypeOfSparseComponent<ValueType>) {
+                return sets.remove<ValueType>(entity);
+            } else {
+                assert(false && "Only sparse components live in the sparse sets.");
+                return ArchetypeKey{};
+            }
+        },
+    };
+    return codec;
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <vector>
+
+#include "hephaestus/Common.hpp"
+#include "hephaestus/HephaestusConfig.hpp"
+
+namespace atlas::hephaestus {
+constexpr auto INVALID_COMPONENT_TYPE_ID = std::numeric_limits<ComponentTypeId>::max();
+
+// Hands out component type ids at registration time. Ids are assigned densely in registration
+// order, which makes them stable and deterministic as long as the registration order is. Games
+// that rely on the ids (saved files, network replication, precomputed keys) should register all
+// of their component types up front with register_components<...>(), any type which isn't
+// registered is registered on first use.
+//
+// Running out of ids is a hard error, ids never wrap around and alias another type. Increase
+// HEPHAESTUS_MAX_COMPONENT_TYPES if more component types are needed.
+//
+// The registry is shared between all worlds, the ids are only a mapping between a type and a bit
+// in the ArchetypeKey, there is no simulation state stored here.
+class ComponentRegistry final {
+  public:
+    [[nodiscard]] static auto get() -> ComponentRegistry&;
+
+    ComponentRegistry(const ComponentRegistry&) = delete;
+    auto operator=(const ComponentRegistry&) -> ComponentRegistry& = delete;
+
+    ComponentRegistry(ComponentRegistry&&) = delete;
+    auto operator=(ComponentRegistry&&) -> ComponentRegistry& = delete;
+
+    ~ComponentRegistry() = default;
+
+    // Returns the already assigned id if the type has been registered before.
+    auto register_type(std::type_index type) -> ComponentTypeId;
+
+    [[nodiscard]] auto get_num_registered() const -> std::size_t;
+    [[nodiscard]] auto get_type_name(ComponentTypeId id) const -> std::string_view;
+
+  private:
+    ComponentRegistry() = default;
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::type_index, ComponentTypeId> ids;
+    std::vector<std::type_index> types;
+};
+
+namespace detail {
+// The id of each type is cached in a plain global instead of a function local static. Reading it
+// is a relaxed load with no static init guard on the hot path, only the first lookup of a type
+// which hasn't been registered yet takes the slow path through the registry.
+template <typename T>
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+inline std::atomic<ComponentTypeId> COMPONENT_TYPE_ID{INVALID_COMPONENT_TYPE_ID};
+} // namespace detail
+
+template <typename T>
+auto register_component() -> ComponentTypeId {
+    using NormalizedType = std::remove_cvref_t<T>;
+
+    const auto id = ComponentRegistry::get().register_type(std::type_index(typeid(NormalizedType)));
+    detail::COMPONENT_TYPE_ID<NormalizedType>.store(id, std::memory_order_relaxed);
+    return id;
+}
+
+// Registers the component types in the order given, see ComponentRegistry.
+template <typename... Ts>
+auto register_components() -> void {
+    (register_component<Ts>(), ...);
+}
+
+template <typename T>
+[[nodiscard]] auto get_component_type_id() -> ComponentTypeId {
+    using NormalizedType = std::remove_cvref_t<T>;
+
+    const auto id = detail::COMPONENT_TYPE_ID<NormalizedType>.load(std::memory_order_relaxed);
+    if (id != INVALID_COMPONENT_TYPE_ID) [[likely]] {
+        return id;
+    }
+
+    return register_component<NormalizedType>();
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/HephaestusConfig.hpp"
+
+namespace atlas::hephaestus {
+// Structural version per component type, owned by a World. Every time an entity carrying a
+// component type is added to or removed from an archetype, the version for that type is bumped.
+// Queries sum the versions of the types they are interested in to know when their cache has been
+// invalidated.
+//
+// This used to be a static counter on Component<T>, which made it impossible to run isolated
+// worlds side by side since a structural change in one world would invalidate the queries in all
+// others (and race when worlds tick concurrently).
+class ComponentVersions final {
+  public:
+    template <TypeOfComponent ComponentType>
+    [[nodiscard]] auto get() const -> std::uint64_t {
+        return get(get_component_type_id<ComponentType>());
+    }
+
+    [[nodiscard]] auto get(ComponentTypeId component_id) const -> std::uint64_t {
+        return versions[component_id];
+    }
+
+    auto increment(std::size_t component_id) -> void {
+        versions[component_id]++;
+    }
+
+    // Bumps the version of every component type present in the key.
+    auto increment(const ArchetypeKey& key) -> void {
+        key.for_each_component([this](const std::size_t component_id) {
+            versions[component_id]++;
+        });
+    }
+
+  private:
+    std::array<std::uint64_t, MAX_COMPONENT_TYPES> versions{};
+};
+} // namespace atlas::hephaestus
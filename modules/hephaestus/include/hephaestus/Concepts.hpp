@@ -1,18 +1,51 @@
 #pragma once
 
+#include <concepts>
 #include <type_traits>
 
 namespace atlas::hephaestus {
-template <typename Derived>
+template <typename Derived, typename Storage>
 class Component;
+struct SparseStorage;
 }
 
 namespace atlas::hephaestus {
 
 template <typename T>
-concept TypeOfComponent = std::
-    is_base_of_v<Component<std::remove_cvref_t<T>>, std::remove_cvref_t<T>>;
+concept TypeOfComponent = requires { typename std::remove_cvref_t<T>::StoragePolicy; }
+                          && std::is_base_of_v<
+                              Component<
+                                  std::remove_cvref_t<T>,
+                                  typename std::remove_cvref_t<T>::StoragePolicy>,
+                              std::remove_cvref_t<T>>;
 
 template <typename... Ts>
 concept AllTypeOfComponent = (TypeOfComponent<Ts> && ...);
+
+// Components declared with SparseStorage, see hephaestus/Component.hpp. They are not part of the
+// ArchetypeKey of an entity.
+template <typename T>
+concept TypeOfSparseComponent
+    = TypeOfComponent<T>
+      && std::is_same_v<typename std::remove_cvref_t<T>::StoragePolicy, SparseStorage>;
+
+// Tags are components without any data, e.g. struct Enemy : Component<Enemy> {}. They only exist as
+// a bit in the ArchetypeKey, archetypes don't allocate a column for them.
+template <typename T>
+concept TypeOfTagComponent = TypeOfComponent<T> && !TypeOfSparseComponent<T>
+                             && std::is_empty_v<std::remove_cvref_t<T>>;
+
+// Components stored as a column in the archetype.
+template <typename T>
+concept TypeOfColumnComponent = TypeOfComponent<T> && !TypeOfSparseComponent<T>
+                                && !TypeOfTagComponent<T>;
+
+// Components with a position in the plane, which can be tracked by a spatial index, see
+// hephaestus/SpatialIndex.hpp.
+template <typename T>
+concept TypeOfSpatialComponent = TypeOfComponent<T> && !TypeOfTagComponent<T>
+                                 && requires(const std::remove_cvref_t<T>& component) {
+                                        { component.x } -> std::convertible_to<float>;
+                                        { component.y } -> std::convertible_to<float>;
+                                    };
 } // namespace atlas::hephaestus
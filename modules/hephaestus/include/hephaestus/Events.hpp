@@ -0,0 +1,250 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+namespace atlas::hephaestus {
+// An append only buffer of events which any number of threads can send to at once without locking.
+// Every send claims an index with a single fetch_add and constructs the event in place. The events
+// live in blocks which double in size and never move, the blocks are kept when the buffer is
+// cleared, so a buffer which has seen its busiest frame doesn't allocate anymore.
+template <typename EventType>
+class EventBuffer final {
+  public:
+    class Iterator final {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = EventType;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const EventType*;
+        using reference = const EventType&;
+
+        Iterator() = default;
+        Iterator(const EventBuffer* buffer, const std::size_t index)
+            : buffer{buffer}
+            , index{index} {}
+
+        [[nodiscard]] auto operator*() const -> const EventType& {
+            return (*buffer)[index];
+        }
+
+        [[nodiscard]] auto operator->() const -> const EventType* {
+            return &(*buffer)[index];
+        }
+
+        auto operator++() -> Iterator& {
+            ++index;
+            return *this;
+        }
+
+        auto operator++(int) -> Iterator {
+            auto copy = *this;
+            ++index;
+            return copy;
+        }
+
+        [[nodiscard]] auto operator==(const Iterator& other) const -> bool {
+            return index == other.index;
+        }
+
+      private:
+        const EventBuffer* buffer = nullptr;
+        std::size_t index = 0;
+    };
+
+    EventBuffer() = default;
+    ~EventBuffer() {
+        clear();
+        for (std::size_t block = 0; block < MAX_BLOCKS; ++block) {
+            if (auto* events = blocks[block].load(std::memory_order_relaxed); events != nullptr) {
+                ::operator delete(events, std::align_val_t{alignof(EventType)});
+            }
+        }
+    }
+
+    EventBuffer(const EventBuffer&) = delete;
+    auto operator=(const EventBuffer&) -> EventBuffer& = delete;
+
+    EventBuffer(EventBuffer&&) = delete;
+    auto operator=(EventBuffer&&) -> EventBuffer& = delete;
+
+    // Thread safe.
+    template <typename... Args>
+    auto emplace(Args&&... args) -> void {
+        const auto index = num_events.fetch_add(1, std::memory_order_relaxed);
+        const auto block = get_block(index);
+        std::construct_at(
+            get_or_allocate(block) + (index - get_block_start(block)),
+            std::forward<Args>(args)...
+        );
+    }
+
+    // Reading and clearing must not overlap with sending, the frame graph orders the systems
+    // writing to a buffer before the ones reading it.
+    [[nodiscard]] auto size() const -> std::size_t {
+        return num_events.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto empty() const -> bool {
+        return size() == 0;
+    }
+
+    [[nodiscard]] auto operator[](const std::size_t index) const -> const EventType& {
+        assert(index < size() && "Reading an event past the end of the buffer.");
+        const auto block = get_block(index);
+        return blocks[block].load(std::memory_order_relaxed)[index - get_block_start(block)];
+    }
+
+    [[nodiscard]] auto begin() const -> Iterator {
+        return Iterator{this, 0};
+    }
+
+    [[nodiscard]] auto end() const -> Iterator {
+        return Iterator{this, size()};
+    }
+
+    auto clear() -> void {
+        if constexpr (!std::is_trivially_destructible_v<EventType>) {
+            for (std::size_t index = 0; index < size(); ++index) {
+                const auto block = get_block(index);
+                std::destroy_at(
+                    blocks[block].load(std::memory_order_relaxed) + (index - get_block_start(block))
+                );
+            }
+        }
+        num_events.store(0, std::memory_order_relaxed);
+    }
+
+  private:
+    static constexpr std::size_t FIRST_BLOCK_SIZE = 64;
+    // Enough blocks for more events than fit in memory.
+    static constexpr std::size_t MAX_BLOCKS = 48;
+
+    [[nodiscard]] static auto get_block(const std::size_t index) -> std::size_t {
+        return static_cast<std::size_t>(std::bit_width((index / FIRST_BLOCK_SIZE) + 1)) - 1;
+    }
+
+    [[nodiscard]] static auto get_block_start(const std::size_t block) -> std::size_t {
+        return FIRST_BLOCK_SIZE * ((std::size_t{1} << block) - 1);
+    }
+
+    // The first sender to reach a block allocates it, the others which raced it free theirs.
+    auto get_or_allocate(const std::size_t block) -> EventType* {
+        assert(block < MAX_BLOCKS && "Too many events in the buffer.");
+        auto* events = blocks[block].load(std::memory_order_acquire);
+        if (events != nullptr) {
+            return events;
+        }
+
+        auto* allocated = static_cast<EventType*>(::operator new(
+            sizeof(EventType) * (FIRST_BLOCK_SIZE << block),
+            std::align_val_t{alignof(EventType)}
+        ));
+        if (blocks[block].compare_exchange_strong(events, allocated, std::memory_order_acq_rel)) {
+            return allocated;
+        }
+
+        ::operator delete(allocated, std::align_val_t{alignof(EventType)});
+        return events;
+    }
+
+    std::array<std::atomic<EventType*>, MAX_BLOCKS> blocks{};
+    std::atomic<std::size_t> num_events = 0;
+};
+
+namespace detail {
+struct IEventChannel {
+    IEventChannel() = default;
+    virtual ~IEventChannel() = default;
+
+    IEventChannel(const IEventChannel&) = delete;
+    auto operator=(const IEventChannel&) -> IEventChannel& = delete;
+
+    IEventChannel(IEventChannel&&) = delete;
+    auto operator=(IEventChannel&&) -> IEventChannel& = delete;
+
+    virtual auto swap_buffers() -> void = 0;
+};
+} // namespace detail
+
+// The two buffers of an event type. Systems send to and read from the current buffer, at the end
+// of the systems of every frame it becomes the buffer of the last frame and the old one is cleared
+// to take the events of the next frame. Every event is read by the systems of exactly one frame:
+// the frame it's sent in when it's sent by a system, the next one otherwise.
+template <typename EventType>
+class EventChannel final : public detail::IEventChannel {
+  public:
+    // Thread safe.
+    template <typename... Args>
+    auto send(Args&&... args) -> void {
+        buffers[current].emplace(std::forward<Args>(args)...);
+    }
+
+    [[nodiscard]] auto get_current() const -> const EventBuffer<EventType>& {
+        return buffers[current];
+    }
+
+    [[nodiscard]] auto get_last_frame() const -> const EventBuffer<EventType>& {
+        return buffers[1 - current];
+    }
+
+    auto swap_buffers() -> void override {
+        current = 1 - current;
+        buffers[current].clear();
+    }
+
+  private:
+    std::array<EventBuffer<EventType>, 2> buffers;
+    std::size_t current = 0;
+};
+
+// The event channels of a World, one per event type. Like resources, channels are added before
+// start and never removed.
+class EventChannels final {
+  public:
+    EventChannels() = default;
+    ~EventChannels() = default;
+
+    EventChannels(const EventChannels&) = delete;
+    auto operator=(const EventChannels&) -> EventChannels& = delete;
+
+    EventChannels(EventChannels&&) = delete;
+    auto operator=(EventChannels&&) -> EventChannels& = delete;
+
+    // Does nothing if the channel already exists.
+    template <typename EventType>
+    auto add() -> EventChannel<EventType>& {
+        auto& channel = channels[std::type_index(typeid(EventType))];
+        if (channel == nullptr) {
+            channel = std::make_unique<EventChannel<EventType>>();
+        }
+        return static_cast<EventChannel<EventType>&>(*channel);
+    }
+
+    template <typename EventType>
+    [[nodiscard]] auto get() const -> EventChannel<EventType>& {
+        const auto channel = channels.find(std::type_index(typeid(EventType)));
+        assert(channel != channels.end() && "The event type hasn't been added to the world.");
+        return static_cast<EventChannel<EventType>&>(*channel->second);
+    }
+
+    auto swap_buffers() -> void {
+        for (auto& [type, channel] : channels) {
+            channel->swap_buffers();
+        }
+    }
+
+  private:
+    std::unordered_map<std::type_index, std::unique_ptr<detail::IEventChannel>> channels;
+};
+} // namespace atlas::hephaestus
@@ -1,9 +1,9 @@
 #pragma once
 
 #include <cstdint>
-#include <optional>
-#include <tuple>
-#include <type_traits>
+#include <expected>
+#include <filesystem>
+#include <memory>
 #include <vector>
 
 #include <taskflow/taskflow.hpp>
@@ -11,14 +11,12 @@
 #include "core/IEngine.hpp"
 #include "core/ITickable.hpp"
 #include "core/Module.hpp"
-#include "hephaestus/Archetype.hpp"
+#include "hephaestus/AllocationTracker.hpp"
 #include "hephaestus/ArchetypeKey.hpp"
-#include "hephaestus/ArchetypeMap.hpp"
 #include "hephaestus/Common.hpp"
 #include "hephaestus/Concepts.hpp"
-#include "hephaestus/System.hpp"
-#include "hephaestus/SystemBase.hpp"
-#include "hephaestus/Utils.hpp"
+#include "hephaestus/Prefab.hpp"
+#include "hephaestus/World.hpp"
 
 namespace atlas::hephaestus {
 template <typename T>
@@ -27,10 +25,10 @@ struct Debug;
 template <typename... Ts>
 struct Debugs;
 
-struct SystemNode {
-    std::vector<SystemDependencies> dependencies;
-};
-
+// Hephaestus hosts one or more isolated Worlds and ticks all of them concurrently on a single
+// shared executor. A default world is always created, and the entity/system/archetype API on the
+// module forwards to it, so games that only need a single simulation never have to touch World
+// directly.
 class Hephaestus final : public core::Module, public core::ITickable {
   public:
     explicit Hephaestus(core::IEngine& engine);
@@ -42,9 +40,19 @@ class Hephaestus final : public core::Module, public core::ITickable {
 
     auto tick() -> void override;
 
-    template <typename Func>
+    // Worlds must be created before start has finished, same as systems and archetypes.
+    auto create_world(const AllocatorPolicy& allocator_policy = {}) -> World&;
+
+    [[nodiscard]] auto get_world() const -> World&;
+    [[nodiscard]] auto get_world(WorldId id) const -> World&;
+    [[nodiscard]] auto get_num_worlds() const -> std::size_t;
+
+    template <typename... Filters, typename Func>
     auto create_system(Func&& func) -> void;
 
+    template <typename... Filters, typename Func>
+    auto create_hierarchy_system(Func&& func) -> void;
+
     template <AllTypeOfComponent... ComponentTypes>
     auto create_archetype(std::uint32_t entity_buffer_size) -> void;
 
@@ -52,157 +60,201 @@ class Hephaestus final : public core::Module, public core::ITickable {
         -> void;
 
     template <AllTypeOfComponent... ComponentTypes>
-    auto create_entity(ComponentTypes&&... components) -> void;
+    auto create_entity(ComponentTypes&&... components) -> Entity;
+
+    template <AllTypeOfComponent... ComponentTypes>
+    auto create_prefab(ComponentTypes&&... components)
+        -> Prefab<std::remove_cvref_t<ComponentTypes>...>;
+
+    template <AllTypeOfComponent... ComponentTypes>
+    auto create_prefab_from(Entity entity) -> Prefab<ComponentTypes...>;
+
+    template <AllTypeOfComponent... ComponentTypes, typename Func = detail::NoOverride>
+    auto instantiate(const Prefab<ComponentTypes...>& prefab, std::size_t count, Func&& func = {})
+        -> Entity;
 
     auto destroy_entity(Entity entity) -> void;
 
+    template <TypeOfSparseComponent ComponentType>
+    auto add_component(Entity entity, ComponentType&& component) -> void;
+
+    template <TypeOfSparseComponent ComponentType>
+    auto remove_component(Entity entity) -> void;
+
+    template <TypeOfSparseComponent... ComponentTypes>
+    auto create_group() -> void;
+
+    template <TypeOfSpatialComponent ComponentType>
+    auto create_spatial_index(float cell_size)
+        -> SpatialIndex<std::remove_cvref_t<ComponentType>>&;
+
+    auto set_parent(Entity child, Entity parent) -> void;
+    auto remove_parent(Entity child) -> void;
+
+    auto set_enabled(Entity entity, bool enabled) -> void;
+
+    // Records the commands of the default world, see World::set_command_recorder.
+    auto set_command_recorder(CommandRecorder* recorder) -> void;
+
+    // Saves and loads the default world, see World::save_snapshot and World::load_snapshot.
+    [[nodiscard]] auto save_snapshot(
+        const std::filesystem::path& path,
+        const SnapshotSchema& schema
+    ) const -> std::expected<void, SnapshotErrorCode>;
+    auto load_snapshot(const std::filesystem::path& path, const SnapshotSchema& schema)
+        -> std::expected<void, SnapshotErrorCode>;
+
+    // Streams cells in and out of the default world, see World::create_streamer.
+    auto create_streamer(SnapshotSchema schema, const StreamingSettings& settings = {})
+        -> WorldStreamer&;
+
+    // Observes the components of the default world, see World::on_add.
+    template <AllTypeOfComponent ComponentType, typename Func>
+    auto on_add(Func&& func) -> void;
+
+    template <AllTypeOfComponent ComponentType, typename Func>
+    auto on_remove(Func&& func) -> void;
+
+    template <TypeOfSparseComponent ComponentType, typename Func>
+    auto on_change(Func&& func) -> void;
+
+    // Checkpoints and rolls back the default world, see World::enable_checkpoints and
+    // World::restore_checkpoint. Ticking after a restore ticks every world.
+    template <TypeOfColumnComponent... ComponentTypes>
+    auto enable_checkpoints(const CheckpointSettings& settings = {}) -> Checkpoints&;
+    auto restore_checkpoint(std::uint64_t frame) -> bool;
+
+    // Events of the default world, see World::add_event.
+    template <typename EventType>
+    auto add_event() -> void;
+
+    template <typename EventType, typename... Args>
+    auto send_event(Args&&... args) -> void;
+
+    template <typename ResourceType>
+    auto insert_resource(ResourceType&& resource) -> std::remove_cvref_t<ResourceType>&;
+
+    template <typename ResourceType>
+    [[nodiscard]] auto get_resource() const -> ResourceType&;
+
+    // Totals summed over all worlds, use World::get_stats for per world numbers.
     auto get_tot_num_created_ents() const -> std::uint64_t;
     auto get_tot_num_destroyed_ents() const -> std::uint64_t;
 
-  protected:
-    [[nodiscard]] static auto generate_unique_entity_id() -> Entity;
+    // The heap allocations of the last tick, empty unless built with HEPHAESTUS_TRACK_ALLOCATIONS.
+    [[nodiscard]] auto get_frame_allocations() const -> const AllocationStats&;
 
-    auto build_systems_dependency_graph() -> void;
+    // One snapshot per world, see World::collect_introspection. Must not be called while ticking.
+    [[nodiscard]] auto collect_introspection() const -> std::vector<WorldIntrospection>;
 
-  private:
-    std::vector<std::unique_ptr<SystemBase>> systems;
-    ArchetypeMap archetypes;
-    std::unordered_map<Entity, ArchetypeKey> ent_to_archetype_key;
+    // Writes the snapshots of all worlds to path as JSON, returns false if it couldn't be written.
+    auto dump_introspection(const std::filesystem::path& path) const -> bool;
 
-    std::vector<std::function<void()>> creation_queue;
-    std::vector<Entity> destroy_queue;
-    std::optional<std::vector<SystemNode>> system_nodes = std::vector<SystemNode>{};
+  private:
+    std::vector<std::unique_ptr<World>> worlds;
 
-    tf::Taskflow systems_graph;
+    tf::Taskflow worlds_graph;
     tf::Executor systems_executor;
-
-    std::uint64_t tot_num_created_ents = 0;
-    std::uint64_t tot_num_destroyed_ents = 0;
-
-    // This is all confusing, however, the purpose of this is to improve the API
-    // for calling the create_system function. This way, the user only needs to
-    // pass the lambda which will be used as the system function, the rest is
-    // deduced and handled.
-
-    // A utility to pull out parameter types from a a callable.
-    template <typename T>
-    struct FunctionTraits : FunctionTraits<decltype(&T::operator())> {};
-    // This leverages the call operator of a lambda:
-    // For example, if we have:
-    //   auto myLambda = [](int a, float b) { ... };
-    // then decltype(&decltype(myLambda)::operator()) = Ret (ClassType::*)(int,
-    // float) const;
-
-    // Now the partial specialization for a non-generic, const lambda
-    // with exactly two parameters.
-    template <typename ClassType, typename ReturnType, typename EngineParam, typename TupleParam>
-    struct FunctionTraits<ReturnType (ClassType::*)(EngineParam, TupleParam) const> {
-        static_assert(
-            !std::is_const_v<std::remove_reference_t<TupleParam>>,
-            "Const tuples are not supported. Use std::tuple<const Component&, ...>& instead of "
-            "const std::tuple<Component&, ...>&"
-        );
-        using EngineType = std::decay_t<EngineParam>;
-        using TupleType = std::remove_reference_t<TupleParam>; // Remove reference but keep
-                                                               // component const-ness
-    };
-
-    template <typename T>
-    struct TupleElements;
-
-    template <typename... Ts>
-    struct TupleElements<std::tuple<Ts...>> {
-        static_assert(
-            !HAS_DUPLICATE_COMPONENT_TYPE_V<Ts...>,
-            "A system cannot take the same component type twice (const or non-const)."
-        );
-
-        template <template <typename...> class Template>
-        using Apply = Template<std::remove_cvref_t<Ts>...>; // Remove both const and ref
-
-        static auto make_dependencies() {
-            return make_system_dependencies<Ts...>();
-        }
-    };
 };
 
-template <typename Func>
+template <typename... Filters, typename Func>
 auto Hephaestus::create_system(Func&& func) -> void {
-    const auto init_status = get_engine().get_engine_init_status();
-    assert(
-        init_status <= core::EngineInitStatus::RunningStart && "Cannot create systems after start."
-    );
-    assert(
-        system_nodes != std::nullopt
-        && "Trying to create a system after the system_nodes have been reset."
-    );
+    get_world().create_system<Filters...>(std::forward<Func>(func));
+}
 
-    using Traits = FunctionTraits<std::decay_t<Func>>;
-    using TupleType = typename Traits::TupleType; // e.g. std::tuple<Transform&, Velocity&>
-    using Components = TupleElements<TupleType>;
-    using SystemType = typename Components::template Apply<System>;
+template <typename... Filters, typename Func>
+auto Hephaestus::create_hierarchy_system(Func&& func) -> void {
+    get_world().create_hierarchy_system<Filters...>(std::forward<Func>(func));
+}
 
-    auto dependencies = Components::make_dependencies();
-    system_nodes->emplace_back(SystemNode{.dependencies = dependencies});
+template <AllTypeOfComponent... ComponentTypes>
+auto Hephaestus::create_archetype(const std::uint32_t entity_buffer_size) -> void {
+    get_world().create_archetype<ComponentTypes...>(entity_buffer_size);
+}
 
-    auto new_system = std::make_unique<SystemType>(
-        std::forward<Func>(func),
-        archetypes,
-        std::move(dependencies)
-    );
+template <AllTypeOfComponent... ComponentTypes>
+auto Hephaestus::create_entity(ComponentTypes&&... components) -> Entity {
+    return get_world().create_entity(std::forward<ComponentTypes>(components)...);
+}
 
-    systems.emplace_back(std::move(new_system));
+template <AllTypeOfComponent... ComponentTypes>
+auto Hephaestus::create_prefab(ComponentTypes&&... components)
+    -> Prefab<std::remove_cvref_t<ComponentTypes>...> {
+    return get_world().create_prefab(std::forward<ComponentTypes>(components)...);
 }
 
 template <AllTypeOfComponent... ComponentTypes>
-auto Hephaestus::create_archetype(const std::uint32_t entity_buffer_size) -> void {
-    const auto init_status = get_engine().get_engine_init_status();
-    assert(
-        init_status <= core::EngineInitStatus::RunningStart
-        && "Cannot create new archetypes after start."
-    );
+auto Hephaestus::create_prefab_from(const Entity entity) -> Prefab<ComponentTypes...> {
+    return get_world().create_prefab_from<ComponentTypes...>(entity);
+}
 
-    create_archetype_with_signature(make_archetype_key<ComponentTypes...>(), entity_buffer_size);
+template <AllTypeOfComponent... ComponentTypes, typename Func>
+auto Hephaestus::instantiate(
+    const Prefab<ComponentTypes...>& prefab,
+    const std::size_t count,
+    Func&& func
+) -> Entity {
+    return get_world().instantiate(prefab, count, std::forward<Func>(func));
 }
 
-// No entities are created on the fly. We enqueue all of it into a collection
-// which is iterated and constructs all entities in the begining of the next
-// frame.
-template <AllTypeOfComponent... ComponentTypes>
-auto Hephaestus::create_entity(ComponentTypes&&... components) -> void {
-    static_assert(
-        !HAS_DUPLICATE_COMPONENT_TYPE_V<ComponentTypes...>,
-        "A single entity cannot have the same component type twice (const or non-const)."
-    );
-
-    const auto signature = make_archetype_key<ComponentTypes...>();
-    auto& archetype = [this, &signature]() -> ArchetypePtr& {
-        if (!archetypes.contains(signature)) {
-            constexpr auto ENTITY_BUFFER_GUESSTIMATION = 500;
-            create_archetype_with_signature(signature, ENTITY_BUFFER_GUESSTIMATION);
-        }
-
-        return archetypes[signature];
-    }();
-
-    auto components_tuple = std::make_tuple(std::forward<ComponentTypes>(components)...);
-    creation_queue.emplace_back([this,
-                                 data = std::move(components_tuple),
-                                 signature = std::move(signature),
-                                 &archetype]() mutable {
-        const auto entity_id = generate_unique_entity_id();
-
-        std::apply(
-            [&](auto&&... unpacked) {
-                archetype->template create_entity<ComponentTypes...>(
-                    entity_id,
-                    std::move(unpacked)...
-                );
-            },
-            data
-        );
-
-        ent_to_archetype_key.emplace(entity_id, signature);
-    });
+template <TypeOfSparseComponent ComponentType>
+auto Hephaestus::add_component(const Entity entity, ComponentType&& component) -> void {
+    get_world().add_component(entity, std::forward<ComponentType>(component));
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto Hephaestus::remove_component(const Entity entity) -> void {
+    get_world().remove_component<ComponentType>(entity);
+}
+
+template <TypeOfSparseComponent... ComponentTypes>
+auto Hephaestus::create_group() -> void {
+    get_world().create_group<ComponentTypes...>();
+}
+
+template <TypeOfSpatialComponent ComponentType>
+auto Hephaestus::create_spatial_index(const float cell_size)
+    -> SpatialIndex<std::remove_cvref_t<ComponentType>>& {
+    return get_world().create_spatial_index<ComponentType>(cell_size);
+}
+
+template <AllTypeOfComponent ComponentType, typename Func>
+auto Hephaestus::on_add(Func&& func) -> void {
+    get_world().on_add<ComponentType>(std::forward<Func>(func));
+}
+
+template <AllTypeOfComponent ComponentType, typename Func>
+auto Hephaestus::on_remove(Func&& func) -> void {
+    get_world().on_remove<ComponentType>(std::forward<Func>(func));
+}
+
+template <TypeOfSparseComponent ComponentType, typename Func>
+auto Hephaestus::on_change(Func&& func) -> void {
+    get_world().on_change<ComponentType>(std::forward<Func>(func));
+}
+
+template <TypeOfColumnComponent... ComponentTypes>
+auto Hephaestus::enable_checkpoints(const CheckpointSettings& settings) -> Checkpoints& {
+    return get_world().enable_checkpoints<ComponentTypes...>(settings);
+}
+
+template <typename EventType>
+auto Hephaestus::add_event() -> void {
+    get_world().add_event<EventType>();
+}
+
+template <typename EventType, typename... Args>
+auto Hephaestus::send_event(Args&&... args) -> void {
+    get_world().send_event<EventType>(std::forward<Args>(args)...);
+}
+
+template <typename ResourceType>
+auto Hephaestus::insert_resource(ResourceType&& resource) -> std::remove_cvref_t<ResourceType>& {
+    return get_world().insert_resource(std::forward<ResourceType>(resource));
+}
+
+template <typename ResourceType>
+auto Hephaestus::get_resource() const -> ResourceType& {
+    return get_world().get_resource<ResourceType>();
 }
 } // namespace atlas::hephaestus
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "hephaestus/Common.hpp"
+
+namespace atlas::hephaestus {
+constexpr auto NO_PARENT = std::numeric_limits<Entity>::max();
+
+// Parent/child relationships of the entities of a World.
+//
+// Every entity has at most one parent. The links live in two hash maps, child to parent and parent
+// to children, which keeps changing them O(1) in the number of entities. For iteration the children
+// are also stored as ranges in a flat vector sorted by parent, so the children of an entity are
+// contiguous and handed out as a span. The ranges are rebuilt once after a batch of changes, see
+// sort.
+//
+// Entities without a parent are roots, which includes every entity which isn't part of any
+// relationship.
+class Hierarchy final {
+  public:
+    explicit Hierarchy(
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource()
+    );
+    ~Hierarchy() = default;
+
+    Hierarchy(const Hierarchy&) = delete;
+    auto operator=(const Hierarchy&) -> Hierarchy& = delete;
+
+    Hierarchy(Hierarchy&&) = delete;
+    auto operator=(Hierarchy&&) -> Hierarchy& = delete;
+
+    // Replaces the current parent of the child. Returns false, and leaves the hierarchy untouched,
+    // if the parent is the child itself or one of its descendants.
+    auto set_parent(Entity child, Entity parent) -> bool;
+
+    // Returns false if the child didn't have a parent.
+    auto remove_parent(Entity child) -> bool;
+
+    // Removes every link of the entity, its children become roots. Returns false if the entity
+    // wasn't part of any relationship.
+    auto remove_entity(Entity entity) -> bool;
+
+    // Rebuilds the child ranges if any link has changed since the last call.
+    auto sort() -> void;
+
+    // Returns NO_PARENT for roots.
+    [[nodiscard]] auto get_parent(Entity child) const -> Entity;
+
+    // Only valid after sort, sorted by entity.
+    [[nodiscard]] auto get_children(Entity parent) const -> std::span<const Entity>;
+
+    // Bumped by every change, used by the hierarchy queries to detect that they must be rebuilt.
+    [[nodiscard]] auto get_version() const -> std::uint64_t {
+        return version;
+    }
+
+  private:
+    struct ChildRange {
+        std::uint32_t begin = 0;
+        std::uint32_t end = 0;
+    };
+
+    auto unlink(Entity child, Entity parent) -> void;
+
+    std::pmr::unordered_map<Entity, Entity> parents;
+    std::pmr::unordered_multimap<Entity, Entity> links;
+
+    // Built by sort, children holds the child of every link grouped by parent.
+    std::pmr::vector<Entity> children;
+    std::pmr::unordered_map<Entity, ChildRange> child_ranges;
+
+    std::uint64_t version = 0;
+    bool is_sorted = true;
+};
+} // namespace atlas::hephaestus
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "hephaestus/AllocationTracker.hpp"
+#include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/ComponentVersions.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/Hierarchy.hpp"
+#include "hephaestus/SparseSet.hpp"
+#include "hephaestus/SystemBase.hpp"
+#include "hephaestus/SystemParams.hpp"
+#include "hephaestus/Utils.hpp"
+#include "hephaestus/query/HierarchyQuery.hpp"
+#include <algorithm>
+#include <taskflow/algorithm/for_each.hpp>
+#include <taskflow/taskflow.hpp>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace atlas::core {
+class IEngine;
+}
+
+namespace atlas::hephaestus {
+// A system which runs on the entities depth by depth, see HierarchyQuery. Every entity gets the
+// components of its parent, which have already been processed, so transforms and other inherited
+// state can be propagated from the roots down in a single execution.
+//
+// The entities of a level are independent of each other and are processed in parallel, the levels
+// run one after the other.
+template <typename Params, AllTypeOfComponent... ComponentTypes>
+class HierarchySystem final : public SystemBase {
+  public:
+    using SystemFunc = typename Params::template HierarchyFunc<ComponentTypes...>;
+
+    explicit HierarchySystem(
+        SystemFunc func,
+        const ArchetypeMap& archetypes,
+        const SparseSets& sparse_sets,
+        const ComponentVersions& versions,
+        const Hierarchy& hierarchy,
+        SystemContext context,
+        std::vector<SystemDependencies> dependencies,
+        const QueryFilter& filter = {}
+    )
+        : query{
+              archetypes,
+              sparse_sets,
+              versions,
+              hierarchy,
+              context.memory_resource,
+              std::move(dependencies),
+              filter
+          }
+        , func{std::move(func)}
+        , context{context} {}
+
+    HierarchySystem(const HierarchySystem&) = delete;
+    auto operator=(const HierarchySystem&) -> HierarchySystem& = delete;
+
+    HierarchySystem(HierarchySystem&&) = delete;
+    auto operator=(HierarchySystem&&) -> HierarchySystem& = delete;
+
+    ~HierarchySystem() override = default;
+
+    auto set_concurrent_systems(std::size_t estimate) -> void override {
+        concurrent_systems_estimate = estimate;
+    }
+
+    auto execute(const core::IEngine& engine, tf::Subflow& subflow) -> void override;
+
+    [[nodiscard]] auto collect_query_stats() const -> QueryStats override {
+        return query.collect_stats();
+    }
+
+  private:
+    using Levels = typename HierarchyQuery<ComponentTypes...>::Levels;
+
+    auto invoke(
+        const core::IEngine& engine,
+        const Levels& levels,
+        std::size_t index,
+        const typename Params::Tuple& params
+    ) const -> void;
+
+    HierarchyQuery<ComponentTypes...> query;
+    SystemFunc func;
+    SystemContext context;
+    std::size_t concurrent_systems_estimate = 1;
+};
+
+template <typename Params, AllTypeOfComponent... ComponentTypes>
+auto HierarchySystem<Params, ComponentTypes...>::invoke(
+    const core::IEngine& engine,
+    const Levels& levels,
+    const std::size_t index,
+    const typename Params::Tuple& params
+) const -> void {
+    if (!levels.is_enabled(index)) {
+        return;
+    }
+
+    std::apply(
+        [&](const auto&... unpacked) {
+            func(engine, levels.components[index], levels.get_parent(index), unpacked...);
+        },
+        params
+    );
+}
+
+template <typename Params, AllTypeOfComponent... ComponentTypes>
+auto HierarchySystem<Params, ComponentTypes...>::execute(
+    const core::IEngine& engine,
+    tf::Subflow& subflow
+) -> void {
+    const auto params = Params::fetch(context);
+    const auto& levels = query.get();
+
+    constexpr std::size_t MIN_PARALLEL_THRESHOLD = 128;
+    if (Params::IS_EXCLUSIVE || levels.components.size() < MIN_PARALLEL_THRESHOLD) {
+        for (std::size_t index = 0; index < levels.components.size(); ++index) {
+            invoke(engine, levels, index, params);
+        }
+        return;
+    }
+
+    const auto num_workers = subflow.executor().num_workers();
+    const auto effective_workers = std::max<std::size_t>(
+        1,
+        num_workers / concurrent_systems_estimate
+    );
+
+    // One task per level, chained so a level only starts once its parents are done. Small levels,
+    // typically the few roots at the top, aren't worth splitting up.
+    const AllocationScopeGuard scheduling{AllocationScope::TaskScheduling};
+    tf::Task previous_level;
+    for (std::size_t depth = 0; depth < levels.get_num_levels(); ++depth) {
+        const auto [begin, end] = levels.get_level(depth);
+        const auto process = [this, &engine, &levels, &params](std::size_t index) {
+            const AllocationScopeGuard scope{AllocationScope::SystemExecute};
+            invoke(engine, levels, index, params);
+        };
+
+        tf::Task level;
+        if (end - begin < MIN_PARALLEL_THRESHOLD) {
+            level = subflow.emplace([begin, end, process]() {
+                for (auto index = begin; index < end; ++index) {
+                    process(index);
+                }
+            });
+        } else {
+            constexpr std::size_t MIN_CHUNK_SIZE = MIN_PARALLEL_THRESHOLD / 2;
+            const auto chunk_size = std::max<std::size_t>(
+                (end - begin) / effective_workers,
+                MIN_CHUNK_SIZE
+            );
+            level = subflow.for_each_index(
+                begin,
+                end,
+                std::size_t{1},
+                process,
+                tf::StaticPartitioner(chunk_size)
+            );
+        }
+
+        if (!previous_level.empty()) {
+            previous_level.precede(level);
+        }
+        previous_level = level;
+    }
+
+    // The params and the cached levels live on this stack frame, the subflow is joined before
+    // returning.
+    subflow.join();
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace atlas::hephaestus {
+// A read only view of a whole file. The file is memory mapped, so only the pages which are touched
+// are read from disk, and copying out of it is a plain memcpy from the page cache. Platforms, or
+// files, which can't be mapped are read into memory instead, the view is the same either way.
+class MappedFile final {
+  public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+    MappedFile(MappedFile&&) = delete;
+    auto operator=(MappedFile&&) -> MappedFile& = delete;
+
+    // Closes the file which was open before. Returns false if the file can't be opened.
+    auto open(const std::filesystem::path& path) -> bool;
+    auto close() -> void;
+
+    [[nodiscard]] auto get_data() const -> std::span<const std::byte> {
+        return data;
+    }
+
+    // False when the file was read into memory.
+    [[nodiscard]] auto is_mapped() const -> bool {
+        return mapping != nullptr;
+    }
+
+  private:
+    auto read(const std::filesystem::path& path) -> bool;
+
+    std::span<const std::byte> data;
+    // The start of the mapped view, nullptr when the file was read into buffer.
+    void* mapping = nullptr;
+    std::vector<std::byte> buffer;
+};
+} // namespace atlas::hephaestus
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <vector>
+
+#include "hephaestus/HephaestusConfig.hpp"
+
+namespace atlas::hephaestus {
+// How a World allocates its component columns, archetype bookkeeping, sparse sets and query
+// caches. The Archetype and component storage objects and the ArchetypeMap index still come from
+// the global heap: they are allocated once per archetype or column, never per entity, and are
+// owned through std::unique_ptr, which can't give memory back to a pmr resource.
+// - Heap: the global heap, through std::pmr::new_delete_resource.
+// - Pages: a pool on top of large pages which are reserved from the OS, optionally backed by
+//   2 MB transparent huge pages on Linux. Keeps the ECS allocations of a world away from the global
+//   heap, which avoids malloc contention with other threads and fragmentation over long uptimes.
+//
+// The default for all worlds is decided at configure time, see HEPHAESTUS_PAGE_ALLOCATOR and
+// HEPHAESTUS_HUGE_PAGES in modules/hephaestus/CMakeLists.txt.
+struct AllocatorPolicy {
+    enum class Kind : std::uint8_t { Heap, Pages };
+
+    static constexpr std::size_t HUGE_PAGE_SIZE = std::size_t{2} * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_PAGE_SIZE = std::size_t{64} * 1024;
+
+    Kind kind = DEFAULT_USE_PAGE_ALLOCATOR ? Kind::Pages : Kind::Heap;
+    bool use_huge_pages = DEFAULT_USE_HUGE_PAGES;
+    // Only used with Kind::Pages, rounded up to HUGE_PAGE_SIZE when use_huge_pages is set.
+    std::size_t page_size = DEFAULT_PAGE_SIZE;
+};
+
+struct MemoryStats {
+    // Bytes taken from the OS (Pages) or the global heap (Heap).
+    std::size_t bytes_reserved = 0;
+    // Bytes currently handed out to the containers of the world.
+    std::size_t bytes_used = 0;
+    std::size_t peak_bytes_used = 0;
+    // Allocations which haven't been deallocated yet.
+    std::size_t num_live_allocations = 0;
+
+    // Reserved but unused, pool overhead, free blocks and page rounding.
+    [[nodiscard]] auto get_waste() const -> std::size_t {
+        return bytes_reserved > bytes_used ? bytes_reserved - bytes_used : 0;
+    }
+};
+
+// Hands out whole pages straight from the OS (mmap on POSIX, the aligned global heap elsewhere).
+// It is meant to sit below a pool resource and not to be used directly by containers. Large
+// allocations are rounded up to the page size. Small ones, like the first chunks of every pool,
+// are packed together into shared pages instead of taking a page each, which would be 2 MB apiece
+// with huge pages. Shared pages are only returned to the OS with the resource.
+class PageResource final : public std::pmr::memory_resource {
+  public:
+    PageResource(std::size_t page_size, bool use_huge_pages);
+    ~PageResource() override;
+
+    PageResource(const PageResource&) = delete;
+    auto operator=(const PageResource&) -> PageResource& = delete;
+
+    PageResource(PageResource&&) = delete;
+    auto operator=(PageResource&&) -> PageResource& = delete;
+
+    [[nodiscard]] auto get_bytes_reserved() const -> std::size_t {
+        return bytes_reserved.load(std::memory_order_relaxed);
+    }
+
+  private:
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override;
+    auto do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) -> void override;
+    [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept
+        -> bool override;
+
+    [[nodiscard]] auto round_to_pages(std::size_t bytes) const -> std::size_t;
+    [[nodiscard]] auto is_shared(std::size_t bytes) const -> bool;
+    [[nodiscard]] auto map_pages(std::size_t size, std::size_t alignment) -> void*;
+    auto unmap_pages(void* ptr, std::size_t size, std::size_t alignment) -> void;
+
+    std::size_t page_size;
+    bool use_huge_pages;
+    std::atomic<std::size_t> bytes_reserved = 0;
+
+    // The pages small allocations are packed into, and what's left of the last one.
+    std::mutex shared_mutex;
+    std::vector<void*> shared_pages;
+    std::byte* shared_cursor = nullptr;
+    std::size_t shared_left = 0;
+};
+
+// Counts the bytes going through it to the upstream resource.
+class TrackingResource final : public std::pmr::memory_resource {
+  public:
+    explicit TrackingResource(std::pmr::memory_resource* upstream);
+    ~TrackingResource() override = default;
+
+    TrackingResource(const TrackingResource&) = delete;
+    auto operator=(const TrackingResource&) -> TrackingResource& = delete;
+
+    TrackingResource(TrackingResource&&) = delete;
+    auto operator=(TrackingResource&&) -> TrackingResource& = delete;
+
+    [[nodiscard]] auto get_bytes_used() const -> std::size_t {
+        return bytes_used.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto get_peak_bytes_used() const -> std::size_t {
+        return peak_bytes_used.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] auto get_num_live_allocations() const -> std::size_t {
+        return num_live_allocations.load(std::memory_order_relaxed);
+    }
+
+  private:
+    auto do_allocate(std::size_t bytes, std::size_t alignment) -> void* override;
+    auto do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) -> void override;
+    [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept
+        -> bool override;
+
+    std::pmr::memory_resource* upstream;
+    std::atomic<std::size_t> bytes_used = 0;
+    std::atomic<std::size_t> peak_bytes_used = 0;
+    std::atomic<std::size_t> num_live_allocations = 0;
+};
+
+// The memory resources of a World, built from its AllocatorPolicy. Query caches are rebuilt from
+// within the systems, which run concurrently, so the resource handed out is thread safe.
+class WorldMemory final {
+  public:
+    explicit WorldMemory(const AllocatorPolicy& policy);
+    ~WorldMemory();
+
+    WorldMemory(const WorldMemory&) = delete;
+    auto operator=(const WorldMemory&) -> WorldMemory& = delete;
+
+    WorldMemory(WorldMemory&&) = delete;
+    auto operator=(WorldMemory&&) -> WorldMemory& = delete;
+
+    [[nodiscard]] auto get_resource() -> std::pmr::memory_resource*;
+    [[nodiscard]] auto get_policy() const -> const AllocatorPolicy&;
+    [[nodiscard]] auto get_stats() const -> MemoryStats;
+
+  private:
+    AllocatorPolicy policy;
+
+    // Declared in dependency order, each resource uses the one above it as upstream.
+    std::unique_ptr<PageResource> pages;
+    std::unique_ptr<std::pmr::synchronized_pool_resource> pool;
+    std::unique_ptr<TrackingResource> tracking;
+};
+} // namespace atlas::hephaestus
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <vector>
+
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
+
+namespace atlas::core {
+class IEngine;
+} // namespace atlas::core
+
+namespace atlas::hephaestus {
+enum class ObserverEvent : std::uint8_t {
+    // The entity got the component, created entities included.
+    Add,
+    // A sparse component the entity already had was assigned by add_component.
+    Change,
+    // The entity lost the component, destroyed entities included.
+    Remove,
+};
+
+using ObserverFunc =
+    std::function<void(const core::IEngine& engine, std::span<const Entity> entities)>;
+
+// The observers of a World, see World::on_add. Events are collected while the structural changes
+// are applied and delivered in batches: every observer is called once per batch with all the
+// entities of its component and event, in the order the changes were applied. A batch only holds
+// handles, destroyed entities are gone by the time their removal is delivered.
+class Observers final {
+  public:
+    Observers() = default;
+    ~Observers() = default;
+
+    Observers(const Observers&) = delete;
+    auto operator=(const Observers&) -> Observers& = delete;
+
+    Observers(Observers&&) = delete;
+    auto operator=(Observers&&) -> Observers& = delete;
+
+    auto add(ObserverEvent event, ComponentTypeId component_id, ObserverFunc func) -> void;
+
+    // The components with observers for the event.
+    [[nodiscard]] auto get_observed(const ObserverEvent event) const -> const ArchetypeKey& {
+        return observed[static_cast<std::size_t>(event)];
+    }
+
+    [[nodiscard]] auto is_observed(const ObserverEvent event, const ComponentTypeId component_id)
+        const -> bool {
+        return get_observed(event).has_component(component_id);
+    }
+
+    // The component must be observed for the event. Must not be called concurrently, the changes
+    // of a world are applied one task at a time as far as observed components go.
+    auto push(ObserverEvent event, ComponentTypeId component_id, Entity entity) -> void;
+    auto push(ObserverEvent event, ComponentTypeId component_id, std::span<const Entity> entities)
+        -> void;
+
+    // Calls the observers of every batch collected since the last delivery, additions first, then
+    // changes, then removals.
+    auto deliver(const core::IEngine& engine) -> void;
+
+  private:
+    static constexpr std::size_t NUM_EVENTS = 3;
+
+    struct Batch {
+        std::vector<ObserverFunc> observers;
+        std::vector<Entity> entities;
+    };
+
+    [[nodiscard]] auto get_batch(ObserverEvent event, ComponentTypeId component_id) -> Batch&;
+
+    // Per event, in the order the components were first observed.
+    std::array<std::vector<Batch>, NUM_EVENTS> batches;
+    // Per event, the index in batches of every observed component, indexed by component id.
+    std::array<std::vector<std::uint32_t>, NUM_EVENTS> batch_indices;
+    std::array<ArchetypeKey, NUM_EVENTS> observed;
+};
+} // namespace atlas::hephaestus
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <tuple>
+#include <utility>
+
+#include "hephaestus/Common.hpp"
+#include "hephaestus/Concepts.hpp"
+
+namespace atlas::hephaestus {
+// A template entity which World::instantiate clones many times over. It holds a copy of every
+// component, and the archetype of its instances, which is resolved once when the prefab is
+// created. Prefabs are plain values, changing the components of a prefab only changes the
+// instances which are queued afterwards.
+template <AllTypeOfComponent... ComponentTypes>
+class Prefab final {
+  public:
+    [[nodiscard]] auto get_components() const -> const std::tuple<ComponentTypes...>& {
+        return components;
+    }
+
+    [[nodiscard]] auto get_components() -> std::tuple<ComponentTypes...>& {
+        return components;
+    }
+
+  private:
+    friend class World;
+
+    Prefab(
+        const WorldId world_id,
+        const ArchetypeId archetype_id,
+        std::tuple<ComponentTypes...> components
+    )
+        : world_id{world_id}
+        , archetype_id{archetype_id}
+        , components{std::move(components)} {}
+
+    WorldId world_id;
+    ArchetypeId archetype_id;
+    std::tuple<ComponentTypes...> components;
+};
+} // namespace atlas::hephaestus
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cassert>
+#include <memory>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+namespace atlas::hephaestus {
+// Typed singletons owned by a World, for global state such as configs, input snapshots and RNG
+// state which would otherwise have to live in an entity. Systems access them through Res<T> and
+// Res<const T>, see hephaestus/SystemParams.hpp.
+//
+// Resources are inserted before start and are never removed, which keeps the references handed out
+// to the systems stable.
+class Resources final {
+  public:
+    Resources() = default;
+    ~Resources() = default;
+
+    Resources(const Resources&) = delete;
+    auto operator=(const Resources&) -> Resources& = delete;
+
+    Resources(Resources&&) = delete;
+    auto operator=(Resources&&) -> Resources& = delete;
+
+    // Replaces the value if the resource already exists.
+    template <typename ResourceType>
+    auto insert(ResourceType&& resource) -> std::remove_cvref_t<ResourceType>&;
+
+    template <typename ResourceType>
+    [[nodiscard]] auto get() const -> ResourceType&;
+
+    template <typename ResourceType>
+    [[nodiscard]] auto contains() const -> bool {
+        return resources.contains(std::type_index(typeid(std::remove_cvref_t<ResourceType>)));
+    }
+
+  private:
+    struct IResource {
+        IResource() = default;
+        virtual ~IResource() = default;
+
+        IResource(const IResource&) = delete;
+        auto operator=(const IResource&) -> IResource& = delete;
+
+        IResource(IResource&&) = delete;
+        auto operator=(IResource&&) -> IResource& = delete;
+    };
+
+    template <typename ResourceType>
+    struct Resource final : public IResource {
+        explicit Resource(ResourceType&& value)
+            : value{std::move(value)} {}
+
+        ResourceType value;
+    };
+
+    std::unordered_map<std::type_index, std::unique_ptr<IResource>> resources;
+};
+
+template <typename ResourceType>
+auto Resources::insert(ResourceType&& resource) -> std::remove_cvref_t<ResourceType>& {
+    using ValueType = std::remove_cvref_t<ResourceType>;
+
+    const auto type = std::type_index(typeid(ValueType));
+    if (const auto it = resources.find(type); it != resources.end()) {
+        auto& value = static_cast<Resource<ValueType>&>(*it->second).value;
+        value = std::forward<ResourceType>(resource);
+        return value;
+    }
+
+    auto new_resource = std::make_unique<Resource<ValueType>>(
+        ValueType{std::forward<ResourceType>(resource)}
+    );
+    auto& value = new_resource->value;
+    resources.emplace(type, std::move(new_resource));
+    return value;
+}
+
+template <typename ResourceType>
+auto Resources::get() const -> ResourceType& {
+    using ValueType = std::remove_cvref_t<ResourceType>;
+
+    const auto it = resources.find(std::type_index(typeid(ValueType)));
+    assert(it != resources.end() && "Resource has not been inserted into the world");
+    return static_cast<Resource<ValueType>&>(*it->second).value;
+}
+} // namespace atlas::hephaestus
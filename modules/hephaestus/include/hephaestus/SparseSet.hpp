@@ -0,0 +1,357 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/Observers.hpp"
+#include "hephaestus/Stats.hpp"
+
+namespace atlas::hephaestus {
+// Entity bookkeeping of a sparse set, independent of the component type so membership tests don't
+// need a virtual call.
+//
+// The sparse side maps an entity to its index in the dense arrays. It's split into fixed size pages
+// which are allocated on first use, so a set only pays for the entity id ranges it has actually
+// seen instead of a slot for every entity id ever handed out.
+class SparseSetBase {
+  public:
+    static constexpr std::size_t PAGE_SIZE = 4096;
+    static constexpr auto INVALID_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+    explicit SparseSetBase(std::pmr::memory_resource* memory_resource)
+        : pages{memory_resource}
+        , entities{memory_resource} {}
+    virtual ~SparseSetBase() = default;
+
+    SparseSetBase(const SparseSetBase&) = delete;
+    auto operator=(const SparseSetBase&) -> SparseSetBase& = delete;
+
+    SparseSetBase(SparseSetBase&&) = delete;
+    auto operator=(SparseSetBase&&) -> SparseSetBase& = delete;
+
+    [[nodiscard]] auto contains(Entity entity) const -> bool {
+        return index_of(entity) != INVALID_INDEX;
+    }
+
+    // Returns INVALID_INDEX if the entity isn't in the set.
+    [[nodiscard]] auto index_of(Entity entity) const -> std::uint32_t {
+        const auto page = entity / PAGE_SIZE;
+        if (page >= pages.size() || pages[page] == nullptr) {
+            return INVALID_INDEX;
+        }
+
+        return (*pages[page])[entity % PAGE_SIZE];
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t {
+        return entities.size();
+    }
+
+    [[nodiscard]] auto get_entities() const -> const std::pmr::vector<Entity>& {
+        return entities;
+    }
+
+    // Bytes of the allocated pages and the dense entity vector.
+    [[nodiscard]] auto get_index_bytes() const -> std::size_t;
+
+    [[nodiscard]] virtual auto get_element_size() const -> std::size_t = 0;
+    [[nodiscard]] virtual auto get_components_capacity() const -> std::size_t = 0;
+
+    // Returns false if the entity wasn't in the set.
+    virtual auto remove(Entity entity) -> bool = 0;
+
+    // Swaps two dense slots, entities and components alike. Used by SparseGroup to keep the
+    // entities of a group packed.
+    virtual auto swap(std::size_t lhs, std::size_t rhs) -> void = 0;
+
+  protected:
+    // Returns the dense index of the new entity.
+    auto add_entity(Entity entity) -> std::size_t;
+
+    // Swaps the last entity into the slot of the removed one, and returns that slot. The derived
+    // set is expected to do the same with its components.
+    auto remove_entity(Entity entity) -> std::size_t;
+
+    auto swap_entities(std::size_t lhs, std::size_t rhs) -> void;
+
+  private:
+    using Page = std::array<std::uint32_t, PAGE_SIZE>;
+
+    auto get_or_create_page(Entity entity) -> Page&;
+
+    std::pmr::vector<std::unique_ptr<Page>> pages;
+    std::pmr::vector<Entity> entities;
+};
+
+template <TypeOfSparseComponent ComponentType>
+class SparseSet final : public SparseSetBase {
+  public:
+    explicit SparseSet(
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource()
+    )
+        : SparseSetBase{memory_resource}
+        , components{memory_resource} {}
+
+    // Assigns the component if the entity already has one.
+    auto emplace(Entity entity, ComponentType&& component) -> void {
+        if (const auto index = index_of(entity); index != INVALID_INDEX) {
+            components[index] = std::move(component);
+            return;
+        }
+
+        add_entity(entity);
+        components.emplace_back(std::move(component));
+    }
+
+    auto remove(Entity entity) -> bool override {
+        if (!contains(entity)) {
+            return false;
+        }
+
+        const auto index = remove_entity(entity);
+        if (index != components.size() - 1) {
+            components[index] = std::move(components.back());
+        }
+        components.pop_back();
+
+        return true;
+    }
+
+    auto swap(const std::size_t lhs, const std::size_t rhs) -> void override {
+        swap_entities(lhs, rhs);
+        std::swap(components[lhs], components[rhs]);
+    }
+
+    [[nodiscard]] auto get_element_size() const -> std::size_t override {
+        return sizeof(ComponentType);
+    }
+
+    [[nodiscard]] auto get_components_capacity() const -> std::size_t override {
+        return components.capacity();
+    }
+
+    [[nodiscard]] auto get(Entity entity) -> ComponentType& {
+        const auto index = index_of(entity);
+        assert(index != INVALID_INDEX && "Entity does not have the sparse component");
+        return components[index];
+    }
+
+    [[nodiscard]] auto get_components() -> std::pmr::vector<ComponentType>& {
+        return components;
+    }
+
+  private:
+    std::pmr::vector<ComponentType> components;
+};
+
+// Owning group over a set of sparse components, similar to the owning groups of EnTT. The entities
+// which have all the owned components are kept packed at the front of every owned set, in the same
+// order. Iterating the group is a single linear pass over the first size() components of each set,
+// no matter how many archetypes the entities are spread over.
+//
+// Keeping the group packed costs a swap per owned set whenever an entity enters or leaves it,
+// which is why groups are opt-in, see World::create_group.
+class SparseGroup final {
+  public:
+    // Packs the entities which are already in all of the sets.
+    SparseGroup(const ArchetypeKey& owned, std::vector<SparseSetBase*> sets);
+    ~SparseGroup() = default;
+
+    SparseGroup(const SparseGroup&) = delete;
+    auto operator=(const SparseGroup&) -> SparseGroup& = delete;
+
+    SparseGroup(SparseGroup&&) = delete;
+    auto operator=(SparseGroup&&) -> SparseGroup& = delete;
+
+    [[nodiscard]] auto get_owned() const -> const ArchetypeKey& {
+        return owned;
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t {
+        return num_entities;
+    }
+
+    [[nodiscard]] auto contains(Entity entity) const -> bool;
+
+    // Moves the entity into the group if it has all the owned components, returns true if it did.
+    // Must be called after an owned component has been added.
+    auto try_add(Entity entity) -> bool;
+
+    // Moves the entity out of the group if it's in it, returns true if it did. Must be called
+    // before an owned component is removed.
+    auto try_remove(Entity entity) -> bool;
+
+  private:
+    auto move_to(Entity entity, std::size_t index) -> void;
+
+    ArchetypeKey owned;
+    std::vector<SparseSetBase*> sets;
+    std::size_t num_entities = 0;
+};
+
+// All sparse sets of a World, indexed by component type id.
+class SparseSets final {
+  public:
+    explicit SparseSets(
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource()
+    )
+        : sets{memory_resource}
+        , groups{memory_resource}
+        , memory_resource{memory_resource} {}
+    ~SparseSets() = default;
+
+    SparseSets(const SparseSets&) = delete;
+    auto operator=(const SparseSets&) -> SparseSets& = delete;
+
+    SparseSets(SparseSets&&) = delete;
+    auto operator=(SparseSets&&) -> SparseSets& = delete;
+
+    template <TypeOfSparseComponent ComponentType>
+    auto get_or_create() -> SparseSet<std::remove_cvref_t<ComponentType>>&;
+
+    // Adding and removing components goes through here rather than through the sets, so the
+    // groups stay packed. Both return the components whose storage has changed, which includes
+    // every component of a group the entity entered or left.
+    template <TypeOfSparseComponent ComponentType>
+    auto emplace(Entity entity, ComponentType&& component) -> ArchetypeKey;
+
+    template <TypeOfSparseComponent ComponentType>
+    auto remove(Entity entity) -> ArchetypeKey;
+
+    // A component can be owned by a single group.
+    template <TypeOfSparseComponent... ComponentTypes>
+    auto create_group() -> SparseGroup&;
+
+    // Returns nullptr if there is no group owning exactly the components of the key.
+    [[nodiscard]] auto find_group(const ArchetypeKey& owned) const -> const SparseGroup*;
+
+    // The set must exist, use find when it might not.
+    template <TypeOfSparseComponent ComponentType>
+    [[nodiscard]] auto get() const -> SparseSet<std::remove_cvref_t<ComponentType>>&;
+
+    // Returns nullptr if no component of the type has been added yet.
+    [[nodiscard]] auto find(ComponentTypeId component_id) const -> SparseSetBase*;
+
+    // True if the entity is in every set of the include key and none of the sets in the exclude
+    // key. The keys only hold sparse component ids.
+    [[nodiscard]] auto matches(
+        Entity entity,
+        const ArchetypeKey& include,
+        const ArchetypeKey& exclude
+    ) const -> bool;
+
+    // One entry per existing set, in ascending component id order.
+    [[nodiscard]] auto collect_stats() const -> std::vector<SparseSetStats>;
+
+    // Removes the entity from all sets, returns the sparse components it had so their versions can
+    // be bumped.
+    auto remove_entity(Entity entity) -> ArchetypeKey;
+
+    // Every component added, assigned or removed from now on is pushed to the observers of its
+    // event, nullptr stops it.
+    auto set_observers(Observers* observers) -> void {
+        this->observers = observers;
+    }
+
+  private:
+    auto notify(ObserverEvent event, ComponentTypeId component_id, Entity entity) const -> void {
+        if (observers != nullptr && observers->is_observed(event, component_id)) {
+            observers->push(event, component_id, entity);
+        }
+    }
+
+    [[nodiscard]] auto find_owning_group(ComponentTypeId component_id) const -> SparseGroup*;
+
+    std::pmr::vector<std::unique_ptr<SparseSetBase>> sets;
+    ArchetypeKey existing_sets;
+    std::pmr::vector<std::unique_ptr<SparseGroup>> groups;
+    ArchetypeKey grouped;
+    std::pmr::memory_resource* memory_resource;
+    Observers* observers = nullptr;
+};
+
+template <TypeOfSparseComponent ComponentType>
+auto SparseSets::get_or_create() -> SparseSet<std::remove_cvref_t<ComponentType>>& {
+    using SetType = SparseSet<std::remove_cvref_t<ComponentType>>;
+
+    const auto type_id = get_component_type_id<ComponentType>();
+    if (type_id >= sets.size()) {
+        sets.resize(type_id + 1);
+    }
+
+    if (sets[type_id] == nullptr) {
+        sets[type_id] = std::make_unique<SetType>(memory_resource);
+        existing_sets.add_component(type_id);
+    }
+
+    return static_cast<SetType&>(*sets[type_id]);
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto SparseSets::emplace(const Entity entity, ComponentType&& component) -> ArchetypeKey {
+    const auto type_id = get_component_type_id<ComponentType>();
+    auto& set = get_or_create<ComponentType>();
+    const auto is_new = !set.contains(entity);
+    set.emplace(entity, std::forward<ComponentType>(component));
+    notify(is_new ? ObserverEvent::Add : ObserverEvent::Change, type_id, entity);
+
+    ArchetypeKey changed;
+    changed.add_component(type_id);
+    if (auto* group = find_owning_group(type_id);
+        is_new && group != nullptr && group->try_add(entity)) {
+        changed.add_components(group->get_owned());
+    }
+
+    return changed;
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto SparseSets::remove(const Entity entity) -> ArchetypeKey {
+    const auto type_id = get_component_type_id<ComponentType>();
+    auto* set = find(type_id);
+    if (set == nullptr || !set->contains(entity)) {
+        return {};
+    }
+
+    ArchetypeKey changed;
+    changed.add_component(type_id);
+    if (auto* group = find_owning_group(type_id); group != nullptr && group->try_remove(entity)) {
+        changed.add_components(group->get_owned());
+    }
+    set->remove(entity);
+    notify(ObserverEvent::Remove, type_id, entity);
+
+    return changed;
+}
+
+template <TypeOfSparseComponent... ComponentTypes>
+auto SparseSets::create_group() -> SparseGroup& {
+    static_assert(sizeof...(ComponentTypes) > 1, "A group must own at least two components.");
+
+    ArchetypeKey owned;
+    (owned.add_component(get_component_type_id<ComponentTypes>()), ...);
+    assert(!owned.intersects_with(grouped) && "A component can only be owned by a single group.");
+    grouped.add_components(owned);
+
+    std::vector<SparseSetBase*> owned_sets{&get_or_create<ComponentTypes>()...};
+    return *groups.emplace_back(std::make_unique<SparseGroup>(owned, std::move(owned_sets)));
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto SparseSets::get() const -> SparseSet<std::remove_cvref_t<ComponentType>>& {
+    auto* set = find(get_component_type_id<ComponentType>());
+    assert(set != nullptr && "Sparse set has not been created");
+    return static_cast<SparseSet<std::remove_cvref_t<ComponentType>>&>(*set);
+}
+} // namespace atlas::hephaestus
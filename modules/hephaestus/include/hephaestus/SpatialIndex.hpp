@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+#include "hephaestus/Common.hpp"
+#include "hephaestus/Concepts.hpp"
+
+namespace atlas::hephaestus {
+// Spatial hash over the x and y of the entities, for proximity queries without scanning every
+// entity. The plane is split into square cells of cell_size, and only the non-empty cells are
+// stored. Pick a cell size in the order of the typical query radius, a query visits every cell its
+// bounding box overlaps.
+//
+// The query functions only read and are safe to call concurrently with each other. The index is
+// maintained by the World, see World::create_spatial_index.
+class SpatialHash {
+  public:
+    SpatialHash(
+        float cell_size,
+        std::pmr::memory_resource* memory_resource = std::pmr::get_default_resource()
+    );
+    ~SpatialHash() = default;
+
+    SpatialHash(const SpatialHash&) = delete;
+    auto operator=(const SpatialHash&) -> SpatialHash& = delete;
+
+    // Movable so it can be stored as a world resource.
+    SpatialHash(SpatialHash&&) noexcept = default;
+    auto operator=(SpatialHash&&) noexcept -> SpatialHash& = default;
+
+    // Calls func(entity) for every entity within radius of (x, y), in no particular order.
+    template <typename Func>
+    auto query_radius(float x, float y, float radius, Func&& func) const -> void;
+
+    // Calls func(entity) for every entity inside the box, bounds included, in no particular order.
+    template <typename Func>
+    auto query_aabb(float min_x, float min_y, float max_x, float max_y, Func&& func) const -> void;
+
+    [[nodiscard]] auto size() const -> std::size_t {
+        return locations.size();
+    }
+
+    [[nodiscard]] auto get_cell_size() const -> float {
+        return cell_size;
+    }
+
+    // An update pass re-submits every entity the index should contain. Entities which stay in the
+    // same cell are updated in place, only entities crossing a cell boundary are moved, and
+    // entities which weren't submitted since begin_update are removed by end_update.
+    auto begin_update() -> void;
+    auto update(Entity entity, float x, float y) -> void;
+    auto end_update() -> void;
+
+  private:
+    using CellKey = std::uint64_t;
+
+    struct Item {
+        Entity entity;
+        float x;
+        float y;
+    };
+
+    struct Location {
+        CellKey cell;
+        std::uint32_t index;
+        std::uint32_t stamp;
+    };
+
+    // Clamped to the range of int32 before the cast, which is undefined out of it, so huge and
+    // infinite coordinates land in the outermost cells. NaN lands in cell 0.
+    [[nodiscard]] auto to_cell(const float value) const -> std::int32_t {
+        const auto cell = std::floor(static_cast<double>(value) * inverse_cell_size);
+        if (std::isnan(cell)) {
+            return 0;
+        }
+        return static_cast<std::int32_t>(std::clamp(
+            cell,
+            static_cast<double>(std::numeric_limits<std::int32_t>::min()),
+            static_cast<double>(std::numeric_limits<std::int32_t>::max())
+        ));
+    }
+
+    [[nodiscard]] static auto make_key(const std::int32_t cell_x, const std::int32_t cell_y)
+        -> CellKey {
+        return (static_cast<CellKey>(static_cast<std::uint32_t>(cell_x)) << 32U)
+               | static_cast<std::uint32_t>(cell_y);
+    }
+
+    // Calls visitor(item) for every item in the cells overlapped by the box.
+    template <typename Visitor>
+    auto visit_cells(float min_x, float min_y, float max_x, float max_y, Visitor&& visitor) const
+        -> void;
+
+    auto insert(Entity entity, float x, float y) -> void;
+    auto remove_from_cell(CellKey cell, std::uint32_t index) -> void;
+
+    float cell_size;
+    float inverse_cell_size;
+    std::pmr::unordered_map<CellKey, std::pmr::vector<Item>> cells;
+    std::pmr::unordered_map<Entity, Location> locations;
+    std::uint32_t stamp = 0;
+};
+
+// The index of a single component type, stored as a resource of the world so systems can read it
+// through Res<const SpatialIndex<ComponentType>>.
+template <TypeOfSpatialComponent ComponentType>
+class SpatialIndex final : public SpatialHash {
+  public:
+    using SpatialHash::SpatialHash;
+};
+
+template <typename Func>
+auto SpatialHash::query_radius(
+    const float x,
+    const float y,
+    const float radius,
+    Func&& func
+) const -> void {
+    const auto radius_squared = radius * radius;
+    visit_cells(x - radius, y - radius, x + radius, y + radius, [&](const Item& item) {
+        const auto dx = item.x - x;
+        const auto dy = item.y - y;
+        if ((dx * dx) + (dy * dy) <= radius_squared) {
+            func(item.entity);
+        }
+    });
+}
+
+template <typename Func>
+auto SpatialHash::query_aabb(
+    const float min_x,
+    const float min_y,
+    const float max_x,
+    const float max_y,
+    Func&& func
+) const -> void {
+    visit_cells(min_x, min_y, max_x, max_y, [&](const Item& item) {
+        if (item.x >= min_x && item.x <= max_x && item.y >= min_y && item.y <= max_y) {
+            func(item.entity);
+        }
+    });
+}
+
+template <typename Visitor>
+auto SpatialHash::visit_cells(
+    const float min_x,
+    const float min_y,
+    const float max_x,
+    const float max_y,
+    Visitor&& visitor
+) const -> void {
+    // In 64 bits, the span of the whole int32 range doesn't fit in 32.
+    const std::int64_t first_x = to_cell(min_x);
+    const std::int64_t last_x = to_cell(max_x);
+    const std::int64_t first_y = to_cell(min_y);
+    const std::int64_t last_y = to_cell(max_y);
+    if (last_x < first_x || last_y < first_y) {
+        return;
+    }
+
+    // Boxes spanning more cells than there are occupied ones walk the occupied cells instead.
+    const auto span_x = static_cast<std::uint64_t>(last_x - first_x) + 1;
+    const auto span_y = static_cast<std::uint64_t>(last_y - first_y) + 1;
+    if (span_x > cells.size() || span_x * span_y > cells.size()) {
+        for (const auto& [key, items] : cells) {
+            std::ranges::for_each(items, visitor);
+        }
+        return;
+    }
+
+    for (auto cell_x = first_x; cell_x <= last_x; ++cell_x) {
+        for (auto cell_y = first_y; cell_y <= last_y; ++cell_y) {
+            const auto key =
+                make_key(static_cast<std::int32_t>(cell_x), static_cast<std::int32_t>(cell_y));
+            if (const auto it = cells.find(key); it != cells.end()) {
+                std::ranges::for_each(it->second, visitor);
+            }
+        }
+    }
+}
+} // namespace atlas::hephaestus
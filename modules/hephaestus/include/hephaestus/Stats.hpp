@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "hephaestus/Common.hpp"
+#include "hephaestus/Memory.hpp"
+
+namespace atlas::hephaestus {
+struct WorldStats {
+    std::uint64_t tot_num_created_ents = 0;
+    std::uint64_t tot_num_destroyed_ents = 0;
+    std::uint64_t num_ticks = 0;
+    // Number of times an archetype has been shrunk by the compaction pass.
+    std::uint64_t tot_num_compactions = 0;
+
+    // Wall time in seconds for the whole frame of the world, creation queue, systems and destroy
+    // queue included.
+    double last_tick_time = 0.0;
+    double tot_tick_time = 0.0;
+};
+
+// The snapshot types below are collected by World::collect_introspection. Collecting only walks the
+// archetypes, columns, sparse sets and systems, never the entities, so it's cheap enough to sample
+// periodically in a shipping build.
+//
+// Bytes are split into used (size * element size) and reserved (capacity * element size), the
+// difference is the slack left behind by growth or by entities which have been destroyed. The
+// index bytes of the hash maps are estimates, the standard library doesn't expose their node and
+// bucket overhead.
+
+struct ColumnStats {
+    ComponentTypeId component_id = 0;
+    std::size_t element_size = 0;
+    std::size_t bytes_used = 0;
+    std::size_t bytes_reserved = 0;
+};
+
+struct ArchetypeStats {
+    ArchetypeId id = 0;
+    // Every component of the key, tags included, in ascending id order.
+    std::vector<ComponentTypeId> component_ids;
+    // Retired archetypes are empty and skipped by query matching, see ArchetypeMap.
+    bool is_retired = false;
+    std::size_t num_entities = 0;
+    std::size_t capacity = 0;
+    // Sums over the columns.
+    std::size_t column_bytes_used = 0;
+    std::size_t column_bytes_reserved = 0;
+    // The entity to row map and the row to entity vector.
+    std::size_t index_bytes = 0;
+    std::vector<ColumnStats> columns;
+
+    // Share of the rows in use, 1 when the capacity is fully used or the archetype has no rows.
+    [[nodiscard]] auto get_occupancy() const -> double {
+        return capacity == 0 ? 1.0
+                             : static_cast<double>(num_entities) / static_cast<double>(capacity);
+    }
+};
+
+struct SparseSetStats {
+    ComponentTypeId component_id = 0;
+    std::size_t element_size = 0;
+    std::size_t num_entities = 0;
+    std::size_t bytes_used = 0;
+    std::size_t bytes_reserved = 0;
+    // The sparse pages and the dense entity vector.
+    std::size_t index_bytes = 0;
+};
+
+// Totals of a component type over all archetypes and its sparse set.
+struct ComponentStats {
+    ComponentTypeId component_id = 0;
+    std::size_t num_entities = 0;
+    std::size_t bytes_used = 0;
+    std::size_t bytes_reserved = 0;
+};
+
+struct QueryStats {
+    // Index of the system in creation order.
+    std::size_t system_index = 0;
+    std::size_t num_matched_archetypes = 0;
+    // Entities in the cache at the last rebuild.
+    std::size_t num_cached = 0;
+    std::size_t cache_bytes_reserved = 0;
+    std::uint64_t num_rebuilds = 0;
+    std::uint64_t num_rematches = 0;
+    // Served by a SparseGroup rather than by matching archetypes.
+    bool uses_group = false;
+};
+
+struct WorldIntrospection {
+    WorldId world_id = 0;
+    WorldStats stats;
+    MemoryStats memory;
+    std::vector<ArchetypeStats> archetypes;
+    std::vector<SparseSetStats> sparse_sets;
+    // Bytes of the table of the archetype every entity lives in.
+    std::size_t location_bytes = 0;
+    std::vector<ComponentStats> components;
+    std::vector<QueryStats> queries;
+};
+
+// Writes the worlds as a JSON array, one object per world. Component types are written with both
+// their id and the (implementation defined) name of their type.
+auto write_introspection_json(std::ostream& stream, std::span<const WorldIntrospection> worlds)
+    -> void;
+
+// Returns false if the file couldn't be written.
+auto dump_introspection_json(
+    const std::filesystem::path& path,
+    std::span<const WorldIntrospection> worlds
+) -> bool;
+} // namespace atlas::hephaestus
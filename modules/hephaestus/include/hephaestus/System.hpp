@@ -1,8 +1,12 @@
 #pragma once
 
+#include "hephaestus/AllocationTracker.hpp"
 #include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/ComponentVersions.hpp"
 #include "hephaestus/Concepts.hpp"
+#include "hephaestus/SparseSet.hpp"
 #include "hephaestus/SystemBase.hpp"
+#include "hephaestus/SystemParams.hpp"
 #include "hephaestus/Utils.hpp"
 #include "hephaestus/query/Query.hpp"
 #include <algorithm>
@@ -18,18 +22,33 @@ class IEngine;
 }
 
 namespace atlas::hephaestus {
-template <AllTypeOfComponent... ComponentTypes>
+// Params is a SystemParams<...> with the params declared after the component tuple, see
+// hephaestus/SystemParams.hpp.
+template <typename Params, AllTypeOfComponent... ComponentTypes>
 class System final : public SystemBase {
   public:
-    using SystemFunc = std::function<void(const core::IEngine&, std::tuple<ComponentTypes&...>)>;
+    using SystemFunc = typename Params::template Func<ComponentTypes...>;
 
     explicit System(
         SystemFunc func,
         const ArchetypeMap& archetypes,
-        std::vector<SystemDependencies> dependencies
+        const SparseSets& sparse_sets,
+        const ComponentVersions& versions,
+        SystemContext context,
+        std::vector<SystemDependencies> dependencies,
+        const QueryFilter& filter = {}
     )
-        : func{std::move(func)}
-        , query{archetypes, std::move(dependencies)} {}
+        : query{
+              archetypes,
+              sparse_sets,
+              versions,
+              context.memory_resource,
+              std::move(dependencies),
+              filter
+          }
+        , func{std::move(func)}
+        , context{context}
+        , runs_once{sizeof...(ComponentTypes) == 0 && filter.empty()} {}
 
     System(const System&) = delete;
     auto operator=(const System&) -> System& = delete;
@@ -42,9 +61,24 @@ class System final : public SystemBase {
     auto set_concurrent_systems(std::size_t estimate) -> void override;
     auto execute(const core::IEngine& engine, tf::Subflow& subflow) -> void override;
 
+    [[nodiscard]] auto collect_query_stats() const -> QueryStats override {
+        return query.collect_stats();
+    }
+
   private:
+    auto invoke(
+        const core::IEngine& engine,
+        const std::tuple<ComponentTypes&...>& components,
+        const typename Params::Tuple& params
+    ) const -> void;
+
     Query<ComponentTypes...> query;
     SystemFunc func;
+    SystemContext context;
+
+    // A system without components and filters, e.g. one only working on resources, runs once per
+    // execution instead of once per entity.
+    bool runs_once;
 
     // How many systems which are being executed
     // concurrently. This is estimated from the dependency
@@ -53,13 +87,39 @@ class System final : public SystemBase {
     std::size_t concurrent_systems_estimate = 1;
 };
 
-template <AllTypeOfComponent... ComponentTypes>
-auto System<ComponentTypes...>::set_concurrent_systems(std::size_t estimate) -> void {
+template <typename Params, AllTypeOfComponent... ComponentTypes>
+auto System<Params, ComponentTypes...>::set_concurrent_systems(std::size_t estimate) -> void {
     concurrent_systems_estimate = estimate;
 }
 
-template <AllTypeOfComponent... ComponentTypes>
-auto System<ComponentTypes...>::execute(const core::IEngine& engine, tf::Subflow& subflow) -> void {
+template <typename Params, AllTypeOfComponent... ComponentTypes>
+auto System<Params, ComponentTypes...>::invoke(
+    const core::IEngine& engine,
+    const std::tuple<ComponentTypes&...>& components,
+    const typename Params::Tuple& params
+) const -> void {
+    if constexpr (Params::IS_EMPTY) {
+        func(engine, components);
+    } else {
+        std::apply([&](const auto&... unpacked) { func(engine, components, unpacked...); }, params);
+    }
+}
+
+template <typename Params, AllTypeOfComponent... ComponentTypes>
+auto System<Params, ComponentTypes...>::execute(
+    const core::IEngine& engine,
+    tf::Subflow& subflow
+) -> void {
+    // Params are fetched once and shared by every entity the system runs on.
+    const auto params = Params::fetch(context);
+
+    if constexpr (sizeof...(ComponentTypes) == 0) {
+        if (runs_once) {
+            invoke(engine, std::tuple<>{}, params);
+            return;
+        }
+    }
+
     const auto& entity_components = query.get();
     const auto entity_count = entity_components.size();
 
@@ -67,10 +127,23 @@ auto System<ComponentTypes...>::execute(const core::IEngine& engine, tf::Subflow
         return;
     }
 
+    // Only set when some of the entities are disabled, one bit per entity, see Query::get_enabled.
+    const auto enabled = query.get_enabled();
+    // Sets the scope as well, the chunks may run on workers outside of any.
+    const auto invoke_at = [this, &engine, &entity_components, &params](std::size_t i) {
+        const AllocationScopeGuard scope{AllocationScope::SystemExecute};
+        invoke(engine, entity_components[i], params);
+    };
+
+    // Exclusive params, such as a Res<T> with write access, can't be shared between workers.
     constexpr std::size_t MIN_PARALLEL_THRESHOLD = 128;
-    if (entity_count < MIN_PARALLEL_THRESHOLD) {
-        for (const auto& data : entity_components) {
-            func(engine, data);
+    if (Params::IS_EXCLUSIVE || entity_count < MIN_PARALLEL_THRESHOLD) {
+        if (enabled.empty()) {
+            for (const auto& data : entity_components) {
+                invoke(engine, data, params);
+            }
+        } else {
+            for_each_enabled(enabled, 0, enabled.size(), invoke_at);
         }
         return;
     }
@@ -85,13 +158,31 @@ auto System<ComponentTypes...>::execute(const core::IEngine& engine, tf::Subflow
     auto chunk_size = std::max<std::size_t>(1, entity_count / effective_workers);
     chunk_size = std::max<std::size_t>(chunk_size, MIN_PARALLEL_WORKERS);
 
-    subflow.for_each_index(
-        std::size_t{0},
-        entity_count,
-        chunk_size,
-        [this, &engine, &entity_components](std::size_t i) {
-            func(engine, entity_components[i]);
-        }
-    );
+    // The chunk size goes to the partitioner, the third argument of for_each_index is the step.
+    const AllocationScopeGuard scheduling{AllocationScope::TaskScheduling};
+    if (enabled.empty()) {
+        subflow.for_each_index(
+            std::size_t{0},
+            entity_count,
+            std::size_t{1},
+            invoke_at,
+            tf::StaticPartitioner(chunk_size)
+        );
+    } else {
+        // Partitioned by mask word instead, every word covers 64 entities.
+        constexpr auto WORD_BITS = Archetype::MASK_WORD_BITS;
+        subflow.for_each_index(
+            std::size_t{0},
+            enabled.size(),
+            std::size_t{1},
+            [enabled, &invoke_at](std::size_t word) {
+                for_each_enabled(enabled, word, word + 1, invoke_at);
+            },
+            tf::StaticPartitioner(std::max<std::size_t>(1, chunk_size / WORD_BITS))
+        );
+    }
+    // The params and the cached components live on this stack frame, the subflow is joined before
+    // returning.
+    subflow.join();
 }
 } // namespace atlas::hephaestus
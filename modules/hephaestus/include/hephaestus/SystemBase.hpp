@@ -2,6 +2,8 @@
 
 #include <taskflow/taskflow.hpp>
 
+#include "hephaestus/Stats.hpp"
+
 namespace atlas::core {
 class IEngine;
 } // namespace atlas::core
@@ -19,6 +21,7 @@ class SystemBase {
 
     virtual auto set_concurrent_systems(std::size_t estimate) -> void = 0;
     virtual auto execute(const core::IEngine& engine, tf::Subflow& subflow) -> void = 0;
+    [[nodiscard]] virtual auto collect_query_stats() const -> QueryStats = 0;
 
   protected:
     SystemBase() = default;
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory_resource>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <vector>
+
+#include "hephaestus/Events.hpp"
+#include "hephaestus/Resources.hpp"
+#include "hephaestus/Utils.hpp"
+
+namespace atlas::core {
+class IEngine;
+}
+
+namespace atlas::hephaestus {
+// The world owned state a system, and its params, can be fetched from.
+struct SystemContext {
+    Resources& resources;
+    EventChannels& events;
+    std::pmr::memory_resource* memory_resource;
+};
+
+// Access to a resource of the world, declared after the component tuple of a system:
+//
+//   world.create_system([](const core::IEngine& engine,
+//                          std::tuple<Position&> components,
+//                          Res<const PhysicsConfig> config) { ... });
+//
+// Res<const T> is a read, Res<T> a write. Both are part of the system dependencies, so systems
+// writing to a resource never run concurrently with other systems accessing it.
+template <typename ResourceType>
+class Res final {
+  public:
+    explicit Res(ResourceType& resource)
+        : resource{&resource} {}
+
+    [[nodiscard]] auto get() const -> ResourceType& {
+        return *resource;
+    }
+
+    [[nodiscard]] auto operator*() const -> ResourceType& {
+        return *resource;
+    }
+
+    [[nodiscard]] auto operator->() const -> ResourceType* {
+        return resource;
+    }
+
+  private:
+    ResourceType* resource;
+};
+
+// Sends events to the systems reading them, declared after the component tuple like Res<T>:
+//
+//   world.create_system([](const core::IEngine& engine,
+//                          std::tuple<const Health&> components,
+//                          EventWriter<DamageEvent> damage) { damage.send(DamageEvent{...}); });
+//
+// The event type must have been added with World::add_event. Sending is lock free, so writers run
+// concurrently with each other and over many workers, but every writer of an event runs before
+// every reader of it, whatever the order the systems were created in.
+template <typename EventType>
+class EventWriter final {
+  public:
+    explicit EventWriter(EventChannel<EventType>& channel)
+        : channel{&channel} {}
+
+    template <typename... Args>
+    auto send(Args&&... args) const -> void {
+        channel->send(std::forward<Args>(args)...);
+    }
+
+  private:
+    EventChannel<EventType>* channel;
+};
+
+// The events sent since the systems of the last frame, the ones sent by the writers of this frame
+// included, see EventChannel. Readers run concurrently with each other.
+template <typename EventType>
+class EventReader final {
+  public:
+    explicit EventReader(const EventBuffer<EventType>& events)
+        : events{&events} {}
+
+    [[nodiscard]] auto begin() const {
+        return events->begin();
+    }
+
+    [[nodiscard]] auto end() const {
+        return events->end();
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t {
+        return events->size();
+    }
+
+    [[nodiscard]] auto empty() const -> bool {
+        return events->empty();
+    }
+
+  private:
+    const EventBuffer<EventType>* events;
+};
+
+// Every type which can be declared as a trailing system param specializes SystemParamTraits with:
+// - make_dependency: the access of the param, merged with the component accesses of the system.
+// - fetch: creates the param from the world once per execution of the system.
+// - IS_EXCLUSIVE: true if the param can't be shared between the workers of the same system.
+template <typename T>
+struct SystemParamTraits {
+    static_assert(
+        !std::is_same_v<T, T>,
+        "Unsupported system param, only Res<T>, Res<const T>, EventWriter<E> and EventReader<E> "
+        "can follow the component tuple."
+    );
+};
+
+template <typename ResourceType>
+struct SystemParamTraits<Res<ResourceType>> {
+    static constexpr bool IS_EXCLUSIVE = !std::is_const_v<ResourceType>;
+
+    static auto make_dependency() -> SystemDependencies {
+        // Keyed on Res<T> rather than T, a resource never conflicts with a component of the same
+        // type.
+        return SystemDependencies{
+            .type = std::type_index(typeid(Res<std::remove_const_t<ResourceType>>)),
+            .is_read_only = std::is_const_v<ResourceType>
+        };
+    }
+
+    static auto fetch(const SystemContext& context) -> Res<ResourceType> {
+        return Res<ResourceType>{context.resources.get<std::remove_const_t<ResourceType>>()};
+    }
+};
+
+template <typename EventType>
+struct SystemParamTraits<EventWriter<EventType>> {
+    static constexpr bool IS_EXCLUSIVE = false;
+
+    static auto make_dependency() -> SystemDependencies {
+        return SystemDependencies{
+            .type = std::type_index(typeid(EventChannel<EventType>)),
+            .is_read_only = false,
+            .is_append = true
+        };
+    }
+
+    static auto fetch(const SystemContext& context) -> EventWriter<EventType> {
+        return EventWriter<EventType>{context.events.get<EventType>()};
+    }
+};
+
+template <typename EventType>
+struct SystemParamTraits<EventReader<EventType>> {
+    static constexpr bool IS_EXCLUSIVE = false;
+
+    static auto make_dependency() -> SystemDependencies {
+        return SystemDependencies{
+            .type = std::type_index(typeid(EventChannel<EventType>)),
+            .is_read_only = true
+        };
+    }
+
+    static auto fetch(const SystemContext& context) -> EventReader<EventType> {
+        return EventReader<EventType>{context.events.get<EventType>().get_current()};
+    }
+};
+
+template <typename... Params>
+struct SystemParams {
+    static_assert(
+        (!std::is_reference_v<Params> && ...),
+        "System params such as Res<T> must be taken by value."
+    );
+
+    template <typename... ComponentTypes>
+    using Func = std::function<
+        void(const core::IEngine&, std::tuple<ComponentTypes&...>, std::decay_t<Params>...)>;
+
+    // Hierarchy systems also get the components of the parent, nullptr for roots.
+    template <typename... ComponentTypes>
+    using HierarchyFunc = std::function<void(
+        const core::IEngine&,
+        std::tuple<ComponentTypes&...>,
+        const std::tuple<ComponentTypes&...>*,
+        std::decay_t<Params>...
+    )>;
+
+    using Tuple = std::tuple<std::decay_t<Params>...>;
+
+    static constexpr bool IS_EMPTY = sizeof...(Params) == 0;
+    static constexpr bool IS_EXCLUSIVE = (SystemParamTraits<std::decay_t<Params>>::IS_EXCLUSIVE
+                                          || ...);
+
+    static auto fetch(const SystemContext& context) -> Tuple {
+        return Tuple{SystemParamTraits<std::decay_t<Params>>::fetch(context)...};
+    }
+
+    // Appends the accesses of the params and keeps the dependencies sorted, which
+    // are_dependencies_overlapping relies on.
+    static auto add_dependencies(std::vector<SystemDependencies>& dependencies) -> void {
+        (dependencies.emplace_back(SystemParamTraits<std::decay_t<Params>>::make_dependency()),
+         ...);
+        std::ranges::sort(
+            dependencies,
+            [](const SystemDependencies& lhs, const SystemDependencies& rhs) {
+                return lhs.type < rhs.type;
+            }
+        );
+    }
+};
+} // namespace atlas::hephaestus
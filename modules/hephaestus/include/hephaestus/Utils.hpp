@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
 #include "hephaestus/Concepts.hpp"
 
 namespace atlas::hephaestus {
@@ -12,17 +13,24 @@ namespace atlas::hephaestus {
 struct SystemDependencies {
     std::type_index type;
     bool is_read_only;
+    // Appends, such as the sends of an EventWriter, conflict with reads and writes but not with
+    // each other. They aren't read only.
+    bool is_append = false;
 
     auto operator==(const SystemDependencies& other) const -> bool {
-        return type == other.type && is_read_only == other.is_read_only;
+        return type == other.type && is_read_only == other.is_read_only
+               && is_append == other.is_append;
     }
 
     auto operator<=>(const SystemDependencies& other) const -> std::strong_ordering {
         if (type != other.type) {
             return type < other.type ? std::strong_ordering::less : std::strong_ordering::greater;
         }
+        if (is_read_only != other.is_read_only) {
+            return static_cast<int>(is_read_only) <=> static_cast<int>(other.is_read_only);
+        }
 
-        return static_cast<int>(is_read_only) <=> static_cast<int>(other.is_read_only);
+        return static_cast<int>(is_append) <=> static_cast<int>(other.is_append);
     }
 };
 
@@ -42,7 +50,9 @@ template <AllTypeOfComponent... ComponentTypes>
 auto make_system_dependencies() -> std::vector<SystemDependencies> {
     auto accesses = std::vector<SystemDependencies>{SystemDependencies{
         .type = std::type_index(typeid(std::remove_cvref_t<ComponentTypes>)),
+        // Tags have no data to write to, they never conflict with other systems.
         .is_read_only = std::is_const_v<std::remove_reference_t<ComponentTypes>>
+                        || TypeOfTagComponent<ComponentTypes>
     }...};
 
     std::ranges::sort(accesses, [](const SystemDependencies& lhs, const SystemDependencies& rhs) {
@@ -57,10 +67,37 @@ auto are_dependencies_overlapping(
     const std::vector<SystemDependencies>& rhs
 ) -> bool;
 
+// True if lhs appends to a type which rhs reads, such as an EventWriter and an EventReader of the
+// same event, in which case lhs must run first. Both must be sorted like for
+// are_dependencies_overlapping.
+auto is_appending_to_reads(
+    const std::vector<SystemDependencies>& lhs,
+    const std::vector<SystemDependencies>& rhs
+) -> bool;
+
+// Sparse components live outside of the archetypes and are left out of the archetype key, use
+// make_sparse_key for them.
 template <AllTypeOfComponent... ComponentTypes>
 auto make_archetype_key() -> ArchetypeKey {
     ArchetypeKey signature;
-    ((signature.add_component(get_component_type_id<ComponentTypes>())), ...);
+    const auto add = [&signature]<typename ComponentType>() {
+        if constexpr (!TypeOfSparseComponent<ComponentType>) {
+            signature.add_component(get_component_type_id<ComponentType>());
+        }
+    };
+    (add.template operator()<ComponentTypes>(), ...);
+    return signature;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto make_sparse_key() -> ArchetypeKey {
+    ArchetypeKey signature;
+    const auto add = [&signature]<typename ComponentType>() {
+        if constexpr (TypeOfSparseComponent<ComponentType>) {
+            signature.add_component(get_component_type_id<ComponentType>());
+        }
+    };
+    (add.template operator()<ComponentTypes>(), ...);
     return signature;
 }
 } // namespace atlas::hephaestus
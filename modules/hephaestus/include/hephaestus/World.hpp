@@ -0,0 +1,1016 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+#include "core/IEngine.hpp"
+#include "core/time/Timer.hpp"
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/Checkpoints.hpp"
+#include "hephaestus/CommandLog.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentCodec.hpp"
+#include "hephaestus/ComponentVersions.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/Events.hpp"
+#include "hephaestus/Hierarchy.hpp"
+#include "hephaestus/HierarchySystem.hpp"
+#include "hephaestus/Memory.hpp"
+#include "hephaestus/Observers.hpp"
+#include "hephaestus/Prefab.hpp"
+#include "hephaestus/Resources.hpp"
+#include "hephaestus/SparseSet.hpp"
+#include "hephaestus/SpatialIndex.hpp"
+#include "hephaestus/Stats.hpp"
+#include "hephaestus/System.hpp"
+#include "hephaestus/SystemBase.hpp"
+#include "hephaestus/SystemParams.hpp"
+#include "hephaestus/Utils.hpp"
+#include "hephaestus/WorldSnapshot.hpp"
+#include "hephaestus/WorldStreamer.hpp"
+#include "hephaestus/query/QueryFilters.hpp"
+
+namespace atlas::hephaestus {
+namespace detail {
+// A tuple holding the component if the condition holds, an empty one otherwise. Used to split the
+// components of an entity by where they are stored.
+template <bool Condition, typename ComponentType>
+auto take_if(ComponentType&& component) {
+    if constexpr (Condition) {
+        return std::tuple<std::remove_cvref_t<ComponentType>>{
+            std::forward<ComponentType>(component)
+        };
+    } else {
+        return std::tuple<>{};
+    }
+}
+
+// A tuple holding the column of the component if it's stored in the archetype, an empty one
+// otherwise.
+template <typename ComponentType>
+auto column_if_stored(Archetype& archetype) {
+    if constexpr (TypeOfColumnComponent<ComponentType>) {
+        return std::tuple{archetype.get_column<ComponentType>()};
+    } else {
+        return std::tuple<>{};
+    }
+}
+
+// The default of World::instantiate, the instances are left as copies of the prefab.
+struct NoOverride {};
+} // namespace detail
+
+struct SystemNode {
+    std::vector<SystemDependencies> dependencies;
+};
+
+// Compaction runs at the end of every frame, after the destroy queue. It visits the archetypes
+// round robin, picking up where the previous frame stopped, until the time budget is spent:
+// - Empty archetypes are retired from query matching, see ArchetypeMap.
+// - Archetypes whose capacity is more than shrink_factor times their number of entities are
+//   shrunk, never below the entity buffer size they were created with.
+struct CompactionSettings {
+    // Wall time in seconds per frame, 0 disables compaction.
+    double time_budget = 0.0002;
+    // Hysteresis, keeps archetypes which fluctuate in size from reallocating every other frame.
+    std::size_t shrink_factor = 4;
+    // Archetypes at or below this capacity are never shrunk.
+    std::size_t min_capacity = 256;
+};
+
+// A World is a fully isolated simulation. It owns its archetypes, entity id allocator, systems
+// (and with them, their queries) and the structural versions of its components. Nothing is shared
+// between worlds except the component type ids, which makes it possible to host many worlds in the
+// same process and tick them concurrently, see Hephaestus.
+//
+// The world does not own an executor. Instead it exposes a frame graph (creation queue -> systems
+// -> destroy queue) which the owner composes into its own taskflow.
+class World final {
+  public:
+    World(core::IEngine& engine, WorldId id, const AllocatorPolicy& allocator_policy = {});
+    ~World() = default;
+
+    World(const World&) = delete;
+    auto operator=(const World&) -> World& = delete;
+
+    World(World&&) = delete;
+    auto operator=(World&&) -> World& = delete;
+
+    // Filters is an optional list of With<...> and Without<...>, see
+    // hephaestus/query/QueryFilters.hpp.
+    //
+    // The system function takes the engine and a tuple of components, optionally followed by
+    // system params such as Res<T>, see hephaestus/SystemParams.hpp. A system with an empty tuple
+    // and no filters runs once per frame instead of once per entity.
+    template <typename... Filters, typename Func>
+    auto create_system(Func&& func) -> void;
+
+    // Same as create_system, but the entities are visited depth by depth in the hierarchy and the
+    // function takes a pointer to the components of the parent after the component tuple, nullptr
+    // for roots, see HierarchySystem:
+    //
+    //   world.create_hierarchy_system([](const core::IEngine& engine,
+    //                                    std::tuple<const Local&, Global&> components,
+    //                                    const std::tuple<const Local&, Global&>* parent) { ... });
+    template <typename... Filters, typename Func>
+    auto create_hierarchy_system(Func&& func) -> void;
+
+    template <AllTypeOfComponent... ComponentTypes>
+    auto create_archetype(std::uint32_t entity_buffer_size) -> void;
+
+    auto create_archetype_with_signature(ArchetypeKey signature, std::uint32_t entity_buffer_size)
+        -> void;
+
+    // The entity is created in the beginning of the next frame, but its handle is reserved and
+    // returned right away. It can be used with everything else which is queued, such as
+    // destroy_entity, set_parent and add_component, within the same frame.
+    //
+    // Entities can be created, destroyed and linked from any thread, systems included. Handles are
+    // reserved lock free, only appending to the queues takes a lock.
+    template <AllTypeOfComponent... ComponentTypes>
+    auto create_entity(ComponentTypes&&... components) -> Entity;
+
+    // Captures the components as a prefab, see hephaestus/Prefab.hpp. The archetype of the
+    // instances is found or created right away, so prefabs which need a new archetype must be
+    // created before start has finished, same as create_archetype.
+    template <AllTypeOfComponent... ComponentTypes>
+    auto create_prefab(ComponentTypes&&... components)
+        -> Prefab<std::remove_cvref_t<ComponentTypes>...>;
+
+    // Captures the given components of an existing entity as a prefab, the entity must have all
+    // of them. Must not be called while the world is ticking.
+    template <AllTypeOfComponent... ComponentTypes>
+    auto create_prefab_from(Entity entity) -> Prefab<ComponentTypes...>;
+
+    // Queues count copies of the prefab and returns the handle of the first one, the others
+    // follow it. Like create_entity they are created in the beginning of the next frame, but as a
+    // single batch: every column of the archetype grows once and is filled with copies of the
+    // prefab row, instead of every entity going through the creation queue on its own.
+    //
+    // The optional override is called for every instance once its row exists, with the index of
+    // the instance and references to its column components, in the order of the prefab:
+    //
+    //   world.instantiate(bullet, 100, [](std::size_t instance,
+    //                                     std::tuple<Position&, Velocity&> components) { ... });
+    //
+    // Overrides of different archetypes can run concurrently. Sparse components and tags are
+    // copied as they are. Command logs record the instances as copies of the prefab, so overrides
+    // can't be used while a command recorder is set.
+    template <AllTypeOfComponent... ComponentTypes, typename Func = detail::NoOverride>
+    auto instantiate(const Prefab<ComponentTypes...>& prefab, std::size_t count, Func&& func = {})
+        -> Entity;
+
+    // Destroyed at the end of the frame, or at the end of the next one if the entity is still
+    // queued for creation. Destroying an entity which is already destroyed does nothing.
+    auto destroy_entity(Entity entity) -> void;
+
+    // Adding and removing sparse components is queued like creation and applied in the beginning of
+    // the next frame, after the creation queue. The entity never changes archetype. Adding a
+    // component the entity already has assigns it, removing one it doesn't have does nothing.
+    template <TypeOfSparseComponent ComponentType>
+    auto add_component(Entity entity, ComponentType&& component) -> void;
+
+    template <TypeOfSparseComponent ComponentType>
+    auto remove_component(Entity entity) -> void;
+
+    // Type erased create_entity, add_component and remove_component for component types which
+    // are only known at runtime, see hephaestus/ComponentCodec.hpp. The values are copied.
+    auto create_entity_raw(std::span<const RawComponent> components) -> Entity;
+    auto add_component_raw(Entity entity, RawComponent component) -> void;
+    auto remove_component_raw(Entity entity, const ComponentCodec& codec) -> void;
+
+    // Parent links are queued like the sparse components and applied in the beginning of the next
+    // frame, after them. Destroying an entity unlinks it from its parent and its children become
+    // roots. Making an entity the parent of one of its ancestors is a bug and is ignored.
+    auto set_parent(Entity child, Entity parent) -> void;
+    auto remove_parent(Entity child) -> void;
+
+    // Returns NO_PARENT for roots. Must not be called while the world is ticking.
+    [[nodiscard]] auto get_parent(Entity child) const -> Entity;
+
+    // Disabled entities keep their components and their row, but every system skips them until
+    // they are enabled again. Toggling is queued like the parent links and applied in the beginning
+    // of the next frame, after them. It never moves the entity and leaves the query caches intact,
+    // which makes it much cheaper than destroying and recreating sleeping or culled entities.
+    auto set_enabled(Entity entity, bool enabled) -> void;
+
+    // Must not be called while the world is ticking.
+    [[nodiscard]] auto is_enabled(Entity entity) const -> bool;
+
+    // Opt-in owning group over sparse components, see SparseGroup. Systems whose component tuple
+    // is exactly the owned components, and which have no filters, iterate the packed group
+    // instead of walking the archetypes. A component can be owned by a single group. Groups must
+    // be created before start has finished, same as systems.
+    template <TypeOfSparseComponent... ComponentTypes>
+    auto create_group() -> void;
+
+    // Observers are called with the entities which got, or lost, the component since the last
+    // delivery, in a single batch rather than once per entity, see hephaestus/Observers.hpp:
+    //
+    //   world.on_add<RigidBody>([](const core::IEngine& engine,
+    //                              std::span<const Entity> entities) { ... });
+    //
+    // Batches are delivered twice per frame: at the end of the creation task, before the systems,
+    // with everything which happened while the queues were applied, and at the end of the
+    // destruction task with the destroyed entities. on_change is only called for components
+    // assigned by add_component, not for the ones systems write to. Observers run on the thread
+    // applying the queues and can queue commands for the next frame. They must be registered before
+    // start has finished, same as systems.
+    template <AllTypeOfComponent ComponentType, typename Func>
+    auto on_add(Func&& func) -> void;
+
+    template <AllTypeOfComponent ComponentType, typename Func>
+    auto on_remove(Func&& func) -> void;
+
+    template <TypeOfSparseComponent ComponentType, typename Func>
+    auto on_change(Func&& func) -> void;
+
+    // Tracks the x and y of every entity with the component in a SpatialIndex<ComponentType>,
+    // inserted as a resource so systems query it through Res<const SpatialIndex<ComponentType>>.
+    // The index is refreshed at the end of the frame, after the destroy queue, so queries see the
+    // positions as of the end of the previous frame. Frames in which no system wrote to the
+    // component and no entity with it was created or destroyed skip the refresh. Must be created
+    // before start has finished, same as systems.
+    template <TypeOfSpatialComponent ComponentType>
+    auto create_spatial_index(float cell_size)
+        -> SpatialIndex<std::remove_cvref_t<ComponentType>>&;
+
+    // Resources must be inserted before start has finished, same as systems. Inserting a resource
+    // which already exists replaces its value.
+    template <typename ResourceType>
+    auto insert_resource(ResourceType&& resource) -> std::remove_cvref_t<ResourceType>&;
+
+    // Must not be called while the world is ticking, systems should use Res<T> instead.
+    template <typename ResourceType>
+    [[nodiscard]] auto get_resource() const -> ResourceType&;
+
+    // Event types must be added before start has finished, same as systems. Systems send them with
+    // EventWriter<E> and read them with EventReader<E>, see hephaestus/Events.hpp. Adding an event
+    // type which already exists does nothing.
+    template <typename EventType>
+    auto add_event() -> void;
+
+    // Thread safe. The event is read by the systems of the next frame, systems should use
+    // EventWriter<E> instead.
+    template <typename EventType, typename... Args>
+    auto send_event(Args&&... args) -> void;
+
+    // The events read by the systems of the last frame. Must not be called while the world is
+    // ticking.
+    template <typename EventType>
+    [[nodiscard]] auto get_events() const -> const EventBuffer<EventType>&;
+
+    auto set_compaction_settings(const CompactionSettings& settings) -> void;
+
+    // Records every structural command into the recorder from now on, see
+    // hephaestus/CommandLog.hpp, nullptr stops recording. The recorder must outlive the recording.
+    // Must not be called while the world is ticking.
+    auto set_command_recorder(CommandRecorder* recorder) -> void;
+
+    // Writes every entity of the world with its components, parent and enabled state to a
+    // snapshot, see hephaestus/WorldSnapshot.hpp. Commands which are still queued aren't part of
+    // it. Must not be called while the world is ticking.
+    [[nodiscard]] auto save_snapshot(
+        const std::filesystem::path& path,
+        const SnapshotSchema& schema
+    ) const -> std::expected<void, SnapshotErrorCode>;
+
+    // Loads a snapshot into a world which has never had an entity. The file is memory mapped and
+    // validated, then every column is copied in one go and the entity locations are rebuilt in a
+    // single pass, instead of queueing every entity. The entities exist right away with the
+    // handles they were saved with, entities created later get handles past them.
+    //
+    // Must be called before start has finished, same as create_archetype. Nothing is loaded if the
+    // snapshot is invalid, but a hook which fails to read its component back leaves the world
+    // half loaded, such a world must be discarded.
+    auto load_snapshot(const std::filesystem::path& path, const SnapshotSchema& schema)
+        -> std::expected<void, SnapshotErrorCode>;
+
+    // Streams cells of entities in and out of the world from now on, see
+    // hephaestus/WorldStreamer.hpp. Must be called once at most, before start has finished.
+    auto create_streamer(SnapshotSchema schema, const StreamingSettings& settings = {})
+        -> WorldStreamer&;
+
+    // nullptr unless create_streamer has been called.
+    [[nodiscard]] auto get_streamer() const -> WorldStreamer*;
+
+    // Checkpoints the columns of the components at the end of every frame from now on, after the
+    // destroy queue, see hephaestus/Checkpoints.hpp. The components must be trivially copyable.
+    // Must be called once at most, before start has finished.
+    template <TypeOfColumnComponent... ComponentTypes>
+    auto enable_checkpoints(const CheckpointSettings& settings = {}) -> Checkpoints&;
+
+    // nullptr unless enable_checkpoints has been called.
+    [[nodiscard]] auto get_checkpoints() const -> Checkpoints*;
+
+    // Rolls the checkpointed columns back to the end of the frame, the frames after it are dropped
+    // and every tick from now on resimulates one of them with the same systems. Returns false if
+    // the frame isn't in the ring. Must not be called while the world is ticking.
+    auto restore_checkpoint(std::uint64_t frame) -> bool;
+
+    // Runs the compaction pass with the given time budget in seconds, on top of the one which runs
+    // every frame. Useful after despawning a large wave of entities. Must not be called while the
+    // world is ticking.
+    auto compact(double time_budget) -> void;
+
+    // Builds the dependency graph between the systems and the frame graph of the world.
+    // concurrent_worlds is the number of worlds which will tick concurrently with this one, it's
+    // used to estimate how many workers the systems can expect to get.
+    auto build_graph(std::size_t concurrent_worlds) -> void;
+
+    // The frame graph is only valid after build_graph has been called. It must not be run
+    // concurrently with itself.
+    [[nodiscard]] auto get_frame_graph() -> tf::Taskflow&;
+
+    [[nodiscard]] auto get_id() const -> WorldId;
+    [[nodiscard]] auto get_stats() const -> const WorldStats&;
+    [[nodiscard]] auto get_memory_stats() const -> MemoryStats;
+
+    // Per archetype, sparse set, component type and query numbers, see hephaestus/Stats.hpp. Must
+    // not be called while the world is ticking.
+    [[nodiscard]] auto collect_introspection() const -> WorldIntrospection;
+
+  private:
+    [[nodiscard]] auto reserve_entity_id() -> Entity;
+    [[nodiscard]] auto find_or_create_archetype(const ArchetypeKey& signature) -> ArchetypeId;
+
+    auto build_systems_dependency_graph(std::size_t concurrent_worlds) -> void;
+    // The position of every system node, conflicting systems run in that order.
+    [[nodiscard]] auto order_event_writers_first() const -> std::vector<std::size_t>;
+
+    auto apply_creation_queue(tf::Subflow& subflow) -> void;
+    auto apply_sparse_queue() -> void;
+    auto apply_hierarchy_queue() -> void;
+    auto apply_enabled_queue() -> void;
+    auto apply_destroy_queue(tf::Subflow& subflow) -> void;
+    // The entities must exist and be unique.
+    auto destroy_entities(tf::Subflow& subflow, std::span<const Entity> entities) -> void;
+    auto commit_streamed_cells() -> void;
+    auto commit_streamed_chunk(WorldStreamer::Cell& cell) -> void;
+    auto link_streamed_cell(WorldStreamer::Cell& cell) -> void;
+    auto evict_streamed_cells(tf::Subflow& subflow) -> void;
+    auto compact_archetype(ArchetypeId archetype_id) -> void;
+    // Push the entities of the rows to the observers of the components of the archetype.
+    auto observe_added_rows(ArchetypeId archetype_id, std::size_t first_row) -> void;
+    auto observe_removed_rows(ArchetypeId archetype_id, std::span<const std::size_t> rows) -> void;
+    template <AllTypeOfComponent ComponentType, typename Func>
+    auto add_observer(ObserverEvent event, Func&& func) -> void;
+    auto update_spatial_indices() -> void;
+
+    core::IEngine& engine;
+    WorldId id;
+
+    // Must outlive every container allocating from it, keep it declared before them.
+    WorldMemory memory;
+
+    std::vector<std::unique_ptr<SystemBase>> systems;
+    ArchetypeMap archetypes;
+    SparseSets sparse_sets;
+    Hierarchy hierarchy;
+    ComponentVersions versions;
+    Resources resources;
+    EventChannels events;
+    Observers observers;
+
+    // Indexed by archetype id, every archetype is filled in by a task of its own.
+    std::vector<std::vector<std::function<void()>>> creation_queues;
+    // Entities created by the batches of instantiate past the first of every batch, each batch is
+    // a single entry of creation_queues.
+    std::size_t num_batched_creations = 0;
+    std::vector<std::function<void()>> sparse_queue;
+    // Child and parent, NO_PARENT removes the parent of the child.
+    std::vector<std::pair<Entity, Entity>> hierarchy_queue;
+    std::vector<std::pair<Entity, bool>> enabled_queue;
+    // Guards appending to the queues, they are applied while no system is running.
+    std::mutex queue_mutex;
+    std::vector<Entity> destroy_queue;
+    // Handles from here on have been reserved since the creation queue was last applied, their
+    // creation may still be queued. Destroying them waits until they exist.
+    Entity first_queued_entity = 0;
+    // The number of rows of every archetype before the creation queue, only filled in when
+    // additions are observed. Kept to reuse the allocation.
+    std::vector<std::size_t> first_created_rows;
+    // The rows to destroy this frame, indexed by archetype id. Kept to reuse the allocations.
+    std::vector<std::vector<std::size_t>> destroy_rows;
+    std::optional<std::vector<SystemNode>> system_nodes = std::vector<SystemNode>{};
+
+    tf::Taskflow systems_graph;
+    tf::Taskflow frame_graph;
+
+    // Only set while recording, read by every command.
+    CommandRecorder* command_recorder = nullptr;
+
+    std::unique_ptr<WorldStreamer> streamer;
+    std::unique_ptr<Checkpoints> checkpoints;
+    // The entities evicted by a chunk. Kept to reuse the allocation.
+    std::vector<Entity> evicted;
+
+    std::atomic<Entity> next_entity_id = 0;
+    static_assert(std::atomic<Entity>::is_always_lock_free);
+
+    CompactionSettings compaction_settings;
+    std::size_t compaction_cursor = 0;
+
+    struct SpatialIndexUpdater {
+        std::type_index type;
+        ComponentTypeId component_id;
+        std::function<void()> update;
+        // Resolved from the system dependencies in build_graph. Without writers the component
+        // can only change through structural changes, which bump its version.
+        bool has_writers = true;
+        std::optional<std::uint64_t> last_version;
+    };
+    std::vector<SpatialIndexUpdater> spatial_index_updaters;
+
+    core::Timer tick_timer;
+    WorldStats stats;
+
+    // This is all confusing, however, the purpose of this is to improve the API
+    // for calling the create_system function. This way, the user only needs to
+    // pass the lambda which will be used as the system function, the rest is
+    // deduced and handled.
+
+    // A utility to pull out parameter types from a a callable.
+    template <typename T>
+    struct FunctionTraits : FunctionTraits<decltype(&T::operator())> {};
+    // This leverages the call operator of a lambda:
+    // For example, if we have:
+    //   auto myLambda = [](int a, float b) { ... };
+    // then decltype(&decltype(myLambda)::operator()) = Ret (ClassType::*)(int,
+    // float) const;
+
+    // Now the partial specialization for a non-generic, const lambda
+    // with the engine, the component tuple and any number of system params.
+    template <
+        typename ClassType,
+        typename ReturnType,
+        typename EngineParam,
+        typename TupleParam,
+        typename... Params>
+    struct FunctionTraits<ReturnType (ClassType::*)(EngineParam, TupleParam, Params...) const> {
+        static_assert(
+            !std::is_const_v<std::remove_reference_t<TupleParam>>,
+            "Const tuples are not supported. Use std::tuple<const Component&, ...>& instead of "
+            "const std::tuple<Component&, ...>&"
+        );
+        using EngineType = std::decay_t<EngineParam>;
+        using TupleType = std::remove_reference_t<TupleParam>; // Remove reference but keep
+                                                               // component const-ness
+        using ParamsType = SystemParams<Params...>;
+    };
+
+    // Hierarchy systems take a pointer to the component tuple of the parent after the tuple.
+    template <typename T>
+    struct HierarchyFunctionTraits : HierarchyFunctionTraits<decltype(&T::operator())> {};
+
+    template <
+        typename ClassType,
+        typename ReturnType,
+        typename EngineParam,
+        typename TupleParam,
+        typename ParentParam,
+        typename... Params>
+    struct HierarchyFunctionTraits<
+        ReturnType (ClassType::*)(EngineParam, TupleParam, ParentParam, Params...) const> {
+        using TupleType = std::remove_reference_t<TupleParam>;
+        static_assert(
+            std::is_same_v<std::decay_t<ParentParam>, const TupleType*>,
+            "The parent must be taken as a pointer to a const tuple of the same components."
+        );
+        using ParamsType = SystemParams<Params...>;
+    };
+
+    template <typename T>
+    struct TupleElements;
+
+    template <typename... Ts>
+    struct TupleElements<std::tuple<Ts...>> {
+        static_assert(
+            !HAS_DUPLICATE_COMPONENT_TYPE_V<Ts...>,
+            "A system cannot take the same component type twice (const or non-const)."
+        );
+
+        template <template <typename, typename...> class Template, typename First>
+        using Apply = Template<First, std::remove_cvref_t<Ts>...>; // Remove both const and ref
+
+        static auto make_dependencies() {
+            return make_system_dependencies<Ts...>();
+        }
+    };
+};
+
+template <typename... Filters, typename Func>
+auto World::create_system(Func&& func) -> void {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart && "Cannot create systems after start."
+    );
+    assert(
+        system_nodes != std::nullopt
+        && "Trying to create a system after the system_nodes have been reset."
+    );
+
+    using Traits = FunctionTraits<std::decay_t<Func>>;
+    using TupleType = typename Traits::TupleType; // e.g. std::tuple<Transform&, Velocity&>
+    using Components = TupleElements<TupleType>;
+    using Params = typename Traits::ParamsType;
+    using SystemType = typename Components::template Apply<System, Params>;
+
+    auto dependencies = Components::make_dependencies();
+    Params::add_dependencies(dependencies);
+    system_nodes->emplace_back(SystemNode{.dependencies = dependencies});
+
+    auto new_system = std::make_unique<SystemType>(
+        std::forward<Func>(func),
+        archetypes,
+        sparse_sets,
+        versions,
+        SystemContext{
+            .resources = resources,
+            .events = events,
+            .memory_resource = memory.get_resource()
+        },
+        std::move(dependencies),
+        make_query_filter<Filters...>()
+    );
+
+    systems.emplace_back(std::move(new_system));
+}
+
+template <typename... Filters, typename Func>
+auto World::create_hierarchy_system(Func&& func) -> void {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart && "Cannot create systems after start."
+    );
+    assert(
+        system_nodes != std::nullopt
+        && "Trying to create a system after the system_nodes have been reset."
+    );
+
+    using Traits = HierarchyFunctionTraits<std::decay_t<Func>>;
+    using TupleType = typename Traits::TupleType;
+    using Components = TupleElements<TupleType>;
+    using Params = typename Traits::ParamsType;
+    using SystemType = typename Components::template Apply<HierarchySystem, Params>;
+
+    auto dependencies = Components::make_dependencies();
+    Params::add_dependencies(dependencies);
+    system_nodes->emplace_back(SystemNode{.dependencies = dependencies});
+
+    // The system only deals in mutable components, the tuple of the parent is converted back to
+    // the const-ness the function asked for.
+    auto adapter = [func = std::forward<Func>(func)](
+                       const core::IEngine& engine,
+                       auto components,
+                       const auto* parent,
+                       auto... params
+                   ) {
+        if (parent == nullptr) {
+            func(engine, TupleType{components}, nullptr, std::move(params)...);
+            return;
+        }
+
+        const TupleType parent_components{*parent};
+        func(engine, TupleType{components}, &parent_components, std::move(params)...);
+    };
+
+    systems.emplace_back(std::make_unique<SystemType>(
+        std::move(adapter),
+        archetypes,
+        sparse_sets,
+        versions,
+        hierarchy,
+        SystemContext{
+            .resources = resources,
+            .events = events,
+            .memory_resource = memory.get_resource()
+        },
+        std::move(dependencies),
+        make_query_filter<Filters...>()
+    ));
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto World::create_archetype(const std::uint32_t entity_buffer_size) -> void {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot create new archetypes after start."
+    );
+
+    create_archetype_with_signature(make_archetype_key<ComponentTypes...>(), entity_buffer_size);
+}
+
+// No entities are created on the fly. We enqueue all of it into a collection
+// which is iterated and constructs all entities in the begining of the next
+// frame.
+template <AllTypeOfComponent... ComponentTypes>
+auto World::create_entity(ComponentTypes&&... components) -> Entity {
+    static_assert(
+        !HAS_DUPLICATE_COMPONENT_TYPE_V<ComponentTypes...>,
+        "A single entity cannot have the same component type twice (const or non-const)."
+    );
+
+    const auto entity_id = reserve_entity_id();
+    const auto signature = make_archetype_key<ComponentTypes...>();
+    if (command_recorder != nullptr) {
+        command_recorder->record_create(entity_id, std::as_const(components)...);
+    }
+
+    // New archetypes can only be created before start has finished, while no system is running.
+    // After that the map is only read here, which is safe from any thread.
+    const auto archetype_id = find_or_create_archetype(signature);
+    // The Archetype itself never moves, its entry in the map might when new archetypes are added.
+    auto* archetype = archetypes.at(archetype_id).get();
+
+    // The rows are created in parallel per archetype, the sparse sets are shared between all of
+    // them and are filled in afterwards by the sparse queue.
+    auto columns = std::tuple_cat(
+        detail::take_if<TypeOfColumnComponent<ComponentTypes>>(
+            std::forward<ComponentTypes>(components)
+        )...
+    );
+    auto sparse = std::tuple_cat(
+        detail::take_if<TypeOfSparseComponent<ComponentTypes>>(
+            std::forward<ComponentTypes>(components)
+        )...
+    );
+
+    const std::scoped_lock lock{queue_mutex};
+    if (creation_queues.size() <= archetype_id) {
+        creation_queues.resize(archetype_id + 1);
+    }
+    creation_queues[archetype_id].emplace_back([this,
+                                                data = std::move(columns),
+                                                archetype_id,
+                                                archetype,
+                                                entity_id]() mutable {
+        std::apply(
+            [&]<typename... ColumnTypes>(ColumnTypes&&... unpacked) {
+                archetype->template create_entity<ColumnTypes...>(
+                    entity_id,
+                    std::forward<ColumnTypes>(unpacked)...
+                );
+            },
+            std::move(data)
+        );
+        archetypes.set_location(entity_id, archetype_id);
+    });
+
+    if constexpr ((TypeOfSparseComponent<ComponentTypes> || ...)) {
+        sparse_queue.emplace_back([this, data = std::move(sparse), entity_id]() mutable {
+            std::apply(
+                [&](auto&&... unpacked) {
+                    (versions.increment(sparse_sets.emplace(entity_id, std::move(unpacked))), ...);
+                },
+                data
+            );
+        });
+    }
+
+    return entity_id;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto World::create_prefab(ComponentTypes&&... components)
+    -> Prefab<std::remove_cvref_t<ComponentTypes>...> {
+    static_assert(
+        !HAS_DUPLICATE_COMPONENT_TYPE_V<ComponentTypes...>,
+        "A single entity cannot have the same component type twice (const or non-const)."
+    );
+
+    const auto archetype_id =
+        find_or_create_archetype(make_archetype_key<std::remove_cvref_t<ComponentTypes>...>());
+    return Prefab<std::remove_cvref_t<ComponentTypes>...>{
+        id,
+        archetype_id,
+        std::tuple<std::remove_cvref_t<ComponentTypes>...>{
+            std::forward<ComponentTypes>(components)...
+        },
+    };
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto World::create_prefab_from(const Entity entity) -> Prefab<ComponentTypes...> {
+    const auto archetype_id = archetypes.find_location(entity);
+    assert(archetype_id != INVALID_ARCHETYPE_ID && "Entity does not exist in the world.");
+
+    const auto& archetype = *archetypes.at(archetype_id);
+    const auto row = archetype.get_row_index(entity);
+    return create_prefab(ComponentTypes{
+        std::get<0>(archetype.template get_row<ComponentTypes>(row, sparse_sets))
+    }...);
+}
+
+template <AllTypeOfComponent... ComponentTypes, typename Func>
+auto World::instantiate(
+    const Prefab<ComponentTypes...>& prefab,
+    const std::size_t count,
+    Func&& func
+) -> Entity {
+    assert(prefab.world_id == id && "The prefab was created by another world.");
+    if (count == 0) {
+        return next_entity_id.load(std::memory_order_relaxed);
+    }
+
+    const auto first_entity = next_entity_id.fetch_add(
+        static_cast<Entity>(count),
+        std::memory_order_relaxed
+    );
+    if (command_recorder != nullptr) {
+        assert(
+            (std::is_same_v<std::remove_cvref_t<Func>, detail::NoOverride>)
+            && "Overridden instances can't be recorded."
+        );
+        for (std::size_t i = 0; i < count; ++i) {
+            std::apply(
+                [&](const auto&... components) {
+                    command_recorder->record_create(
+                        static_cast<Entity>(first_entity + i),
+                        components...
+                    );
+                },
+                prefab.components
+            );
+        }
+    }
+
+    const auto archetype_id = prefab.archetype_id;
+    auto* archetype = archetypes.at(archetype_id).get();
+    auto columns = std::tuple_cat(
+        detail::take_if<TypeOfColumnComponent<ComponentTypes>>(
+            std::get<ComponentTypes>(prefab.components)
+        )...
+    );
+    auto sparse = std::tuple_cat(
+        detail::take_if<TypeOfSparseComponent<ComponentTypes>>(
+            std::get<ComponentTypes>(prefab.components)
+        )...
+    );
+
+    const std::scoped_lock lock{queue_mutex};
+    if (creation_queues.size() <= archetype_id) {
+        creation_queues.resize(archetype_id + 1);
+    }
+    creation_queues[archetype_id].emplace_back([this,
+                                                data = std::move(columns),
+                                                func = std::forward<Func>(func),
+                                                archetype_id,
+                                                archetype,
+                                                first_entity,
+                                                count]() mutable {
+        const auto first_row = archetype->get_num_entities();
+        std::apply(
+            [&](const auto&... components) { archetype->append_copies(count, components...); },
+            data
+        );
+        archetype->push_rows(first_entity, count);
+        for (std::size_t i = 0; i < count; ++i) {
+            archetypes.set_location(static_cast<Entity>(first_entity + i), archetype_id);
+        }
+
+        if constexpr (!std::is_same_v<std::remove_cvref_t<Func>, detail::NoOverride>) {
+            const auto instance_columns =
+                std::tuple_cat(detail::column_if_stored<ComponentTypes>(*archetype)...);
+            for (std::size_t i = 0; i < count; ++i) {
+                func(
+                    i,
+                    std::apply(
+                        [row = first_row + i](const auto&... column) {
+                            return std::tie(column[row]...);
+                        },
+                        instance_columns
+                    )
+                );
+            }
+        }
+    });
+    num_batched_creations += count - 1;
+
+    if constexpr ((TypeOfSparseComponent<ComponentTypes> || ...)) {
+        sparse_queue.emplace_back([this, data = std::move(sparse), first_entity, count]() {
+            std::apply(
+                [&](const auto&... components) {
+                    for (std::size_t i = 0; i < count; ++i) {
+                        const auto entity = static_cast<Entity>(first_entity + i);
+                        (versions.increment(sparse_sets.emplace(
+                             entity,
+                             std::remove_cvref_t<decltype(components)>{components}
+                         )),
+                         ...);
+                    }
+                },
+                data
+            );
+        });
+    }
+
+    return first_entity;
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto World::add_component(const Entity entity, ComponentType&& component) -> void {
+    if (command_recorder != nullptr) {
+        command_recorder->record_add_component(entity, std::as_const(component));
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    sparse_queue.emplace_back([this,
+                               entity,
+                               data = std::forward<ComponentType>(component)]() mutable {
+        assert(
+            archetypes.contains_entity(entity)
+            && "Trying to add a component to an entity that doesnt exist!"
+        );
+
+        versions.increment(sparse_sets.emplace(entity, std::move(data)));
+    });
+}
+
+template <typename ResourceType>
+auto World::insert_resource(ResourceType&& resource) -> std::remove_cvref_t<ResourceType>& {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot insert resources after start."
+    );
+
+    return resources.insert(std::forward<ResourceType>(resource));
+}
+
+template <typename ResourceType>
+auto World::get_resource() const -> ResourceType& {
+    return resources.get<ResourceType>();
+}
+
+template <typename EventType>
+auto World::add_event() -> void {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot add event types after start."
+    );
+
+    events.add<EventType>();
+}
+
+template <typename EventType, typename... Args>
+auto World::send_event(Args&&... args) -> void {
+    events.get<EventType>().send(std::forward<Args>(args)...);
+}
+
+template <typename EventType>
+auto World::get_events() const -> const EventBuffer<EventType>& {
+    return events.get<EventType>().get_last_frame();
+}
+
+template <TypeOfSparseComponent ComponentType>
+auto World::remove_component(const Entity entity) -> void {
+    if (command_recorder != nullptr) {
+        command_recorder->record_remove_component(entity, get_component_codec<ComponentType>());
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    sparse_queue.emplace_back([this, entity]() {
+        versions.increment(sparse_sets.remove<ComponentType>(entity));
+    });
+}
+
+template <TypeOfSpatialComponent ComponentType>
+auto World::create_spatial_index(const float cell_size)
+    -> SpatialIndex<std::remove_cvref_t<ComponentType>>& {
+    using ValueType = std::remove_cvref_t<ComponentType>;
+
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot create spatial indices after start."
+    );
+    assert(
+        !resources.contains<SpatialIndex<ValueType>>()
+        && "A spatial index already exists for the component."
+    );
+
+    auto& index = resources.insert(SpatialIndex<ValueType>{cell_size, memory.get_resource()});
+    spatial_index_updaters.emplace_back(SpatialIndexUpdater{
+        .type = std::type_index(typeid(ValueType)),
+        .component_id = get_component_type_id<ValueType>(),
+        .update =
+            [this, &index]() {
+                index.begin_update();
+                if constexpr (TypeOfSparseComponent<ValueType>) {
+                    if (sparse_sets.find(get_component_type_id<ValueType>()) != nullptr) {
+                        auto& set = sparse_sets.get<ValueType>();
+                        const auto& entities = set.get_entities();
+                        const auto& components = set.get_components();
+                        for (std::size_t i = 0; i < entities.size(); ++i) {
+                            index.update(entities[i], components[i].x, components[i].y);
+                        }
+                    }
+                } else {
+                    for (const auto archetype_id :
+                         filter_archetypes(archetypes, make_archetype_key<ValueType>())) {
+                        const auto& archetype = *archetypes.at(archetype_id);
+                        const auto& entities = archetype.get_entities();
+                        const auto components = archetype.template get_column<ValueType>();
+                        for (std::size_t i = 0; i < entities.size(); ++i) {
+                            index.update(entities[i], components[i].x, components[i].y);
+                        }
+                    }
+                }
+                index.end_update();
+            },
+    });
+    return index;
+}
+
+template <AllTypeOfComponent ComponentType, typename Func>
+auto World::on_add(Func&& func) -> void {
+    add_observer<ComponentType>(ObserverEvent::Add, std::forward<Func>(func));
+}
+
+template <AllTypeOfComponent ComponentType, typename Func>
+auto World::on_remove(Func&& func) -> void {
+    add_observer<ComponentType>(ObserverEvent::Remove, std::forward<Func>(func));
+}
+
+template <TypeOfSparseComponent ComponentType, typename Func>
+auto World::on_change(Func&& func) -> void {
+    add_observer<ComponentType>(ObserverEvent::Change, std::forward<Func>(func));
+}
+
+template <AllTypeOfComponent ComponentType, typename Func>
+auto World::add_observer(const ObserverEvent event, Func&& func) -> void {
+    static_assert(
+        std::is_invocable_v<Func, const core::IEngine&, std::span<const Entity>>,
+        "Observers take the engine and a span of entities."
+    );
+
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot register observers after start."
+    );
+
+    observers.add(
+        event,
+        get_component_type_id<std::remove_cvref_t<ComponentType>>(),
+        std::forward<Func>(func)
+    );
+}
+
+template <TypeOfColumnComponent... ComponentTypes>
+auto World::enable_checkpoints(const CheckpointSettings& settings) -> Checkpoints& {
+    static_assert(
+        (std::is_trivially_copyable_v<std::remove_cvref_t<ComponentTypes>> && ...),
+        "Only trivially copyable components can be checkpointed byte for byte."
+    );
+
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot enable checkpoints after start."
+    );
+    assert(checkpoints == nullptr && "Checkpoints are already enabled for the world.");
+
+    checkpoints = std::make_unique<Checkpoints>(settings);
+    (checkpoints->components.emplace_back(Checkpoints::Component{
+         .component_id = get_component_type_id<std::remove_cvref_t<ComponentTypes>>(),
+         .type = std::type_index(typeid(std::remove_cvref_t<ComponentTypes>)),
+         .element_size = sizeof(std::remove_cvref_t<ComponentTypes>),
+         .get_bytes = [](Archetype& archetype) -> std::span<std::byte> {
+             return std::as_writable_bytes(archetype.get_column<ComponentTypes>());
+         },
+     }),
+     ...);
+    return *checkpoints;
+}
+
+template <TypeOfSparseComponent... ComponentTypes>
+auto World::create_group() -> void {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart && "Cannot create groups after start."
+    );
+
+    static_cast<void>(sparse_sets.create_group<ComponentTypes...>());
+}
+} // namespace atlas::hephaestus
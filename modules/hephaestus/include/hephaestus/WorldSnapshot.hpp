@@ -0,0 +1,401 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/SparseSet.hpp"
+
+namespace atlas::hephaestus {
+// A snapshot holds every entity of a world along with its components, parent and enabled state,
+// laid out so that loading it is a handful of bulk copies per archetype, see World::save_snapshot
+// and World::load_snapshot:
+//
+//   header:     "ATLSSNAP", version, next entity handle, number of entries of every table below
+//   components: type name, size and storage of every component type of the snapshot
+//   archetypes: components, entities, enabled mask, then every column as one block
+//   sparse:     entities and values of every sparse component type
+//   hierarchy:  child and parent of every link
+//
+// Integers are fixed width in the byte order of the machine, and every block starts 64 bytes
+// aligned from the start of the file, which keeps the blocks of a memory mapped snapshot aligned
+// for any component. Trivially copyable components are stored as their bytes, so snapshots are
+// only portable between builds with the same layout of the components. Entities keep their
+// handles.
+enum class SnapshotErrorCode : std::uint8_t {
+    NoError,
+
+    CannotOpen,
+    CannotWrite,
+    NotASnapshot,
+    UnsupportedVersion,
+    Truncated,
+    // A component type of the world or the snapshot which isn't in the schema.
+    UnknownComponent,
+    ComponentSizeMismatch,
+    // A hook couldn't read the value of a component back.
+    MalformedComponent,
+    // Snapshots can only be loaded into a world which has never had an entity.
+    WorldNotEmpty,
+    // A streamed cell holds an archetype which wasn't created before start, see WorldStreamer.
+    UnknownArchetype,
+};
+
+constexpr std::array<char, 8> SNAPSHOT_MAGIC = {'A', 'T', 'L', 'S', 'S', 'N', 'A', 'P'};
+constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+constexpr std::size_t SNAPSHOT_ALIGNMENT = 64;
+
+// Serializes a component which isn't trivially copyable value by value. save appends the bytes of
+// the value, load reads a value back from the front of the data and consumes its bytes, or
+// returns nullopt if they are malformed.
+template <typename ComponentType>
+struct SnapshotHooks {
+    std::function<void(const ComponentType& component, std::vector<std::byte>& data)> save;
+    std::function<std::optional<ComponentType>(std::span<const std::byte>& data)> load;
+};
+
+enum class SnapshotStorage : std::uint8_t {
+    Column,
+    Sparse,
+    Tag,
+};
+
+// How a component type is stored in and restored from a snapshot. The column and sparse functions
+// are only set for the matching storage.
+struct SnapshotComponent {
+    ComponentTypeId component_id = INVALID_COMPONENT_TYPE_ID;
+    std::size_t size = 0;
+    SnapshotStorage storage = SnapshotStorage::Column;
+    // Registered with hooks, the values have no fixed size in the snapshot.
+    bool has_hooks = false;
+
+    // Appends the whole column of the component in the archetype.
+    std::function<void(const Archetype& archetype, std::vector<std::byte>& data)> save_column;
+    // Appends num_rows values to the column, returns false if the data doesn't hold exactly them.
+    std::function<bool(Archetype& archetype, std::span<const std::byte> data, std::size_t num_rows)>
+        load_column;
+    // Appends the entities of the sparse set and their values, in the same order.
+    std::function<
+        void(const SparseSets& sets, std::vector<Entity>& entities, std::vector<std::byte>& data)>
+        save_sparse;
+    // Adds the component to the entities, returns false if the data doesn't hold exactly a value
+    // per entity. changed collects the components whose storage has changed.
+    std::function<bool(
+        SparseSets& sets,
+        std::span<const Entity> entities,
+        std::span<const std::byte> data,
+        ArchetypeKey& changed
+    )>
+        load_sparse;
+};
+
+// The component types a snapshot may hold. Every component type of a saved world must be
+// registered, and every component type of a loaded snapshot, matched by type name and size.
+//
+//   SnapshotSchema schema;
+//   schema.register_components<Position, Velocity, Selected>();
+//   schema.register_component<Name>({.save = save_name, .load = load_name});
+//   world.save_snapshot("level.snapshot", schema);
+class SnapshotSchema final {
+  public:
+    // Trivially copyable components, their columns are copied byte for byte.
+    template <AllTypeOfComponent... ComponentTypes>
+    auto register_components() -> void;
+
+    // Any other component goes through its hooks, value by value.
+    template <TypeOfComponent ComponentType>
+    auto register_component(SnapshotHooks<std::remove_cvref_t<ComponentType>> hooks) -> void;
+
+    // Both return nullptr if the type isn't registered.
+    [[nodiscard]] auto find(ComponentTypeId component_id) const -> const SnapshotComponent*;
+    [[nodiscard]] auto find(std::string_view type_name) const -> const SnapshotComponent*;
+
+  private:
+    template <TypeOfComponent ComponentType>
+    auto make_component() -> SnapshotComponent&;
+
+    std::vector<SnapshotComponent> components;
+};
+
+namespace detail {
+// Appends the fixed width integers and aligned blocks of a snapshot.
+class SnapshotWriter final {
+  public:
+    template <typename ValueType>
+    auto write(const ValueType& value) -> void {
+        static_assert(std::is_trivially_copyable_v<ValueType>);
+        write_bytes(std::as_bytes(std::span{&value, 1}));
+    }
+
+    auto write_bytes(const std::span<const std::byte> bytes) -> void {
+        data.insert(data.end(), bytes.begin(), bytes.end());
+    }
+
+    // Pads up to the next block boundary.
+    auto align() -> void {
+        const auto padding = (SNAPSHOT_ALIGNMENT - (data.size() % SNAPSHOT_ALIGNMENT))
+                             % SNAPSHOT_ALIGNMENT;
+        data.resize(data.size() + padding);
+    }
+
+    // A block of size bytes starting at the next boundary.
+    auto write_block(const std::span<const std::byte> bytes) -> void {
+        write<std::uint64_t>(bytes.size());
+        align();
+        write_bytes(bytes);
+    }
+
+    [[nodiscard]] auto get_data() const -> std::span<const std::byte> {
+        return data;
+    }
+
+  private:
+    std::vector<std::byte> data;
+};
+
+// Reads back what SnapshotWriter wrote, every read fails with Truncated past the end of the data.
+class SnapshotReader final {
+  public:
+    explicit SnapshotReader(const std::span<const std::byte> data)
+        : data{data} {}
+
+    template <typename ValueType>
+    auto read() -> std::expected<ValueType, SnapshotErrorCode> {
+        static_assert(std::is_trivially_copyable_v<ValueType>);
+        const auto bytes = read_bytes(sizeof(ValueType));
+        if (!bytes) {
+            return std::unexpected(bytes.error());
+        }
+
+        ValueType value;
+        std::memcpy(&value, bytes->data(), sizeof(ValueType));
+        return value;
+    }
+
+    auto read_bytes(const std::size_t size)
+        -> std::expected<std::span<const std::byte>, SnapshotErrorCode> {
+        if (data.size() - offset < size) {
+            return std::unexpected(SnapshotErrorCode::Truncated);
+        }
+
+        const auto bytes = data.subspan(offset, size);
+        offset += size;
+        return bytes;
+    }
+
+    auto read_block() -> std::expected<std::span<const std::byte>, SnapshotErrorCode> {
+        const auto size = read<std::uint64_t>();
+        if (!size) {
+            return std::unexpected(size.error());
+        }
+
+        const auto padding = (SNAPSHOT_ALIGNMENT - (offset % SNAPSHOT_ALIGNMENT))
+                             % SNAPSHOT_ALIGNMENT;
+        offset = std::min(data.size(), offset + padding);
+        return read_bytes(*size);
+    }
+
+    // A block of count values, which are used in place. The block is aligned for them as long as
+    // the data itself is aligned, which mapped files and heap buffers are.
+    template <typename ValueType>
+    auto read_array(const std::size_t count)
+        -> std::expected<std::span<const ValueType>, SnapshotErrorCode> {
+        static_assert(std::is_trivially_copyable_v<ValueType>);
+        const auto block = read_block();
+        if (!block) {
+            return std::unexpected(block.error());
+        }
+        if (block->size() % sizeof(ValueType) != 0 || block->size() / sizeof(ValueType) != count) {
+            return std::unexpected(SnapshotErrorCode::NotASnapshot);
+        }
+        assert(
+            reinterpret_cast<std::uintptr_t>(block->data()) % alignof(ValueType) == 0
+            && "The snapshot data is misaligned."
+        );
+
+        return std::span{reinterpret_cast<const ValueType*>(block->data()), count};
+    }
+
+    [[nodiscard]] auto is_done() const -> bool {
+        return offset == data.size();
+    }
+
+  private:
+    std::span<const std::byte> data;
+    std::size_t offset = 0;
+};
+
+struct SnapshotArchetype {
+    ArchetypeKey key;
+    std::span<const Entity> entities;
+    std::span<const std::uint64_t> enabled_mask;
+    std::vector<std::pair<const SnapshotComponent*, std::span<const std::byte>>> columns;
+};
+
+struct SnapshotSparseSet {
+    const SnapshotComponent* component = nullptr;
+    std::span<const Entity> entities;
+    std::span<const std::byte> values;
+};
+
+// The tables of a snapshot, the spans point into its data.
+struct SnapshotContents {
+    Entity next_entity = 0;
+    std::vector<SnapshotArchetype> archetypes;
+    std::vector<SnapshotSparseSet> sparse_sets;
+    // Child and parent of every link.
+    std::span<const Entity> links;
+};
+
+// Reads the whole snapshot and checks it against the schema, before anything is loaded from it.
+auto parse_snapshot(std::span<const std::byte> data, const SnapshotSchema& schema)
+    -> std::expected<SnapshotContents, SnapshotErrorCode>;
+} // namespace detail
+
+template <AllTypeOfComponent... ComponentTypes>
+auto SnapshotSchema::register_components() -> void {
+    static_assert(
+        (std::is_trivially_copyable_v<std::remove_cvref_t<ComponentTypes>> && ...),
+        "Components which aren't trivially copyable need hooks, see register_component."
+    );
+
+    (
+        [this]() {
+            using ValueType = std::remove_cvref_t<ComponentTypes>;
+            auto& component = make_component<ValueType>();
+            if constexpr (TypeOfSparseComponent<ValueType>) {
+                component.save_sparse = [](const SparseSets& sets,
+                                           std::vector<Entity>& entities,
+                                           std::vector<std::byte>& data) {
+                    auto& set = sets.get<ValueType>();
+                    const auto bytes = std::as_bytes(std::span{set.get_components()});
+                    entities.assign(set.get_entities().begin(), set.get_entities().end());
+                    data.assign(bytes.begin(), bytes.end());
+                };
+                component.load_sparse = [](SparseSets& sets,
+                                           const std::span<const Entity> entities,
+                                           const std::span<const std::byte> data,
+                                           ArchetypeKey& changed) {
+                    if (data.size() != entities.size() * sizeof(ValueType)) {
+                        return false;
+                    }
+                    for (std::size_t i = 0; i < entities.size(); ++i) {
+                        ValueType value;
+                        std::memcpy(&value, data.data() + (i * sizeof(ValueType)), sizeof(value));
+                        changed.add_components(sets.emplace(entities[i], std::move(value)));
+                    }
+                    return true;
+                };
+            } else if constexpr (!TypeOfTagComponent<ValueType>) {
+                component.save_column = [](const Archetype& archetype,
+                                           std::vector<std::byte>& data) {
+                    const auto bytes = std::as_bytes(archetype.get_column<ValueType>());
+                    data.assign(bytes.begin(), bytes.end());
+                };
+                component.load_column = [](Archetype& archetype,
+                                           const std::span<const std::byte> data,
+                                           const std::size_t num_rows) {
+                    if (data.size() != num_rows * sizeof(ValueType)) {
+                        return false;
+                    }
+                    archetype.append_to_column<ValueType>(data);
+                    return true;
+                };
+            }
+        }(),
+        ...
+    );
+}
+
+template <TypeOfComponent ComponentType>
+auto SnapshotSchema::register_component(SnapshotHooks<std::remove_cvref_t<ComponentType>> hooks)
+    -> void {
+    using ValueType = std::remove_cvref_t<ComponentType>;
+    static_assert(!TypeOfTagComponent<ValueType>, "Tags carry no data, register them as is.");
+
+    auto& component = make_component<ValueType>();
+    component.has_hooks = true;
+    if constexpr (TypeOfSparseComponent<ValueType>) {
+        component.save_sparse = [save = hooks.save](const SparseSets& sets,
+                                                    std::vector<Entity>& entities,
+                                                    std::vector<std::byte>& data) {
+            auto& set = sets.get<ValueType>();
+            entities.assign(set.get_entities().begin(), set.get_entities().end());
+            data.clear();
+            for (const auto& value : set.get_components()) {
+                save(value, data);
+            }
+        };
+        component.load_sparse = [load = hooks.load](SparseSets& sets,
+                                                    const std::span<const Entity> entities,
+                                                    std::span<const std::byte> data,
+                                                    ArchetypeKey& changed) {
+            for (const auto entity : entities) {
+                auto value = load(data);
+                if (!value.has_value()) {
+                    return false;
+                }
+                changed.add_components(sets.emplace(entity, std::move(*value)));
+            }
+            return data.empty();
+        };
+    } else {
+        component.save_column = [save = hooks.save](const Archetype& archetype,
+                                                    std::vector<std::byte>& data) {
+            data.clear();
+            for (const auto& value : archetype.get_column<ValueType>()) {
+                save(value, data);
+            }
+        };
+        component.load_column = [load = hooks.load](Archetype& archetype,
+                                                    std::span<const std::byte> data,
+                                                    const std::size_t num_rows) {
+            for (std::size_t row = 0; row < num_rows; ++row) {
+                auto value = load(data);
+                if (!value.has_value()) {
+                    return false;
+                }
+                archetype.add_to_component_storage(std::move(*value));
+            }
+            return data.empty();
+        };
+    }
+}
+
+template <TypeOfComponent ComponentType>
+auto SnapshotSchema::make_component() -> SnapshotComponent& {
+    using ValueType = std::remove_cvref_t<ComponentType>;
+
+    const auto component_id = get_component_type_id<ValueType>();
+    assert(find(component_id) == nullptr && "The component type is already registered.");
+
+    SnapshotStorage storage = SnapshotStorage::Column;
+    if constexpr (TypeOfSparseComponent<ValueType>) {
+        storage = SnapshotStorage::Sparse;
+    } else if constexpr (TypeOfTagComponent<ValueType>) {
+        storage = SnapshotStorage::Tag;
+    }
+
+    return components.emplace_back(SnapshotComponent{
+        .component_id = component_id,
+        .size = storage == SnapshotStorage::Tag ? 0 : sizeof(ValueType),
+        .storage = storage,
+    });
+}
+} // namespace atlas::hephaestus
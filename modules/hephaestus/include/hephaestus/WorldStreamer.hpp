@@ -0,0 +1,165 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Common.hpp"
+#include "hephaestus/MappedFile.hpp"
+#include "hephaestus/WorldSnapshot.hpp"
+
+namespace atlas::hephaestus {
+using CellId = std::uint32_t;
+
+// Both budgets are wall time in seconds per frame. Every frame with work left commits and evicts at
+// least one chunk of rows whatever the budget, so streaming always makes progress.
+struct StreamingSettings {
+    // Spent committing staged cells into the archetypes in the beginning of the frame, after the
+    // queues.
+    double commit_budget = 0.002;
+    // Spent evicting unloaded cells at the end of the frame, after the destroy queue.
+    double evict_budget = 0.001;
+    std::size_t num_loader_threads = 1;
+};
+
+enum class CellState : std::uint8_t {
+    Unloaded,
+    // Being read and decoded by a loader thread.
+    Loading,
+    // Decoded, its rows are being moved into the archetypes.
+    Committing,
+    Resident,
+    // Its entities are being evicted.
+    Unloading,
+    // See WorldStreamer::get_error. Failed cells can be loaded again.
+    Failed,
+};
+
+// Streams cells, blocks of entities saved as snapshots with World::save_snapshot, in and out of a
+// running world without spiking the frame. A loader thread maps, validates and decodes the
+// snapshot of a cell into staging archetypes, off the frame. The world then moves the staged rows
+// into its archetypes chunk by chunk in the beginning of every frame, within the commit budget,
+// and evicts unloaded cells the same way at the end of it.
+//
+// Streamed entities get new handles, see get_entities. The handles saved in a cell only link its
+// parents and sparse components. Every archetype of a cell must have been created before start has
+// finished, other cells fail with UnknownArchetype. The hooks of column components run on the
+// loader threads, the ones of sparse components in the frame. Streaming isn't recorded by command
+// logs.
+//
+// Created by World::create_streamer. Every function can be called from any thread, systems
+// included.
+class WorldStreamer final {
+  public:
+    WorldStreamer(SnapshotSchema schema, const StreamingSettings& settings);
+    ~WorldStreamer() = default;
+
+    WorldStreamer(const WorldStreamer&) = delete;
+    auto operator=(const WorldStreamer&) -> WorldStreamer& = delete;
+
+    WorldStreamer(WorldStreamer&&) = delete;
+    auto operator=(WorldStreamer&&) -> WorldStreamer& = delete;
+
+    // Returns false if the cell is neither Unloaded nor Failed.
+    auto load_cell(CellId cell, std::filesystem::path path) -> bool;
+
+    // Also cancels cells which aren't resident yet, the rows which already made it into the world
+    // are evicted. Returns false if the cell is Unloaded, Failed or already Unloading.
+    auto unload_cell(CellId cell) -> bool;
+
+    [[nodiscard]] auto get_state(CellId cell) const -> CellState;
+
+    // Why the cell failed, NoError unless it's Failed.
+    [[nodiscard]] auto get_error(CellId cell) const -> SnapshotErrorCode;
+
+    // The entities of the cell which are in the world, all of them once it's Resident.
+    [[nodiscard]] auto get_entities(CellId cell) const -> std::vector<Entity>;
+
+    [[nodiscard]] auto get_settings() const -> const StreamingSettings& {
+        return settings;
+    }
+
+  private:
+    friend class World;
+
+    struct StagedArchetype {
+        ArchetypeKey key;
+        // Only the columns are filled in, the entities and enabled bits are added when the rows
+        // are committed.
+        std::unique_ptr<Archetype> columns;
+        std::span<const std::uint64_t> enabled_mask;
+        // The first row of the archetype within the cell, the rows get consecutive handles.
+        std::size_t offset = 0;
+        std::size_t num_rows = 0;
+        std::size_t num_committed = 0;
+    };
+
+    struct StagedCell {
+        // The sparse sets and links of the contents point into it.
+        MappedFile file;
+        detail::SnapshotContents contents;
+        std::vector<StagedArchetype> archetypes;
+        // The row within the cell of every saved handle.
+        std::vector<Entity> rows;
+        std::size_t num_rows = 0;
+        // Handles are reserved for all rows when the first one is committed.
+        Entity first_entity = 0;
+        bool is_started = false;
+    };
+
+    struct Cell {
+        CellId id = 0;
+        CellState state = CellState::Unloaded;
+        SnapshotErrorCode error = SnapshotErrorCode::NoError;
+        // Tells the result of a load apart from the ones of the loads it replaced.
+        std::uint64_t generation = 0;
+        std::unique_ptr<StagedCell> staged;
+        // Evicted from the back.
+        std::vector<Entity> entities;
+    };
+
+    struct LoadRequest {
+        CellId cell = 0;
+        std::uint64_t generation = 0;
+        std::filesystem::path path;
+    };
+
+    auto run_loader(const std::stop_token& stop_token) -> void;
+    [[nodiscard]] auto stage(const std::filesystem::path& path) const
+        -> std::expected<std::unique_ptr<StagedCell>, SnapshotErrorCode>;
+
+    // The first cell of the queue which is still in the state, nullptr if there is none. Must be
+    // called with the mutex locked.
+    [[nodiscard]] auto find_front(std::deque<CellId>& queue, CellState state) -> Cell*;
+
+    SnapshotSchema schema;
+    StreamingSettings settings;
+
+    mutable std::mutex mutex;
+    std::unordered_map<CellId, Cell> cells;
+    // Shared by all cells, so a cell which was erased and loaded again doesn't reuse a generation.
+    std::uint64_t last_generation = 0;
+    std::deque<LoadRequest> load_requests;
+    std::condition_variable_any requested;
+    // The cells in the order they are committed and evicted, cells which changed state in the
+    // meantime are skipped.
+    std::deque<CellId> committing;
+    std::deque<CellId> unloading;
+
+    // Declared last, the loaders are stopped and joined before anything they use is destroyed.
+    std::vector<std::jthread> loaders;
+};
+} // namespace atlas::hephaestus
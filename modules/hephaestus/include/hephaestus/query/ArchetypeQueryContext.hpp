@@ -1,15 +1,21 @@
 #pragma once
 
 #include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/ComponentVersions.hpp"
+#include "hephaestus/SparseSet.hpp"
 #include "hephaestus/Utils.hpp"
 
 namespace atlas::hephaestus {
 struct ArchetypeQueryContext final {
     explicit ArchetypeQueryContext(
         const ArchetypeMap& archetypes,
+        const SparseSets& sparse_sets,
+        const ComponentVersions& versions,
         std::vector<SystemDependencies> dependencies
     )
         : archetypes{archetypes}
+        , sparse_sets{sparse_sets}
+        , versions{versions}
         , dependencies{std::move(dependencies)} {}
 
     ArchetypeQueryContext(const ArchetypeQueryContext&) = delete;
@@ -21,6 +27,8 @@ struct ArchetypeQueryContext final {
     ~ArchetypeQueryContext() = default;
 
     const ArchetypeMap& archetypes;
+    const SparseSets& sparse_sets;
+    const ComponentVersions& versions;
     const std::vector<SystemDependencies> dependencies;
 };
 } // namespace atlas::hephaestus
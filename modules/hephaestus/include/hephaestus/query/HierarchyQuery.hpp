@@ -0,0 +1,266 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "hephaestus/Archetype.hpp"
+#include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/ComponentVersions.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/Hierarchy.hpp"
+#include "hephaestus/SparseSet.hpp"
+#include "hephaestus/Stats.hpp"
+#include "hephaestus/query/ArchetypeQueryContext.hpp"
+#include "hephaestus/query/QueryComponentsPipeline.hpp"
+#include "hephaestus/query/QueryFilters.hpp"
+
+namespace atlas::hephaestus {
+// The entities matched by a hierarchy query in breadth first order, see HierarchyQuery.
+template <AllTypeOfComponent... ComponentTypes>
+struct HierarchyLevels final {
+    static constexpr auto NO_PARENT_INDEX = std::numeric_limits<std::uint32_t>::max();
+
+    explicit HierarchyLevels(std::pmr::memory_resource* memory_resource)
+        : components{memory_resource}
+        , parent_indices{memory_resource}
+        , level_offsets{memory_resource}
+        , rows{memory_resource} {}
+
+    [[nodiscard]] auto get_num_levels() const -> std::size_t {
+        return level_offsets.empty() ? 0 : level_offsets.size() - 1;
+    }
+
+    // The indices into components of the entities at the depth.
+    [[nodiscard]] auto get_level(const std::size_t depth) const
+        -> std::pair<std::size_t, std::size_t> {
+        return {level_offsets[depth], level_offsets[depth + 1]};
+    }
+
+    // Returns nullptr for the roots.
+    [[nodiscard]] auto get_parent(const std::size_t index) const
+        -> const std::tuple<ComponentTypes&...>* {
+        const auto parent_index = parent_indices[index];
+        return parent_index == NO_PARENT_INDEX ? nullptr : &components[parent_index];
+    }
+
+    // Disabled entities keep their place in the levels, their children still refer to them.
+    [[nodiscard]] auto is_enabled(const std::size_t index) const -> bool {
+        return rows[index].first->is_enabled(rows[index].second);
+    }
+
+    std::pmr::vector<std::tuple<ComponentTypes&...>> components;
+    // Index into components of the parent of each entity, NO_PARENT_INDEX for roots.
+    std::pmr::vector<std::uint32_t> parent_indices;
+    // Depth d spans [level_offsets[d], level_offsets[d + 1]).
+    std::pmr::vector<std::size_t> level_offsets;
+    // The archetype and row of each entity.
+    std::pmr::vector<std::pair<const Archetype*, std::size_t>> rows;
+};
+
+// Visits the entities matching the components and filters depth by depth. The roots come first,
+// then their children, then their grandchildren and so on, and each entity refers back to its
+// parent. An entity whose parent doesn't match the query is treated as a root.
+//
+// Siblings are contiguous and the levels are laid out in the order of their parents, so the
+// parents read by one level are a single forward sweep through the previous level.
+//
+// Like Query, the result is cached and only rebuilt when the versions of the components, or the
+// hierarchy itself, have changed. Only the cached references are ordered by depth, the rows stay
+// where they are in their archetypes: sorting the archetype storage would move the rows under
+// every other query and command of the world.
+template <AllTypeOfComponent... ComponentTypes>
+class HierarchyQuery final {
+  public:
+    using Levels = HierarchyLevels<ComponentTypes...>;
+
+    HierarchyQuery(
+        const ArchetypeMap& archetypes,
+        const SparseSets& sparse_sets,
+        const ComponentVersions& versions,
+        const Hierarchy& hierarchy,
+        std::pmr::memory_resource* memory_resource,
+        std::vector<SystemDependencies> dependencies,
+        const QueryFilter& filter = {}
+    )
+        : context{archetypes, sparse_sets, versions, std::move(dependencies)}
+        , hierarchy{hierarchy}
+        , filter{make_filter(filter)}
+        , memory_resource{memory_resource} {
+        auto versioned_key = this->filter.with;
+        versioned_key.add_components(this->filter.with_sparse)
+            .add_components(this->filter.without_sparse);
+        versioned_key.for_each_component([this](const std::size_t component_id) {
+            component_ids.emplace_back(static_cast<ComponentTypeId>(component_id));
+        });
+    }
+
+    HierarchyQuery(const HierarchyQuery&) = delete;
+    auto operator=(const HierarchyQuery&) -> HierarchyQuery& = delete;
+
+    HierarchyQuery(HierarchyQuery&&) = delete;
+    auto operator=(HierarchyQuery&&) -> HierarchyQuery& = delete;
+
+    ~HierarchyQuery() = default;
+
+    [[nodiscard]] auto get() const -> const Levels&;
+
+    [[nodiscard]] auto collect_stats() const -> QueryStats {
+        return QueryStats{
+            .num_cached = cache.has_value() ? cache->components.size() : 0,
+            .cache_bytes_reserved = cache.has_value()
+                                        ? cache->components.capacity()
+                                              * sizeof(std::tuple<ComponentTypes&...>)
+                                        : 0,
+            .num_rebuilds = num_rebuilds,
+        };
+    }
+
+  private:
+    static constexpr auto NO_ROW = std::numeric_limits<std::uint32_t>::max();
+
+    struct Row {
+        Entity entity;
+        const Archetype* archetype;
+        std::size_t index;
+        std::tuple<ComponentTypes&...> components;
+    };
+
+    [[nodiscard]] static auto make_filter(QueryFilter filter) -> QueryFilter {
+        filter.with.add_components(make_archetype_key<ComponentTypes...>());
+        filter.with_sparse.add_components(make_sparse_key<ComponentTypes...>());
+        return filter;
+    }
+
+    [[nodiscard]] auto calc_version() const -> std::uint64_t;
+    auto rebuild() const -> void;
+
+    const ArchetypeQueryContext context;
+    const Hierarchy& hierarchy;
+    const QueryFilter filter;
+    std::vector<ComponentTypeId> component_ids;
+    std::pmr::memory_resource* memory_resource;
+
+    mutable std::optional<Levels> cache;
+    mutable std::uint64_t last_cache_version{};
+    mutable std::uint64_t num_rebuilds = 0;
+
+    // Scratch of rebuild, kept to reuse the allocations. row_of is indexed by entity, and only the
+    // entries of the gathered rows are set.
+    mutable std::pmr::vector<Row> rows{memory_resource};
+    mutable std::pmr::vector<std::uint32_t> row_of{memory_resource};
+    mutable std::pmr::vector<std::uint32_t> order{memory_resource};
+};
+
+template <AllTypeOfComponent... ComponentTypes>
+auto HierarchyQuery<ComponentTypes...>::calc_version() const -> std::uint64_t {
+    std::uint64_t cumsum = hierarchy.get_version();
+    for (const auto component_id : component_ids) {
+        cumsum += context.versions.get(component_id);
+    }
+    return cumsum;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto HierarchyQuery<ComponentTypes...>::get() const -> const Levels& {
+    const auto version = calc_version();
+    if (!cache.has_value() || version != last_cache_version) {
+        rebuild();
+        last_cache_version = version;
+        num_rebuilds++;
+    }
+
+    return *cache;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+auto HierarchyQuery<ComponentTypes...>::rebuild() const -> void {
+    for (const auto& row : rows) {
+        row_of[row.entity] = NO_ROW;
+    }
+    rows.clear();
+
+    // Gathers the matching entities in archetype order, the order they are visited in is only
+    // decided once every entity which can be a parent is known.
+    const auto needs_sparse_join = !filter.with_sparse.empty() || !filter.without_sparse.empty();
+    for (const auto archetype_id :
+         filter_archetypes(context.archetypes, filter.with, filter.without)) {
+        const auto& archetype = *context.archetypes.at(archetype_id);
+        const auto& entities = archetype.get_entities();
+        for (std::size_t index = 0; index < entities.size(); ++index) {
+            const auto entity = entities[index];
+            if (needs_sparse_join
+                && !context.sparse_sets
+                        .matches(entity, filter.with_sparse, filter.without_sparse)) {
+                continue;
+            }
+
+            if (row_of.size() <= entity) {
+                row_of.resize(static_cast<std::size_t>(entity) + 1, NO_ROW);
+            }
+            row_of[entity] = static_cast<std::uint32_t>(rows.size());
+            rows.emplace_back(Row{
+                .entity = entity,
+                .archetype = &archetype,
+                .index = index,
+                .components = archetype.template get_row<ComponentTypes...>(
+                    index,
+                    context.sparse_sets
+                ),
+            });
+        }
+    }
+    const auto find_row = [this](const Entity entity) {
+        return entity < row_of.size() ? row_of[entity] : NO_ROW;
+    };
+
+    if (!cache.has_value()) {
+        cache.emplace(memory_resource);
+    }
+    auto& levels = *cache;
+    levels.components.clear();
+    levels.parent_indices.clear();
+    levels.level_offsets.clear();
+    levels.rows.clear();
+
+    // The order of the rows visited so far, levels.components mirrors it.
+    order.clear();
+    order.reserve(rows.size());
+    const auto visit = [&](const std::uint32_t row, const std::uint32_t parent_index) {
+        order.emplace_back(row);
+        levels.components.emplace_back(rows[row].components);
+        levels.parent_indices.emplace_back(parent_index);
+        levels.rows.emplace_back(rows[row].archetype, rows[row].index);
+    };
+
+    for (std::uint32_t row = 0; row < rows.size(); ++row) {
+        const auto parent = hierarchy.get_parent(rows[row].entity);
+        if (parent == NO_PARENT || find_row(parent) == NO_ROW) {
+            visit(row, Levels::NO_PARENT_INDEX);
+        }
+    }
+
+    std::size_t level_begin = 0;
+    while (level_begin < order.size()) {
+        const auto level_end = order.size();
+        levels.level_offsets.emplace_back(level_begin);
+
+        for (auto index = level_begin; index < level_end; ++index) {
+            for (const auto child : hierarchy.get_children(rows[order[index]].entity)) {
+                if (const auto row = find_row(child); row != NO_ROW) {
+                    visit(row, static_cast<std::uint32_t>(index));
+                }
+            }
+        }
+
+        level_begin = level_end;
+    }
+    levels.level_offsets.emplace_back(order.size());
+}
+} // namespace atlas::hephaestus
@@ -1,18 +1,81 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory_resource>
 #include <optional>
+#include <span>
+#include <vector>
 
+#include "hephaestus/Archetype.hpp"
 #include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/ComponentVersions.hpp"
 #include "hephaestus/Concepts.hpp"
+#include "hephaestus/SparseSet.hpp"
+#include "hephaestus/Stats.hpp"
 #include "hephaestus/query/ArchetypeQueryContext.hpp"
 #include "hephaestus/query/QueryComponentsPipeline.hpp"
+#include "hephaestus/query/QueryFilters.hpp"
 
 namespace atlas::hephaestus {
+// Calls func(index) for every set bit of the words in [first_word, last_word), index counting bits
+// from the start of words. Chunks of 64 disabled entities are skipped with a single comparison, see
+// Query::get_enabled.
+template <typename Func>
+inline auto for_each_enabled(
+    const std::span<const std::uint64_t> words,
+    const std::size_t first_word,
+    const std::size_t last_word,
+    Func&& func
+) -> void {
+    constexpr auto WORD_BITS = Archetype::MASK_WORD_BITS;
+    for (auto word = first_word; word < last_word; ++word) {
+        auto bits = words[word];
+        const auto base = word * WORD_BITS;
+        if (bits == ~std::uint64_t{0}) {
+            for (std::size_t bit = 0; bit < WORD_BITS; ++bit) {
+                func(base + bit);
+            }
+            continue;
+        }
+
+        while (bits != 0) {
+            func(base + static_cast<std::size_t>(std::countr_zero(bits)));
+            bits &= bits - 1;
+        }
+    }
+}
+
 template <AllTypeOfComponent... ComponentTypes>
 class Query final {
   public:
-    Query(const ArchetypeMap& archetypes, std::vector<SystemDependencies> dependencies)
-        : context{archetypes, std::move(dependencies)} {}
+    Query(
+        const ArchetypeMap& archetypes,
+        const SparseSets& sparse_sets,
+        const ComponentVersions& versions,
+        std::pmr::memory_resource* memory_resource,
+        std::vector<SystemDependencies> dependencies,
+        const QueryFilter& filter = {}
+    )
+        : context{archetypes, sparse_sets, versions, std::move(dependencies)}
+        , filter{make_filter(filter)}
+        , memory_resource{memory_resource}
+        , row_spans{memory_resource}
+        , enabled{memory_resource} {
+        // Every entity the query matches has all the components of the with keys, so their
+        // versions are enough to detect structural changes. Sparse components are added and
+        // removed without the entity changing archetype, which is why the versions of the
+        // excluded sparse components are needed as well.
+        auto versioned_key = this->filter.with;
+        versioned_key.add_components(this->filter.with_sparse)
+            .add_components(this->filter.without_sparse);
+        versioned_key.for_each_component([this](const std::size_t component_id) {
+            component_ids.emplace_back(static_cast<ComponentTypeId>(component_id));
+        });
+    }
 
     Query(const Query&) = delete;
     auto operator=(const Query&) = delete;
@@ -23,20 +86,75 @@ class Query final {
     ~Query() = default;
 
   private:
-    using ComponentsVector = std::vector<std::tuple<ComponentTypes&...>>;
+    using ComponentsVector = std::pmr::vector<std::tuple<ComponentTypes&...>>;
 
   public:
     [[nodiscard]]
     inline auto get() const -> ComponentsVector&;
 
+    // One bit per tuple returned by get, in the same order, clear for disabled entities. Empty when
+    // none of the entities is disabled, which is the common case. Refreshed by get, toggling
+    // entities only refreshes the bits and leaves the cached tuples alone.
+    [[nodiscard]] auto get_enabled() const -> std::span<const std::uint64_t> {
+        return enabled;
+    }
+
+    // Everything but the system index. Must not be called while the query is being rebuilt.
+    [[nodiscard]] inline auto collect_stats() const -> QueryStats;
+
   private:
     [[nodiscard]] inline auto is_cache_dirty(const std::uint64_t& cumsum_version) const -> bool;
     [[nodiscard]] inline auto calc_components_cumsum_version() const -> std::uint64_t;
+    // The components cumsum, plus the row versions of the source archetypes for group queries.
+    [[nodiscard]] inline auto calc_cache_version() const -> std::uint64_t;
+    inline auto match_archetypes() const -> void;
+
+    // Returns the group owning exactly the components of the query, if the query can be served by
+    // one, see SparseGroup.
+    [[nodiscard]] inline auto find_group() const -> const SparseGroup*;
+    inline auto rebuild_from_group(const SparseGroup& group) const -> void;
+    inline auto rebuild_from_archetypes() const -> void;
+
+    // Records that the next tuple of the cache is the row of the archetype.
+    inline auto add_row_span(const Archetype& archetype, std::size_t row) const -> void;
+    inline auto refresh_enabled(bool is_rebuilt) const -> void;
+
+    // Merges the components of the tuple into the With<...> filters of the system.
+    [[nodiscard]] static auto make_filter(QueryFilter filter) -> QueryFilter {
+        filter.with.add_components(make_archetype_key<ComponentTypes...>());
+        filter.with_sparse.add_components(make_sparse_key<ComponentTypes...>());
+        return filter;
+    }
 
     mutable std::uint64_t last_cache_cumsum_version{};
     mutable std::optional<ComponentsVector> cache;
 
+    // Only rematched when the set of active archetypes has changed, see ArchetypeMap.
+    mutable std::uint64_t matched_generation = std::numeric_limits<std::uint64_t>::max();
+    mutable std::vector<ArchetypeId> matched_archetypes;
+
+    mutable std::uint64_t num_rebuilds = 0;
+    mutable std::uint64_t num_rematches = 0;
+    mutable bool uses_group = false;
+
     const ArchetypeQueryContext context;
+    const QueryFilter filter;
+    std::vector<ComponentTypeId> component_ids;
+    std::pmr::memory_resource* memory_resource;
+
+    // Tuple begin + i of the cache is row first_row + i of the archetype. Archetype rows map to a
+    // single span, sparse joins and groups break them up.
+    struct RowSpan {
+        std::size_t begin;
+        std::size_t end;
+        const Archetype* archetype;
+        std::size_t first_row;
+    };
+    mutable std::pmr::vector<RowSpan> row_spans;
+    // The distinct archetypes of the spans.
+    mutable std::vector<const Archetype*> sources;
+    mutable std::pmr::vector<std::uint64_t> enabled;
+    mutable std::uint64_t last_enabled_version = 0;
 };
 
 template <AllTypeOfComponent... ComponentTypes>
@@ -58,23 +176,205 @@ template <AllTypeOfComponent... ComponentTypes>
 template <AllTypeOfComponent... ComponentTypes>
 [[nodiscard]] inline auto Query<ComponentTypes...>::calc_components_cumsum_version() const
     -> std::uint64_t {
-    return (0ULL + ... + Component<ComponentTypes>::get_version());
+    std::uint64_t cumsum = 0;
+    for (const auto component_id : component_ids) {
+        cumsum += context.versions.get(component_id);
+    }
+    return cumsum;
 }
 
 template <AllTypeOfComponent... ComponentTypes>
-[[nodiscard]] inline auto Query<ComponentTypes...>::get() const -> ComponentsVector& {
-    const auto cumsum_version = calc_components_cumsum_version();
-    if (is_cache_dirty(cumsum_version)) {
-        auto pipeline = build_pipeline<ComponentTypes...>(context.archetypes);
+[[nodiscard]] inline auto Query<ComponentTypes...>::calc_cache_version() const -> std::uint64_t {
+    auto version = calc_components_cumsum_version();
+    // Groups are only versioned on their sparse components. Entities outside of the group moving
+    // the rows of the grouped ones around in their archetypes only bump the versions of the keys.
+    if (uses_group) {
+        for (const auto* archetype : sources) {
+            version += archetype->get_row_version();
+        }
+    }
+    return version;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+inline auto Query<ComponentTypes...>::match_archetypes() const -> void {
+    const auto generation = context.archetypes.get_generation();
+    if (generation == matched_generation) {
+        return;
+    }
+
+    matched_archetypes.clear();
+    std::ranges::copy(
+        filter_archetypes(context.archetypes, filter.with, filter.without),
+        std::back_inserter(matched_archetypes)
+    );
+    matched_generation = generation;
+    num_rematches++;
+}
 
-        // We evaluate the pipeline and collect it into a vector.
+template <AllTypeOfComponent... ComponentTypes>
+[[nodiscard]] inline auto Query<ComponentTypes...>::collect_stats() const -> QueryStats {
+    return QueryStats{
+        .num_matched_archetypes = matched_archetypes.size(),
+        .num_cached = cache.has_value() ? cache->size() : 0,
+        .cache_bytes_reserved = cache.has_value()
+                                    ? cache->capacity() * sizeof(std::tuple<ComponentTypes&...>)
+                                    : 0,
+        .num_rebuilds = num_rebuilds,
+        .num_rematches = num_rematches,
+        .uses_group = uses_group,
+    };
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+[[nodiscard]] inline auto Query<ComponentTypes...>::find_group() const -> const SparseGroup* {
+    if constexpr (sizeof...(ComponentTypes) > 1 && (TypeOfSparseComponent<ComponentTypes> && ...)) {
+        // Archetype filters and excluded sparse components would need a join, which is exactly
+        // what the group is meant to avoid.
+        if (filter.with.empty() && filter.without.empty() && filter.without_sparse.empty()) {
+            return context.sparse_sets.find_group(filter.with_sparse);
+        }
+    }
+
+    return nullptr;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+inline auto Query<ComponentTypes...>::rebuild_from_group(const SparseGroup& group) const -> void {
+    if constexpr (sizeof...(ComponentTypes) > 1 && (TypeOfSparseComponent<ComponentTypes> && ...)) {
+        // The group keeps its entities packed at the front of every owned set, in the same order.
+        using FirstType = std::tuple_element_t<0, std::tuple<ComponentTypes...>>;
+        const auto& entities = context.sparse_sets.template get<FirstType>().get_entities();
+        for (std::size_t index = 0; index < group.size(); ++index) {
+            const auto& archetype = *context.archetypes.at(
+                context.archetypes.find_location(entities[index])
+            );
+            add_row_span(archetype, archetype.get_row_index(entities[index]));
+            cache->emplace_back(
+                context.sparse_sets.template get<ComponentTypes>().get_components()[index]...
+            );
+        }
+    }
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+inline auto Query<ComponentTypes...>::rebuild_from_archetypes() const -> void {
+    match_archetypes();
+
+    // The archetypes are matched on their keys beforehand, the rows of the matching archetypes are
+    // joined with the sparse set membership of the entities.
+    for (const auto archetype_id : matched_archetypes) {
+        const auto& archetype = *context.archetypes.at(archetype_id);
+        for (const auto row : archetype.get_matching_rows(
+                 context.sparse_sets,
+                 filter.with_sparse,
+                 filter.without_sparse
+             )) {
+            add_row_span(archetype, row);
+            cache->emplace_back(
+                archetype.template get_row<ComponentTypes...>(row, context.sparse_sets)
+            );
+        }
+    }
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+inline auto Query<ComponentTypes...>::add_row_span(
+    const Archetype& archetype,
+    const std::size_t row
+) const -> void {
+    const auto index = cache->size();
+    if (!row_spans.empty()) {
+        auto& span = row_spans.back();
+        if (span.archetype == &archetype && span.first_row + (span.end - span.begin) == row) {
+            span.end++;
+            return;
+        }
+    }
+
+    row_spans.emplace_back(
+        RowSpan{.begin = index, .end = index + 1, .archetype = &archetype, .first_row = row}
+    );
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+inline auto Query<ComponentTypes...>::refresh_enabled(const bool is_rebuilt) const -> void {
+    std::uint64_t version = 0;
+    std::size_t num_disabled = 0;
+    for (const auto* archetype : sources) {
+        version += archetype->get_enabled_version();
+        num_disabled += archetype->get_num_disabled();
+    }
+
+    if (num_disabled == 0) {
+        enabled.clear();
+        return;
+    }
+    if (!is_rebuilt && !enabled.empty() && version == last_enabled_version) {
+        return;
+    }
+
+    // Copies the bits of the rows into the order of the cache, 64 rows at a time.
+    constexpr auto WORD_BITS = Archetype::MASK_WORD_BITS;
+    enabled.assign((cache->size() + WORD_BITS - 1) / WORD_BITS, 0);
+    for (const auto& span : row_spans) {
+        for (auto offset = std::size_t{0}; offset < span.end - span.begin; offset += WORD_BITS) {
+            const auto count = std::min(WORD_BITS, span.end - span.begin - offset);
+            auto bits = span.archetype->get_enabled_bits(span.first_row + offset);
+            if (count < WORD_BITS) {
+                bits &= (std::uint64_t{1} << count) - 1;
+            }
+
+            const auto index = span.begin + offset;
+            const auto shift = index % WORD_BITS;
+            enabled[index / WORD_BITS] |= bits << shift;
+            if (shift != 0 && shift + count > WORD_BITS) {
+                enabled[(index / WORD_BITS) + 1] |= bits >> (WORD_BITS - shift);
+            }
+        }
+    }
+    last_enabled_version = version;
+}
+
+template <AllTypeOfComponent... ComponentTypes>
+[[nodiscard]] inline auto Query<ComponentTypes...>::get() const -> ComponentsVector& {
+    if (is_cache_dirty(calc_cache_version())) {
+        // We evaluate the query and collect it into a vector.
         // This costs one iteration over the data, but enables size storage and
         // random access. This can be used to chink and parellize the execution
         // of the systems. And should result in better performance and
         // utilization.
-        ComponentsVector comp_vec = std::ranges::to<std::vector>(pipeline);
-        cache.emplace(std::move(comp_vec));
-        last_cache_cumsum_version = cumsum_version;
+        //
+        // The vector is reused between rebuilds, it only allocates when the number of matching
+        // entities grows past its capacity.
+        if (!cache.has_value()) {
+            cache.emplace(memory_resource);
+        }
+        cache->clear();
+        row_spans.clear();
+
+        const auto* group = find_group();
+        uses_group = group != nullptr;
+        if (uses_group) {
+            rebuild_from_group(*group);
+        } else {
+            rebuild_from_archetypes();
+        }
+
+        sources.clear();
+        for (const auto& span : row_spans) {
+            sources.emplace_back(span.archetype);
+        }
+        std::ranges::sort(sources);
+        const auto [first, last] = std::ranges::unique(sources);
+        sources.erase(first, last);
+
+        // Computed once the sources are known.
+        last_cache_cumsum_version = calc_cache_version();
+        num_rebuilds++;
+        refresh_enabled(true);
+    } else {
+        refresh_enabled(false);
     }
 
     return *cache;
@@ -1,32 +1,32 @@
 #pragma once
 
 #include <ranges>
+#include <vector>
 
 #include "hephaestus/ArchetypeMap.hpp"
 #include "hephaestus/Concepts.hpp"
+#include "hephaestus/SparseSet.hpp"
 #include "hephaestus/Utils.hpp"
+#include "hephaestus/query/QueryFilters.hpp"
 
 namespace atlas::hephaestus {
 
-template <AllTypeOfComponent... ComponentTypes>
-auto filter_archetypes(const ArchetypeMap& map) {
-    // Create ArchetypeKey directly from template parameters
-    const auto query_key = make_archetype_key<ComponentTypes...>();
-
-    return map | std::ranges::views::filter([query_key](const auto& pair) {
-               const auto& archetype_key = pair.first;
-               // Check if the query key is a subset of the archetype key
-               return query_key.is_subset_of(archetype_key);
-           });
-}
-
-template <AllTypeOfComponent... ComponentTypes>
-auto build_pipeline(const ArchetypeMap& map) {
-    return filter_archetypes<ComponentTypes...>(map)
-           | std::ranges::views::transform([&](auto const& pair) {
-                 auto& archetype = *pair.second;
-                 return archetype.template get_entity_tuples<ComponentTypes...>();
-             })
-           | std::ranges::views::join;
+// The query keys are precomputed once by the owner of the pipeline (see Query) instead of being
+// rebuilt from the component type ids every time the pipeline is evaluated.
+//
+// Yields the ids of the matching archetypes, retired archetypes are skipped.
+inline auto filter_archetypes(
+    const ArchetypeMap& map,
+    const ArchetypeKey& query_key,
+    const ArchetypeKey& exclude_key = ArchetypeKey{}
+) {
+    return map.get_active_ids()
+           | std::ranges::views::filter([&map, query_key, exclude_key](const ArchetypeId id) {
+                 const auto& archetype_key = map.get_key(id);
+                 // Check if the query key is a subset of the archetype key, and that none of the
+                 // excluded components are present.
+                 return query_key.is_subset_of(archetype_key)
+                        && !exclude_key.intersects_with(archetype_key);
+             });
 }
 } // namespace atlas::hephaestus
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cassert>
+#include <type_traits>
+
+#include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/Concepts.hpp"
+#include "hephaestus/Utils.hpp"
+
+namespace atlas::hephaestus {
+// Filters narrow down which archetypes a system runs on without adding a slot to its tuple, which
+// is mostly useful for tags:
+//
+//   world.create_system<With<Enemy>, Without<Dead>>(
+//       [](const core::IEngine& engine, std::tuple<Position&>& components) { ... }
+//   );
+//
+// Filters don't access any component data and are therefore not part of the system dependencies.
+template <AllTypeOfComponent... ComponentTypes>
+struct With {};
+
+template <AllTypeOfComponent... ComponentTypes>
+struct Without {};
+
+// Sparse components aren't part of the archetype keys, they are matched per entity against the
+// sparse sets instead, see hephaestus/SparseSet.hpp.
+struct QueryFilter {
+    ArchetypeKey with;
+    ArchetypeKey without;
+    ArchetypeKey with_sparse;
+    ArchetypeKey without_sparse;
+
+    [[nodiscard]] auto empty() const -> bool {
+        return with.empty() && without.empty() && with_sparse.empty() && without_sparse.empty();
+    }
+};
+
+template <typename T>
+struct QueryFilterTraits {
+    static_assert(
+        !std::is_same_v<T, T>,
+        "Only With<...> and Without<...> are supported as filters when creating a system."
+    );
+};
+
+template <AllTypeOfComponent... ComponentTypes>
+struct QueryFilterTraits<With<ComponentTypes...>> {
+    static auto apply(QueryFilter& filter) -> void {
+        filter.with.add_components(make_archetype_key<ComponentTypes...>());
+        filter.with_sparse.add_components(make_sparse_key<ComponentTypes...>());
+    }
+};
+
+template <AllTypeOfComponent... ComponentTypes>
+struct QueryFilterTraits<Without<ComponentTypes...>> {
+    static auto apply(QueryFilter& filter) -> void {
+        filter.without.add_components(make_archetype_key<ComponentTypes...>());
+        filter.without_sparse.add_components(make_sparse_key<ComponentTypes...>());
+    }
+};
+
+template <typename... Filters>
+auto make_query_filter() -> QueryFilter {
+    QueryFilter filter;
+    (QueryFilterTraits<Filters>::apply(filter), ...);
+    assert(
+        !filter.with.intersects_with(filter.without)
+        && !filter.with_sparse.intersects_with(filter.without_sparse)
+        && "A component cannot be both required and excluded by the same system."
+    );
+    return filter;
+}
+} // namespace atlas::hephaestus
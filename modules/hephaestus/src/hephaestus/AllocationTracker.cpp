@@ -0,0 +1,313 @@
+#include "hephaestus/AllocationTracker.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <print>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+namespace atlas::hephaestus {
+namespace {
+// Written by a single thread only, atomic so that the frame boundaries can read them.
+struct ThreadCounters {
+    std::array<std::atomic<std::uint64_t>, NUM_ALLOCATION_SCOPES> num_allocations{};
+    std::array<std::atomic<std::uint64_t>, NUM_ALLOCATION_SCOPES> bytes{};
+};
+
+// Static storage and trivial thread locals only, operator new mustn't allocate itself.
+std::array<ThreadCounters, MAX_TRACKED_THREADS> thread_counters;
+std::atomic<std::size_t> num_registered_threads = 0;
+
+constexpr std::size_t UNREGISTERED_THREAD = MAX_TRACKED_THREADS;
+thread_local std::size_t thread_index = UNREGISTERED_THREAD;
+thread_local AllocationScope thread_scope = AllocationScope::Other;
+
+auto get_thread_counters() noexcept -> ThreadCounters& {
+    if (thread_index == UNREGISTERED_THREAD) {
+        thread_index = std::min(
+            num_registered_threads.fetch_add(1, std::memory_order_relaxed),
+            MAX_TRACKED_THREADS - 1
+        );
+    }
+    return thread_counters[thread_index];
+}
+
+auto subtract(const AllocationCounts& lhs, const AllocationCounts& rhs) -> AllocationCounts {
+    return AllocationCounts{
+        .num_allocations = lhs.num_allocations - rhs.num_allocations,
+        .bytes = lhs.bytes - rhs.bytes,
+    };
+}
+
+auto add(AllocationCounts& counts, const std::uint64_t num_allocations, const std::uint64_t bytes)
+    -> void {
+    counts.num_allocations += num_allocations;
+    counts.bytes += bytes;
+}
+} // namespace
+
+auto get_allocation_scope_name(const AllocationScope scope) -> const char* {
+    switch (scope) {
+    case AllocationScope::Other:
+        return "other";
+    case AllocationScope::ModuleTick:
+        return "module tick";
+    case AllocationScope::TaskScheduling:
+        return "task scheduling";
+    case AllocationScope::SystemExecute:
+        return "system execute";
+    case AllocationScope::QueueApplication:
+        return "queue application";
+    case AllocationScope::Maintenance:
+        return "maintenance";
+    }
+    return "unknown";
+}
+
+auto AllocationStats::get(const std::uint32_t scope_mask) const -> AllocationCounts {
+    AllocationCounts counts;
+    for (std::size_t scope = 0; scope < NUM_ALLOCATION_SCOPES; ++scope) {
+        if ((scope_mask & make_scope_mask(static_cast<AllocationScope>(scope))) != 0) {
+            add(counts, per_scope[scope].num_allocations, per_scope[scope].bytes);
+        }
+    }
+    return counts;
+}
+
+auto AllocationTracker::get() -> AllocationTracker& {
+    static AllocationTracker tracker;
+    return tracker;
+}
+
+auto AllocationTracker::record(const std::size_t bytes) noexcept -> void {
+    auto& counters = get_thread_counters();
+    const auto scope = static_cast<std::size_t>(thread_scope);
+    counters.num_allocations[scope].fetch_add(1, std::memory_order_relaxed);
+    counters.bytes[scope].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+auto AllocationTracker::get_scope() noexcept -> AllocationScope {
+    return thread_scope;
+}
+
+auto AllocationTracker::set_scope(const AllocationScope scope) noexcept -> void {
+    thread_scope = scope;
+}
+
+auto AllocationTracker::collect_totals() const -> AllocationStats {
+    AllocationStats stats;
+    stats.frame = num_frames;
+    stats.num_threads = std::min(
+        num_registered_threads.load(std::memory_order_relaxed), MAX_TRACKED_THREADS
+    );
+    for (std::size_t thread = 0; thread < stats.num_threads; ++thread) {
+        for (std::size_t scope = 0; scope < NUM_ALLOCATION_SCOPES; ++scope) {
+            const auto num_allocations = thread_counters[thread].num_allocations[scope].load(
+                std::memory_order_relaxed
+            );
+            const auto bytes = thread_counters[thread].bytes[scope].load(std::memory_order_relaxed);
+            add(stats.per_thread[thread], num_allocations, bytes);
+            add(stats.per_scope[scope], num_allocations, bytes);
+            add(stats.total, num_allocations, bytes);
+        }
+    }
+    return stats;
+}
+
+auto AllocationTracker::begin_frame() -> void {
+    if constexpr (IS_ENABLED) {
+        frame_start = collect_totals();
+    }
+}
+
+auto AllocationTracker::end_frame() -> void {
+    if constexpr (IS_ENABLED) {
+        const auto frame_end = collect_totals();
+
+        last_frame.frame = num_frames;
+        last_frame.num_threads = frame_end.num_threads;
+        last_frame.total = subtract(frame_end.total, frame_start.total);
+        for (std::size_t scope = 0; scope < NUM_ALLOCATION_SCOPES; ++scope) {
+            last_frame.per_scope[scope] = subtract(
+                frame_end.per_scope[scope], frame_start.per_scope[scope]
+            );
+        }
+        for (std::size_t thread = 0; thread < frame_end.num_threads; ++thread) {
+            last_frame.per_thread[thread] = subtract(
+                frame_end.per_thread[thread], frame_start.per_thread[thread]
+            );
+        }
+
+        check_frame();
+        ++num_frames;
+    }
+}
+
+auto AllocationTracker::expect_no_allocations(
+    const std::uint64_t warmup_frames,
+    const std::uint32_t scope_mask
+) -> void {
+    is_expecting_no_allocations = true;
+    first_checked_frame = num_frames + warmup_frames;
+    checked_scopes = scope_mask;
+}
+
+auto AllocationTracker::stop_expecting_no_allocations() -> void {
+    is_expecting_no_allocations = false;
+}
+
+auto AllocationTracker::check_frame() -> void {
+    if (!is_expecting_no_allocations || last_frame.frame < first_checked_frame) {
+        return;
+    }
+
+    const auto counts = last_frame.get(checked_scopes);
+    if (counts.num_allocations == 0) {
+        return;
+    }
+
+    ++num_violations;
+    std::println(
+        stderr,
+        "Frame {} made {} allocation(s) of {} bytes where none were expected:",
+        last_frame.frame,
+        counts.num_allocations,
+        counts.bytes
+    );
+    for (std::size_t scope = 0; scope < NUM_ALLOCATION_SCOPES; ++scope) {
+        std::println(
+            stderr,
+            "  {}: {} allocation(s), {} bytes",
+            get_allocation_scope_name(static_cast<AllocationScope>(scope)),
+            last_frame.per_scope[scope].num_allocations,
+            last_frame.per_scope[scope].bytes
+        );
+    }
+    assert(false && "Allocated in the steady state.");
+}
+} // namespace atlas::hephaestus
+
+#if HEPHAESTUS_TRACK_ALLOCATIONS
+// Replacements of the global allocation functions, the remaining forms of operator new and delete
+// forward to these.
+namespace {
+auto allocate(std::size_t bytes) noexcept -> void* {
+    atlas::hephaestus::AllocationTracker::record(bytes);
+    return std::malloc(bytes == 0 ? 1 : bytes);
+}
+
+auto allocate_aligned(std::size_t bytes, const std::align_val_t alignment) noexcept -> void* {
+    atlas::hephaestus::AllocationTracker::record(bytes);
+    const auto align = static_cast<std::size_t>(alignment);
+#if defined(_WIN32)
+    return _aligned_malloc(bytes == 0 ? 1 : bytes, align);
+#else
+    // aligned_alloc wants a multiple of the alignment.
+    return std::aligned_alloc(align, ((bytes == 0 ? 1 : bytes) + align - 1) / align * align);
+#endif
+}
+
+auto deallocate_aligned(void* pointer) noexcept -> void {
+#if defined(_WIN32)
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+} // namespace
+
+auto operator new(const std::size_t bytes) -> void* {
+    if (auto* pointer = allocate(bytes)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+auto operator new[](const std::size_t bytes) -> void* {
+    return operator new(bytes);
+}
+
+auto operator new(const std::size_t bytes, const std::nothrow_t& /*unused*/) noexcept -> void* {
+    return allocate(bytes);
+}
+
+auto operator new[](const std::size_t bytes, const std::nothrow_t& /*unused*/) noexcept -> void* {
+    return allocate(bytes);
+}
+
+auto operator new(const std::size_t bytes, const std::align_val_t alignment) -> void* {
+    if (auto* pointer = allocate_aligned(bytes, alignment)) {
+        return pointer;
+    }
+    throw std::bad_alloc{};
+}
+
+auto operator new[](const std::size_t bytes, const std::align_val_t alignment) -> void* {
+    return operator new(bytes, alignment);
+}
+
+auto operator new(
+    const std::size_t bytes,
+    const std::align_val_t alignment,
+    const std::nothrow_t& /*unused*/
+) noexcept -> void* {
+    return allocate_aligned(bytes, alignment);
+}
+
+auto operator new[](
+    const std::size_t bytes,
+    const std::align_val_t alignment,
+    const std::nothrow_t& /*unused*/
+) noexcept -> void* {
+    return allocate_aligned(bytes, alignment);
+}
+
+auto operator delete(void* pointer) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete[](void* pointer) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete(void* pointer, const std::size_t /*unused*/) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete[](void* pointer, const std::size_t /*unused*/) noexcept -> void {
+    std::free(pointer);
+}
+
+auto operator delete(void* pointer, const std::align_val_t /*unused*/) noexcept -> void {
+    deallocate_aligned(pointer);
+}
+
+auto operator delete[](void* pointer, const std::align_val_t /*unused*/) noexcept -> void {
+    deallocate_aligned(pointer);
+}
+
+auto operator delete(
+    void* pointer,
+    const std::size_t /*unused*/,
+    const std::align_val_t /*unused*/
+) noexcept -> void {
+    deallocate_aligned(pointer);
+}
+
+auto operator delete[](
+    void* pointer,
+    const std::size_t /*unused*/,
+    const std::align_val_t /*unused*/
+) noexcept -> void {
+    deallocate_aligned(pointer);
+}
+#endif
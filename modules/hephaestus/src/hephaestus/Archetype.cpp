@@ -1,4 +1,9 @@
 #include "hephaestus/Archetype.hpp"
+#include "hephaestus/ComponentCodec.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <functional>
 
 namespace atlas::hephaestus {
 auto Archetype::destroy_entity(Entity entity) -> bool {
@@ -7,22 +12,221 @@ auto Archetype::destroy_entity(Entity entity) -> bool {
         return false;
     }
 
-    const auto last_component_index = component_storages.begin()->second->size() - 1;
-    const auto entity_at_back = component_index_to_ent.at(last_component_index);
+    const auto row = ent_to_component_index.at(entity);
+    for (auto& [component_type_id, storage_ptr] : component_storages) {
+        (*storage_ptr).destroy(row);
+    }
+    pop_row(row);
+
+    return true;
+}
+
+auto Archetype::destroy_rows(const std::span<const std::size_t> rows) -> void {
+    assert(
+        std::ranges::adjacent_find(rows, std::less_equal{}) == rows.end()
+        && "The rows must be unique and sorted from the highest to the lowest."
+    );
 
-    const auto component_index_for_entity = ent_to_component_index.at(entity);
     for (auto& [component_type_id, storage_ptr] : component_storages) {
-        (*storage_ptr).destroy(component_index_for_entity);
+        storage_ptr->destroy_rows(rows);
+    }
+    for (const auto row : rows) {
+        pop_row(row);
+    }
+}
+
+auto Archetype::create_entity(
+    const Entity entity,
+    const std::span<const ComponentCodec* const> codecs,
+    std::span<const std::byte> data
+) -> void {
+    for (const auto* codec : codecs) {
+        assert(codec->size <= data.size() && "Not enough data for the components.");
+        codec->append_column(*this, data.data());
+        data = data.subspan(codec->size);
+    }
+    push_row(entity);
+}
+
+auto Archetype::push_row(const Entity entity) -> void {
+    // The row count is tracked by component_index_to_ent rather than by a column, an archetype made
+    // up of only tags has no columns at all.
+    const auto row = component_index_to_ent.size();
+    if (row % MASK_WORD_BITS == 0) {
+        enabled_mask.emplace_back(0);
+    }
+    enabled_mask.back() |= std::uint64_t{1} << (row % MASK_WORD_BITS);
+
+    ent_to_component_index.emplace(entity, row);
+    component_index_to_ent.emplace_back(entity);
+}
+
+auto Archetype::append_moved_columns(
+    Archetype& source,
+    const std::size_t first_row,
+    const std::size_t count
+) -> void {
+    for (auto& [component_type_id, source_storage] : source.component_storages) {
+        auto& storage = component_storages[component_type_id];
+        if (storage == nullptr) {
+            storage = source_storage->make_empty(memory_resource);
+        }
+        storage->append_moved(*source_storage, first_row, count);
+    }
+}
+
+auto Archetype::push_rows(const Entity first_entity, const std::size_t count) -> void {
+    const auto first_row = component_index_to_ent.size();
+    const auto end_row = first_row + count;
+
+    enabled_mask.resize(get_num_mask_words(end_row), 0);
+    for (auto row = first_row; row < end_row;) {
+        // Sets the bits of the rows up to the end of the word, or the last row, in one go.
+        const auto bit = row % MASK_WORD_BITS;
+        const auto num_bits = std::min(MASK_WORD_BITS - bit, end_row - row);
+        const auto bits = num_bits == MASK_WORD_BITS ? ~std::uint64_t{0}
+                                                     : ((std::uint64_t{1} << num_bits) - 1) << bit;
+        enabled_mask[row / MASK_WORD_BITS] |= bits;
+        row += num_bits;
+    }
+
+    ent_to_component_index.reserve(end_row);
+    component_index_to_ent.reserve(end_row);
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto entity = static_cast<Entity>(first_entity + i);
+        ent_to_component_index.emplace(entity, first_row + i);
+        component_index_to_ent.emplace_back(entity);
+    }
+}
+
+auto Archetype::push_rows(
+    const std::span<const Entity> entities,
+    const std::span<const std::uint64_t> enabled_mask
+) -> void {
+    assert(component_index_to_ent.empty() && "Rows can only be pushed into an empty archetype.");
+    assert(
+        enabled_mask.size() == get_num_mask_words(entities.size())
+        && "The enabled mask must hold a bit per entity."
+    );
+
+    ent_to_component_index.reserve(entities.size());
+    for (std::size_t row = 0; row < entities.size(); ++row) {
+        ent_to_component_index.emplace(entities[row], row);
+    }
+    component_index_to_ent.assign(entities.begin(), entities.end());
+
+    this->enabled_mask.assign(enabled_mask.begin(), enabled_mask.end());
+    // Bits past the last row must stay zero, see get_enabled_bits.
+    if (const auto tail = entities.size() % MASK_WORD_BITS; tail != 0) {
+        this->enabled_mask.back() &= (std::uint64_t{1} << tail) - 1;
     }
 
-    if (entity != entity_at_back) {
-        ent_to_component_index[entity_at_back] = component_index_for_entity;
-        component_index_to_ent[component_index_for_entity] = entity_at_back;
+    std::size_t num_enabled = 0;
+    for (const auto word : this->enabled_mask) {
+        num_enabled += static_cast<std::size_t>(std::popcount(word));
+    }
+    num_disabled = entities.size() - num_enabled;
+    enabled_version++;
+}
+
+auto Archetype::pop_row(const std::size_t row) -> void {
+    const auto last_row = component_index_to_ent.size() - 1;
+    const auto entity = component_index_to_ent[row];
+    const auto entity_at_back = component_index_to_ent[last_row];
+
+    if (!is_enabled(row)) {
+        num_disabled--;
+    }
+
+    if (row != last_row) {
+        ent_to_component_index[entity_at_back] = row;
+        component_index_to_ent[row] = entity_at_back;
+
+        // The last row moves into the hole, and takes its enabled bit with it.
+        const auto bit = std::uint64_t{1} << (row % MASK_WORD_BITS);
+        auto& word = enabled_mask[row / MASK_WORD_BITS];
+        word = is_enabled(last_row) ? (word | bit) : (word & ~bit);
+        row_version++;
+    }
+
+    // Bits past the last row must stay zero, see get_enabled_bits.
+    enabled_mask[last_row / MASK_WORD_BITS] &= ~(std::uint64_t{1} << (last_row % MASK_WORD_BITS));
+    if (last_row % MASK_WORD_BITS == 0) {
+        enabled_mask.pop_back();
     }
 
     ent_to_component_index.erase(entity);
     component_index_to_ent.pop_back();
+}
 
+auto Archetype::set_enabled(const Entity entity, const bool enabled) -> bool {
+    const auto row = get_row_index(entity);
+    if (is_enabled(row) == enabled) {
+        return false;
+    }
+
+    enabled_mask[row / MASK_WORD_BITS] ^= std::uint64_t{1} << (row % MASK_WORD_BITS);
+    if (enabled) {
+        num_disabled--;
+    } else {
+        num_disabled++;
+    }
+    enabled_version++;
     return true;
 }
+
+auto Archetype::get_enabled_bits(const std::size_t row) const -> std::uint64_t {
+    const auto word = row / MASK_WORD_BITS;
+    const auto shift = row % MASK_WORD_BITS;
+    if (word >= enabled_mask.size()) {
+        return 0;
+    }
+
+    auto bits = enabled_mask[word] >> shift;
+    if (shift != 0 && word + 1 < enabled_mask.size()) {
+        bits |= enabled_mask[word + 1] << (MASK_WORD_BITS - shift);
+    }
+    return bits;
+}
+
+auto Archetype::shrink(const std::size_t capacity) -> void {
+    for (auto& [component_type_id, storage_ptr] : component_storages) {
+        storage_ptr->shrink(capacity);
+    }
+
+    detail::shrink_vector(component_index_to_ent, capacity);
+    detail::shrink_vector(enabled_mask, get_num_mask_words(capacity));
+    // Rehashing to zero buckets picks the smallest bucket count which still fits the entities.
+    ent_to_component_index.rehash(0);
+    ent_to_component_index.reserve(capacity);
+}
+
+auto Archetype::collect_stats() const -> ArchetypeStats {
+    // One pointer per bucket, and a node per entity holding the pair and the next pointer.
+    constexpr auto NODE_SIZE = sizeof(std::pair<const Entity, std::size_t>) + sizeof(void*);
+    const auto map_bytes = (ent_to_component_index.bucket_count() * sizeof(void*))
+                           + (ent_to_component_index.size() * NODE_SIZE);
+
+    ArchetypeStats stats{
+        .num_entities = get_num_entities(),
+        .capacity = get_capacity(),
+        .index_bytes = map_bytes + (component_index_to_ent.capacity() * sizeof(Entity))
+                       + (enabled_mask.capacity() * sizeof(std::uint64_t)),
+    };
+
+    stats.columns.reserve(component_storages.size());
+    for (const auto& [component_type_id, storage_ptr] : component_storages) {
+        const auto& column = stats.columns.emplace_back(ColumnStats{
+            .component_id = component_type_id,
+            .element_size = storage_ptr->get_element_size(),
+            .bytes_used = storage_ptr->size() * storage_ptr->get_element_size(),
+            .bytes_reserved = storage_ptr->capacity() * storage_ptr->get_element_size(),
+        });
+        stats.column_bytes_used += column.bytes_used;
+        stats.column_bytes_reserved += column.bytes_reserved;
+    }
+    std::ranges::sort(stats.columns, {}, &ColumnStats::component_id);
+
+    return stats;
+}
 } // namespace atlas::hephaestus
@@ -0,0 +1,194 @@
+#include "hephaestus/ArchetypeMap.hpp"
+#include "hephaestus/Archetype.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace atlas::hephaestus {
+namespace {
+// Keep the index at most half full, probe sequences stay short and the slots are cheap.
+constexpr std::size_t MAX_LOAD_FACTOR_INVERSE = 2;
+constexpr std::size_t MIN_NUM_SLOTS = 16;
+
+auto hash_fragment(const std::size_t hash) -> std::uint32_t {
+    return static_cast<std::uint32_t>(hash >> 32U) ^ static_cast<std::uint32_t>(hash);
+}
+} // namespace
+
+ArchetypeMap::ArchetypeMap() {
+    rehash(MIN_NUM_SLOTS);
+}
+
+ArchetypeMap::~ArchetypeMap() = default;
+
+ArchetypeMap::ArchetypeMap(ArchetypeMap&&) noexcept = default;
+auto ArchetypeMap::operator=(ArchetypeMap&&) noexcept -> ArchetypeMap& = default;
+
+auto ArchetypeMap::reserve(const std::size_t capacity) -> void {
+    entries.reserve(capacity);
+    active_ids.reserve(capacity);
+    active_index.reserve(capacity);
+
+    const auto needed_slots = std::bit_ceil(
+        std::max(MIN_NUM_SLOTS, capacity * MAX_LOAD_FACTOR_INVERSE)
+    );
+    if (needed_slots > slots.size()) {
+        rehash(needed_slots);
+    }
+}
+
+auto ArchetypeMap::emplace(const ArchetypeKey& key, ArchetypePtr archetype)
+    -> std::pair<ArchetypeId, bool> {
+    const auto hash = ArchetypeKeyHash{}(key);
+    auto slot_index = find_slot(key, hash);
+    if (slots[slot_index].id != INVALID_ARCHETYPE_ID) {
+        return {slots[slot_index].id, false};
+    }
+
+    if ((entries.size() + 1) * MAX_LOAD_FACTOR_INVERSE > slots.size()) {
+        rehash(slots.size() * 2);
+        slot_index = find_slot(key, hash);
+    }
+
+    const auto id = static_cast<ArchetypeId>(entries.size());
+    entries.emplace_back(key, std::move(archetype));
+    slots[slot_index] = Slot{.hash = hash_fragment(hash), .id = id};
+
+    active_index.emplace_back(static_cast<ArchetypeId>(active_ids.size()));
+    active_ids.emplace_back(id);
+    generation++;
+
+    return {id, true};
+}
+
+auto ArchetypeMap::operator[](const ArchetypeKey& key) -> ArchetypePtr& {
+    const auto [id, inserted] = emplace(key, nullptr);
+    return entries[id].second;
+}
+
+auto ArchetypeMap::find_id(const ArchetypeKey& key) const -> ArchetypeId {
+    return slots[find_slot(key, ArchetypeKeyHash{}(key))].id;
+}
+
+auto ArchetypeMap::retire(const ArchetypeId id) -> void {
+    if (is_retired(id)) {
+        return;
+    }
+
+    const auto index = active_index[id];
+    const auto last_id = active_ids.back();
+    active_ids[index] = last_id;
+    active_index[last_id] = index;
+
+    active_ids.pop_back();
+    active_index[id] = INVALID_ARCHETYPE_ID;
+    generation++;
+}
+
+auto ArchetypeMap::revive(const ArchetypeId id) -> void {
+    if (!is_retired(id)) {
+        return;
+    }
+
+    active_index[id] = static_cast<ArchetypeId>(active_ids.size());
+    active_ids.emplace_back(id);
+    generation++;
+}
+
+auto ArchetypeMap::reserve_locations(const std::size_t first_entity, const std::size_t num_entities)
+    -> void {
+    if (first_entity >= num_entities) {
+        return;
+    }
+
+    const auto last_page = (num_entities - 1) / LOCATION_PAGE_SIZE;
+    if (location_pages.size() <= last_page) {
+        location_pages.resize(last_page + 1);
+    }
+    for (auto page = first_entity / LOCATION_PAGE_SIZE; page <= last_page; ++page) {
+        if (location_pages[page] != nullptr) {
+            continue;
+        }
+
+        location_pages[page] = spare_location_page != nullptr
+                                   ? std::move(spare_location_page)
+                                   : std::make_unique<LocationPage>();
+        location_pages[page]->ids.fill(INVALID_ARCHETYPE_ID);
+        location_pages[page]->num_located.store(0, std::memory_order_relaxed);
+    }
+}
+
+auto ArchetypeMap::set_location(const Entity entity, const ArchetypeId id) -> void {
+    assert(id != INVALID_ARCHETYPE_ID && "Use erase_location to remove an entity.");
+    reserve_locations(entity, static_cast<std::size_t>(entity) + 1);
+
+    auto& page = *location_pages[entity / LOCATION_PAGE_SIZE];
+    auto& location = page.ids[entity % LOCATION_PAGE_SIZE];
+    if (location == INVALID_ARCHETYPE_ID) {
+        page.num_located.fetch_add(1, std::memory_order_relaxed);
+    }
+    location = id;
+}
+
+auto ArchetypeMap::erase_location(const Entity entity) -> void {
+    const auto page_index = entity / LOCATION_PAGE_SIZE;
+    if (page_index >= location_pages.size() || location_pages[page_index] == nullptr) {
+        return;
+    }
+
+    auto& page = location_pages[page_index];
+    auto& location = page->ids[entity % LOCATION_PAGE_SIZE];
+    if (location == INVALID_ARCHETYPE_ID) {
+        return;
+    }
+
+    location = INVALID_ARCHETYPE_ID;
+    if (page->num_located.fetch_sub(1, std::memory_order_relaxed) == 1) {
+        spare_location_page = std::move(page);
+    }
+}
+
+auto ArchetypeMap::get_location_bytes() const -> std::size_t {
+    const auto num_pages = std::ranges::count_if(location_pages, [](const auto& page) {
+        return page != nullptr;
+    });
+
+    const auto num_spare = spare_location_page != nullptr ? 1 : 0;
+    return (static_cast<std::size_t>(num_pages + num_spare) * sizeof(LocationPage))
+           + (location_pages.capacity() * sizeof(std::unique_ptr<LocationPage>));
+}
+
+// Returns the slot holding the key, or the empty slot where it would be inserted.
+auto ArchetypeMap::find_slot(const ArchetypeKey& key, const std::size_t hash) const
+    -> std::size_t {
+    const auto mask = slots.size() - 1;
+    const auto fragment = hash_fragment(hash);
+
+    auto index = hash & mask;
+    while (true) {
+        const auto& slot = slots[index];
+        if (slot.id == INVALID_ARCHETYPE_ID
+            || (slot.hash == fragment && entries[slot.id].first == key)) {
+            return index;
+        }
+
+        index = (index + 1) & mask;
+    }
+}
+
+auto ArchetypeMap::rehash(const std::size_t num_slots) -> void {
+    assert(std::has_single_bit(num_slots) && "The number of slots must be a power of two.");
+
+    slots.assign(num_slots, Slot{});
+    const auto mask = num_slots - 1;
+    for (std::size_t id = 0; id < entries.size(); ++id) {
+        const auto hash = ArchetypeKeyHash{}(entries[id].first);
+
+        auto index = hash & mask;
+        while (slots[index].id != INVALID_ARCHETYPE_ID) {
+            index = (index + 1) & mask;
+        }
+        slots[index] = Slot{.hash = hash_fragment(hash), .id = static_cast<ArchetypeId>(id)};
+    }
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,252 @@
+#include "hephaestus/Checkpoints.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace atlas::hephaestus {
+namespace {
+auto get_structural_version(const ArchetypeKey& key, const ComponentVersions& versions)
+    -> std::uint64_t {
+    std::uint64_t version = 0;
+    key.for_each_component([&version, &versions](const std::size_t component_id) {
+        version += versions.get(static_cast<ComponentTypeId>(component_id));
+    });
+    return version;
+}
+} // namespace
+
+Checkpoints::Checkpoints(const CheckpointSettings& settings)
+    : settings{settings}
+    , frames(settings.num_frames) {
+    assert(settings.num_frames > 0 && "Checkpoints need at least one frame.");
+    assert(settings.chunk_size > 0 && "Checkpoint chunks cannot be empty.");
+}
+
+auto Checkpoints::capture(ArchetypeMap& archetypes, const ComponentVersions& versions) -> void {
+    for (; num_archetypes < archetypes.size(); ++num_archetypes) {
+        const auto archetype_id = static_cast<ArchetypeId>(num_archetypes);
+        const auto& key = archetypes.get_key(archetype_id);
+        const auto chunk_size = [this](const std::size_t element_size) {
+            return std::max<std::size_t>(settings.chunk_size / element_size, 1) * element_size;
+        };
+
+        columns.emplace_back(Column{
+            .archetype_id = archetype_id,
+            .component = ENTITIES,
+            .chunk_size = chunk_size(sizeof(Entity)),
+        });
+        for (std::size_t i = 0; i < components.size(); ++i) {
+            if (key.has_component(components[i].component_id)) {
+                columns.emplace_back(Column{
+                    .archetype_id = archetype_id,
+                    .component = i,
+                    .chunk_size = chunk_size(components[i].element_size),
+                });
+            }
+        }
+    }
+
+    stats = {};
+    const auto* previous = num_kept > 0 ? &frames[get_slot(frame)] : nullptr;
+    ++frame;
+    auto& target = frames[get_slot(frame)];
+    if (num_kept == frames.size()) {
+        // The oldest frame is released once the new one is captured, it's the previous one when
+        // the ring holds a single frame.
+        target.columns.swap(dropped.columns);
+        if (previous == &target) {
+            previous = &dropped;
+        }
+    } else {
+        ++num_kept;
+    }
+
+    target.columns.resize(columns.size());
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+        auto& column = columns[i];
+        auto& archetype = *archetypes.at(column.archetype_id);
+        const auto version =
+            get_structural_version(archetypes.get_key(column.archetype_id), versions);
+        const auto is_unchanged = column.version == version
+                                  && (column.component == ENTITIES
+                                      || !components[column.component].has_writers);
+        const auto* previous_column =
+            previous != nullptr && i < previous->columns.size() ? &previous->columns[i] : nullptr;
+
+        capture_column(
+            get_column_bytes(column, archetype),
+            column.chunk_size,
+            is_unchanged,
+            previous_column,
+            target.columns[i]
+        );
+        column.version = version;
+    }
+    release(dropped);
+}
+
+auto Checkpoints::restore(const std::uint64_t restored_frame, ArchetypeMap& archetypes) -> bool {
+    if (num_kept == 0 || restored_frame > frame || restored_frame < get_oldest_frame()) {
+        return false;
+    }
+
+    const auto& saved = frames[get_slot(restored_frame)];
+    auto is_same_rows = false;
+    for (std::size_t i = 0; i < saved.columns.size(); ++i) {
+        const auto& column = columns[i];
+        const auto& saved_column = saved.columns[i];
+        auto& archetype = *archetypes.at(column.archetype_id);
+
+        if (column.component == ENTITIES) {
+            saved_entities.resize(saved_column.size / sizeof(Entity));
+            auto* out = reinterpret_cast<std::byte*>(saved_entities.data());
+            for (const auto chunk : saved_column.chunks) {
+                out = std::ranges::copy(chunks[chunk].data, out).out;
+            }
+
+            // Without structural changes in between the rows line up, and the columns are copied
+            // back whole.
+            is_same_rows = std::ranges::equal(saved_entities, archetype.get_entities());
+            if (!is_same_rows) {
+                restored_rows.clear();
+                for (std::size_t row = 0; row < saved_entities.size(); ++row) {
+                    const auto entity = saved_entities[row];
+                    if (archetype.contains(entity)) {
+                        restored_rows.emplace_back(row, archetype.get_row_index(entity));
+                    }
+                }
+            }
+            continue;
+        }
+
+        if (saved_column.size == 0) {
+            continue;
+        }
+
+        const auto& component = components[column.component];
+        const auto bytes = component.get_bytes(archetype);
+        if (is_same_rows) {
+            assert(bytes.size() == saved_column.size && "The rows of the column have changed.");
+            auto* out = bytes.data();
+            for (const auto chunk : saved_column.chunks) {
+                out = std::ranges::copy(chunks[chunk].data, out).out;
+            }
+        } else {
+            restore_rows(saved_column, component.element_size, column.chunk_size, bytes);
+        }
+    }
+
+    // The newer frames are resimulated from the restored one.
+    for (; frame > restored_frame; --frame) {
+        release(frames[get_slot(frame)]);
+        --num_kept;
+    }
+
+    // The columns differ from what the versions say about them, they are compared with the
+    // restored frame by the next checkpoint.
+    for (auto& column : columns) {
+        column.version.reset();
+    }
+    return true;
+}
+
+auto Checkpoints::capture_column(
+    const std::span<const std::byte> bytes,
+    const std::size_t chunk_size,
+    const bool is_unchanged,
+    const ColumnFrame* previous,
+    ColumnFrame& target
+) -> void {
+    assert(
+        (!is_unchanged || previous == nullptr || previous->size == bytes.size())
+        && "The column changed without a structural change."
+    );
+
+    target.size = bytes.size();
+    target.chunks.clear();
+    for (std::size_t offset = 0; offset < bytes.size(); offset += chunk_size) {
+        const auto chunk_bytes = bytes.subspan(offset, std::min(chunk_size, bytes.size() - offset));
+        const auto index = offset / chunk_size;
+
+        if (previous != nullptr && index < previous->chunks.size()) {
+            const auto previous_chunk = previous->chunks[index];
+            const auto& data = chunks[previous_chunk].data;
+            if (is_unchanged
+                || (data.size() == chunk_bytes.size()
+                    && std::memcmp(data.data(), chunk_bytes.data(), data.size()) == 0)) {
+                ++chunks[previous_chunk].num_refs;
+                target.chunks.emplace_back(previous_chunk);
+                stats.shared_bytes += chunk_bytes.size();
+                continue;
+            }
+        }
+
+        target.chunks.emplace_back(copy_chunk(chunk_bytes));
+    }
+}
+
+auto Checkpoints::restore_rows(
+    const ColumnFrame& saved,
+    const std::size_t element_size,
+    const std::size_t chunk_size,
+    const std::span<std::byte> bytes
+) -> void {
+    // Chunks hold a whole number of elements, none straddles two of them.
+    for (const auto& [saved_row, row] : restored_rows) {
+        const auto offset = saved_row * element_size;
+        const auto& data = chunks[saved.chunks[offset / chunk_size]].data;
+        std::memcpy(
+            bytes.data() + (row * element_size),
+            data.data() + (offset % chunk_size),
+            element_size
+        );
+    }
+}
+
+auto Checkpoints::copy_chunk(const std::span<const std::byte> bytes) -> std::uint32_t {
+    std::uint32_t index = 0;
+    if (free_chunks.empty()) {
+        index = static_cast<std::uint32_t>(chunks.size());
+        chunks.emplace_back();
+    } else {
+        index = free_chunks.back();
+        free_chunks.pop_back();
+    }
+
+    auto& chunk = chunks[index];
+    chunk.data.assign(bytes.begin(), bytes.end());
+    chunk.num_refs = 1;
+    stats.copied_bytes += bytes.size();
+    return index;
+}
+
+auto Checkpoints::release(Frame& target) -> void {
+    for (auto& column : target.columns) {
+        for (const auto chunk : column.chunks) {
+            if (--chunks[chunk].num_refs == 0) {
+                free_chunks.emplace_back(chunk);
+            }
+        }
+        column.chunks.clear();
+        column.size = 0;
+    }
+}
+
+auto Checkpoints::get_slot(const std::uint64_t saved_frame) const -> std::size_t {
+    return static_cast<std::size_t>(saved_frame % frames.size());
+}
+
+auto Checkpoints::get_column_bytes(const Column& column, Archetype& archetype) const
+    -> std::span<const std::byte> {
+    if (column.component == ENTITIES) {
+        return std::as_bytes(std::span{archetype.get_entities()});
+    }
+
+    const auto& component = components[column.component];
+    if (!archetype.has_column(component.component_id)) {
+        return {};
+    }
+    return component.get_bytes(archetype);
+}
+} // namespace atlas::hephaestus
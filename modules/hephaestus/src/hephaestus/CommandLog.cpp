@@ -0,0 +1,608 @@
+#include "hephaestus/CommandLog.hpp"
+#include "core/IEngine.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
+#include "hephaestus/Hierarchy.hpp"
+#include "hephaestus/World.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <tuple>
+
+namespace atlas::hephaestus {
+namespace {
+constexpr std::array<char, 8> MAGIC = {'A', 'T', 'L', 'S', 'C', 'M', 'D', 'S'};
+constexpr auto NO_ARCHETYPE = std::numeric_limits<std::size_t>::max();
+// Destroyed by the commands being validated, which may destroy it more than once.
+constexpr auto DESTROYED_IN_SECTION = NO_ARCHETYPE - 1;
+constexpr auto UNMAPPED_ENTITY = std::numeric_limits<Entity>::max();
+constexpr auto UNDECLARED = std::numeric_limits<std::uint64_t>::max();
+
+constexpr std::uint8_t VARINT_PAYLOAD_BITS = 7;
+constexpr std::uint8_t VARINT_PAYLOAD_MASK = 0x7F;
+constexpr std::uint8_t VARINT_CONTINUE = 0x80;
+
+auto write_bytes(std::vector<std::byte>& buffer, const void* data, const std::size_t size)
+    -> void {
+    const auto* bytes = static_cast<const std::byte*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+}
+
+auto write_varint(std::vector<std::byte>& buffer, std::uint64_t value) -> void {
+    while (value >= VARINT_CONTINUE) {
+        const auto payload = value & VARINT_PAYLOAD_MASK;
+        buffer.emplace_back(static_cast<std::byte>(payload | VARINT_CONTINUE));
+        value >>= VARINT_PAYLOAD_BITS;
+    }
+    buffer.emplace_back(static_cast<std::byte>(value));
+}
+
+auto write_type(std::vector<std::byte>& buffer, const CommandType type) -> void {
+    buffer.emplace_back(static_cast<std::byte>(type));
+}
+
+auto read_bytes(std::span<const std::byte>& data, const std::size_t size)
+    -> std::expected<std::span<const std::byte>, CommandLogErrorCode> {
+    if (data.size() < size) {
+        return std::unexpected(CommandLogErrorCode::Truncated);
+    }
+
+    const auto bytes = data.first(size);
+    data = data.subspan(size);
+    return bytes;
+}
+
+auto read_varint(std::span<const std::byte>& data)
+    -> std::expected<std::uint64_t, CommandLogErrorCode> {
+    std::uint64_t value = 0;
+    for (std::uint32_t shift = 0; shift < std::numeric_limits<std::uint64_t>::digits;
+         shift += VARINT_PAYLOAD_BITS) {
+        if (data.empty()) {
+            return std::unexpected(CommandLogErrorCode::Truncated);
+        }
+
+        const auto byte = std::to_integer<std::uint8_t>(data.front());
+        data = data.subspan(1);
+        value |= static_cast<std::uint64_t>(byte & VARINT_PAYLOAD_MASK) << shift;
+        if ((byte & VARINT_CONTINUE) == 0) {
+            return value;
+        }
+    }
+    return std::unexpected(CommandLogErrorCode::NotACommandLog);
+}
+
+auto read_type(std::span<const std::byte>& data)
+    -> std::expected<CommandType, CommandLogErrorCode> {
+    const auto byte = read_bytes(data, 1);
+    if (!byte) {
+        return std::unexpected(byte.error());
+    }
+    return static_cast<CommandType>(byte->front());
+}
+} // namespace
+
+CommandRecorder::CommandRecorder(std::ostream& stream, const double fixed_delta_time)
+    : stream{stream} {
+    std::vector<std::byte> header;
+    write_bytes(header, MAGIC.data(), MAGIC.size());
+    write_varint(header, COMMAND_LOG_VERSION);
+    write_bytes(header, &fixed_delta_time, sizeof(fixed_delta_time));
+    stream.write(reinterpret_cast<const char*>(header.data()), std::ssize(header));
+}
+
+CommandRecorder::~CommandRecorder() {
+    const std::scoped_lock lock{mutex};
+    assert(frame_start.empty() && "The recorder was destroyed in the middle of a frame.");
+
+    if (!pending_start.empty() || !pending_end.empty()) {
+        write_frame(pending_start, pending_end);
+    }
+    stream.flush();
+}
+
+auto CommandRecorder::record_create(
+    const Entity entity,
+    const std::span<const RawComponent> components
+) -> void {
+    const std::scoped_lock lock{mutex};
+    write_type(pending_start, CommandType::CreateEntity);
+    write_varint(pending_start, entity);
+    write_varint(pending_start, components.size());
+    for (const auto& component : components) {
+        write_component(pending_start, component);
+    }
+}
+
+auto CommandRecorder::record_destroy(const Entity entity) -> void {
+    const std::scoped_lock lock{mutex};
+    write_type(pending_end, CommandType::DestroyEntity);
+    write_varint(pending_end, entity);
+}
+
+auto CommandRecorder::record_add_component(const Entity entity, const RawComponent component)
+    -> void {
+    const std::scoped_lock lock{mutex};
+    write_type(pending_start, CommandType::AddComponent);
+    write_varint(pending_start, entity);
+    write_component(pending_start, component);
+}
+
+auto CommandRecorder::record_remove_component(const Entity entity, const ComponentCodec& codec)
+    -> void {
+    const std::scoped_lock lock{mutex};
+    write_type(pending_start, CommandType::RemoveComponent);
+    write_varint(pending_start, entity);
+    write_component(pending_start, RawComponent{.codec = &codec, .data = nullptr});
+}
+
+auto CommandRecorder::record_set_parent(const Entity child, const Entity parent) -> void {
+    const std::scoped_lock lock{mutex};
+    if (parent == NO_PARENT) {
+        write_type(pending_start, CommandType::RemoveParent);
+        write_varint(pending_start, child);
+        return;
+    }
+
+    write_type(pending_start, CommandType::SetParent);
+    write_varint(pending_start, child);
+    write_varint(pending_start, parent);
+}
+
+auto CommandRecorder::record_set_enabled(const Entity entity, const bool enabled) -> void {
+    const std::scoped_lock lock{mutex};
+    write_type(pending_start, CommandType::SetEnabled);
+    write_varint(pending_start, entity);
+    pending_start.emplace_back(static_cast<std::byte>(enabled ? 1 : 0));
+}
+
+auto CommandRecorder::begin_frame() -> void {
+    const std::scoped_lock lock{mutex};
+    assert(frame_start.empty() && "The previous frame has not ended.");
+    frame_start.swap(pending_start);
+}
+
+auto CommandRecorder::end_frame() -> void {
+    const std::scoped_lock lock{mutex};
+    write_frame(frame_start, pending_end);
+    frame_start.clear();
+    pending_end.clear();
+}
+
+auto CommandRecorder::get_num_frames() const -> std::uint64_t {
+    const std::scoped_lock lock{mutex};
+    return num_frames;
+}
+
+// The value is left out when data is nullptr, removals only need the type.
+auto CommandRecorder::write_component(std::vector<std::byte>& buffer, const RawComponent component)
+    -> void {
+    const auto& codec = *component.codec;
+    if (codec.component_id >= component_indices.size()) {
+        component_indices.resize(codec.component_id + 1, UNDECLARED);
+    }
+
+    auto& index = component_indices[codec.component_id];
+    if (index == UNDECLARED) {
+        index = num_declared++;
+
+        const auto name = ComponentRegistry::get().get_type_name(codec.component_id);
+        write_type(declarations, CommandType::DeclareComponent);
+        write_varint(declarations, index);
+        write_varint(declarations, codec.size);
+        declarations.emplace_back(static_cast<std::byte>(codec.is_sparse ? 1 : 0));
+        write_varint(declarations, name.size());
+        write_bytes(declarations, name.data(), name.size());
+    }
+
+    write_varint(buffer, index);
+    if (component.data != nullptr) {
+        assert(
+            codec.is_trivially_copyable && "Only trivially copyable components can be recorded."
+        );
+        write_bytes(buffer, component.data, codec.size);
+    }
+}
+
+auto CommandRecorder::write_frame(
+    const std::span<const std::byte> start,
+    const std::span<const std::byte> end
+) -> void {
+    // The declarations made since the last frame go first, the frame may use them.
+    auto frame = std::move(declarations);
+    declarations.clear();
+    write_type(frame, CommandType::Frame);
+    write_varint(frame, start.size());
+    write_bytes(frame, start.data(), start.size());
+    write_varint(frame, end.size());
+    write_bytes(frame, end.data(), end.size());
+
+    stream.write(reinterpret_cast<const char*>(frame.data()), std::ssize(frame));
+    num_frames++;
+}
+
+auto CommandReplayer::load(const std::filesystem::path& path)
+    -> std::expected<void, CommandLogErrorCode> {
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+        return std::unexpected(CommandLogErrorCode::CannotOpen);
+    }
+    return load(file);
+}
+
+auto CommandReplayer::load(std::istream& stream) -> std::expected<void, CommandLogErrorCode> {
+    log.clear();
+    std::transform(
+        std::istreambuf_iterator<char>{stream},
+        std::istreambuf_iterator<char>{},
+        std::back_inserter(log),
+        [](const char character) { return static_cast<std::byte>(character); }
+    );
+    codecs.clear();
+    frames.clear();
+    archetype_usages.clear();
+    entity_archetypes.clear();
+    section_destroys.clear();
+    recorded_entities.clear();
+
+    std::span<const std::byte> data{log};
+    const auto magic = read_bytes(data, MAGIC.size());
+    if (!magic || std::memcmp(magic->data(), MAGIC.data(), MAGIC.size()) != 0) {
+        return std::unexpected(CommandLogErrorCode::NotACommandLog);
+    }
+
+    const auto version = read_varint(data);
+    if (!version) {
+        return std::unexpected(version.error());
+    }
+    if (*version != COMMAND_LOG_VERSION) {
+        return std::unexpected(CommandLogErrorCode::UnsupportedVersion);
+    }
+
+    const auto delta_time = read_bytes(data, sizeof(fixed_delta_time));
+    if (!delta_time) {
+        return std::unexpected(delta_time.error());
+    }
+    std::memcpy(&fixed_delta_time, delta_time->data(), sizeof(fixed_delta_time));
+
+    while (!data.empty()) {
+        const auto type = read_type(data);
+        if (*type == CommandType::DeclareComponent) {
+            if (const auto declared = parse_declaration(data); !declared) {
+                return declared;
+            }
+            continue;
+        }
+        if (*type != CommandType::Frame) {
+            return std::unexpected(CommandLogErrorCode::NotACommandLog);
+        }
+
+        Frame frame;
+        for (auto* section : {&frame.start, &frame.end}) {
+            const auto size = read_varint(data);
+            if (!size) {
+                return std::unexpected(size.error());
+            }
+            const auto commands = read_bytes(data, *size);
+            if (!commands) {
+                return std::unexpected(commands.error());
+            }
+            *section = *commands;
+        }
+        frames.emplace_back(frame);
+    }
+
+    if (const auto valid = validate_frames(); !valid) {
+        return valid;
+    }
+
+    recorded_entities.reserve(entity_archetypes.size());
+    for (const auto& [recorded, usage] : entity_archetypes) {
+        recorded_entities.emplace_back(recorded);
+    }
+    std::ranges::sort(recorded_entities);
+    entity_archetypes.clear();
+    return {};
+}
+
+auto CommandReplayer::parse_declaration(std::span<const std::byte>& data)
+    -> std::expected<void, CommandLogErrorCode> {
+    const auto index = read_varint(data);
+    if (!index) {
+        return std::unexpected(index.error());
+    }
+    const auto size = read_varint(data);
+    if (!size) {
+        return std::unexpected(size.error());
+    }
+    const auto is_sparse = read_bytes(data, 1);
+    if (!is_sparse) {
+        return std::unexpected(is_sparse.error());
+    }
+    const auto name_size = read_varint(data);
+    if (!name_size) {
+        return std::unexpected(name_size.error());
+    }
+    const auto name = read_bytes(data, *name_size);
+    if (!name) {
+        return std::unexpected(name.error());
+    }
+    if (*index != codecs.size()) {
+        return std::unexpected(CommandLogErrorCode::NotACommandLog);
+    }
+
+    const std::string_view type_name{reinterpret_cast<const char*>(name->data()), name->size()};
+    const auto codec = std::ranges::find_if(registered, [type_name](const ComponentCodec* codec) {
+        return ComponentRegistry::get().get_type_name(codec->component_id) == type_name;
+    });
+    if (codec == registered.end()) {
+        return std::unexpected(CommandLogErrorCode::UnknownComponent);
+    }
+    if ((*codec)->size != *size || (*codec)->is_sparse != (is_sparse->front() != std::byte{0})) {
+        return std::unexpected(CommandLogErrorCode::ComponentSizeMismatch);
+    }
+
+    codecs.emplace_back(*codec);
+    return {};
+}
+
+// The frames are validated in the order the replay issues them, the destroys at the end of a frame
+// may refer to entities created by the systems of that frame, which are part of the next one.
+auto CommandReplayer::validate_frames() -> std::expected<void, CommandLogErrorCode> {
+    if (frames.empty()) {
+        return {};
+    }
+    if (const auto valid = validate(frames.front().start); !valid) {
+        return valid;
+    }
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        if (i + 1 < frames.size()) {
+            if (const auto valid = validate(frames[i + 1].start); !valid) {
+                return valid;
+            }
+        }
+        if (const auto valid = validate(frames[i].end); !valid) {
+            return valid;
+        }
+    }
+    return {};
+}
+
+// Walks the commands once so the replay can trust them, and keeps track of how many entities every
+// archetype holds at most. Every command must refer to entities the log has created before and not
+// destroyed yet, a recording never creates the same handle twice. The destroys of a frame may name
+// an entity more than once, the world only destroys it once.
+auto CommandReplayer::validate(std::span<const std::byte> commands)
+    -> std::expected<void, CommandLogErrorCode> {
+    const auto read_component = [this, &commands](const bool has_value)
+        -> std::expected<const ComponentCodec*, CommandLogErrorCode> {
+        const auto index = read_varint(commands);
+        if (!index) {
+            return std::unexpected(index.error());
+        }
+        if (*index >= codecs.size()) {
+            return std::unexpected(CommandLogErrorCode::NotACommandLog);
+        }
+
+        const auto* codec = codecs[*index];
+        if (has_value) {
+            if (const auto value = read_bytes(commands, codec->size); !value) {
+                return std::unexpected(value.error());
+            }
+        }
+        return codec;
+    };
+    const auto read_entity = [&commands]() -> std::expected<std::uint64_t, CommandLogErrorCode> {
+        const auto entity = read_varint(commands);
+        if (!entity) {
+            return std::unexpected(entity.error());
+        }
+        if (*entity >= UNMAPPED_ENTITY) {
+            return std::unexpected(CommandLogErrorCode::NotACommandLog);
+        }
+        return entity;
+    };
+
+    while (!commands.empty()) {
+        const auto type = read_type(commands);
+        const auto entity = read_entity();
+        if (!entity) {
+            return std::unexpected(entity.error());
+        }
+
+        const auto created = entity_archetypes.find(*entity);
+        if (*type == CommandType::CreateEntity) {
+            if (created != entity_archetypes.end()) {
+                return std::unexpected(CommandLogErrorCode::NotACommandLog);
+            }
+        } else if (created == entity_archetypes.end() || created->second == NO_ARCHETYPE) {
+            return std::unexpected(CommandLogErrorCode::NotACommandLog);
+        } else if (created->second == DESTROYED_IN_SECTION && *type != CommandType::DestroyEntity) {
+            return std::unexpected(CommandLogErrorCode::NotACommandLog);
+        }
+
+        switch (*type) {
+        case CommandType::CreateEntity: {
+            const auto num_components = read_varint(commands);
+            if (!num_components) {
+                return std::unexpected(num_components.error());
+            }
+
+            ArchetypeKey signature;
+            for (std::uint64_t i = 0; i < *num_components; ++i) {
+                const auto codec = read_component(true);
+                if (!codec) {
+                    return std::unexpected(codec.error());
+                }
+                if (!(*codec)->is_sparse) {
+                    signature.add_component((*codec)->component_id);
+                }
+            }
+
+            auto usage = std::ranges::find(archetype_usages, signature, &ArchetypeUsage::signature);
+            if (usage == archetype_usages.end()) {
+                usage = archetype_usages.insert(usage, ArchetypeUsage{.signature = signature});
+            }
+            usage->num_live++;
+            usage->peak_live = std::max(usage->peak_live, usage->num_live);
+
+            entity_archetypes.emplace(
+                *entity,
+                static_cast<std::size_t>(std::distance(archetype_usages.begin(), usage))
+            );
+            break;
+        }
+        case CommandType::DestroyEntity:
+            if (created->second != DESTROYED_IN_SECTION) {
+                archetype_usages[created->second].num_live--;
+                created->second = DESTROYED_IN_SECTION;
+                section_destroys.emplace_back(*entity);
+            }
+            break;
+        case CommandType::AddComponent:
+        case CommandType::RemoveComponent: {
+            const auto codec = read_component(*type == CommandType::AddComponent);
+            if (!codec) {
+                return std::unexpected(codec.error());
+            }
+            if (!(*codec)->is_sparse) {
+                return std::unexpected(CommandLogErrorCode::NotACommandLog);
+            }
+            break;
+        }
+        case CommandType::SetParent: {
+            const auto parent = read_entity();
+            if (!parent) {
+                return std::unexpected(parent.error());
+            }
+            const auto created_parent = entity_archetypes.find(*parent);
+            if (created_parent == entity_archetypes.end()
+                || created_parent->second >= DESTROYED_IN_SECTION) {
+                return std::unexpected(CommandLogErrorCode::NotACommandLog);
+            }
+            break;
+        }
+        case CommandType::RemoveParent:
+            break;
+        case CommandType::SetEnabled:
+            if (const auto enabled = read_bytes(commands, 1); !enabled) {
+                return std::unexpected(enabled.error());
+            }
+            break;
+        default:
+            return std::unexpected(CommandLogErrorCode::NotACommandLog);
+        }
+    }
+
+    for (const auto entity : section_destroys) {
+        entity_archetypes[entity] = NO_ARCHETYPE;
+    }
+    section_destroys.clear();
+    return {};
+}
+
+auto CommandReplayer::attach(World& world) -> void {
+    for (const auto& usage : archetype_usages) {
+        world.create_archetype_with_signature(
+            usage.signature,
+            static_cast<std::uint32_t>(std::max<std::size_t>(usage.peak_live, 1))
+        );
+    }
+
+    entities.assign(recorded_entities.size(), UNMAPPED_ENTITY);
+    num_replayed_frames = 0;
+    if (!frames.empty()) {
+        issue(world, frames.front().start);
+    }
+
+    world.create_system([this, &world](const core::IEngine& engine, std::tuple<> components) {
+        replay_frame(world);
+    });
+}
+
+auto CommandReplayer::replay_frame(World& world) -> void {
+    if (is_finished()) {
+        return;
+    }
+
+    // The next frame goes first, the destroys of this one may refer to entities created in it,
+    // which are only destroyed once they exist, same as in the recording.
+    if (num_replayed_frames + 1 < frames.size()) {
+        issue(world, frames[num_replayed_frames + 1].start);
+    }
+    issue(world, frames[num_replayed_frames].end);
+    num_replayed_frames++;
+}
+
+// The commands have been validated by load.
+auto CommandReplayer::issue(World& world, std::span<const std::byte> commands) -> void {
+    const auto read_component = [this, &commands](const bool has_value) {
+        const auto* codec = codecs[*read_varint(commands)];
+        return RawComponent{
+            .codec = codec,
+            .data = has_value ? read_bytes(commands, codec->size)->data() : nullptr,
+        };
+    };
+
+    while (!commands.empty()) {
+        const auto type = *read_type(commands);
+        const auto recorded = *read_varint(commands);
+
+        switch (type) {
+        case CommandType::CreateEntity: {
+            const auto num_components = *read_varint(commands);
+            scratch.clear();
+            for (std::uint64_t i = 0; i < num_components; ++i) {
+                scratch.emplace_back(read_component(true));
+            }
+
+            entities[find_entity(recorded)] = world.create_entity_raw(scratch);
+            break;
+        }
+        case CommandType::DestroyEntity:
+            world.destroy_entity(map_entity(recorded));
+            break;
+        case CommandType::AddComponent:
+            world.add_component_raw(map_entity(recorded), read_component(true));
+            break;
+        case CommandType::RemoveComponent:
+            world.remove_component_raw(map_entity(recorded), *read_component(false).codec);
+            break;
+        case CommandType::SetParent:
+            world.set_parent(map_entity(recorded), map_entity(*read_varint(commands)));
+            break;
+        case CommandType::RemoveParent:
+            world.remove_parent(map_entity(recorded));
+            break;
+        case CommandType::SetEnabled:
+            world.set_enabled(
+                map_entity(recorded), read_bytes(commands, 1)->front() != std::byte{0}
+            );
+            break;
+        default:
+            assert(false && "Unknown command, the log should have been validated.");
+            return;
+        }
+    }
+}
+
+auto CommandReplayer::find_entity(const std::uint64_t recorded) const -> std::size_t {
+    const auto found = std::ranges::lower_bound(recorded_entities, recorded);
+    assert(
+        found != recorded_entities.end() && *found == recorded
+        && "The command refers to an entity which isn't created by the log."
+    );
+    return static_cast<std::size_t>(std::distance(recorded_entities.begin(), found));
+}
+
+auto CommandReplayer::map_entity(const std::uint64_t recorded) const -> Entity {
+    const auto entity = entities[find_entity(recorded)];
+    assert(
+        entity != UNMAPPED_ENTITY
+        && "The command refers to an entity which hasn't been created by the log yet."
+    );
+    return entity;
+}
+} // namespace atlas::hephaestus
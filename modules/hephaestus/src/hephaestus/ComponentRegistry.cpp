@@ -0,0 +1,48 @@
+#include "hephaestus/ComponentRegistry.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <print>
+
+namespace atlas::hephaestus {
+auto ComponentRegistry::get() -> ComponentRegistry& {
+    static ComponentRegistry registry;
+    return registry;
+}
+
+auto ComponentRegistry::register_type(const std::type_index type) -> ComponentTypeId {
+    const std::scoped_lock lock{mutex};
+
+    if (const auto it = ids.find(type); it != ids.end()) {
+        return it->second;
+    }
+
+    if (types.size() >= MAX_COMPONENT_TYPES) {
+        std::println(
+            stderr,
+            "Hephaestus: Out of component type ids when registering {}, the limit is {}. Increase "
+            "HEPHAESTUS_MAX_COMPONENT_TYPES.",
+            type.name(),
+            MAX_COMPONENT_TYPES
+        );
+        assert(false && "Out of component type ids.");
+        std::abort();
+    }
+
+    const auto id = static_cast<ComponentTypeId>(types.size());
+    ids.emplace(type, id);
+    types.emplace_back(type);
+    return id;
+}
+
+auto ComponentRegistry::get_num_registered() const -> std::size_t {
+    const std::scoped_lock lock{mutex};
+    return types.size();
+}
+
+auto ComponentRegistry::get_type_name(const ComponentTypeId id) const -> std::string_view {
+    const std::scoped_lock lock{mutex};
+    assert(id < types.size() && "Trying to get the name of an unregistered component type id.");
+    return types[id].name();
+}
+} // namespace atlas::hephaestus
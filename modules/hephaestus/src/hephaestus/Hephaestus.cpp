@@ -1,10 +1,12 @@
 #include "hephaestus/Hephaestus.hpp"
 #include "core/IEngine.hpp"
+#include "hephaestus/AllocationTracker.hpp"
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
 #include <print>
+#include <utility>
 
 namespace atlas::hephaestus {
 Hephaestus::Hephaestus(core::IEngine& engine)
@@ -15,143 +17,169 @@ Hephaestus::Hephaestus(core::IEngine& engine)
     // This is OK for now, but we should handle this in a centralized way
     // later on to make sure that we don't have too many threads.
     systems_executor(std::thread::hardware_concurrency()) {
-
-    constexpr auto ARCHETYPE_BUFFER_SIZE = 30;
-    archetypes.reserve(ARCHETYPE_BUFFER_SIZE);
-    ent_to_archetype_key.reserve(ARCHETYPE_BUFFER_SIZE);
-
-    constexpr auto QUEUE_BUFFER_SIZE = 100;
-    creation_queue.reserve(QUEUE_BUFFER_SIZE);
-    destroy_queue.reserve(QUEUE_BUFFER_SIZE);
+    create_world();
 }
 
 auto Hephaestus::start() -> void {}
 
 auto Hephaestus::post_start() -> void {
-    build_systems_dependency_graph();
-}
-
-auto Hephaestus::shutdown() -> void {
-    std::println("\nTotal created ents: {}", tot_num_created_ents);
-    std::println("Total destroyed ents: {}", tot_num_destroyed_ents);
-}
+    for (auto& world : worlds) {
+        world->build_graph(worlds.size());
 
-auto Hephaestus::tick() -> void {
-    for (auto& creation : creation_queue) {
-        creation();
+        // The worlds share nothing, so they are added without any dependencies between them
+        // and the executor is free to tick them in parallel.
+        worlds_graph.composed_of(world->get_frame_graph());
     }
-    tot_num_created_ents += creation_queue.size();
-    creation_queue.clear();
+}
 
-    if (!systems_graph.empty()) {
-        systems_executor.run(systems_graph).wait();
+auto Hephaestus::shutdown() -> void {
+    std::println("\nTotal created ents: {}", get_tot_num_created_ents());
+    std::println("Total destroyed ents: {}", get_tot_num_destroyed_ents());
+
+    if (worlds.size() > 1) {
+        for (const auto& world : worlds) {
+            const auto& stats = world->get_stats();
+            std::println(
+                "World {}: created: {}, destroyed: {}, avg tick time: {} ms",
+                world->get_id(),
+                stats.tot_num_created_ents,
+                stats.tot_num_destroyed_ents,
+                stats.num_ticks == 0
+                    ? 0.0
+                    : stats.tot_tick_time / static_cast<double>(stats.num_ticks) * 1000
+            );
+        }
     }
 
-    for (const auto entity : destroy_queue) {
-        assert(
-            ent_to_archetype_key.contains(entity)
-            && "Trying to destroy an entity that doesnt exist!"
+    if constexpr (AllocationTracker::IS_ENABLED) {
+        const auto totals = AllocationTracker::get().collect_totals();
+        std::println(
+            "Allocations: {} ({} bytes) over {} threads",
+            totals.total.num_allocations,
+            totals.total.bytes,
+            totals.num_threads
         );
-
-        auto& archetype = *archetypes.at(ent_to_archetype_key.at(entity));
-        if (archetype.destroy_entity(entity)) {
-            ent_to_archetype_key.erase(entity);
+        for (std::size_t scope = 0; scope < NUM_ALLOCATION_SCOPES; ++scope) {
+            std::println(
+                "  {}: {} ({} bytes)",
+                get_allocation_scope_name(static_cast<AllocationScope>(scope)),
+                totals.per_scope[scope].num_allocations,
+                totals.per_scope[scope].bytes
+            );
         }
     }
-    tot_num_destroyed_ents += destroy_queue.size();
-    destroy_queue.clear();
 }
 
-auto Hephaestus::generate_unique_entity_id() -> Entity {
-    static Entity next_entity_id = 0;
-    return next_entity_id++;
+auto Hephaestus::tick() -> void {
+    auto& allocation_tracker = AllocationTracker::get();
+    allocation_tracker.begin_frame();
+    {
+        const AllocationScopeGuard scope{AllocationScope::ModuleTick};
+        systems_executor.run(worlds_graph).wait();
+    }
+    allocation_tracker.end_frame();
 }
 
-auto Hephaestus::build_systems_dependency_graph() -> void {
+auto Hephaestus::create_world(const AllocatorPolicy& allocator_policy) -> World& {
+    const auto init_status = get_engine().get_engine_init_status();
     assert(
-        system_nodes != std::nullopt
-        && "system_nodes has been reset before the dependency_graph was built."
+        init_status <= core::EngineInitStatus::RunningStart && "Cannot create worlds after start."
     );
 
-    const auto num_nodes = (*system_nodes).size();
-    if (num_nodes == 0) {
-        return;
-    }
+    const auto id = static_cast<WorldId>(worlds.size());
+    return *worlds.emplace_back(std::make_unique<World>(get_engine(), id, allocator_policy));
+}
 
-    std::vector<std::vector<std::size_t>> system_deps(num_nodes);
-    // Very pessimistic guesswork for inner vector capacity, but safe.
-    // Choose a more realistic number if needed.
-    for (std::size_t i = 0; i < num_nodes; ++i) {
-        system_deps[i].reserve(num_nodes);
-    }
+auto Hephaestus::get_world() const -> World& {
+    assert(!worlds.empty() && "The default world has not been created.");
+    return *worlds.front();
+}
 
-    for (auto& node : *system_nodes) {
-        // Note: affected_archetypes no longer needed for conflict detection
-        // Systems still query archetypes individually via their Query objects
-    }
+auto Hephaestus::get_world(const WorldId id) const -> World& {
+    assert(id < worlds.size() && "Trying to get a world that doesn't exist.");
+    return *worlds[id];
+}
 
-    const auto are_nodes_conflicting = [](const SystemNode& node, const SystemNode& other) {
-        // Use const-aware access signature conflict detection
-        return are_dependencies_overlapping(node.dependencies, other.dependencies);
-    };
+auto Hephaestus::get_num_worlds() const -> std::size_t {
+    return worlds.size();
+}
 
-    for (std::size_t i = 0; i < num_nodes; ++i) {
-        auto& node = (*system_nodes)[i];
+auto Hephaestus::create_archetype_with_signature(
+    const ArchetypeKey signature,
+    const std::uint32_t entity_buffer_size
+) -> void {
+    get_world().create_archetype_with_signature(signature, entity_buffer_size);
+}
 
-        for (std::size_t j = i + 1; j < num_nodes; ++j) {
-            auto& other = (*system_nodes)[j];
+auto Hephaestus::destroy_entity(Entity entity) -> void {
+    get_world().destroy_entity(entity);
+}
 
-            if (are_nodes_conflicting(node, other)) {
-                system_deps[i].emplace_back(j);
-                system_deps[j].emplace_back(i);
-            }
-        }
-    }
+auto Hephaestus::set_parent(const Entity child, const Entity parent) -> void {
+    get_world().set_parent(child, parent);
+}
 
-    for (std::size_t i = 0; i < num_nodes; ++i) {
-        const auto conflicts = system_deps[i].size();
-        const auto concurrent = std::max<std::size_t>(1, num_nodes - conflicts);
-        systems[i]->set_concurrent_systems(concurrent);
-    }
+auto Hephaestus::remove_parent(const Entity child) -> void {
+    get_world().remove_parent(child);
+}
 
-    std::vector<tf::Task> tasks(num_nodes);
-    for (std::size_t i = 0; i < num_nodes; ++i) {
-        tasks[i] = systems_graph.emplace([this, i](tf::Subflow& subflow) {
-            systems[i]->execute(get_engine(), subflow);
-        });
-    }
+auto Hephaestus::set_enabled(const Entity entity, const bool enabled) -> void {
+    get_world().set_enabled(entity, enabled);
+}
 
-    for (std::size_t i = 0; i < num_nodes; ++i) {
-        for (std::size_t j : system_deps[i]) {
-            if (i < j) {
-                tasks[i].precede(tasks[j]);
-            }
-        }
-    }
+auto Hephaestus::set_command_recorder(CommandRecorder* recorder) -> void {
+    get_world().set_command_recorder(recorder);
 }
 
-auto Hephaestus::create_archetype_with_signature(
-    const ArchetypeKey signature,
-    const std::uint32_t entity_buffer_size
-) -> void {
-    const auto init_status = get_engine().get_engine_init_status();
-    assert(
-        init_status <= core::EngineInitStatus::RunningStart
-        && "Cannot create new archetypes after start."
-    );
+auto Hephaestus::save_snapshot(const std::filesystem::path& path, const SnapshotSchema& schema)
+    const -> std::expected<void, SnapshotErrorCode> {
+    return get_world().save_snapshot(path, schema);
+}
 
-    archetypes.emplace(signature, std::make_unique<Archetype>(entity_buffer_size));
+auto Hephaestus::load_snapshot(const std::filesystem::path& path, const SnapshotSchema& schema)
+    -> std::expected<void, SnapshotErrorCode> {
+    return get_world().load_snapshot(path, schema);
 }
 
-auto Hephaestus::destroy_entity(Entity entity) -> void {
-    destroy_queue.emplace_back(entity);
+auto Hephaestus::create_streamer(SnapshotSchema schema, const StreamingSettings& settings)
+    -> WorldStreamer& {
+    return get_world().create_streamer(std::move(schema), settings);
+}
+
+auto Hephaestus::restore_checkpoint(const std::uint64_t frame) -> bool {
+    return get_world().restore_checkpoint(frame);
 }
 
 auto Hephaestus::get_tot_num_created_ents() const -> std::uint64_t {
-    return tot_num_created_ents;
+    std::uint64_t total = 0;
+    for (const auto& world : worlds) {
+        total += world->get_stats().tot_num_created_ents;
+    }
+    return total;
+}
+
+auto Hephaestus::get_frame_allocations() const -> const AllocationStats& {
+    return AllocationTracker::get().get_last_frame();
+}
+
+auto Hephaestus::collect_introspection() const -> std::vector<WorldIntrospection> {
+    std::vector<WorldIntrospection> introspection;
+    introspection.reserve(worlds.size());
+    for (const auto& world : worlds) {
+        introspection.emplace_back(world->collect_introspection());
+    }
+    return introspection;
+}
+
+auto Hephaestus::dump_introspection(const std::filesystem::path& path) const -> bool {
+    return dump_introspection_json(path, collect_introspection());
 }
 
 auto Hephaestus::get_tot_num_destroyed_ents() const -> std::uint64_t {
-    return tot_num_destroyed_ents;
+    std::uint64_t total = 0;
+    for (const auto& world : worlds) {
+        total += world->get_stats().tot_num_destroyed_ents;
+    }
+    return total;
 }
 } // namespace atlas::hephaestus
@@ -0,0 +1,118 @@
+#include "hephaestus/Hierarchy.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <utility>
+
+namespace atlas::hephaestus {
+Hierarchy::Hierarchy(std::pmr::memory_resource* memory_resource)
+    : parents{memory_resource}
+    , links{memory_resource}
+    , children{memory_resource}
+    , child_ranges{memory_resource} {}
+
+auto Hierarchy::set_parent(const Entity child, const Entity parent) -> bool {
+    assert(child != NO_PARENT && parent != NO_PARENT && "Invalid entity in the hierarchy.");
+
+    // Walking up from the new parent must never reach the child, or the link would close a cycle.
+    for (auto ancestor = parent; ancestor != NO_PARENT; ancestor = get_parent(ancestor)) {
+        if (ancestor == child) {
+            return false;
+        }
+    }
+
+    if (const auto it = parents.find(child); it != parents.end()) {
+        unlink(child, it->second);
+        it->second = parent;
+    } else {
+        parents.emplace(child, parent);
+    }
+    links.emplace(parent, child);
+
+    is_sorted = false;
+    version++;
+    return true;
+}
+
+auto Hierarchy::remove_parent(const Entity child) -> bool {
+    const auto it = parents.find(child);
+    if (it == parents.end()) {
+        return false;
+    }
+
+    unlink(child, it->second);
+    parents.erase(it);
+
+    is_sorted = false;
+    version++;
+    return true;
+}
+
+auto Hierarchy::remove_entity(const Entity entity) -> bool {
+    const auto is_child = remove_parent(entity);
+
+    const auto [begin, end] = links.equal_range(entity);
+    const auto is_parent = begin != end;
+    for (auto it = begin; it != end; ++it) {
+        parents.erase(it->second);
+    }
+    links.erase(begin, end);
+
+    if (is_parent) {
+        is_sorted = false;
+        version++;
+    }
+
+    return is_child || is_parent;
+}
+
+auto Hierarchy::sort() -> void {
+    if (is_sorted) {
+        return;
+    }
+
+    std::pmr::vector<std::pair<Entity, Entity>> sorted_links{children.get_allocator()};
+    sorted_links.reserve(links.size());
+    std::ranges::copy(links, std::back_inserter(sorted_links));
+    std::ranges::sort(sorted_links);
+
+    children.clear();
+    child_ranges.clear();
+    for (const auto& [parent, child] : sorted_links) {
+        auto& range = child_ranges[parent];
+        if (range.begin == range.end) {
+            range.begin = static_cast<std::uint32_t>(children.size());
+        }
+        children.emplace_back(child);
+        range.end = static_cast<std::uint32_t>(children.size());
+    }
+
+    is_sorted = true;
+}
+
+auto Hierarchy::unlink(const Entity child, const Entity parent) -> void {
+    const auto [begin, end] = links.equal_range(parent);
+    const auto it = std::find_if(begin, end, [child](const auto& link) {
+        return link.second == child;
+    });
+    assert(it != end && "The parent link and the child link are out of sync.");
+    links.erase(it);
+}
+
+auto Hierarchy::get_parent(const Entity child) const -> Entity {
+    const auto it = parents.find(child);
+    return it != parents.end() ? it->second : NO_PARENT;
+}
+
+auto Hierarchy::get_children(const Entity parent) const -> std::span<const Entity> {
+    assert(is_sorted && "The child ranges are stale, call sort after changing the hierarchy.");
+
+    const auto it = child_ranges.find(parent);
+    if (it == child_ranges.end()) {
+        return {};
+    }
+
+    return std::span{children}.subspan(it->second.begin, it->second.end - it->second.begin);
+}
+} // namespace atlas::hephaestus
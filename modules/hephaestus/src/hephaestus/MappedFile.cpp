@@ -0,0 +1,131 @@
+#include "hephaestus/MappedFile.hpp"
+
+#include <fstream>
+#include <iterator>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace atlas::hephaestus {
+namespace {
+// Maps the whole file, returns nullptr if it can't be, empty files included.
+auto map_file(const std::filesystem::path& path, std::size_t& size) -> void* {
+#if defined(_WIN32)
+    auto* file = CreateFileW(
+        path.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr
+    );
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+
+    LARGE_INTEGER file_size{};
+    if (GetFileSizeEx(file, &file_size) == 0 || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    // The view keeps the mapping, and with it the file, alive until it's unmapped.
+    auto* mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) {
+        return nullptr;
+    }
+
+    auto* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    size = static_cast<std::size_t>(file_size.QuadPart);
+    return view;
+#else
+    const auto file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return nullptr;
+    }
+
+    struct stat status{};
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        ::close(file);
+        return nullptr;
+    }
+
+    size = static_cast<std::size_t>(status.st_size);
+    auto* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping stays valid once the descriptor is closed.
+    ::close(file);
+    if (view == MAP_FAILED) {
+        return nullptr;
+    }
+
+    // Loading reads the file front to back exactly once.
+    posix_madvise(view, size, POSIX_MADV_SEQUENTIAL);
+    return view;
+#endif
+}
+
+auto unmap_file(void* view, [[maybe_unused]] const std::size_t size) -> void {
+#if defined(_WIN32)
+    UnmapViewOfFile(view);
+#else
+    munmap(view, size);
+#endif
+}
+} // namespace
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+auto MappedFile::open(const std::filesystem::path& path) -> bool {
+    close();
+
+    std::size_t size = 0;
+    mapping = map_file(path, size);
+    if (mapping == nullptr) {
+        return read(path);
+    }
+
+    data = std::span{static_cast<const std::byte*>(mapping), size};
+    return true;
+}
+
+auto MappedFile::close() -> void {
+    if (mapping != nullptr) {
+        unmap_file(mapping, data.size());
+        mapping = nullptr;
+    }
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = {};
+}
+
+auto MappedFile::read(const std::filesystem::path& path) -> bool {
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (!file) {
+        return false;
+    }
+
+    buffer.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), std::ssize(buffer));
+    if (!file) {
+        buffer.clear();
+        return false;
+    }
+
+    data = buffer;
+    return true;
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,190 @@
+#include "hephaestus/Memory.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define HEPHAESTUS_USE_MMAP 1
+#else
+#define HEPHAESTUS_USE_MMAP 0
+#endif
+
+namespace atlas::hephaestus {
+namespace {
+// Pooled blocks up to a quarter of a page, anything bigger goes straight to the page resource.
+constexpr std::size_t POOL_BLOCK_DIVISOR = 4;
+} // namespace
+
+PageResource::PageResource(const std::size_t page_size, const bool use_huge_pages)
+    : page_size{use_huge_pages ? std::max(page_size, AllocatorPolicy::HUGE_PAGE_SIZE) : page_size}
+    , use_huge_pages{use_huge_pages} {
+    assert(page_size > 0 && "The page size must be larger than zero.");
+}
+
+PageResource::~PageResource() {
+    for (void* page : shared_pages) {
+        unmap_pages(page, page_size, alignof(std::max_align_t));
+    }
+}
+
+auto PageResource::round_to_pages(const std::size_t bytes) const -> std::size_t {
+    return ((bytes + page_size - 1) / page_size) * page_size;
+}
+
+auto PageResource::is_shared(const std::size_t bytes) const -> bool {
+    return bytes <= page_size / POOL_BLOCK_DIVISOR;
+}
+
+auto PageResource::map_pages(const std::size_t size, [[maybe_unused]] const std::size_t alignment)
+    -> void* {
+#if HEPHAESTUS_USE_MMAP
+    // mmap is page aligned, which covers every alignment a container asks for.
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        throw std::bad_alloc{};
+    }
+
+#if defined(MADV_HUGEPAGE)
+    if (use_huge_pages) {
+        // Only a hint, the kernel falls back to regular pages if it can't find huge ones.
+        madvise(ptr, size, MADV_HUGEPAGE);
+    }
+#endif
+#else
+    void* ptr = ::operator new(
+        size,
+        std::align_val_t{std::max(alignment, alignof(std::max_align_t))}
+    );
+#endif
+
+    bytes_reserved.fetch_add(size, std::memory_order_relaxed);
+    return ptr;
+}
+
+auto PageResource::unmap_pages(
+    void* ptr,
+    const std::size_t size,
+    [[maybe_unused]] const std::size_t alignment
+) -> void {
+#if HEPHAESTUS_USE_MMAP
+    munmap(ptr, size);
+#else
+    ::operator delete(ptr, size, std::align_val_t{std::max(alignment, alignof(std::max_align_t))});
+#endif
+
+    bytes_reserved.fetch_sub(size, std::memory_order_relaxed);
+}
+
+auto PageResource::do_allocate(const std::size_t bytes, const std::size_t alignment) -> void* {
+    if (!is_shared(bytes)) {
+        return map_pages(round_to_pages(bytes), alignment);
+    }
+
+    const std::scoped_lock lock{shared_mutex};
+    void* ptr = shared_cursor;
+    if (std::align(alignment, bytes, ptr, shared_left) == nullptr) {
+        // The rest of the last page is too small, it's left unused.
+        ptr = map_pages(page_size, alignof(std::max_align_t));
+        shared_pages.emplace_back(ptr);
+        shared_left = page_size;
+    }
+
+    shared_cursor = static_cast<std::byte*>(ptr) + bytes;
+    shared_left -= bytes;
+    return ptr;
+}
+
+auto PageResource::do_deallocate(void* ptr, const std::size_t bytes, const std::size_t alignment)
+    -> void {
+    // Shared pages are returned with the resource, the pool above only gives its chunks back when
+    // it's released anyway.
+    if (!is_shared(bytes)) {
+        unmap_pages(ptr, round_to_pages(bytes), alignment);
+    }
+}
+
+auto PageResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool {
+    return this == &other;
+}
+
+TrackingResource::TrackingResource(std::pmr::memory_resource* upstream)
+    : upstream{upstream} {}
+
+auto TrackingResource::do_allocate(const std::size_t bytes, const std::size_t alignment)
+    -> void* {
+    void* ptr = upstream->allocate(bytes, alignment);
+
+    const auto used = bytes_used.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    num_live_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    auto peak = peak_bytes_used.load(std::memory_order_relaxed);
+    while (used > peak
+           && !peak_bytes_used.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {
+    }
+
+    return ptr;
+}
+
+auto TrackingResource::do_deallocate(
+    void* ptr,
+    const std::size_t bytes,
+    const std::size_t alignment
+) -> void {
+    upstream->deallocate(ptr, bytes, alignment);
+
+    bytes_used.fetch_sub(bytes, std::memory_order_relaxed);
+    num_live_allocations.fetch_sub(1, std::memory_order_relaxed);
+}
+
+auto TrackingResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+    -> bool {
+    return this == &other;
+}
+
+WorldMemory::WorldMemory(const AllocatorPolicy& policy)
+    : policy{policy} {
+    if (policy.kind == AllocatorPolicy::Kind::Heap) {
+        tracking = std::make_unique<TrackingResource>(std::pmr::new_delete_resource());
+        return;
+    }
+
+    pages = std::make_unique<PageResource>(policy.page_size, policy.use_huge_pages);
+    pool = std::make_unique<std::pmr::synchronized_pool_resource>(
+        std::pmr::pool_options{
+            .max_blocks_per_chunk = 0,
+            .largest_required_pool_block = policy.page_size / POOL_BLOCK_DIVISOR
+        },
+        pages.get()
+    );
+    tracking = std::make_unique<TrackingResource>(pool.get());
+}
+
+// The resources are released in the reverse order of their dependencies.
+WorldMemory::~WorldMemory() {
+    tracking.reset();
+    pool.reset();
+    pages.reset();
+}
+
+auto WorldMemory::get_resource() -> std::pmr::memory_resource* {
+    return tracking.get();
+}
+
+auto WorldMemory::get_policy() const -> const AllocatorPolicy& {
+    return policy;
+}
+
+auto WorldMemory::get_stats() const -> MemoryStats {
+    const auto bytes_used = tracking->get_bytes_used();
+    return MemoryStats{
+        // The global heap doesn't report its overhead, all we know is what we asked for.
+        .bytes_reserved = pages != nullptr ? pages->get_bytes_reserved() : bytes_used,
+        .bytes_used = bytes_used,
+        .peak_bytes_used = tracking->get_peak_bytes_used(),
+        .num_live_allocations = tracking->get_num_live_allocations(),
+    };
+}
+} // namespace atlas::hephaestus
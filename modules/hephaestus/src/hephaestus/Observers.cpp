@@ -0,0 +1,65 @@
+#include "hephaestus/Observers.hpp"
+
+#include <cassert>
+#include <utility>
+
+namespace atlas::hephaestus {
+auto Observers::add(
+    const ObserverEvent event,
+    const ComponentTypeId component_id,
+    ObserverFunc func
+) -> void {
+    const auto event_index = static_cast<std::size_t>(event);
+    if (!is_observed(event, component_id)) {
+        auto& indices = batch_indices[event_index];
+        if (indices.size() <= component_id) {
+            indices.resize(component_id + 1);
+        }
+        indices[component_id] = static_cast<std::uint32_t>(batches[event_index].size());
+        batches[event_index].emplace_back();
+        observed[event_index].add_component(component_id);
+    }
+
+    get_batch(event, component_id).observers.emplace_back(std::move(func));
+}
+
+auto Observers::push(
+    const ObserverEvent event,
+    const ComponentTypeId component_id,
+    const Entity entity
+) -> void {
+    get_batch(event, component_id).entities.emplace_back(entity);
+}
+
+auto Observers::push(
+    const ObserverEvent event,
+    const ComponentTypeId component_id,
+    const std::span<const Entity> entities
+) -> void {
+    auto& batch = get_batch(event, component_id);
+    batch.entities.insert(batch.entities.end(), entities.begin(), entities.end());
+}
+
+auto Observers::deliver(const core::IEngine& engine) -> void {
+    for (auto& event_batches : batches) {
+        for (auto& batch : event_batches) {
+            if (batch.entities.empty()) {
+                continue;
+            }
+
+            for (const auto& observer : batch.observers) {
+                observer(engine, batch.entities);
+            }
+            batch.entities.clear();
+        }
+    }
+}
+
+auto Observers::get_batch(const ObserverEvent event, const ComponentTypeId component_id)
+    -> Batch& {
+    assert(is_observed(event, component_id) && "The component isn't observed for the event.");
+
+    const auto event_index = static_cast<std::size_t>(event);
+    return batches[event_index][batch_indices[event_index][component_id]];
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,190 @@
+#include "hephaestus/SparseSet.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace atlas::hephaestus {
+auto SparseSetBase::add_entity(const Entity entity) -> std::size_t {
+    assert(!contains(entity) && "Entity is already in the sparse set");
+
+    const auto index = entities.size();
+    get_or_create_page(entity)[entity % PAGE_SIZE] = static_cast<std::uint32_t>(index);
+    entities.emplace_back(entity);
+
+    return index;
+}
+
+auto SparseSetBase::remove_entity(const Entity entity) -> std::size_t {
+    const auto index = index_of(entity);
+    assert(index != INVALID_INDEX && "Entity is not in the sparse set");
+
+    const auto entity_at_back = entities.back();
+    if (entity != entity_at_back) {
+        entities[index] = entity_at_back;
+        (*pages[entity_at_back / PAGE_SIZE])[entity_at_back % PAGE_SIZE] = index;
+    }
+
+    (*pages[entity / PAGE_SIZE])[entity % PAGE_SIZE] = INVALID_INDEX;
+    entities.pop_back();
+
+    return index;
+}
+
+auto SparseSetBase::swap_entities(const std::size_t lhs, const std::size_t rhs) -> void {
+    const auto lhs_entity = entities[lhs];
+    const auto rhs_entity = entities[rhs];
+
+    std::swap(entities[lhs], entities[rhs]);
+    (*pages[lhs_entity / PAGE_SIZE])[lhs_entity % PAGE_SIZE] = static_cast<std::uint32_t>(rhs);
+    (*pages[rhs_entity / PAGE_SIZE])[rhs_entity % PAGE_SIZE] = static_cast<std::uint32_t>(lhs);
+}
+
+auto SparseSetBase::get_index_bytes() const -> std::size_t {
+    const auto num_pages = std::ranges::count_if(pages, [](const auto& page) {
+        return page != nullptr;
+    });
+
+    return (static_cast<std::size_t>(num_pages) * sizeof(Page))
+           + (pages.capacity() * sizeof(std::unique_ptr<Page>))
+           + (entities.capacity() * sizeof(Entity));
+}
+
+auto SparseSetBase::get_or_create_page(const Entity entity) -> Page& {
+    const auto page = entity / PAGE_SIZE;
+    if (page >= pages.size()) {
+        pages.resize(page + 1);
+    }
+
+    if (pages[page] == nullptr) {
+        pages[page] = std::make_unique<Page>();
+        pages[page]->fill(INVALID_INDEX);
+    }
+
+    return *pages[page];
+}
+
+SparseGroup::SparseGroup(const ArchetypeKey& owned, std::vector<SparseSetBase*> sets)
+    : owned{owned}
+    , sets{std::move(sets)} {
+    assert(!this->sets.empty() && "A group must own at least one set.");
+
+    // Entities at or past the current index are not in the group yet, try_add only ever moves the
+    // entity at index to a lower slot.
+    const auto& entities = this->sets.front()->get_entities();
+    for (std::size_t index = 0; index < entities.size(); ++index) {
+        try_add(entities[index]);
+    }
+}
+
+auto SparseGroup::contains(const Entity entity) const -> bool {
+    const auto index = sets.front()->index_of(entity);
+    return index != SparseSetBase::INVALID_INDEX && index < num_entities;
+}
+
+auto SparseGroup::try_add(const Entity entity) -> bool {
+    const auto has_all = std::ranges::all_of(sets, [entity](const SparseSetBase* set) {
+        return set->contains(entity);
+    });
+    if (!has_all || contains(entity)) {
+        return false;
+    }
+
+    move_to(entity, num_entities);
+    num_entities++;
+    return true;
+}
+
+auto SparseGroup::try_remove(const Entity entity) -> bool {
+    if (!contains(entity)) {
+        return false;
+    }
+
+    num_entities--;
+    move_to(entity, num_entities);
+    return true;
+}
+
+auto SparseGroup::move_to(const Entity entity, const std::size_t index) -> void {
+    for (auto* set : sets) {
+        const auto current = set->index_of(entity);
+        if (current != index) {
+            set->swap(current, index);
+        }
+    }
+}
+
+auto SparseSets::find_group(const ArchetypeKey& owned) const -> const SparseGroup* {
+    const auto it = std::ranges::find_if(groups, [&owned](const auto& group) {
+        return group->get_owned() == owned;
+    });
+    return it != groups.end() ? it->get() : nullptr;
+}
+
+auto SparseSets::find_owning_group(const ComponentTypeId component_id) const -> SparseGroup* {
+    if (!grouped.has_component(component_id)) {
+        return nullptr;
+    }
+
+    const auto it = std::ranges::find_if(groups, [component_id](const auto& group) {
+        return group->get_owned().has_component(component_id);
+    });
+    return it != groups.end() ? it->get() : nullptr;
+}
+
+auto SparseSets::find(const ComponentTypeId component_id) const -> SparseSetBase* {
+    return component_id < sets.size() ? sets[component_id].get() : nullptr;
+}
+
+auto SparseSets::matches(
+    const Entity entity,
+    const ArchetypeKey& include,
+    const ArchetypeKey& exclude
+) const -> bool {
+    bool is_match = true;
+    include.for_each_component([this, entity, &is_match](const std::size_t component_id) {
+        const auto* set = find(static_cast<ComponentTypeId>(component_id));
+        is_match = is_match && set != nullptr && set->contains(entity);
+    });
+    exclude.for_each_component([this, entity, &is_match](const std::size_t component_id) {
+        const auto* set = find(static_cast<ComponentTypeId>(component_id));
+        is_match = is_match && (set == nullptr || !set->contains(entity));
+    });
+
+    return is_match;
+}
+
+auto SparseSets::collect_stats() const -> std::vector<SparseSetStats> {
+    std::vector<SparseSetStats> stats;
+    existing_sets.for_each_component([this, &stats](const std::size_t component_id) {
+        const auto& set = *sets[component_id];
+        stats.emplace_back(SparseSetStats{
+            .component_id = static_cast<ComponentTypeId>(component_id),
+            .element_size = set.get_element_size(),
+            .num_entities = set.size(),
+            .bytes_used = set.size() * set.get_element_size(),
+            .bytes_reserved = set.get_components_capacity() * set.get_element_size(),
+            .index_bytes = set.get_index_bytes(),
+        });
+    });
+
+    return stats;
+}
+
+auto SparseSets::remove_entity(const Entity entity) -> ArchetypeKey {
+    ArchetypeKey removed;
+    for (auto& group : groups) {
+        if (group->try_remove(entity)) {
+            removed.add_components(group->get_owned());
+        }
+    }
+
+    existing_sets.for_each_component([this, entity, &removed](const std::size_t component_id) {
+        if (sets[component_id]->remove(entity)) {
+            removed.add_component(component_id);
+            notify(ObserverEvent::Remove, static_cast<ComponentTypeId>(component_id), entity);
+        }
+    });
+
+    return removed;
+}
+} // namespace atlas::hephaestus
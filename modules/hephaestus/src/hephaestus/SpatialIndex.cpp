@@ -0,0 +1,89 @@
+#include "hephaestus/SpatialIndex.hpp"
+
+#include <cassert>
+#include <iterator>
+
+namespace atlas::hephaestus {
+SpatialHash::SpatialHash(const float cell_size, std::pmr::memory_resource* memory_resource)
+    : cell_size{cell_size}
+    , inverse_cell_size{1.0F / cell_size}
+    , cells{memory_resource}
+    , locations{memory_resource} {
+    assert(cell_size > 0.0F && "The cell size of a spatial index must be positive.");
+}
+
+auto SpatialHash::begin_update() -> void {
+    stamp++;
+}
+
+auto SpatialHash::update(const Entity entity, const float x, const float y) -> void {
+    const auto it = locations.find(entity);
+    if (it == locations.end()) {
+        insert(entity, x, y);
+        return;
+    }
+
+    auto& location = it->second;
+    location.stamp = stamp;
+    const auto cell = make_key(to_cell(x), to_cell(y));
+    if (cell == location.cell) {
+        auto& item = cells.find(cell)->second[location.index];
+        item.x = x;
+        item.y = y;
+        return;
+    }
+
+    remove_from_cell(location.cell, location.index);
+    auto& items = cells[cell];
+    location = Location{
+        .cell = cell,
+        .index = static_cast<std::uint32_t>(items.size()),
+        .stamp = stamp,
+    };
+    items.emplace_back(Item{.entity = entity, .x = x, .y = y});
+}
+
+auto SpatialHash::end_update() -> void {
+    for (auto it = locations.begin(); it != locations.end();) {
+        if (it->second.stamp == stamp) {
+            ++it;
+            continue;
+        }
+
+        remove_from_cell(it->second.cell, it->second.index);
+        it = locations.erase(it);
+    }
+}
+
+auto SpatialHash::insert(const Entity entity, const float x, const float y) -> void {
+    const auto cell = make_key(to_cell(x), to_cell(y));
+    auto& items = cells[cell];
+    locations.emplace(
+        entity,
+        Location{
+            .cell = cell,
+            .index = static_cast<std::uint32_t>(items.size()),
+            .stamp = stamp,
+        }
+    );
+    items.emplace_back(Item{.entity = entity, .x = x, .y = y});
+}
+
+auto SpatialHash::remove_from_cell(const CellKey cell, const std::uint32_t index) -> void {
+    const auto it = cells.find(cell);
+    assert(it != cells.end() && "The location of an entity refers to an empty cell.");
+
+    // Swap and pop, the entity moved into the hole has to be pointed at its new slot.
+    auto& items = it->second;
+    if (index != items.size() - 1) {
+        items[index] = items.back();
+        locations.find(items[index].entity)->second.index = index;
+    }
+    items.pop_back();
+
+    // Empty cells are dropped, or the map would grow with every cell an entity ever passed.
+    if (items.empty()) {
+        cells.erase(it);
+    }
+}
+} // namespace atlas::hephaestus
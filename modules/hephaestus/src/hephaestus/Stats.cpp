@@ -0,0 +1,239 @@
+#include "hephaestus/Stats.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
+
+#include <array>
+#include <cstdio>
+#include <fstream>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace atlas::hephaestus {
+namespace {
+// Minimal streaming JSON writer, only what the introspection snapshot needs. Keeps track of
+// whether a separator is needed before the next value of the innermost object or array.
+class JsonWriter final {
+  public:
+    explicit JsonWriter(std::ostream& stream)
+        : stream{stream} {}
+
+    auto begin_object() -> void {
+        begin_value();
+        stream << '{';
+        needs_separator.push_back(false);
+    }
+
+    auto end_object() -> void {
+        needs_separator.pop_back();
+        stream << '}';
+    }
+
+    auto begin_array() -> void {
+        begin_value();
+        stream << '[';
+        needs_separator.push_back(false);
+    }
+
+    auto end_array() -> void {
+        needs_separator.pop_back();
+        stream << ']';
+    }
+
+    auto key(const std::string_view name) -> JsonWriter& {
+        begin_value();
+        write_string(name);
+        stream << ':';
+        // The value belongs to the key, it must not be preceded by a separator.
+        is_after_key = true;
+        return *this;
+    }
+
+    template <typename T>
+    auto value(const T& value) -> void {
+        begin_value();
+        if constexpr (std::is_same_v<T, bool>) {
+            stream << (value ? "true" : "false");
+        } else if constexpr (std::is_convertible_v<T, std::string_view>) {
+            write_string(value);
+        } else {
+            stream << value;
+        }
+    }
+
+  private:
+    auto begin_value() -> void {
+        if (is_after_key) {
+            is_after_key = false;
+            return;
+        }
+
+        if (!needs_separator.empty()) {
+            if (needs_separator.back()) {
+                stream << ',';
+            }
+            needs_separator.back() = true;
+        }
+    }
+
+    auto write_string(const std::string_view string) -> void {
+        stream << '"';
+        for (const auto character : string) {
+            switch (character) {
+            case '"':
+                stream << "\\\"";
+                break;
+            case '\\':
+                stream << "\\\\";
+                break;
+            case '\n':
+                stream << "\\n";
+                break;
+            default:
+                if (static_cast<unsigned char>(character) < ' ') {
+                    std::array<char, 8> escaped{};
+                    std::snprintf(
+                        escaped.data(),
+                        escaped.size(),
+                        "\\u%04x",
+                        static_cast<unsigned>(character)
+                    );
+                    stream << escaped.data();
+                } else {
+                    stream << character;
+                }
+            }
+        }
+        stream << '"';
+    }
+
+    std::ostream& stream;
+    std::vector<bool> needs_separator;
+    bool is_after_key = false;
+};
+
+auto write_component_ids(JsonWriter& json, const std::vector<ComponentTypeId>& component_ids)
+    -> void {
+    json.begin_array();
+    for (const auto component_id : component_ids) {
+        json.value(component_id);
+    }
+    json.end_array();
+}
+
+auto write_world(JsonWriter& json, const WorldIntrospection& world) -> void {
+    json.begin_object();
+    json.key("world_id").value(world.world_id);
+
+    json.key("stats").begin_object();
+    json.key("tot_num_created_ents").value(world.stats.tot_num_created_ents);
+    json.key("tot_num_destroyed_ents").value(world.stats.tot_num_destroyed_ents);
+    json.key("num_ticks").value(world.stats.num_ticks);
+    json.key("tot_num_compactions").value(world.stats.tot_num_compactions);
+    json.key("last_tick_time").value(world.stats.last_tick_time);
+    json.key("tot_tick_time").value(world.stats.tot_tick_time);
+    json.end_object();
+
+    json.key("memory").begin_object();
+    json.key("bytes_reserved").value(world.memory.bytes_reserved);
+    json.key("bytes_used").value(world.memory.bytes_used);
+    json.key("peak_bytes_used").value(world.memory.peak_bytes_used);
+    json.key("num_live_allocations").value(world.memory.num_live_allocations);
+    json.key("waste").value(world.memory.get_waste());
+    json.end_object();
+
+    json.key("archetypes").begin_array();
+    for (const auto& archetype : world.archetypes) {
+        json.begin_object();
+        json.key("id").value(archetype.id);
+        json.key("component_ids");
+        write_component_ids(json, archetype.component_ids);
+        json.key("is_retired").value(archetype.is_retired);
+        json.key("num_entities").value(archetype.num_entities);
+        json.key("capacity").value(archetype.capacity);
+        json.key("occupancy").value(archetype.get_occupancy());
+        json.key("column_bytes_used").value(archetype.column_bytes_used);
+        json.key("column_bytes_reserved").value(archetype.column_bytes_reserved);
+        json.key("index_bytes").value(archetype.index_bytes);
+
+        json.key("columns").begin_array();
+        for (const auto& column : archetype.columns) {
+            json.begin_object();
+            json.key("component_id").value(column.component_id);
+            json.key("element_size").value(column.element_size);
+            json.key("bytes_used").value(column.bytes_used);
+            json.key("bytes_reserved").value(column.bytes_reserved);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+    }
+    json.end_array();
+
+    json.key("sparse_sets").begin_array();
+    for (const auto& set : world.sparse_sets) {
+        json.begin_object();
+        json.key("component_id").value(set.component_id);
+        json.key("element_size").value(set.element_size);
+        json.key("num_entities").value(set.num_entities);
+        json.key("bytes_used").value(set.bytes_used);
+        json.key("bytes_reserved").value(set.bytes_reserved);
+        json.key("index_bytes").value(set.index_bytes);
+        json.end_object();
+    }
+    json.end_array();
+    json.key("location_bytes").value(world.location_bytes);
+
+    const auto& registry = ComponentRegistry::get();
+    json.key("components").begin_array();
+    for (const auto& component : world.components) {
+        json.begin_object();
+        json.key("component_id").value(component.component_id);
+        json.key("name").value(registry.get_type_name(component.component_id));
+        json.key("num_entities").value(component.num_entities);
+        json.key("bytes_used").value(component.bytes_used);
+        json.key("bytes_reserved").value(component.bytes_reserved);
+        json.end_object();
+    }
+    json.end_array();
+
+    json.key("queries").begin_array();
+    for (const auto& query : world.queries) {
+        json.begin_object();
+        json.key("system_index").value(query.system_index);
+        json.key("num_matched_archetypes").value(query.num_matched_archetypes);
+        json.key("num_cached").value(query.num_cached);
+        json.key("cache_bytes_reserved").value(query.cache_bytes_reserved);
+        json.key("num_rebuilds").value(query.num_rebuilds);
+        json.key("num_rematches").value(query.num_rematches);
+        json.key("uses_group").value(query.uses_group);
+        json.end_object();
+    }
+    json.end_array();
+
+    json.end_object();
+}
+} // namespace
+
+auto write_introspection_json(std::ostream& stream, std::span<const WorldIntrospection> worlds)
+    -> void {
+    JsonWriter json{stream};
+    json.begin_array();
+    for (const auto& world : worlds) {
+        write_world(json, world);
+    }
+    json.end_array();
+}
+
+auto dump_introspection_json(
+    const std::filesystem::path& path,
+    std::span<const WorldIntrospection> worlds
+) -> bool {
+    std::ofstream file{path};
+    if (!file) {
+        return false;
+    }
+
+    write_introspection_json(file, worlds);
+    return static_cast<bool>(file);
+}
+} // namespace atlas::hephaestus
@@ -14,8 +14,10 @@ auto are_dependencies_overlapping(
 
         if (lhs_access.type == rhs_access.type) {
             // Same component type - check if there's a conflict
-            // Conflict only occurs if at least one access is non-const (write access)
-            if (!lhs_access.is_read_only || !rhs_access.is_read_only) {
+            // Conflict only occurs if at least one access is non-const (write access), and
+            // appends don't conflict with each other
+            const auto is_writing = !lhs_access.is_read_only || !rhs_access.is_read_only;
+            if (is_writing && !(lhs_access.is_append && rhs_access.is_append)) {
                 return true;
             }
             // Both are const (read-only), no conflict
@@ -30,4 +32,31 @@ auto are_dependencies_overlapping(
 
     return false;
 }
+
+auto is_appending_to_reads(
+    const std::vector<SystemDependencies>& lhs,
+    const std::vector<SystemDependencies>& rhs
+) -> bool {
+    std::size_t lhs_idx = 0;
+    std::size_t rhs_idx = 0;
+
+    while (lhs_idx < lhs.size() && rhs_idx < rhs.size()) {
+        const auto& lhs_access = lhs[lhs_idx];
+        const auto& rhs_access = rhs[rhs_idx];
+
+        if (lhs_access.type == rhs_access.type) {
+            if (lhs_access.is_append && rhs_access.is_read_only) {
+                return true;
+            }
+            ++lhs_idx;
+            ++rhs_idx;
+        } else if (lhs_access.type < rhs_access.type) {
+            ++lhs_idx;
+        } else {
+            ++rhs_idx;
+        }
+    }
+
+    return false;
+}
 } // namespace atlas::hephaestus
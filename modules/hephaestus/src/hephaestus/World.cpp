@@ -0,0 +1,1227 @@
+#include "hephaestus/World.hpp"
+#include "core/IEngine.hpp"
+#include "hephaestus/AllocationTracker.hpp"
+#include "hephaestus/MappedFile.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace atlas::hephaestus {
+namespace {
+// Spreading the structural changes of a frame over the workers only pays off for mass spawns and
+// despawns, smaller frames are applied inline.
+constexpr std::size_t MIN_PARALLEL_STRUCTURAL_CHANGES = 1024;
+
+// Rows moved in and out of the archetypes by streaming between two checks of the budgets. Evicting
+// a chunk never spreads over the workers, which leaves the subflow to the destroy queue.
+constexpr std::size_t STREAMING_CHUNK_ROWS = 512;
+static_assert(STREAMING_CHUNK_ROWS < MIN_PARALLEL_STRUCTURAL_CHANGES);
+
+// Calls apply(archetype_id, batch) for every non-empty batch, batches being indexed by archetype
+// id and touching nothing but their own archetype. With enough changes every batch gets a task of
+// its own, and alongside runs as one more task next to them.
+template <typename Batch, typename Apply, typename Alongside>
+auto apply_per_archetype(
+    tf::Subflow& subflow,
+    std::vector<Batch>& batches,
+    const std::size_t num_changes,
+    const Apply& apply,
+    const Alongside& alongside
+) -> void {
+    const auto num_batches = std::ranges::count_if(batches, [](const Batch& batch) {
+        return !batch.empty();
+    });
+    if (num_changes < MIN_PARALLEL_STRUCTURAL_CHANGES || num_batches < 2) {
+        for (std::size_t archetype_id = 0; archetype_id < batches.size(); ++archetype_id) {
+            if (!batches[archetype_id].empty()) {
+                apply(static_cast<ArchetypeId>(archetype_id), batches[archetype_id]);
+            }
+        }
+        alongside();
+        return;
+    }
+
+    const AllocationScopeGuard scheduling{AllocationScope::TaskScheduling};
+    for (std::size_t archetype_id = 0; archetype_id < batches.size(); ++archetype_id) {
+        if (!batches[archetype_id].empty()) {
+            subflow.emplace([&apply, &batches, archetype_id]() {
+                const AllocationScopeGuard scope{AllocationScope::QueueApplication};
+                apply(static_cast<ArchetypeId>(archetype_id), batches[archetype_id]);
+            });
+        }
+    }
+    subflow.emplace([&alongside]() {
+        const AllocationScopeGuard scope{AllocationScope::QueueApplication};
+        alongside();
+    });
+    subflow.join();
+}
+} // namespace
+
+World::World(core::IEngine& engine, const WorldId id, const AllocatorPolicy& allocator_policy)
+    : engine{engine}
+    , id{id}
+    , memory{allocator_policy}
+    , sparse_sets{memory.get_resource()}
+    , hierarchy{memory.get_resource()} {
+    sparse_sets.set_observers(&observers);
+
+    constexpr auto ARCHETYPE_BUFFER_SIZE = 30;
+    archetypes.reserve(ARCHETYPE_BUFFER_SIZE);
+
+    constexpr auto QUEUE_BUFFER_SIZE = 100;
+    sparse_queue.reserve(QUEUE_BUFFER_SIZE);
+    hierarchy_queue.reserve(QUEUE_BUFFER_SIZE);
+    enabled_queue.reserve(QUEUE_BUFFER_SIZE);
+    destroy_queue.reserve(QUEUE_BUFFER_SIZE);
+}
+
+auto World::build_graph(const std::size_t concurrent_worlds) -> void {
+    for (auto& updater : spatial_index_updaters) {
+        const auto writes = [&updater](const SystemDependencies& dependency) {
+            return dependency.type == updater.type && !dependency.is_read_only;
+        };
+        updater.has_writers = std::ranges::any_of(*system_nodes, [&writes](const SystemNode& node) {
+            return std::ranges::any_of(node.dependencies, writes);
+        });
+    }
+
+    if (checkpoints != nullptr) {
+        for (auto& component : checkpoints->components) {
+            const auto writes = [&component](const SystemDependencies& dependency) {
+                return dependency.type == component.type && !dependency.is_read_only;
+            };
+            component.has_writers =
+                std::ranges::any_of(*system_nodes, [&writes](const SystemNode& node) {
+                    return std::ranges::any_of(node.dependencies, writes);
+                });
+        }
+    }
+
+    build_systems_dependency_graph(concurrent_worlds);
+
+    auto creation = frame_graph.emplace([this](tf::Subflow& subflow) {
+        tick_timer.reset();
+        if (command_recorder != nullptr) {
+            command_recorder->begin_frame();
+        }
+
+        const AllocationScopeGuard scope{AllocationScope::QueueApplication};
+        apply_creation_queue(subflow);
+        apply_sparse_queue();
+        apply_hierarchy_queue();
+        apply_enabled_queue();
+        commit_streamed_cells();
+        observers.deliver(engine);
+    });
+    auto systems_module = frame_graph.composed_of(systems_graph);
+    auto destruction = frame_graph.emplace([this](tf::Subflow& subflow) {
+        if (command_recorder != nullptr) {
+            command_recorder->end_frame();
+        }
+        // Events sent from now on, by observers included, are read by the next frame.
+        events.swap_buffers();
+
+        {
+            const AllocationScopeGuard scope{AllocationScope::QueueApplication};
+            apply_destroy_queue(subflow);
+            evict_streamed_cells(subflow);
+            observers.deliver(engine);
+        }
+        {
+            const AllocationScopeGuard scope{AllocationScope::Maintenance};
+            update_spatial_indices();
+            if (checkpoints != nullptr) {
+                checkpoints->capture(archetypes, versions);
+            }
+            compact(compaction_settings.time_budget);
+        }
+
+        stats.last_tick_time = tick_timer.elapsed();
+        stats.tot_tick_time += stats.last_tick_time;
+        stats.num_ticks++;
+    });
+
+    creation.precede(systems_module);
+    systems_module.precede(destruction);
+}
+
+auto World::get_frame_graph() -> tf::Taskflow& {
+    return frame_graph;
+}
+
+auto World::get_id() const -> WorldId {
+    return id;
+}
+
+auto World::get_stats() const -> const WorldStats& {
+    return stats;
+}
+
+auto World::get_memory_stats() const -> MemoryStats {
+    return memory.get_stats();
+}
+
+auto World::collect_introspection() const -> WorldIntrospection {
+    WorldIntrospection introspection{
+        .world_id = id,
+        .stats = stats,
+        .memory = memory.get_stats(),
+        .sparse_sets = sparse_sets.collect_stats(),
+        .location_bytes = archetypes.get_location_bytes(),
+    };
+
+    std::vector<ComponentStats> components;
+    const auto add_to_component = [&components](
+                                      const ComponentTypeId component_id,
+                                      const std::size_t num_entities,
+                                      const std::size_t bytes_used,
+                                      const std::size_t bytes_reserved
+                                  ) {
+        if (component_id >= components.size()) {
+            components.resize(component_id + 1);
+        }
+
+        auto& component = components[component_id];
+        component.component_id = component_id;
+        component.num_entities += num_entities;
+        component.bytes_used += bytes_used;
+        component.bytes_reserved += bytes_reserved;
+    };
+
+    introspection.archetypes.reserve(archetypes.size());
+    for (ArchetypeId archetype_id = 0; archetype_id < archetypes.size(); ++archetype_id) {
+        auto archetype_stats = archetypes.at(archetype_id)->collect_stats();
+        archetype_stats.id = archetype_id;
+        archetype_stats.is_retired = archetypes.is_retired(archetype_id);
+        archetypes.get_key(archetype_id).for_each_component(
+            [&archetype_stats, &add_to_component](const std::size_t component_id) {
+                archetype_stats.component_ids.emplace_back(component_id);
+                // Tags have no column, they still count towards the entities of the type.
+                add_to_component(
+                    static_cast<ComponentTypeId>(component_id),
+                    archetype_stats.num_entities,
+                    0,
+                    0
+                );
+            }
+        );
+        for (const auto& column : archetype_stats.columns) {
+            add_to_component(column.component_id, 0, column.bytes_used, column.bytes_reserved);
+        }
+
+        introspection.archetypes.emplace_back(std::move(archetype_stats));
+    }
+
+    for (const auto& set : introspection.sparse_sets) {
+        add_to_component(set.component_id, set.num_entities, set.bytes_used, set.bytes_reserved);
+    }
+
+    // Component ids are shared by all worlds, only keep the types this world has seen.
+    std::ranges::copy_if(
+        components,
+        std::back_inserter(introspection.components),
+        [](const ComponentStats& component) {
+            return component.num_entities > 0 || component.bytes_reserved > 0;
+        }
+    );
+
+    introspection.queries.reserve(systems.size());
+    for (std::size_t system_index = 0; system_index < systems.size(); ++system_index) {
+        auto& query_stats = introspection.queries.emplace_back(
+            systems[system_index]->collect_query_stats()
+        );
+        query_stats.system_index = system_index;
+    }
+
+    return introspection;
+}
+
+auto World::apply_creation_queue(tf::Subflow& subflow) -> void {
+    // No system is running, every handle reserved so far has its creation queued by now.
+    const auto first_entity = std::exchange(
+        first_queued_entity,
+        next_entity_id.load(std::memory_order_relaxed)
+    );
+
+    std::size_t num_created = num_batched_creations;
+    for (const auto& creations : creation_queues) {
+        num_created += creations.size();
+    }
+    if (num_created == 0) {
+        return;
+    }
+
+    // Rows are appended, the created entities are the ones past the current sizes.
+    const auto is_observed = !observers.get_observed(ObserverEvent::Add).empty();
+    if (is_observed) {
+        first_created_rows.resize(creation_queues.size());
+        for (std::size_t archetype_id = 0; archetype_id < creation_queues.size(); ++archetype_id) {
+            first_created_rows[archetype_id] =
+                archetypes.at(static_cast<ArchetypeId>(archetype_id))->get_num_entities();
+        }
+    }
+
+    // Every entity only writes its own location, which must not be reallocated by the tasks.
+    archetypes.reserve_locations(first_entity, first_queued_entity);
+    apply_per_archetype(
+        subflow,
+        creation_queues,
+        num_created,
+        [](ArchetypeId /*archetype_id*/, std::vector<std::function<void()>>& creations) {
+            for (auto& creation : creations) {
+                creation();
+            }
+        },
+        []() {}
+    );
+
+    for (std::size_t archetype_id = 0; archetype_id < creation_queues.size(); ++archetype_id) {
+        auto& creations = creation_queues[archetype_id];
+        if (!creations.empty()) {
+            archetypes.revive(static_cast<ArchetypeId>(archetype_id));
+            versions.increment(archetypes.get_key(static_cast<ArchetypeId>(archetype_id)));
+            if (is_observed) {
+                observe_added_rows(
+                    static_cast<ArchetypeId>(archetype_id),
+                    first_created_rows[archetype_id]
+                );
+            }
+            creations.clear();
+        }
+    }
+    num_batched_creations = 0;
+    stats.tot_num_created_ents += num_created;
+}
+
+auto World::apply_sparse_queue() -> void {
+    for (auto& change : sparse_queue) {
+        change();
+    }
+    sparse_queue.clear();
+}
+
+auto World::apply_hierarchy_queue() -> void {
+    for (const auto& [child, parent] : hierarchy_queue) {
+        assert(
+            archetypes.contains_entity(child)
+            && "Trying to set the parent of an entity that doesnt exist!"
+        );
+
+        if (parent == NO_PARENT) {
+            hierarchy.remove_parent(child);
+            continue;
+        }
+
+        assert(
+            archetypes.contains_entity(parent)
+            && "Trying to set the parent to an entity that doesnt exist!"
+        );
+        [[maybe_unused]] const auto is_linked = hierarchy.set_parent(child, parent);
+        assert(is_linked && "Setting the parent would create a cycle in the hierarchy.");
+    }
+    hierarchy_queue.clear();
+    hierarchy.sort();
+}
+
+auto World::set_parent(const Entity child, const Entity parent) -> void {
+    if (command_recorder != nullptr) {
+        command_recorder->record_set_parent(child, parent);
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    hierarchy_queue.emplace_back(child, parent);
+}
+
+auto World::remove_parent(const Entity child) -> void {
+    if (command_recorder != nullptr) {
+        command_recorder->record_set_parent(child, NO_PARENT);
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    hierarchy_queue.emplace_back(child, NO_PARENT);
+}
+
+auto World::get_parent(const Entity child) const -> Entity {
+    return hierarchy.get_parent(child);
+}
+
+auto World::apply_enabled_queue() -> void {
+    for (const auto& [entity, enabled] : enabled_queue) {
+        const auto archetype_id = archetypes.find_location(entity);
+        assert(
+            archetype_id != INVALID_ARCHETYPE_ID
+            && "Trying to enable or disable an entity that doesnt exist!"
+        );
+        archetypes.at(archetype_id)->set_enabled(entity, enabled);
+    }
+    enabled_queue.clear();
+}
+
+auto World::set_enabled(const Entity entity, const bool enabled) -> void {
+    if (command_recorder != nullptr) {
+        command_recorder->record_set_enabled(entity, enabled);
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    enabled_queue.emplace_back(entity, enabled);
+}
+
+auto World::is_enabled(const Entity entity) const -> bool {
+    const auto archetype_id = archetypes.find_location(entity);
+    assert(archetype_id != INVALID_ARCHETYPE_ID && "Entity does not exist in the world.");
+
+    const auto& archetype = *archetypes.at(archetype_id);
+    return archetype.is_enabled(archetype.get_row_index(entity));
+}
+
+auto World::apply_destroy_queue(tf::Subflow& subflow) -> void {
+    if (destroy_queue.empty()) {
+        return;
+    }
+
+    // The same entity can be queued more than once.
+    std::ranges::sort(destroy_queue);
+    const auto [duplicates, end] = std::ranges::unique(destroy_queue);
+    destroy_queue.erase(duplicates, end);
+
+    // Entities created by a system this frame only exist from the next frame on, so does their
+    // destruction. They are moved to the back and stay in the queue. Any other handle which
+    // doesn't exist has already been destroyed and is dropped.
+    const auto pending = std::ranges::stable_partition(destroy_queue, [this](Entity entity) {
+        return archetypes.contains_entity(entity);
+    });
+    assert(
+        std::ranges::all_of(
+            pending,
+            [reserved = next_entity_id.load(std::memory_order_relaxed)](Entity entity) {
+                return entity < reserved;
+            }
+        )
+        && "Trying to destroy an entity that doesnt exist!"
+    );
+    const auto destroyed = std::ranges::stable_partition(pending, [this](Entity entity) {
+        return entity < first_queued_entity;
+    });
+    destroy_entities(subflow, std::span{destroy_queue.begin(), pending.begin()});
+    destroy_queue.erase(destroy_queue.begin(), destroyed.begin());
+}
+
+auto World::destroy_entities(tf::Subflow& subflow, const std::span<const Entity> entities)
+    -> void {
+    if (destroy_rows.size() < archetypes.size()) {
+        destroy_rows.resize(archetypes.size());
+    }
+    for (const auto entity : entities) {
+        const auto archetype_id = archetypes.find_location(entity);
+        destroy_rows[archetype_id].emplace_back(
+            archetypes.at(archetype_id)->get_row_index(entity)
+        );
+    }
+
+    // The sparse components are pushed to their observers by the sparse sets.
+    if (!observers.get_observed(ObserverEvent::Remove).empty()) {
+        for (std::size_t archetype_id = 0; archetype_id < destroy_rows.size(); ++archetype_id) {
+            if (!destroy_rows[archetype_id].empty()) {
+                observe_removed_rows(
+                    static_cast<ArchetypeId>(archetype_id),
+                    destroy_rows[archetype_id]
+                );
+            }
+        }
+    }
+
+    apply_per_archetype(
+        subflow,
+        destroy_rows,
+        entities.size(),
+        [this](const ArchetypeId archetype_id, std::vector<std::size_t>& rows) {
+            std::ranges::sort(rows, std::greater{});
+            archetypes.at(archetype_id)->destroy_rows(rows);
+        },
+        // Doesn't touch the archetypes, only the bookkeeping shared between them.
+        [this, entities]() {
+            for (const auto entity : entities) {
+                versions.increment(sparse_sets.remove_entity(entity));
+                archetypes.erase_location(entity);
+                hierarchy.remove_entity(entity);
+            }
+            hierarchy.sort();
+        }
+    );
+
+    for (std::size_t archetype_id = 0; archetype_id < destroy_rows.size(); ++archetype_id) {
+        auto& rows = destroy_rows[archetype_id];
+        if (!rows.empty()) {
+            versions.increment(archetypes.get_key(static_cast<ArchetypeId>(archetype_id)));
+            rows.clear();
+        }
+    }
+    stats.tot_num_destroyed_ents += entities.size();
+}
+
+auto World::observe_added_rows(const ArchetypeId archetype_id, const std::size_t first_row)
+    -> void {
+    const auto& observed = observers.get_observed(ObserverEvent::Add);
+    const auto entities = std::span{archetypes.at(archetype_id)->get_entities()}.subspan(first_row);
+    archetypes.get_key(archetype_id)
+        .for_each_component([this, &observed, entities](const std::size_t component_id) {
+            if (observed.has_component(component_id)) {
+                observers.push(
+                    ObserverEvent::Add,
+                    static_cast<ComponentTypeId>(component_id),
+                    entities
+                );
+            }
+        });
+}
+
+auto World::observe_removed_rows(
+    const ArchetypeId archetype_id,
+    const std::span<const std::size_t> rows
+) -> void {
+    const auto& observed = observers.get_observed(ObserverEvent::Remove);
+    const auto& entities = archetypes.at(archetype_id)->get_entities();
+    archetypes.get_key(archetype_id)
+        .for_each_component([this, &observed, &entities, rows](const std::size_t component_id) {
+            if (!observed.has_component(component_id)) {
+                return;
+            }
+            for (const auto row : rows) {
+                observers.push(
+                    ObserverEvent::Remove,
+                    static_cast<ComponentTypeId>(component_id),
+                    entities[row]
+                );
+            }
+        });
+}
+
+auto World::update_spatial_indices() -> void {
+    for (auto& updater : spatial_index_updaters) {
+        const auto version = versions.get(updater.component_id);
+        if (!updater.has_writers && updater.last_version == version) {
+            continue;
+        }
+
+        updater.update();
+        updater.last_version = version;
+    }
+}
+
+auto World::set_compaction_settings(const CompactionSettings& settings) -> void {
+    assert(settings.shrink_factor >= 1 && "The shrink factor must be at least 1.");
+    compaction_settings = settings;
+}
+
+auto World::set_command_recorder(CommandRecorder* recorder) -> void {
+    command_recorder = recorder;
+}
+
+auto World::save_snapshot(const std::filesystem::path& path, const SnapshotSchema& schema) const
+    -> std::expected<void, SnapshotErrorCode> {
+    constexpr auto NOT_SAVED = std::numeric_limits<std::uint32_t>::max();
+
+    // The component types of the snapshot by their index in it, and the other way around.
+    std::vector<const SnapshotComponent*> components;
+    std::vector<std::uint32_t> component_indices(MAX_COMPONENT_TYPES, NOT_SAVED);
+    bool is_schema_complete = true;
+    const auto add_component = [&](const std::size_t component_id) {
+        if (component_indices[component_id] != NOT_SAVED) {
+            return;
+        }
+
+        const auto* component = schema.find(static_cast<ComponentTypeId>(component_id));
+        if (component == nullptr) {
+            is_schema_complete = false;
+            return;
+        }
+        component_indices[component_id] = static_cast<std::uint32_t>(components.size());
+        components.emplace_back(component);
+    };
+
+    std::vector<ArchetypeId> saved_archetypes;
+    std::vector<Entity> links;
+    for (ArchetypeId archetype_id = 0; archetype_id < archetypes.size(); ++archetype_id) {
+        const auto& archetype = *archetypes.at(archetype_id);
+        if (archetype.get_num_entities() == 0) {
+            continue;
+        }
+
+        saved_archetypes.emplace_back(archetype_id);
+        archetypes.get_key(archetype_id).for_each_component(add_component);
+        for (const auto entity : archetype.get_entities()) {
+            if (const auto parent = hierarchy.get_parent(entity); parent != NO_PARENT) {
+                links.emplace_back(entity);
+                links.emplace_back(parent);
+            }
+        }
+    }
+
+    std::vector<ComponentTypeId> saved_sets;
+    for (const auto& set : sparse_sets.collect_stats()) {
+        if (set.num_entities > 0) {
+            saved_sets.emplace_back(set.component_id);
+            add_component(set.component_id);
+        }
+    }
+    if (!is_schema_complete) {
+        return std::unexpected(SnapshotErrorCode::UnknownComponent);
+    }
+    // Indexed in the order of their ids, so that every key lists them by increasing index.
+    std::ranges::sort(components, {}, &SnapshotComponent::component_id);
+    for (std::uint32_t index = 0; index < components.size(); ++index) {
+        component_indices[components[index]->component_id] = index;
+    }
+
+    detail::SnapshotWriter writer;
+    writer.write(SNAPSHOT_MAGIC);
+    writer.write(SNAPSHOT_VERSION);
+    writer.write(next_entity_id.load(std::memory_order_relaxed));
+    writer.write(static_cast<std::uint32_t>(components.size()));
+    writer.write(static_cast<std::uint32_t>(saved_archetypes.size()));
+    writer.write(static_cast<std::uint32_t>(saved_sets.size()));
+    writer.write(static_cast<std::uint64_t>(links.size() / 2));
+
+    for (const auto* component : components) {
+        const auto name = ComponentRegistry::get().get_type_name(component->component_id);
+        writer.write(static_cast<std::uint32_t>(name.size()));
+        writer.write_bytes(std::as_bytes(std::span{name}));
+        writer.write(static_cast<std::uint64_t>(component->size));
+        writer.write(component->storage);
+    }
+
+    // Reused by every column and set.
+    std::vector<std::byte> values;
+    std::vector<Entity> entities;
+    for (const auto archetype_id : saved_archetypes) {
+        const auto& archetype = *archetypes.at(archetype_id);
+        const auto& key = archetypes.get_key(archetype_id);
+
+        writer.write(static_cast<std::uint32_t>(key.count_components()));
+        key.for_each_component([&](const std::size_t component_id) {
+            writer.write(component_indices[component_id]);
+        });
+        writer.write(static_cast<std::uint64_t>(archetype.get_num_entities()));
+        writer.write_block(std::as_bytes(std::span{archetype.get_entities()}));
+        writer.write_block(std::as_bytes(archetype.get_enabled_mask()));
+        key.for_each_component([&](const std::size_t component_id) {
+            const auto& component = *components[component_indices[component_id]];
+            if (component.storage == SnapshotStorage::Column) {
+                values.clear();
+                component.save_column(archetype, values);
+                writer.write_block(values);
+            }
+        });
+    }
+
+    for (const auto component_id : saved_sets) {
+        const auto& component = *components[component_indices[component_id]];
+        component.save_sparse(sparse_sets, entities, values);
+        writer.write(component_indices[component_id]);
+        writer.write(static_cast<std::uint64_t>(entities.size()));
+        writer.write_block(std::as_bytes(std::span{entities}));
+        writer.write_block(values);
+    }
+
+    writer.write_block(std::as_bytes(std::span{links}));
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file) {
+        return std::unexpected(SnapshotErrorCode::CannotOpen);
+    }
+    const auto data = writer.get_data();
+    file.write(reinterpret_cast<const char*>(data.data()), std::ssize(data));
+    file.flush();
+    if (!file) {
+        return std::unexpected(SnapshotErrorCode::CannotWrite);
+    }
+    return {};
+}
+
+auto World::load_snapshot(const std::filesystem::path& path, const SnapshotSchema& schema)
+    -> std::expected<void, SnapshotErrorCode> {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot load snapshots after start."
+    );
+    if (next_entity_id.load(std::memory_order_relaxed) != 0) {
+        return std::unexpected(SnapshotErrorCode::WorldNotEmpty);
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        return std::unexpected(SnapshotErrorCode::CannotOpen);
+    }
+    const auto contents = detail::parse_snapshot(file.get_data(), schema);
+    if (!contents) {
+        return std::unexpected(contents.error());
+    }
+
+    archetypes.reserve_locations(0, contents->next_entity);
+    std::uint64_t num_loaded = 0;
+    for (const auto& block : contents->archetypes) {
+        auto archetype_id = archetypes.find_id(block.key);
+        if (archetype_id == INVALID_ARCHETYPE_ID) {
+            create_archetype_with_signature(
+                block.key,
+                static_cast<std::uint32_t>(block.entities.size())
+            );
+            archetype_id = archetypes.find_id(block.key);
+        }
+
+        auto& archetype = *archetypes.at(archetype_id);
+        for (const auto& [component, values] : block.columns) {
+            if (!component->load_column(archetype, values, block.entities.size())) {
+                return std::unexpected(SnapshotErrorCode::MalformedComponent);
+            }
+        }
+        archetype.push_rows(block.entities, block.enabled_mask);
+        for (const auto entity : block.entities) {
+            archetypes.set_location(entity, archetype_id);
+        }
+        observe_added_rows(archetype_id, archetype.get_num_entities() - block.entities.size());
+
+        archetypes.revive(archetype_id);
+        versions.increment(block.key);
+        num_loaded += block.entities.size();
+    }
+
+    for (const auto& block : contents->sparse_sets) {
+        ArchetypeKey changed;
+        if (!block.component->load_sparse(sparse_sets, block.entities, block.values, changed)) {
+            return std::unexpected(SnapshotErrorCode::MalformedComponent);
+        }
+        versions.increment(changed);
+    }
+
+    const auto links = contents->links;
+    for (std::size_t i = 0; i < links.size(); i += 2) {
+        hierarchy.set_parent(links[i], links[i + 1]);
+    }
+    hierarchy.sort();
+
+    next_entity_id.store(contents->next_entity, std::memory_order_relaxed);
+    stats.tot_num_created_ents += num_loaded;
+    return {};
+}
+
+auto World::create_streamer(SnapshotSchema schema, const StreamingSettings& settings)
+    -> WorldStreamer& {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot create a streamer after start."
+    );
+    assert(streamer == nullptr && "The world already has a streamer.");
+
+    streamer = std::make_unique<WorldStreamer>(std::move(schema), settings);
+    return *streamer;
+}
+
+auto World::get_streamer() const -> WorldStreamer* {
+    return streamer.get();
+}
+
+auto World::get_checkpoints() const -> Checkpoints* {
+    return checkpoints.get();
+}
+
+auto World::restore_checkpoint(const std::uint64_t frame) -> bool {
+    assert(checkpoints != nullptr && "Checkpoints aren't enabled for the world.");
+    if (!checkpoints->restore(frame, archetypes)) {
+        return false;
+    }
+
+    // The restored values went around the versions, the spatial indices are refreshed at the end
+    // of the next frame whatever the writers.
+    for (auto& updater : spatial_index_updaters) {
+        updater.last_version.reset();
+    }
+    return true;
+}
+
+auto World::commit_streamed_cells() -> void {
+    if (streamer == nullptr) {
+        return;
+    }
+
+    const core::Timer timer;
+    do {
+        WorldStreamer::Cell* cell = nullptr;
+        {
+            const std::scoped_lock lock{streamer->mutex};
+            cell = streamer->find_front(streamer->committing, CellState::Committing);
+        }
+        if (cell == nullptr) {
+            return;
+        }
+
+        commit_streamed_chunk(*cell);
+    } while (timer.elapsed() < streamer->settings.commit_budget);
+}
+
+auto World::commit_streamed_chunk(WorldStreamer::Cell& cell) -> void {
+    // Only the world touches the staged cell once it's committing.
+    auto& staged = *cell.staged;
+    if (!staged.is_started) {
+        // New archetypes can't be created after start, see find_or_create_archetype.
+        const auto is_missing = [this](const WorldStreamer::StagedArchetype& staged_archetype) {
+            return archetypes.find_id(staged_archetype.key) == INVALID_ARCHETYPE_ID;
+        };
+        if (std::ranges::any_of(staged.archetypes, is_missing)) {
+            const std::scoped_lock lock{streamer->mutex};
+            cell.state = CellState::Failed;
+            cell.error = SnapshotErrorCode::UnknownArchetype;
+            cell.staged.reset();
+            return;
+        }
+
+        staged.first_entity = next_entity_id.fetch_add(
+            static_cast<Entity>(staged.num_rows),
+            std::memory_order_relaxed
+        );
+        archetypes.reserve_locations(staged.first_entity, staged.first_entity + staged.num_rows);
+        staged.is_started = true;
+    }
+
+    const auto is_pending = [](const WorldStreamer::StagedArchetype& staged_archetype) {
+        return staged_archetype.num_committed < staged_archetype.num_rows;
+    };
+    const auto pending = std::ranges::find_if(staged.archetypes, is_pending);
+    if (pending == staged.archetypes.end()) {
+        // A cell without any rows.
+        link_streamed_cell(cell);
+        return;
+    }
+
+    const auto archetype_id = archetypes.find_id(pending->key);
+    auto& archetype = *archetypes.at(archetype_id);
+    const auto first_row = pending->num_committed;
+    const auto count = std::min(STREAMING_CHUNK_ROWS, pending->num_rows - first_row);
+    const auto first_entity =
+        static_cast<Entity>(staged.first_entity + pending->offset + first_row);
+    const auto is_enabled = [&enabled_mask = pending->enabled_mask](const std::size_t row) {
+        const auto word = enabled_mask[row / Archetype::MASK_WORD_BITS];
+        return ((word >> (row % Archetype::MASK_WORD_BITS)) & 1U) != 0;
+    };
+
+    archetype.append_moved_columns(*pending->columns, first_row, count);
+    archetype.push_rows(first_entity, count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const auto entity = static_cast<Entity>(first_entity + i);
+        archetypes.set_location(entity, archetype_id);
+
+        if (!is_enabled(first_row + i)) {
+            archetype.set_enabled(entity, false);
+        }
+    }
+
+    archetypes.revive(archetype_id);
+    versions.increment(pending->key);
+    observe_added_rows(archetype_id, archetype.get_num_entities() - count);
+    pending->num_committed += count;
+    stats.tot_num_created_ents += count;
+
+    {
+        const std::scoped_lock lock{streamer->mutex};
+        for (std::size_t i = 0; i < count; ++i) {
+            cell.entities.emplace_back(static_cast<Entity>(first_entity + i));
+        }
+    }
+
+    // The sparse components and links arrive in the same frame as the last rows.
+    if (std::ranges::none_of(staged.archetypes, is_pending)) {
+        link_streamed_cell(cell);
+    }
+}
+
+auto World::link_streamed_cell(WorldStreamer::Cell& cell) -> void {
+    auto& staged = *cell.staged;
+    const auto map = [&staged](const Entity saved) {
+        return static_cast<Entity>(staged.first_entity + staged.rows[saved]);
+    };
+
+    auto error = SnapshotErrorCode::NoError;
+    std::vector<Entity> entities;
+    for (const auto& set : staged.contents.sparse_sets) {
+        entities.clear();
+        std::ranges::transform(set.entities, std::back_inserter(entities), map);
+
+        ArchetypeKey changed;
+        if (!set.component->load_sparse(sparse_sets, entities, set.values, changed)) {
+            error = SnapshotErrorCode::MalformedComponent;
+        }
+        versions.increment(changed);
+
+        // The values are packed, so the entities the game destroyed since their rows were
+        // committed get theirs and lose them right away.
+        for (const auto entity : entities) {
+            if (!archetypes.contains_entity(entity)) {
+                versions.increment(sparse_sets.remove_entity(entity));
+            }
+        }
+    }
+
+    const auto links = staged.contents.links;
+    for (std::size_t i = 0; i < links.size(); i += 2) {
+        const auto child = map(links[i]);
+        const auto parent = map(links[i + 1]);
+        if (archetypes.contains_entity(child) && archetypes.contains_entity(parent)) {
+            hierarchy.set_parent(child, parent);
+        }
+    }
+    hierarchy.sort();
+
+    const std::scoped_lock lock{streamer->mutex};
+    cell.staged.reset();
+    if (error != SnapshotErrorCode::NoError) {
+        // The rows are in the world already, the cell fails once they have been evicted.
+        cell.error = error;
+        if (cell.state == CellState::Committing) {
+            cell.state = CellState::Unloading;
+            streamer->unloading.emplace_back(cell.id);
+        }
+    } else if (cell.state == CellState::Committing) {
+        cell.state = CellState::Resident;
+    }
+}
+
+auto World::evict_streamed_cells(tf::Subflow& subflow) -> void {
+    if (streamer == nullptr) {
+        return;
+    }
+
+    const core::Timer timer;
+    do {
+        WorldStreamer::Cell* cell = nullptr;
+        {
+            const std::scoped_lock lock{streamer->mutex};
+            cell = streamer->find_front(streamer->unloading, CellState::Unloading);
+            if (cell == nullptr) {
+                return;
+            }
+
+            const auto count = std::min(STREAMING_CHUNK_ROWS, cell->entities.size());
+            const auto first = cell->entities.end() - static_cast<std::ptrdiff_t>(count);
+            evicted.assign(first, cell->entities.end());
+            cell->entities.erase(first, cell->entities.end());
+        }
+
+        // The game might have destroyed some of them already.
+        std::erase_if(evicted, [this](const Entity entity) {
+            return !archetypes.contains_entity(entity);
+        });
+        if (!evicted.empty()) {
+            destroy_entities(subflow, evicted);
+        }
+
+        const std::scoped_lock lock{streamer->mutex};
+        if (cell->entities.empty()) {
+            if (cell->error != SnapshotErrorCode::NoError) {
+                cell->state = CellState::Failed;
+                cell->staged.reset();
+            } else {
+                streamer->cells.erase(cell->id);
+            }
+        }
+    } while (timer.elapsed() < streamer->settings.evict_budget);
+}
+
+auto World::compact(const double time_budget) -> void {
+    if (time_budget <= 0.0) {
+        return;
+    }
+
+    const core::Timer timer;
+    for (std::size_t visited = 0; visited < archetypes.size(); ++visited) {
+        compaction_cursor %= archetypes.size();
+        compact_archetype(static_cast<ArchetypeId>(compaction_cursor++));
+
+        if (timer.elapsed() >= time_budget) {
+            break;
+        }
+    }
+}
+
+auto World::compact_archetype(const ArchetypeId archetype_id) -> void {
+    auto& archetype = *archetypes.at(archetype_id);
+    const auto num_entities = archetype.get_num_entities();
+    if (num_entities == 0) {
+        archetypes.retire(archetype_id);
+    }
+
+    const auto capacity = archetype.get_capacity();
+    const auto target_capacity = std::max(num_entities, archetype.get_entity_buffer_size());
+    if (capacity <= compaction_settings.min_capacity || capacity <= target_capacity
+        || capacity <= num_entities * compaction_settings.shrink_factor) {
+        return;
+    }
+
+    archetype.shrink(target_capacity);
+    // The columns have moved, the queries holding references into them must rebuild their caches.
+    versions.increment(archetypes.get_key(archetype_id));
+    stats.tot_num_compactions++;
+}
+
+auto World::reserve_entity_id() -> Entity {
+    return next_entity_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+auto World::find_or_create_archetype(const ArchetypeKey& signature) -> ArchetypeId {
+    if (const auto id = archetypes.find_id(signature); id != INVALID_ARCHETYPE_ID) {
+        return id;
+    }
+
+    // Entities are created from the systems, on the workers, once the world has started. The map
+    // must not change under them, only lookups are allowed by then.
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot create an entity of a new archetype after start, use create_archetype before."
+    );
+
+    constexpr auto ENTITY_BUFFER_GUESSTIMATION = 500;
+    create_archetype_with_signature(signature, ENTITY_BUFFER_GUESSTIMATION);
+    return archetypes.find_id(signature);
+}
+
+auto World::build_systems_dependency_graph(const std::size_t concurrent_worlds) -> void {
+    assert(
+        system_nodes != std::nullopt
+        && "system_nodes has been reset before the dependency_graph was built."
+    );
+
+    const auto num_nodes = (*system_nodes).size();
+    if (num_nodes == 0) {
+        return;
+    }
+
+    std::vector<std::vector<std::size_t>> system_deps(num_nodes);
+    // Very pessimistic guesswork for inner vector capacity, but safe.
+    // Choose a more realistic number if needed.
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+        system_deps[i].reserve(num_nodes);
+    }
+
+    const auto are_nodes_conflicting = [](const SystemNode& node, const SystemNode& other) {
+        // Use const-aware access signature conflict detection
+        return are_dependencies_overlapping(node.dependencies, other.dependencies);
+    };
+
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+        auto& node = (*system_nodes)[i];
+
+        for (std::size_t j = i + 1; j < num_nodes; ++j) {
+            auto& other = (*system_nodes)[j];
+
+            if (are_nodes_conflicting(node, other)) {
+                system_deps[i].emplace_back(j);
+                system_deps[j].emplace_back(i);
+            }
+        }
+    }
+
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+        const auto conflicts = system_deps[i].size();
+        const auto concurrent = std::max<std::size_t>(1, num_nodes - conflicts);
+        systems[i]->set_concurrent_systems(
+            concurrent * std::max<std::size_t>(1, concurrent_worlds)
+        );
+    }
+
+    std::vector<tf::Task> tasks(num_nodes);
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+        tasks[i] = systems_graph.emplace([this, i](tf::Subflow& subflow) {
+            const AllocationScopeGuard scope{AllocationScope::SystemExecute};
+            systems[i]->execute(engine, subflow);
+        });
+    }
+
+    const auto positions = order_event_writers_first();
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+        for (std::size_t j : system_deps[i]) {
+            if (positions[i] < positions[j]) {
+                tasks[i].precede(tasks[j]);
+            }
+        }
+    }
+}
+
+auto World::order_event_writers_first() const -> std::vector<std::size_t> {
+    const auto& nodes = *system_nodes;
+    const auto num_nodes = nodes.size();
+    std::vector<std::size_t> positions(num_nodes);
+    std::iota(positions.begin(), positions.end(), 0);
+
+    const auto is_appending = [](const SystemNode& node) {
+        return std::ranges::any_of(node.dependencies, &SystemDependencies::is_append);
+    };
+    if (std::ranges::none_of(nodes, is_appending)) {
+        return positions;
+    }
+
+    // Creation order, except that the writers of an event are moved before its readers. Systems
+    // which both write and read events of each other in a cycle keep their creation order.
+    std::vector<std::vector<std::size_t>> readers(num_nodes);
+    std::vector<std::size_t> num_writers(num_nodes, 0);
+    for (std::size_t i = 0; i < num_nodes; ++i) {
+        for (std::size_t j = 0; j < num_nodes; ++j) {
+            if (i != j && is_appending_to_reads(nodes[i].dependencies, nodes[j].dependencies)) {
+                readers[i].emplace_back(j);
+                ++num_writers[j];
+            }
+        }
+    }
+
+    std::vector<bool> is_placed(num_nodes, false);
+    for (std::size_t position = 0; position < num_nodes; ++position) {
+        auto next = num_nodes;
+        for (std::size_t i = 0; i < num_nodes; ++i) {
+            if (!is_placed[i] && (num_writers[i] == 0 || next == num_nodes)) {
+                next = i;
+                if (num_writers[i] == 0) {
+                    break;
+                }
+            }
+        }
+
+        is_placed[next] = true;
+        positions[next] = position;
+        for (const auto reader : readers[next]) {
+            if (!is_placed[reader]) {
+                --num_writers[reader];
+            }
+        }
+    }
+    return positions;
+}
+
+auto World::create_archetype_with_signature(
+    const ArchetypeKey signature,
+    const std::uint32_t entity_buffer_size
+) -> void {
+    const auto init_status = engine.get_engine_init_status();
+    assert(
+        init_status <= core::EngineInitStatus::RunningStart
+        && "Cannot create new archetypes after start."
+    );
+
+    archetypes.emplace(
+        signature,
+        std::make_unique<Archetype>(entity_buffer_size, memory.get_resource())
+    );
+}
+
+auto World::destroy_entity(Entity entity) -> void {
+    if (command_recorder != nullptr) {
+        command_recorder->record_destroy(entity);
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    destroy_queue.emplace_back(entity);
+}
+
+auto World::create_entity_raw(const std::span<const RawComponent> components) -> Entity {
+    const auto entity_id = reserve_entity_id();
+    if (command_recorder != nullptr) {
+        command_recorder->record_create(entity_id, components);
+    }
+
+    // Same split as create_entity, the values are packed back to back in the order of the codecs.
+    ArchetypeKey signature;
+    std::vector<const ComponentCodec*> column_codecs;
+    std::vector<std::byte> column_data;
+    std::vector<const ComponentCodec*> sparse_codecs;
+    std::vector<std::byte> sparse_data;
+    for (const auto& component : components) {
+        const auto* codec = component.codec;
+        auto& codecs = codec->is_sparse ? sparse_codecs : column_codecs;
+        auto& data = codec->is_sparse ? sparse_data : column_data;
+        if (!codec->is_sparse) {
+            signature.add_component(codec->component_id);
+        }
+        codecs.emplace_back(codec);
+        data.insert(data.end(), component.data, component.data + codec->size);
+    }
+
+    const auto archetype_id = find_or_create_archetype(signature);
+    auto* archetype = archetypes.at(archetype_id).get();
+
+    const std::scoped_lock lock{queue_mutex};
+    if (creation_queues.size() <= archetype_id) {
+        creation_queues.resize(archetype_id + 1);
+    }
+    creation_queues[archetype_id].emplace_back([this,
+                                                codecs = std::move(column_codecs),
+                                                data = std::move(column_data),
+                                                archetype_id,
+                                                archetype,
+                                                entity_id]() {
+        archetype->create_entity(entity_id, codecs, data);
+        archetypes.set_location(entity_id, archetype_id);
+    });
+
+    if (!sparse_codecs.empty()) {
+        sparse_queue.emplace_back([this,
+                                   codecs = std::move(sparse_codecs),
+                                   data = std::move(sparse_data),
+                                   entity_id]() {
+            std::size_t offset = 0;
+            for (const auto* codec : codecs) {
+                const auto* value = data.data() + offset;
+                versions.increment(codec->emplace_sparse(sparse_sets, entity_id, value));
+                offset += codec->size;
+            }
+        });
+    }
+
+    return entity_id;
+}
+
+auto World::add_component_raw(const Entity entity, const RawComponent component) -> void {
+    assert(component.codec->is_sparse && "Only sparse components can be added to an entity.");
+    if (command_recorder != nullptr) {
+        command_recorder->record_add_component(entity, component);
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    sparse_queue.emplace_back([this,
+                               entity,
+                               codec = component.codec,
+                               data = std::vector<std::byte>(
+                                   component.data,
+                                   component.data + component.codec->size
+                               )]() {
+        assert(
+            archetypes.contains_entity(entity)
+            && "Trying to add a component to an entity that doesnt exist!"
+        );
+
+        versions.increment(codec->emplace_sparse(sparse_sets, entity, data.data()));
+    });
+}
+
+auto World::remove_component_raw(const Entity entity, const ComponentCodec& codec) -> void {
+    assert(codec.is_sparse && "Only sparse components can be removed from an entity.");
+    if (command_recorder != nullptr) {
+        command_recorder->record_remove_component(entity, codec);
+    }
+
+    const std::scoped_lock lock{queue_mutex};
+    sparse_queue.emplace_back([this, entity, &codec]() {
+        versions.increment(codec.remove_sparse(sparse_sets, entity));
+    });
+}
+} // namespace atlas::hephaestus
@@ -0,0 +1,223 @@
+#include "hephaestus/WorldSnapshot.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace atlas::hephaestus {
+auto SnapshotSchema::find(const ComponentTypeId component_id) const -> const SnapshotComponent* {
+    const auto component = std::ranges::find(
+        components,
+        component_id,
+        &SnapshotComponent::component_id
+    );
+    return component != components.end() ? &*component : nullptr;
+}
+
+auto SnapshotSchema::find(const std::string_view type_name) const -> const SnapshotComponent* {
+    const auto component = std::ranges::find_if(
+        components,
+        [type_name](const SnapshotComponent& component) {
+            return ComponentRegistry::get().get_type_name(component.component_id) == type_name;
+        }
+    );
+    return component != components.end() ? &*component : nullptr;
+}
+
+namespace detail {
+auto parse_snapshot(const std::span<const std::byte> data, const SnapshotSchema& schema)
+    -> std::expected<SnapshotContents, SnapshotErrorCode> {
+    SnapshotReader reader{data};
+
+    const auto magic = reader.read<std::remove_const_t<decltype(SNAPSHOT_MAGIC)>>();
+    if (!magic || *magic != SNAPSHOT_MAGIC) {
+        return std::unexpected(SnapshotErrorCode::NotASnapshot);
+    }
+    const auto version = reader.read<std::uint32_t>();
+    if (!version) {
+        return std::unexpected(version.error());
+    }
+    if (*version != SNAPSHOT_VERSION) {
+        return std::unexpected(SnapshotErrorCode::UnsupportedVersion);
+    }
+
+    const auto next_entity = reader.read<Entity>();
+    const auto num_components = reader.read<std::uint32_t>();
+    const auto num_archetypes = reader.read<std::uint32_t>();
+    const auto num_sets = reader.read<std::uint32_t>();
+    const auto num_links = reader.read<std::uint64_t>();
+    if (!next_entity || !num_components || !num_archetypes || !num_sets || !num_links) {
+        return std::unexpected(SnapshotErrorCode::Truncated);
+    }
+
+    std::vector<const SnapshotComponent*> components;
+    for (std::uint32_t i = 0; i < *num_components; ++i) {
+        const auto name_size = reader.read<std::uint32_t>();
+        if (!name_size) {
+            return std::unexpected(name_size.error());
+        }
+        const auto name = reader.read_bytes(*name_size);
+        const auto size = reader.read<std::uint64_t>();
+        const auto storage = reader.read<SnapshotStorage>();
+        if (!name || !size || !storage) {
+            return std::unexpected(SnapshotErrorCode::Truncated);
+        }
+
+        const auto* component = schema.find(
+            std::string_view{reinterpret_cast<const char*>(name->data()), name->size()}
+        );
+        if (component == nullptr) {
+            return std::unexpected(SnapshotErrorCode::UnknownComponent);
+        }
+        if (component->size != *size || component->storage != *storage) {
+            return std::unexpected(SnapshotErrorCode::ComponentSizeMismatch);
+        }
+        components.emplace_back(component);
+    }
+
+    // Every entity must be unique and below the next handle, and every sparse component and link
+    // must refer to one of them.
+    std::vector<bool> is_loaded(*next_entity, false);
+    const auto load_entities = [&is_loaded](const std::span<const Entity> entities) {
+        return std::ranges::all_of(entities, [&is_loaded](const Entity entity) {
+            if (entity >= is_loaded.size() || is_loaded[entity]) {
+                return false;
+            }
+            is_loaded[entity] = true;
+            return true;
+        });
+    };
+    const auto are_loaded = [&is_loaded](const std::span<const Entity> entities) {
+        return std::ranges::all_of(entities, [&is_loaded](const Entity entity) {
+            return entity < is_loaded.size() && is_loaded[entity];
+        });
+    };
+    // The values of components without hooks are stored back to back, so nothing is loaded from a
+    // snapshot whose blocks don't match.
+    const auto is_block_size = [](const SnapshotComponent& component,
+                                  const std::span<const std::byte> values,
+                                  const std::uint64_t num_values) {
+        if (component.has_hooks) {
+            return true;
+        }
+        if (component.size == 0) {
+            return values.empty();
+        }
+        // Divided, as the product of a corrupt count may wrap around.
+        return values.size() % component.size == 0 && values.size() / component.size == num_values;
+    };
+
+    SnapshotContents contents{.next_entity = *next_entity};
+    contents.archetypes.resize(*num_archetypes);
+    for (auto& block : contents.archetypes) {
+        const auto num_keyed = reader.read<std::uint32_t>();
+        if (!num_keyed) {
+            return std::unexpected(num_keyed.error());
+        }
+
+        // The key lists every component once, by increasing index.
+        std::vector<const SnapshotComponent*> keyed;
+        for (std::uint32_t i = 0, min_index = 0; i < *num_keyed; ++i) {
+            const auto index = reader.read<std::uint32_t>();
+            if (!index) {
+                return std::unexpected(index.error());
+            }
+            if (*index < min_index || *index >= components.size()
+                || components[*index]->storage == SnapshotStorage::Sparse) {
+                return std::unexpected(SnapshotErrorCode::NotASnapshot);
+            }
+            min_index = *index + 1;
+            keyed.emplace_back(components[*index]);
+            block.key.add_component(components[*index]->component_id);
+        }
+        // Every archetype is saved as a single block.
+        const auto previous = std::span{contents.archetypes.data(), &block};
+        if (std::ranges::find(previous, block.key, &SnapshotArchetype::key) != previous.end()) {
+            return std::unexpected(SnapshotErrorCode::NotASnapshot);
+        }
+
+        const auto num_rows = reader.read<std::uint64_t>();
+        if (!num_rows) {
+            return std::unexpected(num_rows.error());
+        }
+        const auto entities = reader.read_array<Entity>(*num_rows);
+        if (!entities) {
+            return std::unexpected(entities.error());
+        }
+        const auto num_mask_words = (*num_rows + Archetype::MASK_WORD_BITS - 1)
+                                    / Archetype::MASK_WORD_BITS;
+        const auto enabled_mask = reader.read_array<std::uint64_t>(num_mask_words);
+        if (!enabled_mask) {
+            return std::unexpected(enabled_mask.error());
+        }
+        if (!load_entities(*entities)) {
+            return std::unexpected(SnapshotErrorCode::NotASnapshot);
+        }
+        block.entities = *entities;
+        block.enabled_mask = *enabled_mask;
+
+        for (const auto* component : keyed) {
+            if (component->storage != SnapshotStorage::Column) {
+                continue;
+            }
+            const auto values = reader.read_block();
+            if (!values) {
+                return std::unexpected(values.error());
+            }
+            if (!is_block_size(*component, *values, *num_rows)) {
+                return std::unexpected(SnapshotErrorCode::NotASnapshot);
+            }
+            block.columns.emplace_back(component, *values);
+        }
+    }
+
+    contents.sparse_sets.resize(*num_sets);
+    for (auto& block : contents.sparse_sets) {
+        const auto index = reader.read<std::uint32_t>();
+        const auto num_entities = reader.read<std::uint64_t>();
+        if (!index || !num_entities) {
+            return std::unexpected(SnapshotErrorCode::Truncated);
+        }
+        if (*index >= components.size()
+            || components[*index]->storage != SnapshotStorage::Sparse) {
+            return std::unexpected(SnapshotErrorCode::NotASnapshot);
+        }
+
+        const auto entities = reader.read_array<Entity>(*num_entities);
+        if (!entities) {
+            return std::unexpected(entities.error());
+        }
+        const auto values = reader.read_block();
+        if (!values) {
+            return std::unexpected(values.error());
+        }
+        if (!are_loaded(*entities) || !is_block_size(*components[*index], *values, *num_entities)) {
+            return std::unexpected(SnapshotErrorCode::NotASnapshot);
+        }
+        block = SnapshotSparseSet{
+            .component = components[*index],
+            .entities = *entities,
+            .values = *values,
+        };
+    }
+
+    // Child and parent of every link.
+    if (*num_links > std::numeric_limits<std::uint64_t>::max() / 2) {
+        return std::unexpected(SnapshotErrorCode::NotASnapshot);
+    }
+    const auto links = reader.read_array<Entity>(*num_links * 2);
+    if (!links) {
+        return std::unexpected(links.error());
+    }
+    if (!are_loaded(*links) || !reader.is_done()) {
+        return std::unexpected(SnapshotErrorCode::NotASnapshot);
+    }
+    contents.links = *links;
+
+    return contents;
+}
+} // namespace detail
+} // namespace atlas::hephaestus
@@ -0,0 +1,165 @@
+#include "hephaestus/WorldStreamer.hpp"
+
+#include <algorithm>
+
+namespace atlas::hephaestus {
+WorldStreamer::WorldStreamer(SnapshotSchema schema, const StreamingSettings& settings)
+    : schema{std::move(schema)}
+    , settings{settings} {
+    assert(settings.num_loader_threads > 0 && "Streaming needs at least one loader thread.");
+
+    loaders.reserve(settings.num_loader_threads);
+    for (std::size_t i = 0; i < settings.num_loader_threads; ++i) {
+        loaders.emplace_back([this](const std::stop_token& stop_token) {
+            run_loader(stop_token);
+        });
+    }
+}
+
+auto WorldStreamer::load_cell(const CellId cell, std::filesystem::path path) -> bool {
+    const std::scoped_lock lock{mutex};
+    auto& entry = cells[cell];
+    if (entry.state != CellState::Unloaded && entry.state != CellState::Failed) {
+        return false;
+    }
+
+    entry.id = cell;
+    entry.state = CellState::Loading;
+    entry.error = SnapshotErrorCode::NoError;
+    entry.generation = ++last_generation;
+    load_requests.emplace_back(LoadRequest{
+        .cell = cell,
+        .generation = entry.generation,
+        .path = std::move(path),
+    });
+    requested.notify_one();
+    return true;
+}
+
+auto WorldStreamer::unload_cell(const CellId cell) -> bool {
+    const std::scoped_lock lock{mutex};
+    const auto found = cells.find(cell);
+    if (found == cells.end()) {
+        return false;
+    }
+
+    auto& entry = found->second;
+    switch (entry.state) {
+    case CellState::Loading:
+        // Nothing is in the world yet, the loader drops the cell once it's done with it.
+        cells.erase(found);
+        return true;
+    case CellState::Committing:
+    case CellState::Resident:
+        // Only the world erases cells it might be committing, once their rows have been evicted.
+        entry.state = CellState::Unloading;
+        unloading.emplace_back(cell);
+        return true;
+    default:
+        return false;
+    }
+}
+
+auto WorldStreamer::get_state(const CellId cell) const -> CellState {
+    const std::scoped_lock lock{mutex};
+    const auto found = cells.find(cell);
+    return found != cells.end() ? found->second.state : CellState::Unloaded;
+}
+
+auto WorldStreamer::get_error(const CellId cell) const -> SnapshotErrorCode {
+    const std::scoped_lock lock{mutex};
+    const auto found = cells.find(cell);
+    return found != cells.end() && found->second.state == CellState::Failed
+               ? found->second.error
+               : SnapshotErrorCode::NoError;
+}
+
+auto WorldStreamer::get_entities(const CellId cell) const -> std::vector<Entity> {
+    const std::scoped_lock lock{mutex};
+    const auto found = cells.find(cell);
+    return found != cells.end() ? found->second.entities : std::vector<Entity>{};
+}
+
+auto WorldStreamer::run_loader(const std::stop_token& stop_token) -> void {
+    while (true) {
+        LoadRequest request;
+        {
+            std::unique_lock lock{mutex};
+            if (!requested.wait(lock, stop_token, [this]() { return !load_requests.empty(); })) {
+                return;
+            }
+            request = std::move(load_requests.front());
+            load_requests.pop_front();
+        }
+
+        auto staged = stage(request.path);
+
+        const std::scoped_lock lock{mutex};
+        const auto found = cells.find(request.cell);
+        if (found == cells.end() || found->second.generation != request.generation
+            || found->second.state != CellState::Loading) {
+            continue;
+        }
+
+        auto& cell = found->second;
+        if (!staged) {
+            cell.state = CellState::Failed;
+            cell.error = staged.error();
+            continue;
+        }
+        cell.staged = std::move(*staged);
+        cell.state = CellState::Committing;
+        committing.emplace_back(request.cell);
+    }
+}
+
+auto WorldStreamer::stage(const std::filesystem::path& path) const
+    -> std::expected<std::unique_ptr<StagedCell>, SnapshotErrorCode> {
+    auto staged = std::make_unique<StagedCell>();
+    if (!staged->file.open(path)) {
+        return std::unexpected(SnapshotErrorCode::CannotOpen);
+    }
+    auto contents = detail::parse_snapshot(staged->file.get_data(), schema);
+    if (!contents) {
+        return std::unexpected(contents.error());
+    }
+    staged->contents = std::move(*contents);
+
+    // Decoding the columns here is what keeps the hooks and the page faults out of the frame.
+    staged->rows.resize(staged->contents.next_entity, 0);
+    for (const auto& block : staged->contents.archetypes) {
+        const auto num_rows = block.entities.size();
+        auto columns = std::make_unique<Archetype>(0);
+        for (const auto& [component, values] : block.columns) {
+            if (!component->load_column(*columns, values, num_rows)) {
+                return std::unexpected(SnapshotErrorCode::MalformedComponent);
+            }
+        }
+
+        for (std::size_t row = 0; row < num_rows; ++row) {
+            staged->rows[block.entities[row]] = static_cast<Entity>(staged->num_rows + row);
+        }
+        staged->archetypes.emplace_back(StagedArchetype{
+            .key = block.key,
+            .columns = std::move(columns),
+            .enabled_mask = block.enabled_mask,
+            .offset = staged->num_rows,
+            .num_rows = num_rows,
+        });
+        staged->num_rows += num_rows;
+    }
+
+    return staged;
+}
+
+auto WorldStreamer::find_front(std::deque<CellId>& queue, const CellState state) -> Cell* {
+    while (!queue.empty()) {
+        const auto found = cells.find(queue.front());
+        if (found != cells.end() && found->second.state == state) {
+            return &found->second;
+        }
+        queue.pop_front();
+    }
+    return nullptr;
+}
+} // namespace atlas::hephaestus
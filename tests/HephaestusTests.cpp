@@ -1,14 +1,32 @@
+#include <atomic>
 #include <chrono>
 
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <gtest/gtest.h>
 
 #include "atlas/core/Engine.hpp"
 #include "atlas/core/IGame.hpp"
+#include "hephaestus/AllocationTracker.hpp"
 #include "hephaestus/ArchetypeKey.hpp"
+#include "hephaestus/CommandLog.hpp"
 #include "hephaestus/Component.hpp"
+#include "hephaestus/ComponentRegistry.hpp"
 #include "hephaestus/Hephaestus.hpp"
 #include "hephaestus/Utils.hpp"
+#include "hephaestus/WorldSnapshot.hpp"
+#include "hephaestus/WorldStreamer.hpp"
 
 namespace atlas::hephauestus::test {
 
@@ -115,6 +133,29 @@ class MockGame : public IGame {
     bool should_stop = false;
 };
 
+// Base of the games whose state is compared with another run, such as a recording and its replay.
+// The systems of the test sum ResultType up over a tick, they run concurrently.
+template <typename ResultType>
+class SimulationGame : public MockGame {
+  protected:
+    template <typename Func>
+    auto update_result(Func&& func) -> void {
+        const std::scoped_lock lock{result_mutex};
+        func(result);
+    }
+
+    // Summed over the tick.
+    auto tick(Hephaestus& hephaestus) -> ResultType {
+        result = {};
+        hephaestus.tick();
+        return result;
+    }
+
+  private:
+    std::mutex result_mutex;
+    ResultType result{};
+};
+
 TEST(HephaestusTest, SystemDependenciesGeneration) {
     const auto const_signature = make_system_dependencies<const Position&, const Velocity&>();
     EXPECT_EQ(const_signature.size(), 2);
@@ -354,6 +395,112 @@ TEST(HephaestusTest, PerformanceComparison) {
         << "ArchetypeKey operations should be constant time and very fast";
 }
 
+TEST(HephaestusTest, StableComponentTypeIds) {
+    struct First : Component<First> {
+        int value;
+    };
+    struct Second : Component<Second> {
+        int value;
+    };
+    struct Third : Component<Third> {
+        int value;
+    };
+
+    // Ids are handed out in registration order, registering up front makes them deterministic.
+    register_components<First, Second, Third>();
+    const auto first_id = get_component_type_id<First>();
+    EXPECT_EQ(get_component_type_id<Second>(), first_id + 1);
+    EXPECT_EQ(get_component_type_id<Third>(), first_id + 2);
+    EXPECT_EQ(get_component_type_id<const Second&>(), first_id + 1);
+
+    // Registering again never reassigns an id.
+    register_components<Third, Second, First>();
+    EXPECT_EQ(get_component_type_id<First>(), first_id);
+    EXPECT_EQ(get_component_type_id<Third>(), first_id + 2);
+
+    EXPECT_LT(get_component_type_id<Third>(), MAX_COMPONENT_TYPES);
+    EXPECT_EQ(ArchetypeKey::STORAGE_SIZE * 64, MAX_COMPONENT_TYPES);
+}
+
+TEST(HephaestusTest, ArchetypeKeyWideOperations) {
+    constexpr auto LAST = ArchetypeKey::STORAGE_SIZE - 1;
+
+    ArchetypeKey::StorageType low{};
+    low[0] = 0b1010;
+    ArchetypeKey::StorageType high{};
+    high[LAST] = 1ULL << 63U;
+    ArchetypeKey::StorageType both = low;
+    both[LAST] |= high[LAST];
+
+    const ArchetypeKey low_key{low};
+    const ArchetypeKey high_key{high};
+    const ArchetypeKey both_key{both};
+
+    EXPECT_TRUE(low_key.is_subset_of(both_key));
+    EXPECT_TRUE(high_key.is_subset_of(both_key));
+    EXPECT_FALSE(both_key.is_subset_of(high_key));
+    EXPECT_FALSE(low_key.intersects_with(high_key));
+    EXPECT_TRUE(high_key.intersects_with(both_key));
+    EXPECT_NE(low_key, both_key);
+    EXPECT_EQ(both_key, ArchetypeKey{both});
+    EXPECT_FALSE(high_key.empty());
+    EXPECT_TRUE(ArchetypeKey{}.empty());
+
+    // The same operations are usable in constant expressions.
+    constexpr ArchetypeKey CONSTEXPR_LOW{ArchetypeKey::StorageType{0b1}};
+    constexpr ArchetypeKey CONSTEXPR_BOTH{ArchetypeKey::StorageType{0b11}};
+    static_assert(CONSTEXPR_LOW.is_subset_of(CONSTEXPR_BOTH));
+    static_assert(CONSTEXPR_LOW.intersects_with(CONSTEXPR_BOTH));
+    static_assert(CONSTEXPR_LOW != CONSTEXPR_BOTH);
+}
+
+TEST(HephaestusTest, ArchetypeLookupAndQueryMatching) {
+    // Synthetic keys, the low 14 bits make every key unique and the next 8 bits spread them over a
+    // few extra component ids to get realistic looking keys. Timings are in atlas_bench.
+    const auto make_key = [](const std::size_t index) {
+        constexpr std::size_t UNIQUE_BITS = 14;
+        constexpr std::size_t SPREAD_BITS = 8;
+
+        ArchetypeKey key;
+        const auto unique = index + 1;
+        for (std::size_t bit = 0; bit < UNIQUE_BITS; ++bit) {
+            if ((unique & (std::size_t{1} << bit)) != 0) {
+                key.add_component(bit);
+            }
+        }
+        key.add_component(UNIQUE_BITS + (index % SPREAD_BITS));
+        return key;
+    };
+
+    ArchetypeKey query_key;
+    query_key.add_component(0).add_component(1);
+
+    for (const std::size_t num_archetypes : {10UZ, 1000UZ, 10000UZ}) {
+        ArchetypeMap map;
+        map.reserve(num_archetypes);
+        for (std::size_t i = 0; i < num_archetypes; ++i) {
+            map.emplace(make_key(i), std::make_unique<Archetype>(1));
+        }
+        ASSERT_EQ(map.size(), num_archetypes);
+
+        for (std::size_t i = 0; i < num_archetypes; ++i) {
+            const auto id = map.find_id(make_key(i));
+            ASSERT_NE(id, INVALID_ARCHETYPE_ID);
+            EXPECT_EQ(map.get_key(id), make_key(i));
+        }
+        ArchetypeKey missing;
+        missing.add_component(0).add_component(1).add_component(40);
+        EXPECT_EQ(map.find_id(missing), INVALID_ARCHETYPE_ID);
+
+        // Every key with the two low bits of its unique part set, one in four.
+        std::size_t matched = 0;
+        for (const auto& [key, archetype] : map) {
+            matched += query_key.is_subset_of(key) ? 1 : 0;
+        }
+        EXPECT_EQ(matched, (num_archetypes + 1) / 4);
+    }
+}
+
 TEST(HephaestusTest, MemoryFootprintComparison) {
     const auto signature = make_archetype_key<Position, Velocity, Health>();
 
@@ -486,4 +633,2484 @@ TEST(HephaestusTest, PreCreateArchetypes) {
     USE_SHOULD_STOP = true;
     Engine<TestArchetypeGame>{}.run();
 }
+
+TEST(HephaestusTest, MultipleIsolatedWorlds) {
+    class TestWorldsGame : public MockGame {
+      public:
+        // Overrides MockGame::start so the default world only holds the entity created here.
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& default_world = hephaestus.get_world();
+            auto& match_world = hephaestus.create_world();
+
+            EXPECT_EQ(hephaestus.get_num_worlds(), 2);
+            EXPECT_NE(default_world.get_id(), match_world.get_id());
+
+            default_world.create_entity(Position{.x = 0.F, .y = 0.F});
+            match_world.create_entity(Position{.x = 0.F, .y = 0.F});
+            match_world.create_entity(Position{.x = 0.F, .y = 0.F});
+
+            default_world.create_system([this](const IEngine& engine, std::tuple<Position&> data) {
+                default_runs++;
+            });
+            match_world.create_system([this](const IEngine& engine, std::tuple<Position&> data) {
+                match_runs++;
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& default_world = hephaestus.get_world();
+            auto& match_world = hephaestus.get_world(1);
+
+            hephaestus.tick();
+            EXPECT_EQ(default_runs, 1) << "Each world should only see its own entities.";
+            EXPECT_EQ(match_runs, 2) << "Each world should only see its own entities.";
+
+            EXPECT_EQ(default_world.get_stats().tot_num_created_ents, 1);
+            EXPECT_EQ(match_world.get_stats().tot_num_created_ents, 2);
+            EXPECT_EQ(hephaestus.get_tot_num_created_ents(), 3);
+
+            // Entity ids are allocated per world, so both worlds have an entity 0. Destroying the
+            // one of the match world leaves the one of the default world alone.
+            match_world.destroy_entity(0);
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(default_runs, 3);
+            EXPECT_EQ(match_runs, 5) << "The match world should only have one entity left.";
+
+            EXPECT_EQ(default_world.get_stats().tot_num_destroyed_ents, 0);
+            EXPECT_EQ(match_world.get_stats().tot_num_destroyed_ents, 1);
+            EXPECT_EQ(match_world.get_stats().num_ticks, 3);
+
+            stop_game();
+        }
+
+      private:
+        std::uint32_t default_runs = 0;
+        std::uint32_t match_runs = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestWorldsGame>{}.run();
+}
+
+TEST(HephaestusTest, TagComponentsAndFilters) {
+    struct Enemy : Component<Enemy> {};
+    struct Dead : Component<Dead> {};
+
+    static_assert(TypeOfTagComponent<Enemy>);
+    static_assert(TypeOfTagComponent<const Dead&>);
+    static_assert(!TypeOfTagComponent<Position>);
+
+    // Tags don't hold any data to write to, they never cause conflicts between systems.
+    const auto dependencies = make_system_dependencies<Position&, Enemy&>();
+    const auto enemy_it = std::ranges::find_if(dependencies, [](const SystemDependencies& access) {
+        return access.type == std::type_index(typeid(Enemy));
+    });
+    ASSERT_NE(enemy_it, dependencies.end());
+    EXPECT_TRUE(enemy_it->is_read_only);
+
+    class TestTagsGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Enemy{});
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Enemy{}, Dead{});
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+            // An archetype made up of only tags has no columns at all.
+            hephaestus.create_entity(Dead{});
+
+            hephaestus.create_system<With<Enemy>, Without<Dead>>(
+                [this](const IEngine& engine, std::tuple<Position&> data) {
+                    alive_enemy_runs++;
+                }
+            );
+            hephaestus.create_system([this](const IEngine& engine,
+                                            std::tuple<Position&, const Enemy&> data) {
+                enemy_tuple_runs++;
+            });
+            hephaestus.create_system<With<Enemy>>([this](const IEngine& engine, std::tuple<> data) {
+                enemy_filter_runs++;
+            });
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<const Dead&> data) {
+                dead_runs++;
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            hephaestus.tick();
+            EXPECT_EQ(alive_enemy_runs, 1);
+            EXPECT_EQ(enemy_tuple_runs, 2);
+            EXPECT_EQ(enemy_filter_runs, 2);
+            EXPECT_EQ(dead_runs, 2);
+
+            hephaestus.destroy_entity(0);
+            hephaestus.destroy_entity(3);
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(alive_enemy_runs, 2) << "The only alive enemy has been destroyed.";
+            EXPECT_EQ(enemy_tuple_runs, 5);
+            EXPECT_EQ(enemy_filter_runs, 5);
+            EXPECT_EQ(dead_runs, 5) << "The tag only entity has been destroyed.";
+
+            stop_game();
+        }
+
+      private:
+        std::uint32_t alive_enemy_runs = 0;
+        std::uint32_t enemy_tuple_runs = 0;
+        std::uint32_t enemy_filter_runs = 0;
+        std::uint32_t dead_runs = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestTagsGame>{}.run();
+}
+
+TEST(HephaestusTest, SparseSetStorage) {
+    struct Selected : Component<Selected, SparseStorage> {
+        std::uint32_t value;
+    };
+
+    static_assert(TypeOfSparseComponent<Selected>);
+    static_assert(!TypeOfSparseComponent<Position>);
+    const auto key_with_sparse = make_archetype_key<Position, Selected>();
+    EXPECT_EQ(key_with_sparse, make_archetype_key<Position>())
+        << "Sparse components are not part of the archetype key.";
+
+    // Entities far apart end up in different pages.
+    SparseSet<Selected> set;
+    const auto far_entity = static_cast<Entity>(SparseSetBase::PAGE_SIZE * 3);
+    set.emplace(0, Selected{.value = 0});
+    set.emplace(far_entity, Selected{.value = 1});
+    set.emplace(7, Selected{.value = 7});
+    EXPECT_EQ(set.size(), 3);
+    EXPECT_TRUE(set.contains(far_entity));
+    EXPECT_FALSE(set.contains(far_entity + 1));
+    EXPECT_FALSE(set.contains(SparseSetBase::PAGE_SIZE));
+
+    EXPECT_TRUE(set.remove(0));
+    EXPECT_FALSE(set.remove(0));
+    EXPECT_FALSE(set.contains(0));
+    EXPECT_EQ(set.get(far_entity).value, 1);
+    EXPECT_EQ(set.get(7).value, 7);
+
+    set.emplace(7, Selected{.value = 8});
+    EXPECT_EQ(set.size(), 2);
+    EXPECT_EQ(set.get(7).value, 8);
+
+    class TestSparseGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Selected{.value = 1});
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+
+            hephaestus.create_system([this](const IEngine& engine,
+                                            std::tuple<const Position&, Selected&> data) {
+                auto& [position, selected] = data;
+                last_selected_value = selected.value;
+                selected_runs++;
+            });
+            hephaestus.create_system<Without<Selected>>(
+                [this](const IEngine& engine, std::tuple<const Position&> data) {
+                    unselected_runs++;
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            hephaestus.tick();
+            EXPECT_EQ(selected_runs, 1);
+            EXPECT_EQ(last_selected_value, 1);
+            EXPECT_EQ(unselected_runs, 2);
+
+            hephaestus.remove_component<Selected>(0);
+            hephaestus.add_component(1, Selected{.value = 2});
+            hephaestus.tick();
+            EXPECT_EQ(selected_runs, 2);
+            EXPECT_EQ(last_selected_value, 2);
+            EXPECT_EQ(unselected_runs, 4);
+
+            // Destroying the entity removes it from the sparse sets as well.
+            hephaestus.destroy_entity(1);
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(selected_runs, 3);
+            EXPECT_EQ(unselected_runs, 8);
+
+            stop_game();
+        }
+
+      private:
+        std::uint32_t selected_runs = 0;
+        std::uint32_t unselected_runs = 0;
+        std::uint32_t last_selected_value = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestSparseGame>{}.run();
+}
+
+TEST(HephaestusTest, ResourcesAsSystemParams) {
+    struct Gravity {
+        float value = 0.F;
+    };
+    struct FrameCounter {
+        std::uint32_t frames = 0;
+    };
+
+    // Resource accesses are part of the dependencies, and never conflict with components. The
+    // systems have disjoint components, only the resource orders them.
+    auto writer = make_system_dependencies<Position&>();
+    EXPECT_FALSE(
+        are_dependencies_overlapping(writer, make_system_dependencies<const Velocity&>())
+    );
+    SystemParams<Res<Gravity>>::add_dependencies(writer);
+    auto reader = make_system_dependencies<const Velocity&>();
+    SystemParams<Res<const Gravity>>::add_dependencies(reader);
+    auto other_reader = make_system_dependencies<Health&>();
+    SystemParams<Res<const Gravity>>::add_dependencies(other_reader);
+
+    EXPECT_EQ(writer.size(), 2);
+    EXPECT_TRUE(are_dependencies_overlapping(writer, reader));
+    EXPECT_TRUE(are_dependencies_overlapping(writer, other_reader));
+    EXPECT_FALSE(are_dependencies_overlapping(reader, other_reader));
+
+    class TestResourcesGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            hephaestus.insert_resource(Gravity{.value = -1.F});
+            hephaestus.insert_resource(FrameCounter{});
+
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+
+            hephaestus.create_system([](const IEngine& engine,
+                                        std::tuple<Position&> data,
+                                        Res<const Gravity> gravity) {
+                std::get<0>(data).y += gravity->value;
+            });
+            hephaestus.create_system([](const IEngine& engine,
+                                        std::tuple<> data,
+                                        Res<FrameCounter> counter) { counter->frames++; });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(hephaestus.get_resource<FrameCounter>().frames, 2)
+                << "A system without components runs once per frame.";
+
+            stop_game();
+        }
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestResourcesGame>{}.run();
+}
+
+TEST(HephaestusTest, ParallelSystemsVisitEveryEntity) {
+    // Enough entities for the systems to be run in parallel chunks.
+    constexpr std::uint32_t NUM_ENTITIES = 1000;
+
+    class TestGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                hephaestus.create_entity(Health{.value = 0});
+            }
+
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<Health&> data) {
+                std::get<0>(data).value++;
+                num_visits++;
+            });
+            // Runs after the writer, every entity should have been incremented once per frame.
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<const Health&> data) {
+                if (std::get<0>(data).value != num_ticks) {
+                    num_skipped++;
+                }
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            for (num_ticks = 1; num_ticks <= 2; ++num_ticks) {
+                hephaestus.tick();
+            }
+            EXPECT_EQ(num_visits.load(), NUM_ENTITIES * 2);
+            EXPECT_EQ(num_skipped.load(), 0);
+
+            stop_game();
+        }
+
+      private:
+        std::uint32_t num_ticks = 0;
+        std::atomic<std::uint32_t> num_visits = 0;
+        std::atomic<std::uint32_t> num_skipped = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, AllocatorPoliciesAndMemoryStats) {
+    constexpr std::size_t NUM_VALUES = 1000;
+
+    for (const auto policy : {
+             AllocatorPolicy{.kind = AllocatorPolicy::Kind::Heap},
+             AllocatorPolicy{.kind = AllocatorPolicy::Kind::Pages, .use_huge_pages = false},
+             AllocatorPolicy{.kind = AllocatorPolicy::Kind::Pages, .use_huge_pages = true},
+         }) {
+        WorldMemory memory{policy};
+        {
+            std::pmr::vector<std::uint64_t> values{memory.get_resource()};
+            values.resize(NUM_VALUES);
+
+            const auto stats = memory.get_stats();
+            EXPECT_GE(stats.bytes_used, NUM_VALUES * sizeof(std::uint64_t));
+            EXPECT_GE(stats.bytes_reserved, stats.bytes_used);
+            EXPECT_EQ(stats.num_live_allocations, 1);
+        }
+
+        const auto stats = memory.get_stats();
+        EXPECT_EQ(stats.bytes_used, 0);
+        EXPECT_EQ(stats.num_live_allocations, 0);
+        EXPECT_GE(stats.peak_bytes_used, NUM_VALUES * sizeof(std::uint64_t));
+        EXPECT_EQ(stats.get_waste(), stats.bytes_reserved);
+    }
+
+    // Small allocations of many sizes share pages instead of reserving a huge page per pool.
+    {
+        WorldMemory memory{AllocatorPolicy{
+            .kind = AllocatorPolicy::Kind::Pages,
+            .use_huge_pages = true,
+        }};
+        std::vector<std::pmr::vector<std::byte>> blocks;
+        for (std::size_t size = 8; size <= 4096; size *= 2) {
+            blocks.emplace_back(size, memory.get_resource());
+        }
+        EXPECT_EQ(memory.get_stats().bytes_reserved, AllocatorPolicy::HUGE_PAGE_SIZE);
+    }
+
+    class TestMemoryGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& paged_world = hephaestus.create_world(
+                AllocatorPolicy{.kind = AllocatorPolicy::Kind::Pages}
+            );
+
+            for (std::uint32_t i = 0; i < 100; ++i) {
+                paged_world.create_entity(Position{.x = 0.F, .y = 0.F}, Health{.value = i});
+            }
+            paged_world.create_system([](const IEngine& engine, std::tuple<Position&> data) {});
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& paged_world = hephaestus.get_world(1);
+            // The archetype and its bookkeeping are created right away, the entities at the
+            // beginning of the next tick.
+            const auto bytes_used_before_tick = paged_world.get_memory_stats().bytes_used;
+
+            hephaestus.tick();
+            const auto stats = paged_world.get_memory_stats();
+            EXPECT_GE(
+                stats.bytes_used - bytes_used_before_tick,
+                100 * (sizeof(Position) + sizeof(Health))
+            );
+            EXPECT_GE(stats.bytes_reserved, stats.bytes_used);
+
+            stop_game();
+        }
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestMemoryGame>{}.run();
+}
+
+TEST(HephaestusTest, ArchetypeCompaction) {
+    class TestCompactionGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& world = hephaestus.get_world();
+            world.create_archetype<Position, Health>(16);
+            for (std::uint32_t i = 0; i < 2000; ++i) {
+                world.create_entity(Position{.x = 0.F, .y = 0.F}, Health{.value = i});
+            }
+
+            world.create_system([this](const IEngine& engine, std::tuple<Health&> data) {
+                num_updated.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& world = hephaestus.get_world();
+            world.set_compaction_settings(CompactionSettings{.time_budget = 0.0});
+
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 2000);
+
+            for (Entity entity = 10; entity < 2000; ++entity) {
+                world.destroy_entity(entity);
+            }
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 2000) << "Destroyed after the systems of the tick.";
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 10);
+            EXPECT_EQ(world.get_stats().tot_num_compactions, 0) << "Compaction is disabled.";
+
+            // Shrinking moves the columns, the query must not hand out the old rows.
+            world.compact(1.0);
+            EXPECT_EQ(world.get_stats().tot_num_compactions, 1);
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 10);
+
+            world.compact(1.0);
+            EXPECT_EQ(world.get_stats().tot_num_compactions, 1) << "Already at its target size.";
+
+            // Retired when empty, revived by the next entity created in it.
+            for (Entity entity = 0; entity < 10; ++entity) {
+                world.destroy_entity(entity);
+            }
+            hephaestus.tick();
+            num_updated = 0;
+            world.compact(1.0);
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 0);
+
+            world.create_entity(Position{.x = 0.F, .y = 0.F}, Health{.value = 0});
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 1);
+
+            stop_game();
+        }
+
+      private:
+        std::atomic<std::uint32_t> num_updated = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestCompactionGame>{}.run();
+}
+
+TEST(HephaestusTest, IntrospectionAndJsonDump) {
+    struct Stunned : Component<Stunned, SparseStorage> {
+        float time_left = 0.F;
+    };
+
+    class TestIntrospectionGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_archetype<Position, Health>(64);
+            for (std::uint32_t i = 0; i < 10; ++i) {
+                hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Health{.value = i});
+            }
+            hephaestus.add_component(0, Stunned{.time_left = 1.F});
+
+            hephaestus.create_system([](const IEngine& engine, std::tuple<Health&> data) {});
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.tick();
+            hephaestus.tick();
+
+            const auto worlds = hephaestus.collect_introspection();
+            ASSERT_EQ(worlds.size(), 1);
+            const auto& world = worlds.front();
+            EXPECT_EQ(world.stats.tot_num_created_ents, 10);
+
+            ASSERT_EQ(world.archetypes.size(), 1);
+            const auto& archetype = world.archetypes.front();
+            EXPECT_EQ(archetype.num_entities, 10);
+            EXPECT_GE(archetype.capacity, 64);
+            EXPECT_EQ(archetype.columns.size(), 2);
+            EXPECT_EQ(
+                archetype.column_bytes_used,
+                10 * (sizeof(Position) + sizeof(Health))
+            );
+            EXPECT_GE(archetype.column_bytes_reserved, archetype.column_bytes_used);
+            EXPECT_GT(archetype.index_bytes, 0);
+            EXPECT_LT(archetype.get_occupancy(), 1.0);
+
+            ASSERT_EQ(world.sparse_sets.size(), 1);
+            EXPECT_EQ(world.sparse_sets.front().component_id, get_component_type_id<Stunned>());
+            EXPECT_EQ(world.sparse_sets.front().num_entities, 1);
+            EXPECT_EQ(world.components.size(), 3);
+
+            ASSERT_EQ(world.queries.size(), 1);
+            EXPECT_EQ(world.queries.front().num_cached, 10);
+            EXPECT_EQ(world.queries.front().num_matched_archetypes, 1);
+            EXPECT_EQ(world.queries.front().num_rebuilds, 1) << "Nothing changed between ticks.";
+
+            std::ostringstream json;
+            write_introspection_json(json, worlds);
+            EXPECT_TRUE(json.str().starts_with(R"([{"world_id":0,"stats":{)"));
+            EXPECT_NE(json.str().find(R"("num_entities":10,"capacity":)"), std::string::npos);
+            EXPECT_TRUE(json.str().ends_with("]}]"));
+
+            stop_game();
+        }
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestIntrospectionGame>{}.run();
+}
+
+TEST(HephaestusTest, OwningGroups) {
+    struct Body : Component<Body, SparseStorage> {
+        float mass = 1.F;
+    };
+    struct Impulse : Component<Impulse, SparseStorage> {
+        float value = 0.F;
+    };
+
+    {
+        SparseSets sets;
+        for (Entity entity = 0; entity < 6; ++entity) {
+            static_cast<void>(sets.emplace(entity, Body{.mass = static_cast<float>(entity)}));
+        }
+        static_cast<void>(sets.emplace(4, Impulse{.value = 4.F}));
+
+        // Existing entities are packed when the group is created.
+        auto& group = sets.create_group<Body, Impulse>();
+        EXPECT_EQ(group.size(), 1);
+        EXPECT_TRUE(group.contains(4));
+
+        const auto changed = sets.emplace(1, Impulse{.value = 1.F});
+        EXPECT_TRUE(changed.has_component(get_component_type_id<Body>()))
+            << "Entering the group moves the entity in every owned set.";
+        static_cast<void>(sets.emplace(5, Impulse{.value = 5.F}));
+        EXPECT_EQ(group.size(), 3);
+
+        static_cast<void>(sets.remove<Body>(1));
+        static_cast<void>(sets.remove_entity(4));
+        EXPECT_EQ(group.size(), 1);
+
+        // Packed and aligned, the first size() slots of both sets belong to the same entities.
+        auto& bodies = sets.get<Body>();
+        auto& impulses = sets.get<Impulse>();
+        for (std::size_t index = 0; index < group.size(); ++index) {
+            EXPECT_EQ(bodies.get_entities()[index], impulses.get_entities()[index]);
+            EXPECT_EQ(bodies.get_components()[index].mass, impulses.get_components()[index].value);
+        }
+        EXPECT_TRUE(group.contains(5));
+        EXPECT_FALSE(group.contains(0));
+    }
+
+    class TestGroupGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_group<Body, Impulse>();
+
+            // Spread over two archetypes, the group doesn't care.
+            for (std::uint32_t i = 0; i < 50; ++i) {
+                hephaestus.create_entity(
+                    Position{.x = 0.F, .y = 0.F},
+                    Body{},
+                    Impulse{.value = 1.F}
+                );
+                hephaestus.create_entity(Health{.value = i}, Body{}, Impulse{.value = 1.F});
+                hephaestus.create_entity(Health{.value = i}, Body{});
+            }
+
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<Body&, const Impulse&> data) {
+                    auto& [body, impulse] = data;
+                    body.mass += impulse.value;
+                    num_updated.fetch_add(1, std::memory_order_relaxed);
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 100);
+
+            hephaestus.remove_component<Impulse>(0);
+            hephaestus.add_component(2, Impulse{.value = 1.F});
+            hephaestus.tick();
+            EXPECT_EQ(num_updated.exchange(0), 100);
+
+            const auto introspection = hephaestus.get_world().collect_introspection();
+            ASSERT_EQ(introspection.queries.size(), 1);
+            EXPECT_TRUE(introspection.queries.front().uses_group);
+            EXPECT_EQ(introspection.queries.front().num_matched_archetypes, 0);
+
+            stop_game();
+        }
+
+      private:
+        std::atomic<std::uint32_t> num_updated = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGroupGame>{}.run();
+}
+
+TEST(HephaestusTest, HierarchyPropagation) {
+    struct Local : Component<Local> {
+        Entity entity = 0;
+        float offset = 1.F;
+    };
+    struct Global : Component<Global> {
+        float offset = 0.F;
+    };
+
+    {
+        Hierarchy hierarchy;
+        EXPECT_TRUE(hierarchy.set_parent(1, 0));
+        EXPECT_TRUE(hierarchy.set_parent(2, 1));
+        EXPECT_TRUE(hierarchy.set_parent(3, 0));
+        EXPECT_FALSE(hierarchy.set_parent(0, 2)) << "0 is an ancestor of 2.";
+
+        hierarchy.sort();
+        const auto children = hierarchy.get_children(0);
+        ASSERT_EQ(children.size(), 2);
+        EXPECT_EQ(children[0], 1);
+        EXPECT_EQ(children[1], 3);
+
+        EXPECT_TRUE(hierarchy.remove_entity(1));
+        hierarchy.sort();
+        EXPECT_EQ(hierarchy.get_parent(2), NO_PARENT) << "Orphans become roots.";
+        EXPECT_EQ(hierarchy.get_children(0).size(), 1);
+    }
+
+    constexpr Entity NUM_ENTITIES = 300;
+
+    class TestHierarchyGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            // 0 <- 1 <- 2 <- leaves, every entity adds 1 to the offset of its parent.
+            for (Entity entity = 0; entity < NUM_ENTITIES; ++entity) {
+                hephaestus.create_entity(Local{.entity = entity}, Global{});
+            }
+            // Not matched by the system, links to it are ignored.
+            hephaestus.create_entity(Local{.entity = NUM_ENTITIES});
+            globals.resize(NUM_ENTITIES);
+
+            hephaestus.create_hierarchy_system(
+                [this](
+                    const IEngine& engine,
+                    std::tuple<const Local&, Global&> components,
+                    const std::tuple<const Local&, Global&>* parent
+                ) {
+                    auto& [local, global] = components;
+                    const auto parent_offset = parent != nullptr ? std::get<1>(*parent).offset
+                                                                 : 0.F;
+                    global.offset = parent_offset + local.offset;
+                    globals[local.entity] = global.offset;
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.tick();
+            EXPECT_EQ(globals[2], 1.F);
+
+            hephaestus.set_parent(1, 0);
+            hephaestus.set_parent(2, 1);
+            for (Entity leaf = 3; leaf < NUM_ENTITIES; ++leaf) {
+                hephaestus.set_parent(leaf, 2);
+            }
+            hephaestus.tick();
+            EXPECT_EQ(globals[2], 3.F);
+            EXPECT_EQ(globals[NUM_ENTITIES - 1], 4.F);
+
+            // Moving the leaves to the root moves them up two levels.
+            for (Entity leaf = 3; leaf < NUM_ENTITIES; ++leaf) {
+                hephaestus.set_parent(leaf, 0);
+            }
+            hephaestus.set_parent(3, NUM_ENTITIES);
+            hephaestus.tick();
+            EXPECT_EQ(globals[4], 2.F);
+            EXPECT_EQ(globals[3], 1.F) << "The parent isn't matched, 3 is a root.";
+
+            // Destroying the middle of the chain makes 2 a root.
+            hephaestus.destroy_entity(1);
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(hephaestus.get_world().get_parent(2), NO_PARENT);
+            EXPECT_EQ(globals[2], 1.F);
+
+            stop_game();
+        }
+
+      private:
+        // Written by index from the system, every entity writes its own slot.
+        std::vector<float> globals;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestHierarchyGame>{}.run();
+}
+
+TEST(HephaestusTest, SpatialIndex) {
+    {
+        SpatialHash hash{2.F};
+        hash.begin_update();
+        hash.update(0, 0.F, 0.F);
+        hash.update(1, 3.F, 0.F);
+        hash.update(2, -5.F, -5.F);
+        hash.end_update();
+
+        std::vector<Entity> found;
+        hash.query_radius(0.F, 0.F, 3.5F, [&found](Entity entity) { found.emplace_back(entity); });
+        std::ranges::sort(found);
+        EXPECT_EQ(found, (std::vector<Entity>{0, 1}));
+
+        found.clear();
+        hash.query_aabb(-6.F, -6.F, -4.F, -4.F, [&found](Entity entity) {
+            found.emplace_back(entity);
+        });
+        EXPECT_EQ(found, (std::vector<Entity>{2}));
+
+        // 0 crosses into another cell, 2 isn't submitted and is dropped.
+        hash.begin_update();
+        hash.update(0, 10.F, 10.F);
+        hash.update(1, 3.F, 0.F);
+        hash.end_update();
+        EXPECT_EQ(hash.size(), 2);
+
+        found.clear();
+        hash.query_radius(0.F, 0.F, 100.F, [&found](Entity entity) { found.emplace_back(entity); });
+        std::ranges::sort(found);
+        EXPECT_EQ(found, (std::vector<Entity>{0, 1}));
+
+        // Bounds past the range of the cells are clamped to the outermost ones.
+        constexpr auto INF = std::numeric_limits<float>::infinity();
+        found.clear();
+        hash.query_aabb(-INF, -INF, INF, INF, [&found](Entity entity) {
+            found.emplace_back(entity);
+        });
+        std::ranges::sort(found);
+        EXPECT_EQ(found, (std::vector<Entity>{0, 1}));
+
+        found.clear();
+        hash.query_aabb(-1e30F, -1.F, 1e30F, 1.F, [&found](Entity entity) {
+            found.emplace_back(entity);
+        });
+        EXPECT_EQ(found, (std::vector<Entity>{1}));
+
+        found.clear();
+        hash.query_radius(1e30F, 1e30F, 1.F, [&found](Entity entity) {
+            found.emplace_back(entity);
+        });
+        EXPECT_TRUE(found.empty());
+    }
+
+    class TestSpatialIndexGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            // A 10x10 grid with unit spacing, entity 0 at the origin keeps moving away from it.
+            hephaestus.create_entity(
+                Position{.x = 0.F, .y = 0.F},
+                Velocity{.dx = 100.F, .dy = 0.F}
+            );
+            for (int i = 1; i < 100; ++i) {
+                hephaestus.create_entity(
+                    Position{.x = static_cast<float>(i % 10), .y = static_cast<float>(i / 10)}
+                );
+            }
+            hephaestus.create_spatial_index<Position>(2.F);
+
+            hephaestus.create_system(
+                [](const IEngine& engine, std::tuple<Position&, const Velocity&> data) {
+                    auto& [position, velocity] = data;
+                    position.x += velocity.dx;
+                }
+            );
+            hephaestus.create_system([this](
+                                         const IEngine& engine,
+                                         std::tuple<> data,
+                                         Res<const SpatialIndex<Position>> index
+                                     ) {
+                near_origin.clear();
+                index->query_radius(0.F, 0.F, 1.5F, [this](Entity entity) {
+                    near_origin.emplace_back(entity);
+                });
+                std::ranges::sort(near_origin);
+
+                far_away.clear();
+                index->query_aabb(99.F, -1.F, 101.F, 1.F, [this](Entity entity) {
+                    far_away.emplace_back(entity);
+                });
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            // The index is refreshed at the end of the frame, the first frame sees it empty.
+            hephaestus.tick();
+            EXPECT_TRUE(near_origin.empty());
+
+            hephaestus.tick();
+            EXPECT_EQ(near_origin, (std::vector<Entity>{1, 10, 11}));
+            EXPECT_EQ(far_away, (std::vector<Entity>{0}));
+
+            hephaestus.destroy_entity(1);
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(near_origin, (std::vector<Entity>{10, 11}));
+            EXPECT_TRUE(far_away.empty()) << "Entity 0 moved on to x = 300.";
+
+            stop_game();
+        }
+
+      private:
+        std::vector<Entity> near_origin;
+        std::vector<Entity> far_away;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestSpatialIndexGame>{}.run();
+}
+
+TEST(HephaestusTest, EnableAndDisableEntities) {
+    struct Charge : Component<Charge, SparseStorage> {
+        float value = 0.F;
+    };
+    struct Shield : Component<Shield, SparseStorage> {
+        float value = 0.F;
+    };
+
+    static constexpr std::uint32_t NUM_ENTITIES = 300;
+
+    class TestEnabledGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_group<Charge, Shield>();
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Health{.value = i});
+            }
+            for (Entity entity = 0; entity < 3; ++entity) {
+                hephaestus.add_component(entity, Charge{});
+                hephaestus.add_component(entity, Shield{});
+            }
+
+            // Enough entities for the parallel path.
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<Position&> data) {
+                std::get<0>(data).x += 1.F;
+                num_positions.fetch_add(1, std::memory_order_relaxed);
+            });
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<Charge&, Shield&> data) {
+                    num_grouped.fetch_add(1, std::memory_order_relaxed);
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& world = hephaestus.get_world();
+            const auto tick = [&]() {
+                num_positions = 0;
+                num_grouped = 0;
+                hephaestus.tick();
+            };
+            const auto get_num_rebuilds = [&]() {
+                std::uint64_t num_rebuilds = 0;
+                for (const auto& query : world.collect_introspection().queries) {
+                    num_rebuilds += query.num_rebuilds;
+                }
+                return num_rebuilds;
+            };
+
+            tick();
+            EXPECT_EQ(num_positions, NUM_ENTITIES);
+            EXPECT_EQ(num_grouped, 3);
+            const auto num_rebuilds = get_num_rebuilds();
+
+            // A full chunk of 64, the chunk after it partially, and one of the grouped entities.
+            for (Entity entity = 0; entity < 130; ++entity) {
+                hephaestus.set_enabled(entity, false);
+            }
+            hephaestus.set_enabled(250, false);
+            tick();
+            EXPECT_EQ(num_positions, NUM_ENTITIES - 131);
+            EXPECT_EQ(num_grouped, 0);
+            EXPECT_FALSE(world.is_enabled(0));
+            EXPECT_TRUE(world.is_enabled(130));
+            EXPECT_EQ(get_num_rebuilds(), num_rebuilds) << "Toggling keeps the query caches.";
+
+            hephaestus.set_enabled(1, true);
+            tick();
+            EXPECT_EQ(num_positions, NUM_ENTITIES - 130);
+            EXPECT_EQ(num_grouped, 1);
+
+            // The last row moves into the hole of the destroyed entity along with its enabled bit.
+            hephaestus.set_enabled(NUM_ENTITIES - 1, false);
+            hephaestus.destroy_entity(131);
+            tick();
+            tick();
+            EXPECT_EQ(num_positions, NUM_ENTITIES - 1 - 131);
+            EXPECT_FALSE(world.is_enabled(NUM_ENTITIES - 1));
+
+            for (Entity entity = 0; entity < NUM_ENTITIES; ++entity) {
+                if (entity != 131) {
+                    hephaestus.set_enabled(entity, true);
+                }
+            }
+            tick();
+            EXPECT_EQ(num_positions, NUM_ENTITIES - 1);
+            EXPECT_EQ(num_grouped, 3);
+
+            stop_game();
+        }
+
+      private:
+        std::atomic<std::uint32_t> num_positions = 0;
+        std::atomic<std::uint32_t> num_grouped = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestEnabledGame>{}.run();
+}
+
+TEST(HephaestusTest, DisableGroupedEntitiesAfterRowMoves) {
+    struct Charge : Component<Charge, SparseStorage> {
+        Entity entity = 0;
+    };
+    struct Shield : Component<Shield, SparseStorage> {
+        float value = 0.F;
+    };
+
+    class TestGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_group<Charge, Shield>();
+
+            // All in the same archetype, only 1, 2 and 3 are in the group.
+            hephaestus.create_entity(Health{.value = 0});
+            for (Entity entity = 1; entity < 4; ++entity) {
+                hephaestus.create_entity(
+                    Health{.value = entity},
+                    Charge{.entity = entity},
+                    Shield{}
+                );
+            }
+
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Charge&, Shield&> data) {
+                    const std::scoped_lock lock{mutex};
+                    visited.emplace_back(std::get<0>(data).entity);
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto tick = [&]() {
+                visited.clear();
+                hephaestus.tick();
+                std::ranges::sort(visited);
+                return visited;
+            };
+
+            EXPECT_EQ(tick(), (std::vector<Entity>{1, 2, 3}));
+
+            // Destroying 0 moves the row of 3 into its hole, without touching the versions of
+            // the grouped components.
+            hephaestus.destroy_entity(0);
+            EXPECT_EQ(tick(), (std::vector<Entity>{1, 2, 3}));
+
+            hephaestus.set_enabled(1, false);
+            EXPECT_EQ(tick(), (std::vector<Entity>{2, 3}));
+
+            stop_game();
+        }
+
+      private:
+        std::mutex mutex;
+        std::vector<Entity> visited;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, ImmediateEntityHandles) {
+    static constexpr std::uint32_t NUM_SPAWNERS = 200;
+
+    class TestHandlesGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_archetype<Position>(NUM_SPAWNERS);
+            for (std::uint32_t i = 0; i < NUM_SPAWNERS; ++i) {
+                hephaestus.create_entity(Health{.value = i});
+            }
+
+            // Runs on the workers, every spawner creates an entity of its own.
+            hephaestus.create_system([this, &hephaestus](
+                                         const IEngine& engine,
+                                         std::tuple<const Health&> data
+                                     ) {
+                if (!should_spawn) {
+                    return;
+                }
+
+                const auto& [health] = data;
+                const auto entity = hephaestus.create_entity(
+                    Position{.x = static_cast<float>(health.value), .y = 0.F}
+                );
+                spawned[health.value] = entity;
+                // Destroying a handle created this frame waits for its creation, at the start of
+                // the next frame.
+                if (health.value % 2 == 1) {
+                    hephaestus.destroy_entity(entity);
+                }
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& world = hephaestus.get_world();
+
+            // The handles are usable in the frame they were created in.
+            const auto parent = hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+            const auto child = hephaestus.create_entity(Position{.x = 1.F, .y = 0.F});
+            EXPECT_EQ(parent, NUM_SPAWNERS);
+            EXPECT_EQ(child, NUM_SPAWNERS + 1);
+            hephaestus.set_parent(child, parent);
+            hephaestus.destroy_entity(hephaestus.create_entity(Position{.x = 2.F, .y = 0.F}));
+            hephaestus.tick();
+            EXPECT_EQ(world.get_parent(child), parent);
+            EXPECT_EQ(world.get_stats().tot_num_destroyed_ents, 1);
+
+            should_spawn = true;
+            hephaestus.tick();
+            EXPECT_EQ(world.get_stats().tot_num_destroyed_ents, 1);
+            should_spawn = false;
+            hephaestus.tick();
+            EXPECT_EQ(world.get_stats().tot_num_created_ents, NUM_SPAWNERS + 3 + NUM_SPAWNERS);
+            EXPECT_EQ(world.get_stats().tot_num_destroyed_ents, 1 + (NUM_SPAWNERS / 2));
+
+            std::ranges::sort(spawned);
+            EXPECT_EQ(std::ranges::adjacent_find(spawned), spawned.end()) << "Unique handles.";
+            EXPECT_EQ(spawned.front(), NUM_SPAWNERS + 3);
+            EXPECT_EQ(spawned.back(), (NUM_SPAWNERS * 2) + 2);
+
+            stop_game();
+        }
+
+      private:
+        std::atomic<bool> should_spawn = false;
+        // Written by index from the system, every spawner writes its own slot.
+        std::vector<Entity> spawned = std::vector<Entity>(NUM_SPAWNERS);
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestHandlesGame>{}.run();
+}
+
+TEST(HephaestusTest, DestroyEntitiesInTwoFrames) {
+    class TestGame : public MockGame {
+      public:
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto& stats = hephaestus.get_world().get_stats();
+            const auto entity = hephaestus.create_entity(
+                Position{.x = 0.F, .y = 0.F},
+                Velocity{.dx = 0.F, .dy = 0.F}
+            );
+            hephaestus.tick();
+
+            hephaestus.destroy_entity(entity);
+            hephaestus.tick();
+            EXPECT_EQ(stats.tot_num_destroyed_ents, 1);
+
+            // The handle is stale by now, destroying it again is dropped.
+            hephaestus.destroy_entity(entity);
+            hephaestus.destroy_entity(entity);
+            hephaestus.tick();
+            hephaestus.tick();
+            EXPECT_EQ(stats.tot_num_destroyed_ents, 1);
+
+            stop_game();
+        }
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, ReleaseLocationsOfDestroyedEntities) {
+    static constexpr std::uint32_t NUM_ENTITIES = 20000;
+    static constexpr std::uint32_t NUM_ROUNDS = 5;
+
+    class TestGame : public MockGame {
+      public:
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& world = hephaestus.get_world();
+            const auto churn = [&]() {
+                std::vector<Entity> entities;
+                for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                    entities.emplace_back(hephaestus.create_entity(
+                        Position{.x = 0.F, .y = 0.F},
+                        Velocity{.dx = 0.F, .dy = 0.F}
+                    ));
+                }
+                hephaestus.tick();
+                const auto alive_bytes = world.collect_introspection().location_bytes;
+                for (const auto entity : entities) {
+                    hephaestus.destroy_entity(entity);
+                }
+                hephaestus.tick();
+                return alive_bytes;
+            };
+
+            // Ids are never reused, the pages of the destroyed ones are freed.
+            const auto alive_bytes = churn();
+            const auto destroyed_bytes = world.collect_introspection().location_bytes;
+            EXPECT_LT(destroyed_bytes, alive_bytes / 2);
+            for (std::uint32_t round = 1; round < NUM_ROUNDS; ++round) {
+                EXPECT_LE(churn(), alive_bytes + (alive_bytes / 2));
+            }
+            EXPECT_LT(world.collect_introspection().location_bytes, alive_bytes / 2);
+
+            stop_game();
+        }
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, BatchedStructuralChanges) {
+    struct Marker : Component<Marker, SparseStorage> {
+        std::uint32_t value = 0;
+    };
+
+    // Above the threshold for applying the archetypes in parallel.
+    static constexpr std::uint32_t NUM_ENTITIES = 3000;
+
+    class TestBatchedGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                const auto position = Position{.x = static_cast<float>(i), .y = 0.F};
+                if (i % 3 == 0) {
+                    hephaestus.create_entity(position, Marker{.value = i});
+                } else if (i % 2 == 0) {
+                    hephaestus.create_entity(position, Health{.value = i});
+                } else {
+                    hephaestus.create_entity(position);
+                }
+            }
+
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Position&> data) {
+                    sum.fetch_add(static_cast<std::uint64_t>(std::get<0>(data).x));
+                    count.fetch_add(1);
+                }
+            );
+            hephaestus.create_system([this, &hephaestus](const IEngine& engine, std::tuple<> data) {
+                if (should_spawn) {
+                    // Created in the next frame, the destroy has to wait for it.
+                    const auto entity = hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+                    hephaestus.destroy_entity(entity);
+                }
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& world = hephaestus.get_world();
+            const auto tick = [&]() {
+                sum = 0;
+                count = 0;
+                hephaestus.tick();
+            };
+
+            tick();
+            EXPECT_EQ(count, NUM_ENTITIES);
+
+            // Every even entity, spread over all archetypes, plus a duplicate.
+            for (Entity entity = 0; entity < NUM_ENTITIES; entity += 2) {
+                hephaestus.destroy_entity(entity);
+            }
+            hephaestus.destroy_entity(0);
+            hephaestus.set_enabled(3, false);
+            tick();
+            tick();
+
+            // The odd entities are left, with their components and enabled bits intact.
+            const std::uint64_t half = NUM_ENTITIES / 2;
+            EXPECT_EQ(count, half - 1);
+            EXPECT_EQ(sum, (half * half) - 3);
+            EXPECT_FALSE(world.is_enabled(3));
+            EXPECT_TRUE(world.is_enabled(NUM_ENTITIES - 1));
+            EXPECT_EQ(world.get_stats().tot_num_destroyed_ents, half);
+
+            std::size_t num_markers = 0;
+            for (const auto& sparse_set : world.collect_introspection().sparse_sets) {
+                num_markers += sparse_set.num_entities;
+            }
+            EXPECT_EQ(num_markers, NUM_ENTITIES / 6) << "Only the odd multiples of 3 are left.";
+
+            should_spawn = true;
+            tick();
+            should_spawn = false;
+            tick();
+            tick();
+            EXPECT_EQ(world.get_stats().tot_num_created_ents, NUM_ENTITIES + 1);
+            EXPECT_EQ(world.get_stats().tot_num_destroyed_ents, half + 1);
+            EXPECT_EQ(count, half - 1);
+
+            stop_game();
+        }
+
+      private:
+        std::atomic<std::uint64_t> sum = 0;
+        std::atomic<std::uint32_t> count = 0;
+        bool should_spawn = false;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestBatchedGame>{}.run();
+}
+
+TEST(HephaestusTest, ZeroAllocationSteadyState) {
+    if constexpr (!AllocationTracker::IS_ENABLED) {
+        GTEST_SKIP() << "Needs -DHEPHAESTUS_TRACK_ALLOCATIONS=ON.";
+    }
+
+    // Enough entities for the system to be run in parallel chunks.
+    static constexpr std::uint32_t NUM_ENTITIES = 1000;
+    static constexpr std::uint64_t NUM_WARMUP_FRAMES = 3;
+    static constexpr std::uint64_t NUM_STEADY_FRAMES = 20;
+
+    class TestAllocationsGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                hephaestus.create_entity(
+                    Position{.x = 0.F, .y = 0.F},
+                    Velocity{.dx = 1.F, .dy = 1.F}
+                );
+            }
+
+            hephaestus.create_system(
+                [](const IEngine& engine, std::tuple<Position&, const Velocity&> data) {
+                    std::get<0>(data).x += std::get<1>(data).dx;
+                    std::get<0>(data).y += std::get<1>(data).dy;
+                }
+            );
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<> data) {
+                if (should_allocate) {
+                    buffers.emplace_back(NUM_ENTITIES);
+                }
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto& tracker = AllocationTracker::get();
+
+            should_allocate = true;
+            hephaestus.tick();
+            should_allocate = false;
+            const auto& frame = hephaestus.get_frame_allocations();
+            EXPECT_GE(frame.get(AllocationScope::SystemExecute).num_allocations, 1);
+            EXPECT_GE(frame.get(AllocationScope::SystemExecute).bytes, NUM_ENTITIES * sizeof(int));
+            EXPECT_GE(
+                frame.total.num_allocations,
+                frame.get(ECS_ALLOCATION_SCOPES).num_allocations
+            );
+
+            tracker.expect_no_allocations(NUM_WARMUP_FRAMES, ECS_ALLOCATION_SCOPES);
+            for (std::uint64_t i = 0; i < NUM_WARMUP_FRAMES + NUM_STEADY_FRAMES; ++i) {
+                hephaestus.tick();
+            }
+            tracker.stop_expecting_no_allocations();
+            EXPECT_EQ(tracker.get_num_violations(), 0);
+
+            stop_game();
+        }
+
+      private:
+        std::vector<std::vector<int>> buffers;
+        bool should_allocate = false;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestAllocationsGame>{}.run();
+}
+
+TEST(HephaestusTest, RecordAndReplayCommands) {
+    struct Selected : Component<Selected, SparseStorage> {
+        std::uint32_t frame = 0;
+    };
+
+    struct Snapshot {
+        std::map<std::vector<ComponentTypeId>, std::size_t> archetype_sizes;
+        std::size_t num_selected = 0;
+        double enabled_position_sum = 0.0;
+        std::vector<Entity> parents;
+        std::uint64_t num_created = 0;
+        std::uint64_t num_destroyed = 0;
+
+        auto operator==(const Snapshot&) const -> bool = default;
+    };
+
+    static constexpr std::uint32_t NUM_ENTITIES = 100;
+    static constexpr std::uint32_t NUM_FRAMES = 6;
+    static std::stringstream log;
+    static std::vector<Entity> linked;
+    static Snapshot recorded;
+
+    CommandReplayer garbage;
+    std::stringstream not_a_log{"not a command log"};
+    EXPECT_EQ(garbage.load(not_a_log).error(), CommandLogErrorCode::NotACommandLog);
+
+    // Commands on entities the log never created, or on handles no world hands out.
+    const auto expect_corrupt = [](const auto& record) {
+        std::stringstream corrupt;
+        {
+            CommandRecorder recorder{corrupt, 1.0 / 60.0};
+            record(recorder);
+        }
+        CommandReplayer replayer;
+        replayer.register_components<Position>();
+        EXPECT_EQ(replayer.load(corrupt).error(), CommandLogErrorCode::NotACommandLog);
+    };
+    expect_corrupt([](CommandRecorder& recorder) { recorder.record_destroy(7); });
+    expect_corrupt([](CommandRecorder& recorder) { recorder.record_set_enabled(7, false); });
+    expect_corrupt([](CommandRecorder& recorder) {
+        recorder.record_create(0, Position{});
+        recorder.record_set_parent(0, 7);
+    });
+    expect_corrupt([](CommandRecorder& recorder) {
+        recorder.record_create(0, Position{});
+        recorder.record_create(0, Position{});
+    });
+    expect_corrupt([](CommandRecorder& recorder) {
+        recorder.record_create(std::numeric_limits<Entity>::max(), Position{});
+    });
+
+    // Or on entities it has destroyed in an earlier frame. The destroys of a frame may repeat.
+    const auto destroy_in_first_frame = [](CommandRecorder& recorder) {
+        recorder.record_create(0, Position{});
+        recorder.record_create(1, Position{});
+        recorder.begin_frame();
+        recorder.record_destroy(0);
+        recorder.record_destroy(0);
+        recorder.end_frame();
+        recorder.begin_frame();
+        recorder.end_frame();
+    };
+    expect_corrupt([&](CommandRecorder& recorder) {
+        destroy_in_first_frame(recorder);
+        recorder.record_set_enabled(0, false);
+    });
+    expect_corrupt([&](CommandRecorder& recorder) {
+        destroy_in_first_frame(recorder);
+        recorder.record_set_parent(1, 0);
+    });
+    expect_corrupt([&](CommandRecorder& recorder) {
+        destroy_in_first_frame(recorder);
+        recorder.record_destroy(0);
+    });
+    std::stringstream destroyed;
+    {
+        CommandRecorder recorder{destroyed, 1.0 / 60.0};
+        destroy_in_first_frame(recorder);
+        recorder.record_set_enabled(1, false);
+    }
+    CommandReplayer replayer;
+    replayer.register_components<Position>();
+    EXPECT_TRUE(replayer.load(destroyed).has_value());
+
+    // The systems both games run, the commands only come from the recording or the replay.
+    class Simulation : public SimulationGame<double> {
+      protected:
+        auto create_systems(Hephaestus& hephaestus) -> void {
+            hephaestus.create_system(
+                [](const IEngine& engine, std::tuple<Position&, const Velocity&> data) {
+                    std::get<0>(data).x += std::get<1>(data).dx;
+                }
+            );
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Position&> data) {
+                    update_result([&](double& position_sum) {
+                        position_sum += std::get<0>(data).x;
+                    });
+                }
+            );
+        }
+
+        // position_sum is the result of the last tick.
+        static auto take_snapshot(Hephaestus& hephaestus, const double position_sum) -> Snapshot {
+            auto& world = hephaestus.get_world();
+            Snapshot snapshot{
+                .enabled_position_sum = position_sum,
+                .num_created = world.get_stats().tot_num_created_ents,
+                .num_destroyed = world.get_stats().tot_num_destroyed_ents,
+            };
+            const auto introspection = world.collect_introspection();
+            for (const auto& archetype : introspection.archetypes) {
+                if (archetype.num_entities > 0) {
+                    snapshot.archetype_sizes[archetype.component_ids] = archetype.num_entities;
+                }
+            }
+            for (const auto& set : introspection.sparse_sets) {
+                snapshot.num_selected += set.num_entities;
+            }
+            for (const auto entity : linked) {
+                snapshot.parents.emplace_back(world.get_parent(entity));
+            }
+            return snapshot;
+        }
+    };
+
+    class TestRecordGame : public Simulation {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            recorder.emplace(log, 1.0 / 60.0);
+            hephaestus.set_command_recorder(&*recorder);
+
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                const auto position = Position{.x = static_cast<float>(i), .y = 0.F};
+                if (i % 3 == 0) {
+                    live.emplace_back(hephaestus.create_entity(position, Velocity{.dx = 1.F}));
+                } else if (i % 3 == 1) {
+                    live.emplace_back(hephaestus.create_entity(
+                        position,
+                        Health{.value = i},
+                        Selected{.frame = 0}
+                    ));
+                } else {
+                    live.emplace_back(hephaestus.create_entity(position));
+                }
+            }
+            create_systems(hephaestus);
+
+            hephaestus.create_system([this, &hephaestus](const IEngine& engine, std::tuple<> data) {
+                frame++;
+                hephaestus.destroy_entity(live[frame]);
+                live[frame] = hephaestus.create_entity(
+                    Position{.x = 1000.F, .y = 0.F},
+                    Velocity{.dx = 2.F},
+                    Selected{.frame = frame}
+                );
+                hephaestus.add_component(live[frame + 10], Selected{.frame = frame});
+                hephaestus.remove_component<Selected>(live[frame + 20]);
+                hephaestus.set_parent(live[frame + 30], live[frame + 40]);
+                hephaestus.set_enabled(live[frame + 50], false);
+                if (frame == 2) {
+                    hephaestus.remove_parent(live[frame + 29]);
+                    // Destroyed once it exists, at the end of the next frame.
+                    hephaestus.destroy_entity(hephaestus.create_entity(Position{.x = 5.F}));
+                }
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            double position_sum = 0.0;
+            for (std::uint32_t i = 0; i < NUM_FRAMES; ++i) {
+                position_sum = tick(hephaestus);
+            }
+            EXPECT_EQ(recorder->get_num_frames(), NUM_FRAMES);
+
+            linked.assign(live.begin() + 30, live.begin() + 40);
+            recorded = take_snapshot(hephaestus, position_sum);
+            hephaestus.set_command_recorder(nullptr);
+            recorder.reset();
+
+            stop_game();
+        }
+
+      private:
+        std::optional<CommandRecorder> recorder;
+        std::vector<Entity> live;
+        std::uint32_t frame = 0;
+    };
+
+    class TestReplayGame : public Simulation {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            CommandReplayer incomplete;
+            incomplete.register_components<Position, Velocity, Health>();
+            std::stringstream copy{log.str()};
+            EXPECT_EQ(incomplete.load(copy).error(), CommandLogErrorCode::UnknownComponent);
+
+            replayer.register_components<Position, Velocity, Health, Selected>();
+            ASSERT_TRUE(replayer.load(log).has_value());
+            EXPECT_EQ(replayer.get_fixed_delta_time(), 1.0 / 60.0);
+            // The commands of the last tick were never applied, they make up a frame of their own.
+            EXPECT_EQ(replayer.get_num_frames(), NUM_FRAMES + 1);
+
+            create_systems(hephaestus);
+            replayer.attach(hephaestus.get_world());
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            double position_sum = 0.0;
+            for (std::uint32_t i = 0; i < NUM_FRAMES; ++i) {
+                position_sum = tick(hephaestus);
+            }
+            EXPECT_EQ(replayer.get_num_replayed_frames(), NUM_FRAMES);
+            EXPECT_TRUE(take_snapshot(hephaestus, position_sum) == recorded);
+
+            stop_game();
+        }
+
+      private:
+        CommandReplayer replayer;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestRecordGame>{}.run();
+    EXPECT_GT(recorded.num_destroyed, 0);
+    EXPECT_EQ(recorded.parents.size(), 10);
+
+    Engine<TestReplayGame>{}.run();
+}
+
+TEST(HephaestusTest, SaveAndLoadSnapshots) {
+    struct Name : Component<Name> {
+        std::string value;
+    };
+    struct Selected : Component<Selected, SparseStorage> {
+        std::uint32_t frame = 0;
+    };
+    struct Frozen : Component<Frozen> {};
+
+    struct Summary {
+        std::uint32_t num_positions = 0;
+        float position_sum = 0.F;
+        std::uint32_t num_frozen = 0;
+        std::size_t name_lengths = 0;
+        std::uint32_t selected_sum = 0;
+
+        auto operator==(const Summary&) const -> bool = default;
+    };
+
+    static constexpr std::uint32_t NUM_ENTITIES = 1000;
+    static const auto PATH = std::filesystem::temp_directory_path() / "hephaestus_snapshot.bin";
+    static Summary saved;
+
+    // Both games run the same systems, which sum up the state of the world.
+    class Simulation : public SimulationGame<Summary> {
+      protected:
+        static auto make_schema() -> SnapshotSchema {
+            SnapshotSchema schema;
+            schema.register_components<Position, Velocity, Health, Selected, Frozen>();
+            schema.register_component<Name>({
+                .save =
+                    [](const Name& name, std::vector<std::byte>& data) {
+                        const auto size = static_cast<std::uint32_t>(name.value.size());
+                        const auto bytes = std::as_bytes(std::span{&size, 1});
+                        data.insert(data.end(), bytes.begin(), bytes.end());
+                        const auto chars = std::as_bytes(std::span{name.value});
+                        data.insert(data.end(), chars.begin(), chars.end());
+                    },
+                .load = [](std::span<const std::byte>& data) -> std::optional<Name> {
+                    std::uint32_t size = 0;
+                    if (data.size() < sizeof(size)) {
+                        return std::nullopt;
+                    }
+                    std::memcpy(&size, data.data(), sizeof(size));
+                    if (data.size() < sizeof(size) + size) {
+                        return std::nullopt;
+                    }
+
+                    Name name;
+                    const auto* chars = reinterpret_cast<const char*>(data.data());
+                    name.value.assign(chars + sizeof(size), size);
+                    data = data.subspan(sizeof(size) + size);
+                    return name;
+                },
+            });
+            return schema;
+        }
+
+        auto create_systems(Hephaestus& hephaestus) -> void {
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Position&> data) {
+                    update_result([&](Summary& summary) {
+                        summary.num_positions++;
+                        summary.position_sum += std::get<0>(data).x;
+                    });
+                }
+            );
+            hephaestus.create_system<With<Frozen>>(
+                [this](const IEngine& engine, std::tuple<const Position&> data) {
+                    update_result([](Summary& summary) { summary.num_frozen++; });
+                }
+            );
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<const Name&> data) {
+                update_result([&](Summary& summary) {
+                    summary.name_lengths += std::get<0>(data).value.size();
+                });
+            });
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Selected&> data) {
+                    update_result([&](Summary& summary) {
+                        summary.selected_sum += std::get<0>(data).frame;
+                    });
+                }
+            );
+        }
+    };
+
+    class TestSaveGame : public Simulation {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                const auto position = Position{.x = static_cast<float>(i), .y = 0.F};
+                switch (i % 4) {
+                case 0:
+                    hephaestus.create_entity(position, Velocity{.dx = 1.F, .dy = 0.F});
+                    break;
+                case 1:
+                    hephaestus.create_entity(
+                        position,
+                        Health{.value = i},
+                        Name{.value = "entity " + std::to_string(i)}
+                    );
+                    break;
+                case 2:
+                    hephaestus.create_entity(position, Frozen{});
+                    break;
+                default:
+                    hephaestus.create_entity(
+                        position,
+                        Velocity{.dx = 2.F, .dy = 0.F},
+                        Selected{.frame = i}
+                    );
+                    break;
+                }
+            }
+            for (Entity entity = 1; entity < NUM_ENTITIES; entity += 100) {
+                hephaestus.set_parent(entity, entity - 1);
+            }
+            for (Entity entity = 0; entity < NUM_ENTITIES; entity += 7) {
+                hephaestus.set_enabled(entity, false);
+            }
+            hephaestus.destroy_entity(5);
+            create_systems(hephaestus);
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            tick(hephaestus);
+            saved = tick(hephaestus);
+            EXPECT_EQ(saved.num_positions, NUM_ENTITIES - 1 - ((NUM_ENTITIES + 6) / 7));
+
+            SnapshotSchema incomplete;
+            incomplete.register_components<Position, Velocity, Health, Selected, Frozen>();
+            EXPECT_EQ(
+                hephaestus.save_snapshot(PATH, incomplete).error(),
+                SnapshotErrorCode::UnknownComponent
+            );
+            EXPECT_TRUE(hephaestus.save_snapshot(PATH, make_schema()).has_value());
+
+            stop_game();
+        }
+    };
+
+    class TestLoadGame : public Simulation {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto schema = make_schema();
+
+            EXPECT_EQ(
+                hephaestus.load_snapshot(PATH.string() + ".missing", schema).error(),
+                SnapshotErrorCode::CannotOpen
+            );
+            ASSERT_TRUE(hephaestus.load_snapshot(PATH, schema).has_value());
+            EXPECT_EQ(
+                hephaestus.load_snapshot(PATH, schema).error(),
+                SnapshotErrorCode::WorldNotEmpty
+            );
+
+            // Loaded right away, with the handles they were saved with.
+            auto& world = hephaestus.get_world();
+            EXPECT_EQ(world.get_stats().tot_num_created_ents, NUM_ENTITIES - 1);
+            EXPECT_EQ(world.get_parent(101), 100);
+            EXPECT_EQ(world.get_parent(102), NO_PARENT);
+            EXPECT_FALSE(world.is_enabled(14));
+            EXPECT_TRUE(world.is_enabled(15));
+            EXPECT_EQ(hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}), NUM_ENTITIES);
+
+            create_systems(hephaestus);
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            auto loaded = tick(hephaestus);
+            // The entity created after loading.
+            loaded.num_positions--;
+            EXPECT_TRUE(loaded == saved);
+
+            stop_game();
+        }
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestSaveGame>{}.run();
+    Engine<TestLoadGame>{}.run();
+
+    {
+        std::ofstream garbage{PATH, std::ios::binary | std::ios::trunc};
+        garbage << "not a snapshot";
+    }
+    class TestGarbageGame : public MockGame {
+      public:
+        auto start() -> void override {
+            SnapshotSchema schema;
+            EXPECT_EQ(
+                get_engine().get_module<Hephaestus>().load_snapshot(PATH, schema).error(),
+                SnapshotErrorCode::NotASnapshot
+            );
+            stop_game();
+        }
+    };
+    Engine<TestGarbageGame>{}.run();
+    std::filesystem::remove(PATH);
+
+    // A snapshot of an entity per archetype, and of a set of Selected with num_selected entities
+    // but no data.
+    struct Block {
+        // Into Position and Selected.
+        std::vector<std::uint32_t> indices{0};
+        std::size_t column_size = sizeof(Position);
+    };
+    const auto write_snapshot = [](const std::vector<Block>& blocks,
+                                   const std::uint64_t num_selected = 0) {
+        const std::array<std::tuple<ComponentTypeId, std::size_t, SnapshotStorage>, 2> components{{
+            {get_component_type_id<Position>(), sizeof(Position), SnapshotStorage::Column},
+            {get_component_type_id<Selected>(), sizeof(Selected), SnapshotStorage::Sparse},
+        }};
+        detail::SnapshotWriter writer;
+        writer.write(SNAPSHOT_MAGIC);
+        writer.write(SNAPSHOT_VERSION);
+        writer.write(static_cast<Entity>(blocks.size()));
+        writer.write(static_cast<std::uint32_t>(components.size()));
+        writer.write(static_cast<std::uint32_t>(blocks.size()));
+        writer.write(static_cast<std::uint32_t>(num_selected > 0 ? 1 : 0));
+        writer.write(static_cast<std::uint64_t>(0));
+        for (const auto& [component_id, size, storage] : components) {
+            const auto name = ComponentRegistry::get().get_type_name(component_id);
+            writer.write(static_cast<std::uint32_t>(name.size()));
+            writer.write_bytes(std::as_bytes(std::span{name}));
+            writer.write(static_cast<std::uint64_t>(size));
+            writer.write(storage);
+        }
+        for (Entity entity = 0; entity < blocks.size(); ++entity) {
+            const std::uint64_t enabled_mask = 1;
+            writer.write(static_cast<std::uint32_t>(blocks[entity].indices.size()));
+            for (const auto index : blocks[entity].indices) {
+                writer.write(index);
+            }
+            writer.write(static_cast<std::uint64_t>(1));
+            writer.write_block(std::as_bytes(std::span{&entity, 1}));
+            writer.write_block(std::as_bytes(std::span{&enabled_mask, 1}));
+            for (std::size_t i = 0; i < blocks[entity].indices.size(); ++i) {
+                writer.write_block(std::vector<std::byte>(blocks[entity].column_size));
+            }
+        }
+        if (num_selected > 0) {
+            writer.write(static_cast<std::uint32_t>(1));
+            writer.write(num_selected);
+            writer.write_block({});
+            writer.write_block({});
+        }
+        writer.write_block({});
+        return std::vector<std::byte>{writer.get_data().begin(), writer.get_data().end()};
+    };
+
+    // Malformed blocks are rejected before anything is loaded.
+    SnapshotSchema schema;
+    schema.register_components<Position, Selected>();
+    EXPECT_TRUE(detail::parse_snapshot(write_snapshot({{}}), schema).has_value());
+    EXPECT_EQ(
+        detail::parse_snapshot(write_snapshot({{.column_size = sizeof(Position) - 1}}), schema)
+            .error(),
+        SnapshotErrorCode::NotASnapshot
+    );
+    EXPECT_EQ(
+        detail::parse_snapshot(write_snapshot({{}, {}}), schema).error(),
+        SnapshotErrorCode::NotASnapshot
+    );
+    EXPECT_EQ(
+        detail::parse_snapshot(write_snapshot({{.indices = {0, 0}}}), schema).error(),
+        SnapshotErrorCode::NotASnapshot
+    );
+    // The sizes of the empty blocks wrap around to 0 when multiplied.
+    EXPECT_EQ(
+        detail::parse_snapshot(write_snapshot({}, std::uint64_t{1} << 62U), schema).error(),
+        SnapshotErrorCode::NotASnapshot
+    );
+}
+
+TEST(HephaestusTest, InstantiatePrefabs) {
+    struct Name : Component<Name> {
+        std::string value;
+    };
+    struct Marked : Component<Marked, SparseStorage> {
+        std::uint32_t value = 0;
+    };
+    struct Frozen : Component<Frozen> {};
+
+    class TestGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto soldier = hephaestus.create_prefab(
+                Position{.x = 1.F, .y = 2.F},
+                Velocity{.dx = 3.F, .dy = 4.F},
+                Marked{.value = 7},
+                Frozen{}
+            );
+            const auto orc = hephaestus.create_prefab(Health{.value = 10}, Name{.value = "orc"});
+
+            EXPECT_EQ(hephaestus.instantiate(soldier, 100), 0);
+            EXPECT_EQ(hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}), 100);
+            EXPECT_EQ(
+                hephaestus.instantiate(
+                    soldier,
+                    50,
+                    [](std::size_t instance, std::tuple<Position&, Velocity&> components) {
+                        std::get<0>(components).x = static_cast<float>(instance);
+                    }
+                ),
+                101
+            );
+            EXPECT_EQ(hephaestus.instantiate(orc, 0), 151);
+            EXPECT_EQ(hephaestus.instantiate(orc, 20), 151);
+
+            hephaestus.create_system<With<Frozen>>(
+                [this](const IEngine& engine, std::tuple<const Position&, const Velocity&> data) {
+                    const std::scoped_lock lock{mutex};
+                    num_soldiers++;
+                    position_sum += std::get<0>(data).x;
+                    EXPECT_EQ(std::get<1>(data).dy, 4.F);
+                }
+            );
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<const Marked&> data) {
+                const std::scoped_lock lock{mutex};
+                marked_sum += std::get<0>(data).value;
+            });
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Health&, const Name&> data) {
+                    const std::scoped_lock lock{mutex};
+                    num_orcs++;
+                    EXPECT_EQ(std::get<0>(data).value, 10);
+                    EXPECT_EQ(std::get<1>(data).value, "orc");
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.tick();
+            EXPECT_EQ(num_soldiers, 150);
+            // 100 copies of the prefab, and the overridden 0 to 49.
+            EXPECT_EQ(position_sum, 100.F + (49.F * 50.F / 2.F));
+            EXPECT_EQ(marked_sum, 150 * 7);
+            EXPECT_EQ(num_orcs, 20);
+            EXPECT_EQ(hephaestus.get_tot_num_created_ents(), 171);
+
+            // The instances of a prefab made from an entity are copies of its components as
+            // they were when the prefab was made.
+            const auto from_entity = hephaestus.create_prefab_from<Position, Velocity, Frozen>(110);
+            EXPECT_EQ(std::get<Position>(from_entity.get_components()).x, 9.F);
+            EXPECT_EQ(hephaestus.instantiate(from_entity, 10), 171);
+
+            reset();
+            hephaestus.tick();
+            EXPECT_EQ(num_soldiers, 160);
+            EXPECT_EQ(position_sum, 100.F + (49.F * 50.F / 2.F) + 90.F);
+            EXPECT_EQ(marked_sum, 150 * 7);
+            EXPECT_EQ(hephaestus.get_tot_num_created_ents(), 181);
+
+            stop_game();
+        }
+
+      private:
+        auto reset() -> void {
+            num_soldiers = 0;
+            position_sum = 0.F;
+            marked_sum = 0;
+            num_orcs = 0;
+        }
+
+        std::mutex mutex;
+        std::uint32_t num_soldiers = 0;
+        float position_sum = 0.F;
+        std::uint32_t marked_sum = 0;
+        std::uint32_t num_orcs = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, StreamCells) {
+    struct Marked : Component<Marked, SparseStorage> {
+        std::uint32_t value = 0;
+    };
+
+    static constexpr std::uint32_t NUM_MOVING = 2000;
+    static constexpr std::uint32_t NUM_HEALTHY = 300;
+    static constexpr std::uint32_t NUM_CELL_ENTITIES = NUM_MOVING + NUM_HEALTHY;
+    static const auto CELL_PATH = std::filesystem::temp_directory_path() / "hephaestus_cell.bin";
+    // Also holds an archetype which the streaming world doesn't have.
+    static const auto FOREIGN_CELL_PATH =
+        std::filesystem::temp_directory_path() / "hephaestus_foreign_cell.bin";
+
+    static const auto make_schema = []() {
+        SnapshotSchema schema;
+        schema.register_components<Position, Velocity, Health, Marked>();
+        return schema;
+    };
+
+    class TestSaveGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            for (std::uint32_t i = 0; i < NUM_MOVING; ++i) {
+                hephaestus.create_entity(
+                    Position{.x = static_cast<float>(i), .y = 0.F},
+                    Velocity{.dx = 1.F, .dy = 0.F}
+                );
+            }
+            for (std::uint32_t i = 0; i < NUM_HEALTHY; ++i) {
+                hephaestus.create_entity(Health{.value = 1});
+            }
+            for (Entity entity = 0; entity < NUM_MOVING; entity += 10) {
+                hephaestus.set_enabled(entity, false);
+            }
+            for (Entity entity = 5; entity < NUM_CELL_ENTITIES; entity += 100) {
+                hephaestus.add_component(entity, Marked{.value = 2});
+            }
+            for (Entity entity = 500; entity < NUM_MOVING; entity += 500) {
+                hephaestus.set_parent(entity, entity - 1);
+            }
+            // Empty archetypes aren't saved, it's only filled in for the foreign cell.
+            hephaestus.create_archetype<Position, Health>(1);
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.tick();
+            EXPECT_TRUE(hephaestus.save_snapshot(CELL_PATH, make_schema()).has_value());
+
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Health{.value = 1});
+            hephaestus.tick();
+            EXPECT_TRUE(hephaestus.save_snapshot(FOREIGN_CELL_PATH, make_schema()).has_value());
+
+            stop_game();
+        }
+    };
+
+    class TestStreamGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_archetype<Position, Velocity>(NUM_MOVING);
+            hephaestus.create_archetype<Health>(NUM_HEALTHY);
+            // Without a budget every frame moves a single chunk of rows.
+            streamer = &hephaestus.create_streamer(
+                make_schema(),
+                {.commit_budget = 0.0, .evict_budget = 0.0}
+            );
+
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<const Position&> data) {
+                    num_positions++;
+                }
+            );
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<const Health&> data) {
+                num_healthy++;
+            });
+            hephaestus.create_system([this](const IEngine& engine, std::tuple<const Marked&> data) {
+                marked_sum += std::get<0>(data).value;
+            });
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto& world = hephaestus.get_world();
+
+            EXPECT_TRUE(streamer->load_cell(1, CELL_PATH));
+            EXPECT_FALSE(streamer->load_cell(1, CELL_PATH));
+            EXPECT_TRUE(streamer->load_cell(2, FOREIGN_CELL_PATH));
+            EXPECT_TRUE(streamer->load_cell(3, CELL_PATH.string() + ".missing"));
+
+            // Every chunk of rows lands in a frame of its own, the links along with the last one.
+            EXPECT_EQ(tick_while(hephaestus, 1, CellState::Committing), 5);
+            EXPECT_EQ(streamer->get_state(1), CellState::Resident);
+            tick_while(hephaestus, 2, CellState::Committing);
+            EXPECT_EQ(streamer->get_state(2), CellState::Failed);
+            EXPECT_EQ(streamer->get_error(2), SnapshotErrorCode::UnknownArchetype);
+            EXPECT_EQ(streamer->get_state(3), CellState::Failed);
+            EXPECT_EQ(streamer->get_error(3), SnapshotErrorCode::CannotOpen);
+            EXPECT_FALSE(streamer->unload_cell(3));
+
+            const auto entities = streamer->get_entities(1);
+            ASSERT_EQ(entities.size(), NUM_CELL_ENTITIES);
+            std::size_t num_linked = 0;
+            for (const auto entity : entities) {
+                num_linked += world.get_parent(entity) != NO_PARENT ? 1 : 0;
+            }
+            EXPECT_EQ(num_linked, 3);
+            EXPECT_EQ(world.get_stats().tot_num_created_ents, NUM_CELL_ENTITIES);
+
+            reset_counts();
+            hephaestus.tick();
+            EXPECT_EQ(num_positions, NUM_MOVING - (NUM_MOVING / 10));
+            EXPECT_EQ(num_healthy, NUM_HEALTHY);
+            EXPECT_EQ(marked_sum, 2 * NUM_CELL_ENTITIES / 100);
+
+            // The game can destroy streamed entities on its own.
+            hephaestus.destroy_entity(entities.front());
+            EXPECT_TRUE(streamer->unload_cell(1));
+            EXPECT_FALSE(streamer->unload_cell(1));
+            EXPECT_EQ(tick_while(hephaestus, 1, CellState::Unloading), 5);
+            EXPECT_EQ(streamer->get_state(1), CellState::Unloaded);
+            EXPECT_TRUE(streamer->get_entities(1).empty());
+            EXPECT_EQ(world.get_stats().tot_num_destroyed_ents, NUM_CELL_ENTITIES);
+
+            reset_counts();
+            hephaestus.tick();
+            EXPECT_EQ(num_positions, 0);
+            EXPECT_EQ(num_healthy, 0);
+            EXPECT_EQ(marked_sum, 0);
+
+            // Failed cells can be loaded again, and cells are only ever streamed in fresh handles.
+            EXPECT_TRUE(streamer->load_cell(3, CELL_PATH));
+            tick_while(hephaestus, 3, CellState::Committing);
+            EXPECT_EQ(streamer->get_state(3), CellState::Resident);
+            EXPECT_EQ(streamer->get_entities(3).front(), NUM_CELL_ENTITIES);
+
+            stop_game();
+        }
+
+      private:
+        // Waits for the loader, then ticks as long as the cell is in the state. Returns the number
+        // of ticks.
+        auto tick_while(Hephaestus& hephaestus, const CellId cell, const CellState state)
+            -> std::size_t {
+            constexpr std::size_t MAX_WAITS = 10'000;
+            for (std::size_t i = 0;
+                 i < MAX_WAITS && streamer->get_state(cell) == CellState::Loading;
+                 ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+
+            std::size_t num_ticks = 0;
+            while (streamer->get_state(cell) == state && num_ticks < MAX_WAITS) {
+                hephaestus.tick();
+                num_ticks++;
+            }
+            return num_ticks;
+        }
+
+        auto reset_counts() -> void {
+            num_positions = 0;
+            num_healthy = 0;
+            marked_sum = 0;
+        }
+
+        WorldStreamer* streamer = nullptr;
+        std::atomic<std::uint32_t> num_positions = 0;
+        std::atomic<std::uint32_t> num_healthy = 0;
+        std::atomic<std::uint32_t> marked_sum = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestSaveGame>{}.run();
+    Engine<TestStreamGame>{}.run();
+    std::filesystem::remove(CELL_PATH);
+    std::filesystem::remove(FOREIGN_CELL_PATH);
+}
+
+TEST(HephaestusTest, ReloadCancelledCell) {
+    struct Gated : Component<Gated> {
+        std::uint32_t value = 0;
+    };
+
+    static constexpr std::uint32_t NUM_ENTITIES = 100;
+    static const auto CELL_PATH =
+        std::filesystem::temp_directory_path() / "hephaestus_gated_cell.bin";
+    // Loading a Gated value waits for it, which keeps the loader busy with a load for as long as
+    // the test needs.
+    static std::atomic<bool> is_released = false;
+
+    static const auto make_schema = []() {
+        SnapshotSchema schema;
+        schema.register_component<Gated>({
+            .save =
+                [](const Gated& gated, std::vector<std::byte>& data) {
+                    const auto bytes = std::as_bytes(std::span{&gated.value, 1});
+                    data.insert(data.end(), bytes.begin(), bytes.end());
+                },
+            .load = [](std::span<const std::byte>& data) -> std::optional<Gated> {
+                is_released.wait(false);
+                Gated gated;
+                if (data.size() < sizeof(gated.value)) {
+                    return std::nullopt;
+                }
+                std::memcpy(&gated.value, data.data(), sizeof(gated.value));
+                data = data.subspan(sizeof(gated.value));
+                return gated;
+            },
+        });
+        return schema;
+    };
+
+    class TestSaveGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                hephaestus.create_entity(Gated{.value = i});
+            }
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.tick();
+            EXPECT_TRUE(hephaestus.save_snapshot(CELL_PATH, make_schema()).has_value());
+            stop_game();
+        }
+    };
+
+    class TestStreamGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.create_archetype<Gated>(NUM_ENTITIES);
+            streamer = &hephaestus.create_streamer(make_schema(), {});
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            // Cancelled before it ever reaches the world, then loaded again while the loader is
+            // still busy with the cancelled load, whose result must not be taken for the new one.
+            EXPECT_TRUE(streamer->load_cell(1, CELL_PATH));
+            EXPECT_TRUE(streamer->unload_cell(1));
+            EXPECT_EQ(streamer->get_state(1), CellState::Unloaded);
+            EXPECT_TRUE(streamer->load_cell(1, CELL_PATH.string() + ".missing"));
+            is_released = true;
+            is_released.notify_all();
+
+            constexpr std::size_t MAX_WAITS = 10'000;
+            for (std::size_t i = 0;
+                 i < MAX_WAITS && streamer->get_state(1) == CellState::Loading;
+                 ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            hephaestus.tick();
+            EXPECT_EQ(streamer->get_state(1), CellState::Failed);
+            EXPECT_EQ(streamer->get_error(1), SnapshotErrorCode::CannotOpen);
+            EXPECT_EQ(hephaestus.get_world().get_stats().tot_num_created_ents, 0);
+
+            stop_game();
+        }
+
+      private:
+        WorldStreamer* streamer = nullptr;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestSaveGame>{}.run();
+    Engine<TestStreamGame>{}.run();
+    std::filesystem::remove(CELL_PATH);
+}
+
+TEST(HephaestusTest, CheckpointAndResimulate) {
+    constexpr std::uint32_t NUM_ENTITIES = 2000;
+    constexpr std::uint32_t NUM_MOVING = 1000;
+    // The sum of the initial x of the positions.
+    constexpr float START_SUM = NUM_ENTITIES * (NUM_ENTITIES - 1) / 2.F;
+
+    class TestGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.enable_checkpoints<Position, Velocity, Health>(
+                {.num_frames = 4, .chunk_size = 1024}
+            );
+
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                hephaestus.create_entity(
+                    Position{.x = static_cast<float>(i), .y = 0.F},
+                    Velocity{.dx = i < NUM_MOVING ? 1.F : 0.F, .dy = 0.F}
+                );
+            }
+            for (std::uint32_t i = 0; i < 100; ++i) {
+                hephaestus.create_entity(Health{.value = i});
+            }
+
+            // Every x stays a small whole number, so the sum doesn't depend on the order.
+            hephaestus.create_system(
+                [this](const IEngine& engine, std::tuple<Position&, const Velocity&> data) {
+                    auto& position = std::get<0>(data);
+                    position.x += std::get<1>(data).dx;
+
+                    const std::scoped_lock lock{mutex};
+                    position_sum += position.x;
+                }
+            );
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto& checkpoints = *hephaestus.get_world().get_checkpoints();
+            const auto expect_tick = [this, &hephaestus](const float sum) {
+                position_sum = 0.F;
+                hephaestus.tick();
+                EXPECT_EQ(position_sum, sum);
+            };
+
+            for (std::uint32_t frame = 1; frame <= 6; ++frame) {
+                expect_tick(START_SUM + static_cast<float>(NUM_MOVING * frame));
+            }
+            EXPECT_EQ(checkpoints.get_frame(), 6);
+            EXPECT_EQ(checkpoints.get_oldest_frame(), 3);
+
+            // Only the chunks of the moving positions are copied, 128 positions per chunk. The
+            // velocities and healths have no writers and are shared without being read.
+            const auto moving_chunks = (NUM_MOVING + 127) / 128;
+            EXPECT_EQ(checkpoints.get_stats().copied_bytes, moving_chunks * 1024);
+
+            EXPECT_FALSE(hephaestus.restore_checkpoint(2));
+            EXPECT_FALSE(hephaestus.restore_checkpoint(7));
+
+            // Resimulating from frame 4 ends up where the first run did.
+            EXPECT_TRUE(hephaestus.restore_checkpoint(4));
+            EXPECT_EQ(checkpoints.get_frame(), 4);
+            expect_tick(START_SUM + static_cast<float>(NUM_MOVING * 5));
+            EXPECT_EQ(checkpoints.get_stats().copied_bytes, moving_chunks * 1024);
+            expect_tick(START_SUM + static_cast<float>(NUM_MOVING * 6));
+
+            // Destroyed entities stay destroyed, the rows of the others are restored wherever
+            // they moved to.
+            hephaestus.destroy_entity(0);
+            hephaestus.destroy_entity(NUM_ENTITIES - 1);
+            expect_tick(START_SUM + static_cast<float>(NUM_MOVING * 7));
+            const auto destroyed = [](const std::uint32_t frame) {
+                return static_cast<float>(frame + NUM_ENTITIES - 1);
+            };
+            expect_tick(START_SUM + static_cast<float>(NUM_MOVING * 8) - destroyed(8));
+
+            EXPECT_TRUE(hephaestus.restore_checkpoint(6));
+            expect_tick(START_SUM + static_cast<float>(NUM_MOVING * 7) - destroyed(7));
+            EXPECT_EQ(checkpoints.get_frame(), 7);
+
+            stop_game();
+        }
+
+      private:
+        std::mutex mutex;
+        float position_sum = 0.F;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, ObserveComponents) {
+    struct Marked : Component<Marked, SparseStorage> {
+        std::uint32_t value = 0;
+    };
+
+    class TestGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            const auto record = [this](std::vector<std::vector<Entity>>& batches) {
+                return [this, &batches](const IEngine& engine, std::span<const Entity> entities) {
+                    batches.emplace_back(entities.begin(), entities.end());
+                };
+            };
+            hephaestus.on_add<Position>(record(added_positions));
+            hephaestus.on_remove<Position>(record(removed_positions));
+            hephaestus.on_add<Marked>(record(added_marks));
+            hephaestus.on_change<Marked>(record(changed_marks));
+            hephaestus.on_remove<Marked>(record(removed_marks));
+
+            for (std::uint32_t i = 0; i < 10; ++i) {
+                hephaestus.create_entity(Position{.x = 0.F, .y = 0.F});
+            }
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Marked{.value = 1});
+            hephaestus.create_entity(Position{.x = 0.F, .y = 0.F}, Marked{.value = 2});
+            hephaestus.create_entity(Health{.value = 3});
+        }
+
+        auto post_start() -> void override {
+            using Batches = std::vector<std::vector<Entity>>;
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            // Every observer is called once with all the entities of the frame.
+            hephaestus.tick();
+            EXPECT_EQ(added_positions, (Batches{{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}}));
+            EXPECT_EQ(added_marks, (Batches{{10, 11}}));
+            EXPECT_TRUE(changed_marks.empty());
+            EXPECT_TRUE(removed_positions.empty());
+            clear();
+
+            hephaestus.add_component(0, Marked{.value = 4});
+            hephaestus.add_component(10, Marked{.value = 5});
+            hephaestus.remove_component<Marked>(11);
+            hephaestus.remove_component<Marked>(1);
+            hephaestus.destroy_entity(10);
+            hephaestus.destroy_entity(3);
+            hephaestus.destroy_entity(12);
+            hephaestus.tick();
+            EXPECT_EQ(added_marks, (Batches{{0}}));
+            EXPECT_EQ(changed_marks, (Batches{{10}}));
+            // The removed components are delivered with the queues, the destroyed entities at the
+            // end of the frame.
+            EXPECT_EQ(removed_marks, (Batches{{11}, {10}}));
+            EXPECT_EQ(removed_positions, (Batches{{3, 10}}));
+            EXPECT_TRUE(added_positions.empty());
+            clear();
+
+            // Nothing happened, nothing is delivered.
+            hephaestus.tick();
+            EXPECT_TRUE(added_positions.empty());
+            EXPECT_TRUE(removed_positions.empty());
+            EXPECT_TRUE(removed_marks.empty());
+
+            stop_game();
+        }
+
+      private:
+        auto clear() -> void {
+            added_positions.clear();
+            removed_positions.clear();
+            added_marks.clear();
+            changed_marks.clear();
+            removed_marks.clear();
+        }
+
+        std::vector<std::vector<Entity>> added_positions;
+        std::vector<std::vector<Entity>> removed_positions;
+        std::vector<std::vector<Entity>> added_marks;
+        std::vector<std::vector<Entity>> changed_marks;
+        std::vector<std::vector<Entity>> removed_marks;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
+
+TEST(HephaestusTest, SendAndReadEvents) {
+    struct Damage {
+        std::uint32_t amount = 0;
+    };
+    static constexpr std::uint32_t NUM_ENTITIES = 1000;
+
+    // Writers of an event don't conflict with each other, only with its readers.
+    auto writer = make_system_dependencies<const Health&>();
+    SystemParams<EventWriter<Damage>>::add_dependencies(writer);
+    auto other_writer = make_system_dependencies<const Position&>();
+    SystemParams<EventWriter<Damage>>::add_dependencies(other_writer);
+    auto reader = make_system_dependencies<>();
+    SystemParams<EventReader<Damage>>::add_dependencies(reader);
+
+    EXPECT_FALSE(are_dependencies_overlapping(writer, other_writer));
+    EXPECT_TRUE(are_dependencies_overlapping(writer, reader));
+    EXPECT_TRUE(is_appending_to_reads(writer, reader));
+    EXPECT_FALSE(is_appending_to_reads(reader, writer));
+
+    class TestGame : public MockGame {
+      public:
+        auto start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+            hephaestus.add_event<Damage>();
+
+            // Created before the writer, still runs after it.
+            hephaestus.create_system([this](const IEngine& engine,
+                                            std::tuple<> data,
+                                            EventReader<Damage> damage) {
+                num_received = damage.size();
+                total_damage = 0;
+                for (const auto& event : damage) {
+                    total_damage += event.amount;
+                }
+            });
+            hephaestus.create_system([](const IEngine& engine,
+                                        std::tuple<const Health&> data,
+                                        EventWriter<Damage> damage) {
+                damage.send(Damage{.amount = std::get<0>(data).value});
+            });
+
+            for (std::uint32_t i = 0; i < NUM_ENTITIES; ++i) {
+                hephaestus.create_entity(Health{.value = 1});
+            }
+        }
+
+        auto post_start() -> void override {
+            auto& hephaestus = get_engine().get_module<Hephaestus>();
+
+            // Sent outside of the systems, read in the next frame along with the ones of the
+            // writer.
+            hephaestus.send_event<Damage>(Damage{.amount = 5000});
+            hephaestus.tick();
+            EXPECT_EQ(num_received, NUM_ENTITIES + 1);
+            EXPECT_EQ(total_damage, NUM_ENTITIES + 5000);
+            EXPECT_EQ(hephaestus.get_world().get_events<Damage>().size(), NUM_ENTITIES + 1);
+
+            // Every event is read once.
+            hephaestus.tick();
+            EXPECT_EQ(num_received, NUM_ENTITIES);
+            EXPECT_EQ(total_damage, NUM_ENTITIES);
+
+            stop_game();
+        }
+
+      private:
+        std::size_t num_received = 0;
+        std::uint32_t total_damage = 0;
+    };
+
+    USE_SHOULD_STOP = true;
+    Engine<TestGame>{}.run();
+}
 } // namespace atlas::hephauestus::test